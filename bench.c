@@ -0,0 +1,629 @@
+/**
+ * Benchmark suite for key setup, block and CFB throughput
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish.h>
+#include <blowfish_cfb64.h>
+#include <blowfish_dispatch.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#define BENCH_PERF
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BENCH_TSC
+#include <x86intrin.h>
+#endif
+
+// Smallest and default largest message size in bytes
+const size_t BENCH_MIN_SIZE     = 8;
+const size_t BENCH_DEFAULT_SIZE = 1024 * 1024 * 1024;
+
+// Factor between successive message sizes
+const size_t BENCH_SIZE_STEP = 8;
+
+// Default minimum measurement time per case in milliseconds
+const unsigned long BENCH_DEFAULT_TIME = 200;
+
+// Number of blocks encrypted per operation of the single-block case
+const size_t BENCH_BLOCKS_PER_OP = 1024;
+
+enum bench_counter_e
+{
+    BENCH_COUNTER_CYCLES,
+    BENCH_COUNTER_INSTRUCTIONS,
+    BENCH_COUNTER_L1D_MISSES
+};
+typedef enum bench_counter_e bench_counter;
+
+// Number of hardware counters
+#define BENCH_COUNTER_COUNT 3
+
+typedef struct bench_counters_s bench_counters;
+struct bench_counters_s
+{
+    int      fds[BENCH_COUNTER_COUNT];
+    uint64_t values[BENCH_COUNTER_COUNT];
+    int      valid[BENCH_COUNTER_COUNT];
+};
+
+typedef struct bench_context_s bench_context;
+struct bench_context_s
+{
+    bf_state       cipher_state;
+    unsigned char  *buffer;
+    size_t         max_size;
+    double         min_time;
+    int            json;
+    size_t         result_count;
+    bench_counters counters;
+};
+
+typedef void (*bench_func)(bench_context *context, size_t size);
+
+typedef struct bench_result_s bench_result;
+struct bench_result_s
+{
+    const char *name;
+    size_t     bytes_per_op;
+    uint64_t   iterations;
+    double     elapsed;
+    uint64_t   tsc_cycles;
+    uint64_t   counters[BENCH_COUNTER_COUNT];
+    int        valid[BENCH_COUNTER_COUNT];
+};
+
+static int bench_parse_options(int argc, char *argv[], bench_context *context);
+static void bench_run(bench_context *context, const char *name, bench_func func, size_t size,
+                      size_t bytes_per_op);
+static void bench_report(bench_context *context, const bench_result *result);
+static void bench_set_key(bench_context *context, size_t size);
+static void bench_encrypt64(bench_context *context, size_t size);
+static void bench_cfb64_encrypt(bench_context *context, size_t size);
+static void bench_cfb64_decrypt(bench_context *context, size_t size);
+static void bench_counters_open(bench_counters *counters);
+static void bench_counters_close(bench_counters *counters);
+static void bench_counters_start(bench_counters *counters);
+static void bench_counters_stop(bench_counters *counters);
+static uint64_t bench_tsc(void);
+static double bench_now(void);
+static void bench_usage(const char *program);
+
+
+int main(int argc, char *argv[])
+{
+    bench_context *context = malloc(sizeof (bench_context));
+    if (context == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    if (bench_parse_options(argc, argv, context) != 0)
+    {
+        bench_usage(argv[0]);
+        free(context);
+        return EXIT_FAILURE;
+    }
+
+    context->buffer = malloc(context->max_size);
+    if (context->buffer == NULL)
+    {
+        fprintf(stderr, "Cannot allocate %zu bytes for the message buffer\n", context->max_size);
+        free(context);
+        return EXIT_FAILURE;
+    }
+    // Touch all pages before measuring
+    memset(context->buffer, 0xA5, context->max_size);
+
+    const unsigned char key[] = "0123456789ABCDEF";
+    blowfish_init(&context->cipher_state);
+    blowfish_set_key(&context->cipher_state, key, sizeof (key) - 1);
+
+    bench_counters_open(&context->counters);
+    context->result_count = 0;
+
+    const char *kernel_name = blowfish_impl_name(blowfish_active_impl());
+    if (context->json)
+    {
+        printf("{\n  \"kernel\": \"%s\",\n  \"results\": [", kernel_name);
+    }
+    else
+    {
+        printf("Kernel: %s\n", kernel_name);
+        printf("%-16s %12s %12s %10s %10s %8s %12s\n",
+               "case", "bytes", "ns/op", "MB/s", "cycles/B", "IPC", "L1D miss/op");
+    }
+
+    bench_run(context, "set_key", bench_set_key, sizeof (key) - 1, 0);
+    bench_run(context, "encrypt64", bench_encrypt64, 0, BENCH_BLOCKS_PER_OP * sizeof (uint64_t));
+    for (size_t size = BENCH_MIN_SIZE; size <= context->max_size; size *= BENCH_SIZE_STEP)
+    {
+        bench_run(context, "cfb64_encrypt", bench_cfb64_encrypt, size, size);
+        bench_run(context, "cfb64_decrypt", bench_cfb64_decrypt, size, size);
+    }
+
+    if (context->json)
+    {
+        printf("\n  ]\n}\n");
+    }
+
+    bench_counters_close(&context->counters);
+    blowfish_clear(&context->cipher_state);
+    free(context->buffer);
+    free(context);
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Parses the command line options
+ *
+ * @param argc    Number of arguments
+ * @param argv    The arguments
+ * @param context Receives the options
+ * @return        0 on success, -1 if the options are invalid
+ */
+static int bench_parse_options(int argc, char *argv[], bench_context *context)
+{
+    int rc = 0;
+
+    context->max_size = BENCH_DEFAULT_SIZE;
+    context->min_time = (double) BENCH_DEFAULT_TIME / 1000;
+    context->json     = 0;
+
+    int option;
+    while (rc == 0 && (option = getopt(argc, argv, "jm:t:")) != -1)
+    {
+        switch (option)
+        {
+            case 'j':
+                context->json = 1;
+                break;
+            case 'm':
+            {
+                char *end = NULL;
+                unsigned long long max_size = strtoull(optarg, &end, 10);
+                if (*end != '\0' || max_size < BENCH_MIN_SIZE || max_size > SIZE_MAX)
+                {
+                    fprintf(stderr, "Invalid maximum message size '%s'\n", optarg);
+                    rc = -1;
+                }
+                context->max_size = (size_t) max_size;
+                break;
+            }
+            case 't':
+            {
+                char *end = NULL;
+                unsigned long min_time = strtoul(optarg, &end, 10);
+                if (*end != '\0' || min_time == 0)
+                {
+                    fprintf(stderr, "Invalid measurement time '%s'\n", optarg);
+                    rc = -1;
+                }
+                context->min_time = (double) min_time / 1000;
+                break;
+            }
+            default:
+                rc = -1;
+                break;
+        }
+    }
+
+    if (rc == 0 && optind != argc)
+    {
+        rc = -1;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Runs a benchmark case and reports the result
+ *
+ * The number of iterations is doubled until a run takes at least the
+ * minimum measurement time; the last run is reported.
+ *
+ * @param context      The benchmark context
+ * @param name         Name of the case
+ * @param func         Function that performs one operation
+ * @param size         Size argument passed to the function
+ * @param bytes_per_op Number of bytes processed per operation, 0 if not applicable
+ */
+static void bench_run(bench_context *context, const char *name, bench_func func, size_t size,
+                      size_t bytes_per_op)
+{
+    bench_result result;
+    memset(&result, 0, sizeof (result));
+    result.name         = name;
+    result.bytes_per_op = bytes_per_op;
+
+    // Warm up the caches and branch predictors
+    func(context, size);
+
+    uint64_t iterations = 1;
+    while (1)
+    {
+        bench_counters_start(&context->counters);
+        uint64_t tsc_start = bench_tsc();
+        double start = bench_now();
+        for (uint64_t iteration = 0; iteration < iterations; ++iteration)
+        {
+            func(context, size);
+        }
+        double elapsed = bench_now() - start;
+        uint64_t tsc_end = bench_tsc();
+        bench_counters_stop(&context->counters);
+
+        if (elapsed >= context->min_time || iterations >= UINT64_MAX / 2)
+        {
+            result.iterations = iterations;
+            result.elapsed    = elapsed;
+            result.tsc_cycles = tsc_end - tsc_start;
+            memcpy(result.counters, context->counters.values, sizeof (result.counters));
+            memcpy(result.valid, context->counters.valid, sizeof (result.valid));
+            break;
+        }
+        iterations *= 2;
+    }
+
+    bench_report(context, &result);
+}
+
+
+/**
+ * Prints a result as a table row or as a JSON object
+ *
+ * Cycles are taken from the hardware cycle counter if available,
+ * otherwise from the time stamp counter.
+ *
+ * @param context The benchmark context
+ * @param result  The result to print
+ */
+static void bench_report(bench_context *context, const bench_result *result)
+{
+    double ops = (double) result->iterations;
+    double ns_per_op = result->elapsed * 1e9 / ops;
+    double cycles = result->valid[BENCH_COUNTER_CYCLES] ?
+                    (double) result->counters[BENCH_COUNTER_CYCLES] : (double) result->tsc_cycles;
+    int have_cycles = result->valid[BENCH_COUNTER_CYCLES] || result->tsc_cycles > 0;
+    int have_ipc = result->valid[BENCH_COUNTER_CYCLES] && result->valid[BENCH_COUNTER_INSTRUCTIONS] &&
+                   result->counters[BENCH_COUNTER_CYCLES] > 0;
+    int have_misses = result->valid[BENCH_COUNTER_L1D_MISSES];
+    int have_bytes = result->bytes_per_op > 0;
+
+    double mb_per_s = have_bytes ? (double) result->bytes_per_op * ops / result->elapsed / 1e6 : 0;
+    double cycles_per_byte = have_bytes ? cycles / ((double) result->bytes_per_op * ops) : 0;
+    double ipc = have_ipc ? (double) result->counters[BENCH_COUNTER_INSTRUCTIONS] /
+                            (double) result->counters[BENCH_COUNTER_CYCLES] : 0;
+    double misses_per_op = have_misses ? (double) result->counters[BENCH_COUNTER_L1D_MISSES] / ops : 0;
+
+    if (context->json)
+    {
+        printf("%s\n    {\"case\": \"%s\", \"bytes\": %zu, \"iterations\": %llu, \"ns_per_op\": %.3f",
+               context->result_count > 0 ? "," : "", result->name, result->bytes_per_op,
+               (unsigned long long) result->iterations, ns_per_op);
+        if (have_bytes)
+        {
+            printf(", \"mb_per_s\": %.3f", mb_per_s);
+        }
+        else
+        {
+            printf(", \"mb_per_s\": null");
+        }
+        if (have_bytes && have_cycles)
+        {
+            printf(", \"cycles_per_byte\": %.3f", cycles_per_byte);
+        }
+        else
+        {
+            printf(", \"cycles_per_byte\": null");
+        }
+        printf(", \"cycle_source\": \"%s\"",
+               result->valid[BENCH_COUNTER_CYCLES] ? "perf" : (result->tsc_cycles > 0 ? "tsc" : "none"));
+        if (have_ipc)
+        {
+            printf(", \"ipc\": %.3f", ipc);
+        }
+        else
+        {
+            printf(", \"ipc\": null");
+        }
+        if (have_misses)
+        {
+            printf(", \"l1d_misses_per_op\": %.3f}", misses_per_op);
+        }
+        else
+        {
+            printf(", \"l1d_misses_per_op\": null}");
+        }
+    }
+    else
+    {
+        char mb_text[32] = "-";
+        char cycles_text[32] = "-";
+        char ipc_text[32] = "-";
+        char misses_text[32] = "-";
+        if (have_bytes)
+        {
+            snprintf(mb_text, sizeof (mb_text), "%.1f", mb_per_s);
+        }
+        if (have_bytes && have_cycles)
+        {
+            snprintf(cycles_text, sizeof (cycles_text), "%.2f", cycles_per_byte);
+        }
+        if (have_ipc)
+        {
+            snprintf(ipc_text, sizeof (ipc_text), "%.2f", ipc);
+        }
+        if (have_misses)
+        {
+            snprintf(misses_text, sizeof (misses_text), "%.1f", misses_per_op);
+        }
+        printf("%-16s %12zu %12.1f %10s %10s %8s %12s\n",
+               result->name, result->bytes_per_op, ns_per_op, mb_text, cycles_text, ipc_text, misses_text);
+    }
+    fflush(stdout);
+
+    ++context->result_count;
+}
+
+
+/**
+ * Expands a key schedule
+ *
+ * @param context The benchmark context
+ * @param size    Length of the key
+ */
+static void bench_set_key(bench_context *context, size_t size)
+{
+    bf_state *state = &context->cipher_state;
+    blowfish_init(state);
+    blowfish_set_key(state, context->buffer, size);
+}
+
+
+/**
+ * Encrypts a chain of single blocks, each depending on the previous one
+ *
+ * @param context The benchmark context
+ * @param size    Unused, each operation encrypts BENCH_BLOCKS_PER_OP blocks
+ */
+static void bench_encrypt64(bench_context *context, size_t size)
+{
+    (void) size;
+
+    uint64_t data = 0;
+    memcpy(&data, context->buffer, sizeof (data));
+    for (size_t block = 0; block < BENCH_BLOCKS_PER_OP; ++block)
+    {
+        data = blowfish_encrypt64(&context->cipher_state, data);
+    }
+    // Keeps the compiler from discarding the loop
+    memcpy(context->buffer, &data, sizeof (data));
+}
+
+
+/**
+ * Encrypts a message in CFB mode
+ *
+ * @param context The benchmark context
+ * @param size    Length of the message
+ */
+static void bench_cfb64_encrypt(bench_context *context, size_t size)
+{
+    bf_cfb64_state cfb_state;
+    blowfish_cfb64_init(&cfb_state, &context->cipher_state, 0);
+    blowfish_cfb64_encrypt(&cfb_state, context->buffer, size);
+}
+
+
+/**
+ * Decrypts a message in CFB mode
+ *
+ * @param context The benchmark context
+ * @param size    Length of the message
+ */
+static void bench_cfb64_decrypt(bench_context *context, size_t size)
+{
+    bf_cfb64_state cfb_state;
+    blowfish_cfb64_init(&cfb_state, &context->cipher_state, 0);
+    blowfish_cfb64_decrypt(&cfb_state, context->buffer, size);
+}
+
+
+/**
+ * Opens the hardware counters that are available
+ *
+ * Counters that cannot be opened, e.g. because of perf_event_paranoid
+ * or a virtual machine without a PMU, are reported as unavailable.
+ *
+ * @param counters Receives the counter file descriptors
+ */
+static void bench_counters_open(bench_counters *counters)
+{
+    for (size_t index = 0; index < BENCH_COUNTER_COUNT; ++index)
+    {
+        counters->fds[index]    = -1;
+        counters->values[index] = 0;
+        counters->valid[index]  = 0;
+    }
+
+#ifdef BENCH_PERF
+    const uint32_t types[BENCH_COUNTER_COUNT] =
+    {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE
+    };
+    const uint64_t configs[BENCH_COUNTER_COUNT] =
+    {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)
+    };
+
+    for (size_t index = 0; index < BENCH_COUNTER_COUNT; ++index)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof (attr));
+        attr.size           = sizeof (attr);
+        attr.type           = types[index];
+        attr.config         = configs[index];
+        attr.disabled       = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv     = 1;
+        counters->fds[index] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+
+/**
+ * Closes the hardware counters
+ *
+ * @param counters The counters
+ */
+static void bench_counters_close(bench_counters *counters)
+{
+    for (size_t index = 0; index < BENCH_COUNTER_COUNT; ++index)
+    {
+        if (counters->fds[index] >= 0)
+        {
+            close(counters->fds[index]);
+            counters->fds[index] = -1;
+        }
+    }
+}
+
+
+/**
+ * Resets and enables the hardware counters
+ *
+ * @param counters The counters
+ */
+static void bench_counters_start(bench_counters *counters)
+{
+#ifdef BENCH_PERF
+    for (size_t index = 0; index < BENCH_COUNTER_COUNT; ++index)
+    {
+        if (counters->fds[index] >= 0)
+        {
+            ioctl(counters->fds[index], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[index], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#else
+    (void) counters;
+#endif
+}
+
+
+/**
+ * Disables the hardware counters and reads their values
+ *
+ * @param counters The counters, receives the values
+ */
+static void bench_counters_stop(bench_counters *counters)
+{
+    for (size_t index = 0; index < BENCH_COUNTER_COUNT; ++index)
+    {
+        counters->valid[index] = 0;
+#ifdef BENCH_PERF
+        if (counters->fds[index] >= 0)
+        {
+            ioctl(counters->fds[index], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t value = 0;
+            if (read(counters->fds[index], &value, sizeof (value)) == (ssize_t) sizeof (value))
+            {
+                counters->values[index] = value;
+                counters->valid[index]  = 1;
+            }
+        }
+#endif
+    }
+}
+
+
+/**
+ * Reads the time stamp counter
+ *
+ * @return The time stamp counter, or 0 if not available on this platform
+ */
+static uint64_t bench_tsc(void)
+{
+#ifdef BENCH_TSC
+    return (uint64_t) __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+
+/**
+ * Returns the current time of the monotonic clock
+ *
+ * @return Time in seconds
+ */
+static double bench_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+/**
+ * Prints the usage information
+ *
+ * @param program Name of the program
+ */
+static void bench_usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s [-j] [-m max_bytes] [-t min_time_ms]\n"
+            "  -j  Print the results as JSON\n"
+            "  -m  Largest message size, default %zu bytes\n"
+            "  -t  Minimum measurement time per case, default %lu ms\n",
+            program, BENCH_DEFAULT_SIZE, BENCH_DEFAULT_TIME);
+}
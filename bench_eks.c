@@ -0,0 +1,222 @@
+/**
+ * Benchmark of EksBlowfish hashes per second for a range of cost factors
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish_eks.h>
+#include <blowfish_dispatch.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// Default range of cost factors
+const unsigned int BENCH_EKS_DEFAULT_MIN_COST = 4;
+const unsigned int BENCH_EKS_DEFAULT_MAX_COST = 10;
+
+// Default number of hashes per batch verification
+const size_t BENCH_EKS_DEFAULT_BATCH = 16;
+
+// Minimum measurement time per cost factor and method in seconds
+const double BENCH_EKS_MIN_TIME = 0.5;
+
+static int bench_eks_parse_number(const char *text, unsigned long *value);
+static double bench_eks_single(unsigned int cost, size_t *hash_count);
+static double bench_eks_batch(unsigned int cost, size_t batch_size, size_t *hash_count);
+static void bench_eks_fill(bf_eks_hash *hash, unsigned int cost, size_t index);
+static double bench_eks_now(void);
+
+
+int main(int argc, char *argv[])
+{
+    unsigned long min_cost   = BENCH_EKS_DEFAULT_MIN_COST;
+    unsigned long max_cost   = BENCH_EKS_DEFAULT_MAX_COST;
+    unsigned long batch_size = BENCH_EKS_DEFAULT_BATCH;
+
+    if (argc > 4 ||
+        (argc > 1 && bench_eks_parse_number(argv[1], &min_cost) != 0) ||
+        (argc > 2 && bench_eks_parse_number(argv[2], &max_cost) != 0) ||
+        (argc > 3 && bench_eks_parse_number(argv[3], &batch_size) != 0) ||
+        min_cost < BF_EKS_MIN_COST || max_cost > BF_EKS_MAX_COST || min_cost > max_cost ||
+        batch_size < 1)
+    {
+        fprintf(stderr, "Usage: %s [min_cost [max_cost [batch_size]]]\n", argv[0]);
+        fprintf(stderr, "       cost factors %u to %u, defaults %u to %u, batch size default %zu\n",
+                BF_EKS_MIN_COST, BF_EKS_MAX_COST,
+                BENCH_EKS_DEFAULT_MIN_COST, BENCH_EKS_DEFAULT_MAX_COST, BENCH_EKS_DEFAULT_BATCH);
+        return EXIT_FAILURE;
+    }
+
+    printf("Kernel: %s, batch size %lu\n", blowfish_impl_name(blowfish_active_impl()), batch_size);
+    printf("%4s  %14s  %14s  %8s\n", "cost", "single hash/s", "batch hash/s", "speedup");
+    for (unsigned int cost = (unsigned int) min_cost; cost <= max_cost; ++cost)
+    {
+        size_t single_count = 0;
+        double single_time = bench_eks_single(cost, &single_count);
+        size_t batch_count = 0;
+        double batch_time = bench_eks_batch(cost, (size_t) batch_size, &batch_count);
+        if (batch_time < 0)
+        {
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+
+        double single_rate = (double) single_count / single_time;
+        double batch_rate  = (double) batch_count / batch_time;
+        printf("%4u  %14.2f  %14.2f  %7.2fx\n", cost, single_rate, batch_rate, batch_rate / single_rate);
+        fflush(stdout);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * Parses a decimal number
+ *
+ * @param text  The text to parse
+ * @param value Receives the number
+ * @return      0 on success, -1 if the text is not a decimal number
+ */
+static int bench_eks_parse_number(const char *text, unsigned long *value)
+{
+    char *end = NULL;
+    (*value) = strtoul(text, &end, 10);
+    return *text != '\0' && *end == '\0' ? 0 : -1;
+}
+
+
+/**
+ * Measures the rate of hashes computed one at a time
+ *
+ * @param cost       The cost factor
+ * @param hash_count Receives the number of hashes computed
+ * @return           The elapsed time in seconds
+ */
+static double bench_eks_single(unsigned int cost, size_t *hash_count)
+{
+    double start = bench_eks_now();
+    double elapsed = 0;
+    size_t count = 0;
+    do
+    {
+        bf_eks_hash hash;
+        bench_eks_fill(&hash, cost, count);
+        blowfish_eks_verify(&hash, (const unsigned char *) "password", 8);
+        ++count;
+        elapsed = bench_eks_now() - start;
+    }
+    while (elapsed < BENCH_EKS_MIN_TIME);
+
+    (*hash_count) = count;
+    return elapsed;
+}
+
+
+/**
+ * Measures the rate of hashes verified in batches
+ *
+ * @param cost       The cost factor
+ * @param batch_size The number of hashes per batch
+ * @param hash_count Receives the number of hashes verified
+ * @return           The elapsed time in seconds, or -1 if out of memory
+ */
+static double bench_eks_batch(unsigned int cost, size_t batch_size, size_t *hash_count)
+{
+    bf_eks_hash *hashes = malloc(sizeof (bf_eks_hash) * batch_size);
+    const unsigned char **passwords = malloc(sizeof (unsigned char *) * batch_size);
+    size_t *password_lengths = malloc(sizeof (size_t) * batch_size);
+    int *results = malloc(sizeof (int) * batch_size);
+
+    double elapsed = -1;
+    if (hashes != NULL && passwords != NULL && password_lengths != NULL && results != NULL)
+    {
+        for (size_t index = 0; index < batch_size; ++index)
+        {
+            bench_eks_fill(&hashes[index], cost, index);
+            passwords[index] = (const unsigned char *) "password";
+            password_lengths[index] = 8;
+        }
+
+        double start = bench_eks_now();
+        size_t count = 0;
+        do
+        {
+            if (blowfish_eks_verify_batch(hashes, passwords, password_lengths, results, batch_size) != 0)
+            {
+                break;
+            }
+            count += batch_size;
+            elapsed = bench_eks_now() - start;
+        }
+        while (elapsed < BENCH_EKS_MIN_TIME);
+
+        (*hash_count) = count;
+    }
+
+    free(results);
+    free(password_lengths);
+    free(passwords);
+    free(hashes);
+    return elapsed;
+}
+
+
+/**
+ * Fills a hash with a distinct salt and an arbitrary digest
+ *
+ * @param hash  The hash to fill
+ * @param cost  The cost factor
+ * @param index Number that distinguishes the salt
+ */
+static void bench_eks_fill(bf_eks_hash *hash, unsigned int cost, size_t index)
+{
+    hash->cost = cost;
+    for (size_t byte_index = 0; byte_index < BF_EKS_SALT_LENGTH; ++byte_index)
+    {
+        hash->salt[byte_index] = (unsigned char) (index * 131 + byte_index * 7);
+    }
+    memset(hash->digest, 0, sizeof (hash->digest));
+}
+
+
+/**
+ * Returns the current time of the monotonic clock
+ *
+ * @return Time in seconds
+ */
+static double bench_eks_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
@@ -0,0 +1,450 @@
+/**
+ * bfcrypt - Blowfish file encryption tool
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include <blowfish_cfb64.h>
+#include <blowfish_ctr64.h>
+#include <blowfish_dispatch.h>
+#include <bftool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Maximum key length in bytes (448 bits)
+#define BFCRYPT_MAX_KEY_LENGTH 56
+
+// Default number of threads for the parallel modes
+const size_t BFCRYPT_DEFAULT_THREADS = 1;
+
+enum bfcrypt_mode_e
+{
+    BFCRYPT_MODE_CFB,
+    BFCRYPT_MODE_CTR
+};
+typedef enum bfcrypt_mode_e bfcrypt_mode;
+
+typedef struct bfcrypt_options_s bfcrypt_options;
+struct bfcrypt_options_s
+{
+    int           decrypt;
+    bfcrypt_mode  mode;
+    size_t        thread_count;
+    unsigned char key[BFCRYPT_MAX_KEY_LENGTH];
+    size_t        key_length;
+    uint64_t      init_vector;
+    int           have_init_vector;
+    const char    *input_path;
+    const char    *output_path;
+};
+
+static int bfcrypt_parse_options(int argc, char *argv[], bfcrypt_options *options);
+static int bfcrypt_run(const bfcrypt_options *options);
+static void bfcrypt_process(const bfcrypt_options *options, bf_state *cipher_state,
+                            const unsigned char *input, unsigned char *output, size_t length);
+static double bfcrypt_now(void);
+static void bfcrypt_usage(const char *program);
+
+
+int main(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+
+    bfcrypt_options options;
+    if (bfcrypt_parse_options(argc, argv, &options) == 0)
+    {
+        if (bfcrypt_run(&options) == 0)
+        {
+            rc = EXIT_SUCCESS;
+        }
+    }
+    else
+    {
+        bfcrypt_usage(argv[0]);
+    }
+
+    memset(options.key, 0, sizeof (options.key));
+
+    return rc;
+}
+
+
+/**
+ * Parses the command line
+ *
+ * @param argc    Number of command line arguments
+ * @param argv    Command line arguments
+ * @param options Receives the parsed options
+ * @return        0 if the command line is valid, -1 otherwise
+ */
+static int bfcrypt_parse_options(int argc, char *argv[], bfcrypt_options *options)
+{
+    int rc = 0;
+
+    memset(options, 0, sizeof (bfcrypt_options));
+    options->decrypt      = -1;
+    options->mode         = BFCRYPT_MODE_CFB;
+    options->thread_count = BFCRYPT_DEFAULT_THREADS;
+
+    int option;
+    while (rc == 0 && (option = getopt(argc, argv, "edm:t:k:K:i:")) != -1)
+    {
+        switch (option)
+        {
+            case 'e':
+                options->decrypt = 0;
+                break;
+            case 'd':
+                options->decrypt = 1;
+                break;
+            case 'm':
+                if (strcmp(optarg, "cfb") == 0)
+                {
+                    options->mode = BFCRYPT_MODE_CFB;
+                }
+                else
+                if (strcmp(optarg, "ctr") == 0)
+                {
+                    options->mode = BFCRYPT_MODE_CTR;
+                }
+                else
+                {
+                    fprintf(stderr, "Unknown mode '%s'\n", optarg);
+                    rc = -1;
+                }
+                break;
+            case 't':
+            {
+                char *end = NULL;
+                unsigned long thread_count = strtoul(optarg, &end, 10);
+                if (*end != '\0' || thread_count == 0)
+                {
+                    fprintf(stderr, "Invalid thread count '%s'\n", optarg);
+                    rc = -1;
+                }
+                options->thread_count = (size_t) thread_count;
+                break;
+            }
+            case 'k':
+                rc = bftool_read_key_file(optarg, options->key, sizeof (options->key),
+                                          &options->key_length);
+                break;
+            case 'K':
+                rc = bftool_parse_hex(optarg, options->key, sizeof (options->key),
+                                      &options->key_length);
+                if (rc != 0)
+                {
+                    fprintf(stderr, "Invalid key, expected 1 to %d hex encoded bytes\n",
+                            BFCRYPT_MAX_KEY_LENGTH);
+                }
+                break;
+            case 'i':
+            {
+                unsigned char init_vector[8];
+                size_t init_vector_length = 0;
+                rc = bftool_parse_hex(optarg, init_vector, sizeof (init_vector), &init_vector_length);
+                if (rc != 0 || init_vector_length != sizeof (init_vector))
+                {
+                    fprintf(stderr, "Invalid initialization vector, expected 16 hex digits\n");
+                    rc = -1;
+                }
+                for (size_t index = 0; index < init_vector_length; ++index)
+                {
+                    options->init_vector = (options->init_vector << 8) | init_vector[index];
+                }
+                options->have_init_vector = 1;
+                break;
+            }
+            default:
+                rc = -1;
+                break;
+        }
+    }
+
+    if (rc == 0)
+    {
+        if (options->decrypt == -1 || options->key_length == 0 || !options->have_init_vector ||
+            argc - optind != 2)
+        {
+            rc = -1;
+        }
+        else
+        {
+            options->input_path  = argv[optind];
+            options->output_path = argv[optind + 1];
+        }
+    }
+
+    return rc;
+}
+
+
+/**
+ * Maps the input and output files and runs the encryption or decryption
+ *
+ * @param options The command line options
+ * @return        0 on success, -1 on error
+ */
+static int bfcrypt_run(const bfcrypt_options *options)
+{
+    int rc = -1;
+
+    int input_fd = open(options->input_path, O_RDONLY);
+    if (input_fd == -1)
+    {
+        fprintf(stderr, "%s: %s\n", options->input_path, strerror(errno));
+        return rc;
+    }
+
+    struct stat input_stat;
+    if (fstat(input_fd, &input_stat) != 0)
+    {
+        fprintf(stderr, "%s: %s\n", options->input_path, strerror(errno));
+        close(input_fd);
+        return rc;
+    }
+    size_t length = (size_t) input_stat.st_size;
+
+    // Not truncated on open, so that an output that is the input file can be detected intact
+    int output_fd = open(options->output_path, O_RDWR | O_CREAT, 0600);
+    if (output_fd == -1)
+    {
+        fprintf(stderr, "%s: %s\n", options->output_path, strerror(errno));
+        close(input_fd);
+        return rc;
+    }
+
+    struct stat output_stat;
+    if (fstat(output_fd, &output_stat) != 0)
+    {
+        fprintf(stderr, "%s: %s\n", options->output_path, strerror(errno));
+        close(output_fd);
+        close(input_fd);
+        return rc;
+    }
+    if (output_stat.st_dev == input_stat.st_dev && output_stat.st_ino == input_stat.st_ino)
+    {
+        fprintf(stderr, "%s: Input and output must be different files\n", options->output_path);
+        close(output_fd);
+        close(input_fd);
+        return rc;
+    }
+
+    int ready = 0;
+    void *input = NULL;
+    void *output = NULL;
+    if (ftruncate(output_fd, input_stat.st_size) != 0)
+    {
+        fprintf(stderr, "%s: %s\n", options->output_path, strerror(errno));
+    }
+    else if (length > 0)
+    {
+        // Reserves the blocks up front, so that a full file system fails here
+        // rather than with SIGBUS on a write to the mapping
+        int error = posix_fallocate(output_fd, 0, input_stat.st_size);
+        if (error != 0)
+        {
+            fprintf(stderr, "%s: %s\n", options->output_path, strerror(error));
+        }
+        else
+        {
+            input = mmap(NULL, length, PROT_READ, MAP_SHARED, input_fd, 0);
+            if (input == MAP_FAILED)
+            {
+                fprintf(stderr, "%s: %s\n", options->input_path, strerror(errno));
+                input = NULL;
+            }
+            output = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, output_fd, 0);
+            if (output == MAP_FAILED)
+            {
+                fprintf(stderr, "%s: %s\n", options->output_path, strerror(errno));
+                output = NULL;
+            }
+            ready = input != NULL && output != NULL;
+        }
+    }
+    else
+    {
+        ready = 1;
+    }
+
+    if (ready)
+    {
+        bf_state *cipher_state = malloc(sizeof (bf_state));
+        if (cipher_state != NULL)
+        {
+            blowfish_init(cipher_state);
+            blowfish_set_key(cipher_state, options->key, options->key_length);
+
+            if (length > 0)
+            {
+                // Each thread walks its own chunk front to back
+                posix_madvise(input, length, POSIX_MADV_SEQUENTIAL);
+                posix_madvise(output, length, POSIX_MADV_SEQUENTIAL);
+            }
+
+            double start = bfcrypt_now();
+            bfcrypt_process(options, cipher_state, input, output, length);
+            double elapsed = bfcrypt_now() - start;
+
+            blowfish_clear(cipher_state);
+            free(cipher_state);
+
+            // Write-back errors are reported only by msync() and fsync(), not by munmap()
+            if (length > 0 && msync(output, length, MS_SYNC) != 0)
+            {
+                fprintf(stderr, "%s: %s\n", options->output_path, strerror(errno));
+            }
+            else if (fsync(output_fd) != 0)
+            {
+                fprintf(stderr, "%s: %s\n", options->output_path, strerror(errno));
+            }
+            else
+            {
+                size_t thread_count = options->mode == BFCRYPT_MODE_CFB && !options->decrypt ?
+                                      1 : options->thread_count;
+                fprintf(stderr, "%s %zu bytes (%s, %s kernel, %zu threads) in %.3f s, %.1f MB/s\n",
+                        options->decrypt ? "Decrypted" : "Encrypted", length,
+                        options->mode == BFCRYPT_MODE_CTR ? "ctr" : "cfb",
+                        blowfish_impl_name(blowfish_active_impl()), thread_count, elapsed,
+                        elapsed > 0 ? (double) length / elapsed / 1e6 : 0.0);
+                rc = 0;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "Out of memory\n");
+        }
+    }
+
+    if (input != NULL)
+    {
+        munmap(input, length);
+    }
+    if (output != NULL)
+    {
+        munmap(output, length);
+    }
+    if (close(output_fd) != 0)
+    {
+        fprintf(stderr, "%s: %s\n", options->output_path, strerror(errno));
+        rc = -1;
+    }
+    close(input_fd);
+
+    return rc;
+}
+
+
+/**
+ * Encrypts or decrypts the input data into the output buffer
+ *
+ * @param options      The command line options
+ * @param cipher_state The keyed cipher state object
+ * @param input        The input data
+ * @param output       Receives the output data
+ * @param length       Length of the data
+ */
+static void bfcrypt_process(const bfcrypt_options *options, bf_state *cipher_state,
+                            const unsigned char *input, unsigned char *output, size_t length)
+{
+    switch (options->mode)
+    {
+        case BFCRYPT_MODE_CFB:
+        {
+            bf_cfb64_state cfb_state;
+            blowfish_cfb64_init(&cfb_state, cipher_state, options->init_vector);
+            if (options->decrypt)
+            {
+                blowfish_cfb64_decrypt_copy_parallel(&cfb_state, input, output, length,
+                                                     options->thread_count);
+            }
+            else
+            {
+                // CFB encryption is inherently sequential
+                blowfish_cfb64_encrypt_copy(&cfb_state, input, output, length);
+            }
+            break;
+        }
+        case BFCRYPT_MODE_CTR:
+        {
+            bf_ctr64_state ctr_state;
+            blowfish_ctr64_init(&ctr_state, cipher_state, options->init_vector);
+            blowfish_ctr64_encrypt_copy_parallel(&ctr_state, input, output, length, 0,
+                                                 options->thread_count);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+
+/**
+ * Returns the current time of the monotonic clock
+ *
+ * @return Time in seconds
+ */
+static double bfcrypt_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+/**
+ * Prints the usage information
+ *
+ * @param program Name of the program
+ */
+static void bfcrypt_usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s (-e | -d) (-k keyfile | -K hexkey) -i hexiv [-m cfb|ctr] [-t threads] "
+            "input output\n"
+            "  -e          Encrypt the input file\n"
+            "  -d          Decrypt the input file\n"
+            "  -k keyfile  Read the raw key (1 to %d bytes) from keyfile\n"
+            "  -K hexkey   Hex encoded key\n"
+            "  -i hexiv    Hex encoded 64 bit initialization vector\n"
+            "  -m mode     Cipher mode, cfb (default) or ctr\n"
+            "  -t threads  Number of threads for parallel operations (CFB decryption, CTR)\n",
+            program, BFCRYPT_MAX_KEY_LENGTH);
+}
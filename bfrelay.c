@@ -0,0 +1,1301 @@
+/**
+ * Encrypting TCP relay and loopback load test
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <blowfish_cfb64.h>
+#include <bftool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+// Maximum key length in bytes (448 bits)
+#define BFRELAY_MAX_KEY_LENGTH 56
+
+// Number of events taken from epoll at a time
+#define BFRELAY_EVENT_COUNT 256
+
+// Size of the initialization vector that precedes the cipher text of each direction
+#define BFRELAY_IV_SIZE 8
+
+// Default size of the buffer of each direction of a connection
+const size_t BFRELAY_DEFAULT_BUFFER_SIZE = 16384;
+
+// Minimum size of the buffer of each direction of a connection; it must hold the initialization vector
+const size_t BFRELAY_MIN_BUFFER_SIZE = 64;
+
+// Default maximum number of concurrent connections per relay
+const size_t BFRELAY_DEFAULT_MAX_CONNECTIONS = 1024;
+
+// Default number of connections per phase of the load test
+const size_t BFRELAY_DEFAULT_LOAD_CONNECTIONS = 10000;
+
+// Default size of the message echoed by each load test connection
+const size_t BFRELAY_DEFAULT_MESSAGE_SIZE = 4096;
+
+// Default number of load test client threads
+const size_t BFRELAY_DEFAULT_CLIENTS = 4;
+
+enum bfrelay_role_e
+{
+    // Encrypts from the client to the upstream server, decrypts the other direction
+    BFRELAY_ROLE_ENCRYPT,
+    // Decrypts from the client to the upstream server, encrypts the other direction
+    BFRELAY_ROLE_DECRYPT,
+    // Sends all received data back; used as the load test server
+    BFRELAY_ROLE_ECHO
+};
+typedef enum bfrelay_role_e bfrelay_role;
+
+enum bfrelay_transform_e
+{
+    BFRELAY_TRANSFORM_NONE,
+    BFRELAY_TRANSFORM_ENCRYPT,
+    BFRELAY_TRANSFORM_DECRYPT
+};
+typedef enum bfrelay_transform_e bfrelay_transform;
+
+// One direction of a connection
+typedef struct bfrelay_flow_s bfrelay_flow;
+struct bfrelay_flow_s
+{
+    int               source_fd;
+    int               dest_fd;
+    bfrelay_transform transform;
+    // Points to cfb_storage once the flow's initialization vector is known
+    bf_cfb64_state    *cfb_state;
+    bf_cfb64_state    cfb_storage;
+    // Received part of the initialization vector of a decrypting flow
+    unsigned char     init_vector[BFRELAY_IV_SIZE];
+    size_t            iv_length;
+    // Bytes from start to end are waiting to be sent
+    unsigned char     *buffer;
+    size_t            start;
+    size_t            end;
+    int               source_closed;
+    int               dest_shut;
+};
+
+typedef struct bfrelay_relay_s bfrelay_relay;
+
+typedef struct bfrelay_connection_s bfrelay_connection;
+struct bfrelay_connection_s
+{
+    bfrelay_relay      *relay;
+    int                client_fd;
+    int                upstream_fd;
+    // flows[0] runs from the client, flows[1] from the upstream server
+    bfrelay_flow       flows[2];
+    size_t             flow_count;
+    bfrelay_connection *next_free;
+};
+
+struct bfrelay_relay_s
+{
+    bfrelay_role            role;
+    int                     listen_fd;
+    int                     epoll_fd;
+    // Signaled to stop the event loop
+    int                     stop_fd;
+    struct sockaddr_storage upstream_address;
+    socklen_t               upstream_length;
+    // Expanded key, shared read-only by the CFB mode state objects of all flows
+    const bf_state          *cipher_state;
+    // Initialization vectors are the encrypted base plus a counter, so they never repeat
+    uint64_t                iv_base;
+    uint64_t                iv_counter;
+    bfrelay_connection      *connections;
+    bfrelay_connection      *free_connections;
+    size_t                  max_connections;
+    // All flow buffers, allocated once
+    unsigned char           *buffers;
+    size_t                  buffers_size;
+    size_t                  buffer_size;
+    // Updated by the event loop only, read by other threads for reporting
+    uint64_t                accepted_count;
+    uint64_t                rejected_count;
+    uint64_t                byte_count;
+    pthread_t               thread;
+};
+
+typedef struct bfrelay_options_s bfrelay_options;
+struct bfrelay_options_s
+{
+    int           load_test;
+    bfrelay_role  role;
+    int           have_role;
+    unsigned char key[BFRELAY_MAX_KEY_LENGTH];
+    size_t        key_length;
+    size_t        buffer_size;
+    size_t        max_connections;
+    size_t        load_connections;
+    size_t        message_size;
+    size_t        client_count;
+    const char    *listen_address;
+    const char    *upstream_address;
+};
+
+// A load test client thread and its measurements
+typedef struct bfrelay_client_s bfrelay_client;
+struct bfrelay_client_s
+{
+    const struct sockaddr_storage *address;
+    socklen_t                     address_length;
+    const unsigned char           *message;
+    size_t                        message_size;
+    size_t                        connection_count;
+    // Latency of each connection in nanoseconds
+    uint64_t                      *latencies;
+    size_t                        failed_count;
+    pthread_t                     thread;
+};
+
+static int bfrelay_parse_options(int argc, char *argv[], bfrelay_options *options);
+static int bfrelay_parse_size(const char *text, size_t *value);
+static int bfrelay_resolve(const char *text, int passive, struct sockaddr_storage *address,
+                           socklen_t *address_length);
+static int bfrelay_relay_init(bfrelay_relay *relay, bfrelay_role role, const bfrelay_options *options,
+                              const bf_state *cipher_state,
+                              const struct sockaddr_storage *listen_address, socklen_t listen_length,
+                              const struct sockaddr_storage *upstream_address, socklen_t upstream_length);
+static void bfrelay_relay_destroy(bfrelay_relay *relay);
+static int bfrelay_relay_run(bfrelay_relay *relay);
+static void *bfrelay_relay_main(void *arg);
+static void bfrelay_relay_stop(bfrelay_relay *relay);
+static void bfrelay_accept(bfrelay_relay *relay);
+static int bfrelay_connection_open(bfrelay_relay *relay, int client_fd);
+static void bfrelay_connection_close(bfrelay_connection *connection);
+static void bfrelay_flow_init(bfrelay_flow *flow, int source_fd, int dest_fd, bfrelay_transform transform);
+static int bfrelay_flow_pump(bfrelay_relay *relay, bfrelay_flow *flow);
+static int bfrelay_run_relay(const bfrelay_options *options, const bf_state *cipher_state);
+static int bfrelay_run_load_test(const bfrelay_options *options, const bf_state *cipher_state);
+static int bfrelay_load_phase(const char *name, const bfrelay_options *options,
+                              const struct sockaddr_storage *address, socklen_t address_length,
+                              uint64_t *p99_latency);
+static void *bfrelay_client_main(void *arg);
+static int bfrelay_compare_latencies(const void *left, const void *right);
+static uint64_t bfrelay_now_ns(void);
+static void bfrelay_usage(const char *program);
+
+
+int main(int argc, char *argv[])
+{
+    int rc = EXIT_FAILURE;
+
+    bfrelay_options options;
+    if (bfrelay_parse_options(argc, argv, &options) == 0)
+    {
+        // Expanded once and shared by all connections instead of expanding or copying it for each
+        bf_state *cipher_state = malloc(sizeof (bf_state));
+        if (cipher_state != NULL)
+        {
+            blowfish_init(cipher_state);
+            blowfish_set_key(cipher_state, options.key, options.key_length);
+            if (options.load_test)
+            {
+                rc = bfrelay_run_load_test(&options, cipher_state) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+            else
+            {
+                rc = bfrelay_run_relay(&options, cipher_state) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+            blowfish_clear(cipher_state);
+        }
+        else
+        {
+            fprintf(stderr, "Out of memory\n");
+        }
+        free(cipher_state);
+    }
+    else
+    {
+        bfrelay_usage(argv[0]);
+    }
+
+    memset(options.key, 0, sizeof (options.key));
+
+    return rc;
+}
+
+
+/**
+ * Parses the command line
+ *
+ * @param argc    Number of command line arguments
+ * @param argv    Command line arguments
+ * @param options Receives the parsed options
+ * @return        0 if the command line is valid, -1 otherwise
+ */
+static int bfrelay_parse_options(int argc, char *argv[], bfrelay_options *options)
+{
+    int rc = 0;
+
+    memset(options, 0, sizeof (bfrelay_options));
+    options->buffer_size      = BFRELAY_DEFAULT_BUFFER_SIZE;
+    options->max_connections  = BFRELAY_DEFAULT_MAX_CONNECTIONS;
+    options->load_connections = BFRELAY_DEFAULT_LOAD_CONNECTIONS;
+    options->message_size     = BFRELAY_DEFAULT_MESSAGE_SIZE;
+    options->client_count     = BFRELAY_DEFAULT_CLIENTS;
+
+    int option;
+    while (rc == 0 && (option = getopt(argc, argv, "edLk:K:b:n:c:s:P:")) != -1)
+    {
+        switch (option)
+        {
+            case 'e':
+                options->role      = BFRELAY_ROLE_ENCRYPT;
+                options->have_role = 1;
+                break;
+            case 'd':
+                options->role      = BFRELAY_ROLE_DECRYPT;
+                options->have_role = 1;
+                break;
+            case 'L':
+                options->load_test = 1;
+                break;
+            case 'k':
+                rc = bftool_read_key_file(optarg, options->key, sizeof (options->key),
+                                          &options->key_length);
+                break;
+            case 'K':
+                rc = bftool_parse_hex(optarg, options->key, sizeof (options->key),
+                                      &options->key_length);
+                if (rc != 0)
+                {
+                    fprintf(stderr, "Invalid key, expected 1 to %d hex encoded bytes\n",
+                            BFRELAY_MAX_KEY_LENGTH);
+                }
+                break;
+            case 'b':
+                rc = bfrelay_parse_size(optarg, &options->buffer_size);
+                if (rc == 0 && options->buffer_size < BFRELAY_MIN_BUFFER_SIZE)
+                {
+                    fprintf(stderr, "Invalid buffer size, expected at least %zu bytes\n",
+                            BFRELAY_MIN_BUFFER_SIZE);
+                    rc = -1;
+                }
+                break;
+            case 'n':
+                rc = bfrelay_parse_size(optarg, &options->max_connections);
+                break;
+            case 'c':
+                rc = bfrelay_parse_size(optarg, &options->load_connections);
+                break;
+            case 's':
+                rc = bfrelay_parse_size(optarg, &options->message_size);
+                break;
+            case 'P':
+                rc = bfrelay_parse_size(optarg, &options->client_count);
+                break;
+            default:
+                rc = -1;
+                break;
+        }
+    }
+
+    if (rc == 0)
+    {
+        if (options->key_length == 0)
+        {
+            rc = -1;
+        }
+        else
+        if (options->load_test)
+        {
+            if (options->have_role || argc != optind)
+            {
+                rc = -1;
+            }
+        }
+        else
+        if (!options->have_role || argc - optind != 2)
+        {
+            rc = -1;
+        }
+        else
+        {
+            options->listen_address   = argv[optind];
+            options->upstream_address = argv[optind + 1];
+        }
+    }
+
+    return rc;
+}
+
+
+/**
+ * Parses a positive decimal number
+ *
+ * @param text  The number
+ * @param value Receives the number
+ * @return      0 if the number is valid, -1 otherwise
+ */
+static int bfrelay_parse_size(const char *text, size_t *value)
+{
+    char *end = NULL;
+    unsigned long number = strtoul(text, &end, 10);
+    if (*end != '\0' || number == 0)
+    {
+        fprintf(stderr, "Invalid number '%s'\n", text);
+        return -1;
+    }
+    (*value) = (size_t) number;
+
+    return 0;
+}
+
+
+/**
+ * Resolves an address of the form [host:]port
+ *
+ * @param text           The address; the host may be an IPv6 address in brackets
+ * @param passive        Non-zero for a listening address, which defaults to all interfaces
+ * @param address        Receives the address
+ * @param address_length Receives the length of the address
+ * @return               0 on success, -1 if the address cannot be resolved
+ */
+static int bfrelay_resolve(const char *text, int passive, struct sockaddr_storage *address,
+                           socklen_t *address_length)
+{
+    char host[256];
+    const char *port = strrchr(text, ':');
+    const char *host_text = NULL;
+    if (port != NULL)
+    {
+        size_t host_length = (size_t) (port - text);
+        if (host_length >= 2 && text[0] == '[' && text[host_length - 1] == ']')
+        {
+            ++text;
+            host_length -= 2;
+        }
+        if (host_length >= sizeof (host))
+        {
+            return -1;
+        }
+        memcpy(host, text, host_length);
+        host[host_length] = '\0';
+        host_text = host_length > 0 ? host : NULL;
+        ++port;
+    }
+    else
+    {
+        port = text;
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof (hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = passive ? AI_PASSIVE : 0;
+
+    struct addrinfo *result = NULL;
+    int error = getaddrinfo(host_text, port, &hints, &result);
+    if (error != 0)
+    {
+        fprintf(stderr, "%s: %s\n", text, gai_strerror(error));
+        return -1;
+    }
+    memcpy(address, result->ai_addr, result->ai_addrlen);
+    (*address_length) = result->ai_addrlen;
+    freeaddrinfo(result);
+
+    return 0;
+}
+
+
+/**
+ * Sets up a relay's listening socket, event loop and connection storage
+ *
+ * @param relay            The relay to initialize
+ * @param role             What the relay does with the data
+ * @param options          The command line options
+ * @param cipher_state     The expanded key; must remain valid until the relay is destroyed
+ * @param listen_address   Address to listen on
+ * @param listen_length    Length of the listening address
+ * @param upstream_address Address connected to for each client; unused by echo relays
+ * @param upstream_length  Length of the upstream address
+ * @return                 0 on success, -1 on error
+ */
+static int bfrelay_relay_init(bfrelay_relay *relay, bfrelay_role role, const bfrelay_options *options,
+                              const bf_state *cipher_state,
+                              const struct sockaddr_storage *listen_address, socklen_t listen_length,
+                              const struct sockaddr_storage *upstream_address, socklen_t upstream_length)
+{
+    memset(relay, 0, sizeof (bfrelay_relay));
+    relay->role            = role;
+    relay->cipher_state    = cipher_state;
+    relay->max_connections = options->max_connections;
+    relay->buffer_size     = options->buffer_size;
+    relay->listen_fd       = -1;
+    relay->epoll_fd        = -1;
+    relay->stop_fd         = -1;
+    if (upstream_address != NULL)
+    {
+        memcpy(&relay->upstream_address, upstream_address, upstream_length);
+        relay->upstream_length = upstream_length;
+    }
+
+    // The initialization vectors are encrypted counters from a random base; a fixed
+    // base would repeat them each time the relay is restarted with the same key
+    unsigned char random_bytes[8];
+    int random_fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+    if (random_fd == -1)
+    {
+        fprintf(stderr, "/dev/urandom: %s\n", strerror(errno));
+        return -1;
+    }
+    ssize_t read_length = read(random_fd, random_bytes, sizeof (random_bytes));
+    if (read_length != (ssize_t) sizeof (random_bytes))
+    {
+        fprintf(stderr, "/dev/urandom: %s\n", read_length == -1 ? strerror(errno) : "Short read");
+        close(random_fd);
+        return -1;
+    }
+    close(random_fd);
+    for (size_t index = 0; index < sizeof (random_bytes); ++index)
+    {
+        relay->iv_base = (relay->iv_base << 8) | random_bytes[index];
+    }
+
+    // A single mapping for all flow buffers, touched only as connections use them
+    relay->buffers_size = options->max_connections * 2 * options->buffer_size;
+    relay->buffers = mmap(NULL, relay->buffers_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    relay->connections = calloc(options->max_connections, sizeof (bfrelay_connection));
+    if (relay->buffers == MAP_FAILED || relay->connections == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        if (relay->buffers == MAP_FAILED)
+        {
+            relay->buffers = NULL;
+        }
+        bfrelay_relay_destroy(relay);
+        return -1;
+    }
+    for (size_t index = options->max_connections; index > 0; --index)
+    {
+        bfrelay_connection *connection = &relay->connections[index - 1];
+        connection->relay = relay;
+        connection->flows[0].buffer = &relay->buffers[(index - 1) * 2 * options->buffer_size];
+        connection->flows[1].buffer = connection->flows[0].buffer + options->buffer_size;
+        connection->next_free = relay->free_connections;
+        relay->free_connections = connection;
+    }
+
+    int rc = -1;
+    int enable = 1;
+    relay->listen_fd = socket(listen_address->ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (relay->listen_fd != -1 &&
+        setsockopt(relay->listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof (enable)) == 0 &&
+        bind(relay->listen_fd, (const struct sockaddr *) listen_address, listen_length) == 0 &&
+        listen(relay->listen_fd, SOMAXCONN) == 0)
+    {
+        relay->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        relay->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (relay->epoll_fd != -1 && relay->stop_fd != -1)
+        {
+            // The listening socket is level-triggered, so that accepting may stop
+            // early when all connections are in use; data.ptr identifies the source
+            struct epoll_event event;
+            event.events   = EPOLLIN;
+            event.data.ptr = NULL;
+            rc = epoll_ctl(relay->epoll_fd, EPOLL_CTL_ADD, relay->listen_fd, &event);
+            event.data.ptr = &relay->stop_fd;
+            if (rc == 0)
+            {
+                rc = epoll_ctl(relay->epoll_fd, EPOLL_CTL_ADD, relay->stop_fd, &event);
+            }
+        }
+    }
+
+    if (rc != 0)
+    {
+        fprintf(stderr, "Cannot listen: %s\n", strerror(errno));
+        bfrelay_relay_destroy(relay);
+    }
+
+    return rc;
+}
+
+
+/**
+ * Closes all connections and sockets of a relay and frees its storage
+ *
+ * @param relay The relay
+ */
+static void bfrelay_relay_destroy(bfrelay_relay *relay)
+{
+    if (relay->connections != NULL)
+    {
+        for (size_t index = 0; index < relay->max_connections; ++index)
+        {
+            if (relay->connections[index].flow_count > 0)
+            {
+                bfrelay_connection_close(&relay->connections[index]);
+            }
+        }
+        free(relay->connections);
+        relay->connections = NULL;
+    }
+    if (relay->buffers != NULL)
+    {
+        munmap(relay->buffers, relay->buffers_size);
+        relay->buffers = NULL;
+    }
+    if (relay->listen_fd != -1)
+    {
+        close(relay->listen_fd);
+        relay->listen_fd = -1;
+    }
+    if (relay->stop_fd != -1)
+    {
+        close(relay->stop_fd);
+        relay->stop_fd = -1;
+    }
+    if (relay->epoll_fd != -1)
+    {
+        close(relay->epoll_fd);
+        relay->epoll_fd = -1;
+    }
+}
+
+
+/**
+ * Runs a relay's event loop until the relay is stopped
+ *
+ * Client and upstream sockets are edge-triggered: each event pumps both
+ * directions of its connection until reading or writing would block.
+ *
+ * @param relay The relay
+ * @return      0 if stopped, -1 on error
+ */
+static int bfrelay_relay_run(bfrelay_relay *relay)
+{
+    struct epoll_event events[BFRELAY_EVENT_COUNT];
+
+    int stopped = 0;
+    while (!stopped)
+    {
+        int event_count = epoll_wait(relay->epoll_fd, events, BFRELAY_EVENT_COUNT, -1);
+        if (event_count == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "epoll_wait: %s\n", strerror(errno));
+            return -1;
+        }
+
+        for (int index = 0; index < event_count; ++index)
+        {
+            void *source = events[index].data.ptr;
+            if (source == NULL)
+            {
+                bfrelay_accept(relay);
+            }
+            else
+            if (source == &relay->stop_fd)
+            {
+                stopped = 1;
+            }
+            else
+            {
+                bfrelay_connection *connection = source;
+                // Closed by an earlier event of the same batch
+                if (connection->flow_count == 0)
+                {
+                    continue;
+                }
+
+                int done = 1;
+                for (size_t flow_index = 0; flow_index < connection->flow_count; ++flow_index)
+                {
+                    bfrelay_flow *flow = &connection->flows[flow_index];
+                    if (bfrelay_flow_pump(relay, flow) != 0)
+                    {
+                        done = 1;
+                        break;
+                    }
+                    if (!flow->dest_shut)
+                    {
+                        done = 0;
+                    }
+                }
+                if (done)
+                {
+                    bfrelay_connection_close(connection);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Thread entry point, runs a relay's event loop
+ *
+ * @param arg The relay
+ * @return    Always NULL
+ */
+static void *bfrelay_relay_main(void *arg)
+{
+    bfrelay_relay_run(arg);
+    return NULL;
+}
+
+
+/**
+ * Stops a relay's event loop from another thread
+ *
+ * @param relay The relay
+ */
+static void bfrelay_relay_stop(bfrelay_relay *relay)
+{
+    uint64_t increment = 1;
+    ssize_t rc = write(relay->stop_fd, &increment, sizeof (increment));
+    (void) rc;
+}
+
+
+/**
+ * Accepts pending clients
+ *
+ * Clients beyond the maximum number of connections are closed immediately.
+ *
+ * @param relay The relay
+ */
+static void bfrelay_accept(bfrelay_relay *relay)
+{
+    while (1)
+    {
+        int client_fd = accept4(relay->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd == -1)
+        {
+            break;
+        }
+
+        if (bfrelay_connection_open(relay, client_fd) == 0)
+        {
+            ++relay->accepted_count;
+        }
+        else
+        {
+            close(client_fd);
+            ++relay->rejected_count;
+        }
+    }
+}
+
+
+/**
+ * Sets up a connection for a new client, connecting to the upstream server
+ *
+ * The upstream connection is not awaited: sending and receiving on it fail
+ * with EAGAIN until it is established, and the edge-triggered EPOLLOUT
+ * event that follows resumes the flows.
+ *
+ * @param relay     The relay
+ * @param client_fd The client's socket
+ * @return          0 on success, -1 on error
+ */
+static int bfrelay_connection_open(bfrelay_relay *relay, int client_fd)
+{
+    bfrelay_connection *connection = relay->free_connections;
+    if (connection == NULL)
+    {
+        return -1;
+    }
+
+    int enable = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof (enable));
+    connection->client_fd   = client_fd;
+    connection->upstream_fd = -1;
+
+    int rc = 0;
+    if (relay->role == BFRELAY_ROLE_ECHO)
+    {
+        bfrelay_flow_init(&connection->flows[0], client_fd, client_fd, BFRELAY_TRANSFORM_NONE);
+        connection->flow_count = 1;
+    }
+    else
+    {
+        int upstream_fd = socket(relay->upstream_address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (upstream_fd == -1)
+        {
+            return -1;
+        }
+        setsockopt(upstream_fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof (enable));
+        if (connect(upstream_fd, (const struct sockaddr *) &relay->upstream_address, relay->upstream_length) != 0 &&
+            errno != EINPROGRESS)
+        {
+            close(upstream_fd);
+            return -1;
+        }
+        connection->upstream_fd = upstream_fd;
+
+        int encrypt_upstream = relay->role == BFRELAY_ROLE_ENCRYPT;
+        bfrelay_flow_init(&connection->flows[0], client_fd, upstream_fd,
+                          encrypt_upstream ? BFRELAY_TRANSFORM_ENCRYPT : BFRELAY_TRANSFORM_DECRYPT);
+        bfrelay_flow_init(&connection->flows[1], upstream_fd, client_fd,
+                          encrypt_upstream ? BFRELAY_TRANSFORM_DECRYPT : BFRELAY_TRANSFORM_ENCRYPT);
+        connection->flow_count = 2;
+
+        // Encrypting flows start by sending their initialization vector
+        for (size_t flow_index = 0; flow_index < 2; ++flow_index)
+        {
+            bfrelay_flow *flow = &connection->flows[flow_index];
+            if (flow->transform == BFRELAY_TRANSFORM_ENCRYPT)
+            {
+                uint64_t init_vector = blowfish_encrypt64(relay->cipher_state, relay->iv_base + relay->iv_counter);
+                ++relay->iv_counter;
+                blowfish_cfb64_init(&flow->cfb_storage, relay->cipher_state, init_vector);
+                flow->cfb_state = &flow->cfb_storage;
+                for (size_t index = 0; index < BFRELAY_IV_SIZE; ++index)
+                {
+                    flow->buffer[index] = (unsigned char) (init_vector >> (56 - 8 * index));
+                }
+                flow->end = BFRELAY_IV_SIZE;
+            }
+        }
+    }
+
+    relay->free_connections = connection->next_free;
+
+    struct epoll_event event;
+    event.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = connection;
+    if (rc == 0)
+    {
+        rc = epoll_ctl(relay->epoll_fd, EPOLL_CTL_ADD, client_fd, &event);
+    }
+    if (rc == 0 && connection->upstream_fd != -1)
+    {
+        rc = epoll_ctl(relay->epoll_fd, EPOLL_CTL_ADD, connection->upstream_fd, &event);
+    }
+
+    if (rc != 0)
+    {
+        // The client socket is closed by the caller
+        connection->client_fd = -1;
+        bfrelay_connection_close(connection);
+    }
+
+    return rc;
+}
+
+
+/**
+ * Closes a connection's sockets and returns it to the free connections
+ *
+ * @param connection The connection
+ */
+static void bfrelay_connection_close(bfrelay_connection *connection)
+{
+    bfrelay_relay *relay = connection->relay;
+
+    // Closing removes the sockets from the epoll set
+    if (connection->client_fd != -1)
+    {
+        close(connection->client_fd);
+    }
+    if (connection->upstream_fd != -1)
+    {
+        close(connection->upstream_fd);
+    }
+
+    connection->flow_count = 0;
+    connection->next_free = relay->free_connections;
+    relay->free_connections = connection;
+}
+
+
+/**
+ * Initializes one direction of a connection
+ *
+ * @param flow      The flow; its buffer is already assigned
+ * @param source_fd Socket the data is received from
+ * @param dest_fd   Socket the data is sent to
+ * @param transform What is done with the data in between
+ */
+static void bfrelay_flow_init(bfrelay_flow *flow, int source_fd, int dest_fd, bfrelay_transform transform)
+{
+    flow->source_fd     = source_fd;
+    flow->dest_fd       = dest_fd;
+    flow->transform     = transform;
+    flow->cfb_state     = NULL;
+    flow->iv_length     = 0;
+    flow->start         = 0;
+    flow->end           = 0;
+    flow->source_closed = 0;
+    flow->dest_shut     = 0;
+}
+
+
+/**
+ * Moves data through a flow until the source or the destination would block
+ *
+ * Received data is encrypted or decrypted in place in the flow's buffer and
+ * sent from there, so data is never copied. A decrypting flow first receives
+ * the initialization vector. At the end of the source's data, the
+ * destination is shut down for writing, so that the end of the stream is
+ * passed on.
+ *
+ * @param relay The relay
+ * @param flow  The flow
+ * @return      0 on success, -1 if the connection failed and must be closed
+ */
+static int bfrelay_flow_pump(bfrelay_relay *relay, bfrelay_flow *flow)
+{
+    while (!flow->dest_shut)
+    {
+        if (flow->start < flow->end)
+        {
+            ssize_t count = send(flow->dest_fd, &flow->buffer[flow->start], flow->end - flow->start,
+                                 MSG_NOSIGNAL);
+            if (count < 0)
+            {
+                return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+            }
+            flow->start += (size_t) count;
+            relay->byte_count += (uint64_t) count;
+            if (flow->start == flow->end)
+            {
+                flow->start = 0;
+                flow->end   = 0;
+            }
+        }
+        else
+        if (flow->source_closed)
+        {
+            shutdown(flow->dest_fd, SHUT_WR);
+            flow->dest_shut = 1;
+        }
+        else
+        {
+            int receive_iv = flow->transform == BFRELAY_TRANSFORM_DECRYPT && flow->cfb_state == NULL;
+            unsigned char *target = receive_iv ? &flow->init_vector[flow->iv_length] : flow->buffer;
+            size_t target_size = receive_iv ? BFRELAY_IV_SIZE - flow->iv_length : relay->buffer_size;
+
+            ssize_t count = recv(flow->source_fd, target, target_size, 0);
+            if (count < 0)
+            {
+                return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+            }
+            if (count == 0)
+            {
+                // A stream that ends within the initialization vector carried no data
+                flow->source_closed = 1;
+            }
+            else
+            if (receive_iv)
+            {
+                flow->iv_length += (size_t) count;
+                if (flow->iv_length == BFRELAY_IV_SIZE)
+                {
+                    uint64_t init_vector = 0;
+                    for (size_t index = 0; index < BFRELAY_IV_SIZE; ++index)
+                    {
+                        init_vector = (init_vector << 8) | flow->init_vector[index];
+                    }
+                    blowfish_cfb64_init(&flow->cfb_storage, relay->cipher_state, init_vector);
+                    flow->cfb_state = &flow->cfb_storage;
+                }
+            }
+            else
+            {
+                switch (flow->transform)
+                {
+                    case BFRELAY_TRANSFORM_ENCRYPT:
+                        blowfish_cfb64_encrypt(flow->cfb_state, flow->buffer, (size_t) count);
+                        break;
+                    case BFRELAY_TRANSFORM_DECRYPT:
+                        blowfish_cfb64_decrypt(flow->cfb_state, flow->buffer, (size_t) count);
+                        break;
+                    case BFRELAY_TRANSFORM_NONE:
+                        break;
+                    default:
+                        break;
+                }
+                flow->end = (size_t) count;
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Runs a relay on the calling thread until it fails
+ *
+ * @param options      The command line options
+ * @param cipher_state The expanded key
+ * @return             -1 on error
+ */
+static int bfrelay_run_relay(const bfrelay_options *options, const bf_state *cipher_state)
+{
+    struct sockaddr_storage listen_address;
+    struct sockaddr_storage upstream_address;
+    socklen_t listen_length = 0;
+    socklen_t upstream_length = 0;
+    if (bfrelay_resolve(options->listen_address, 1, &listen_address, &listen_length) != 0 ||
+        bfrelay_resolve(options->upstream_address, 0, &upstream_address, &upstream_length) != 0)
+    {
+        return -1;
+    }
+
+    bfrelay_relay relay;
+    if (bfrelay_relay_init(&relay, options->role, options, cipher_state,
+                           &listen_address, listen_length, &upstream_address, upstream_length) != 0)
+    {
+        return -1;
+    }
+    int rc = bfrelay_relay_run(&relay);
+    bfrelay_relay_destroy(&relay);
+
+    return rc;
+}
+
+
+/**
+ * Measures the relays on the loopback interface
+ *
+ * Clients send a message through an encrypting relay, a decrypting relay
+ * and back from an echo server, and verify the echoed message. The same
+ * clients first talk to the echo server directly, so that the latency added
+ * by the relays can be reported.
+ *
+ * @param options      The command line options
+ * @param cipher_state The expanded key
+ * @return             0 if all connections succeeded, -1 otherwise
+ */
+static int bfrelay_run_load_test(const bfrelay_options *options, const bf_state *cipher_state)
+{
+    struct sockaddr_storage address;
+    socklen_t address_length = 0;
+    if (bfrelay_resolve("127.0.0.1:0", 1, &address, &address_length) != 0)
+    {
+        return -1;
+    }
+
+    // Each relay connects to the next one's port, assigned when it starts listening
+    bfrelay_relay relays[3];
+    const bfrelay_role roles[3] = { BFRELAY_ROLE_ECHO, BFRELAY_ROLE_DECRYPT, BFRELAY_ROLE_ENCRYPT };
+    struct sockaddr_storage relay_addresses[3];
+    socklen_t relay_lengths[3];
+    size_t relay_count = 0;
+    int rc = 0;
+    for (size_t index = 0; rc == 0 && index < 3; ++index)
+    {
+        const struct sockaddr_storage *upstream = index > 0 ? &relay_addresses[index - 1] : NULL;
+        socklen_t upstream_length = index > 0 ? relay_lengths[index - 1] : 0;
+        rc = bfrelay_relay_init(&relays[index], roles[index], options, cipher_state,
+                                &address, address_length, upstream, upstream_length);
+        if (rc == 0)
+        {
+            relay_lengths[index] = sizeof (relay_addresses[index]);
+            getsockname(relays[index].listen_fd, (struct sockaddr *) &relay_addresses[index], &relay_lengths[index]);
+            if (pthread_create(&relays[index].thread, NULL, bfrelay_relay_main, &relays[index]) != 0)
+            {
+                bfrelay_relay_destroy(&relays[index]);
+                rc = -1;
+            }
+            else
+            {
+                ++relay_count;
+            }
+        }
+    }
+
+    uint64_t direct_p99 = 0;
+    uint64_t relayed_p99 = 0;
+    if (rc == 0)
+    {
+        rc = bfrelay_load_phase("direct", options, &relay_addresses[0], relay_lengths[0], &direct_p99);
+    }
+    if (rc == 0)
+    {
+        rc = bfrelay_load_phase("relayed", options, &relay_addresses[2], relay_lengths[2], &relayed_p99);
+    }
+    if (rc == 0)
+    {
+        printf("added p99 latency: %.1f us\n",
+               ((double) relayed_p99 - (double) direct_p99) / 1e3);
+    }
+
+    for (size_t index = relay_count; index > 0; --index)
+    {
+        bfrelay_relay_stop(&relays[index - 1]);
+        pthread_join(relays[index - 1].thread, NULL);
+        bfrelay_relay_destroy(&relays[index - 1]);
+    }
+
+    return rc;
+}
+
+
+/**
+ * Runs one phase of the load test and prints its results
+ *
+ * @param name           Name of the phase
+ * @param options        The command line options
+ * @param address        Address the clients connect to
+ * @param address_length Length of the address
+ * @param p99_latency    Receives the 99th percentile of the latency in nanoseconds
+ * @return               0 if all connections succeeded, -1 otherwise
+ */
+static int bfrelay_load_phase(const char *name, const bfrelay_options *options,
+                              const struct sockaddr_storage *address, socklen_t address_length,
+                              uint64_t *p99_latency)
+{
+    size_t client_count = options->client_count;
+    if (client_count > options->load_connections)
+    {
+        client_count = options->load_connections;
+    }
+
+    bfrelay_client *clients = calloc(client_count, sizeof (bfrelay_client));
+    uint64_t *latencies = malloc(options->load_connections * sizeof (uint64_t));
+    unsigned char *message = malloc(options->message_size);
+    if (clients == NULL || latencies == NULL || message == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        free(message);
+        free(latencies);
+        free(clients);
+        return -1;
+    }
+    for (size_t index = 0; index < options->message_size; ++index)
+    {
+        message[index] = (unsigned char) (index * 131 + 7);
+    }
+
+    uint64_t start = bfrelay_now_ns();
+    size_t assigned = 0;
+    size_t started_count = 0;
+    for (size_t index = 0; index < client_count; ++index)
+    {
+        bfrelay_client *client = &clients[index];
+        client->address          = address;
+        client->address_length   = address_length;
+        client->message          = message;
+        client->message_size     = options->message_size;
+        client->connection_count = (options->load_connections - assigned) / (client_count - index);
+        client->latencies        = &latencies[assigned];
+        assigned += client->connection_count;
+        if (pthread_create(&client->thread, NULL, bfrelay_client_main, client) != 0)
+        {
+            break;
+        }
+        ++started_count;
+    }
+
+    size_t completed = 0;
+    size_t failed = 0;
+    for (size_t index = 0; index < started_count; ++index)
+    {
+        pthread_join(clients[index].thread, NULL);
+        failed += clients[index].failed_count;
+        // Successful connections are recorded first in each client's part of the array
+        memmove(&latencies[completed], clients[index].latencies,
+                (clients[index].connection_count - clients[index].failed_count) * sizeof (uint64_t));
+        completed += clients[index].connection_count - clients[index].failed_count;
+    }
+    double elapsed = (double) (bfrelay_now_ns() - start) / 1e9;
+
+    int rc = failed == 0 && started_count == client_count ? 0 : -1;
+    if (completed > 0)
+    {
+        qsort(latencies, completed, sizeof (uint64_t), bfrelay_compare_latencies);
+        (*p99_latency) = latencies[(completed - 1) * 99 / 100];
+        printf("%-8s %zu connections, %zu failed, %.0f conn/s, %.1f MB/s, "
+               "latency p50 %.1f us, p99 %.1f us\n",
+               name, completed, failed, (double) completed / elapsed,
+               (double) completed * (double) options->message_size / elapsed / 1e6,
+               (double) latencies[(completed - 1) / 2] / 1e3, (double) (*p99_latency) / 1e3);
+    }
+    else
+    {
+        printf("%-8s all connections failed\n", name);
+        rc = -1;
+    }
+
+    free(message);
+    free(latencies);
+    free(clients);
+
+    return rc;
+}
+
+
+/**
+ * Load test client thread, runs its connections one after the other
+ *
+ * Each connection sends the message, shuts down its sending side, and
+ * receives until the end of the stream. Its latency is the time from
+ * connecting to the end of the echoed stream.
+ *
+ * @param arg The bfrelay_client object
+ * @return    Always NULL
+ */
+static void *bfrelay_client_main(void *arg)
+{
+    bfrelay_client *client = arg;
+    unsigned char *received = malloc(client->message_size + 1);
+    size_t recorded = 0;
+
+    for (size_t index = 0; index < client->connection_count; ++index)
+    {
+        uint64_t start = bfrelay_now_ns();
+        int ok = 0;
+        int fd = socket(client->address->ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd != -1 && received != NULL &&
+            connect(fd, (const struct sockaddr *) client->address, client->address_length) == 0)
+        {
+            int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof (enable));
+
+            size_t sent = 0;
+            while (sent < client->message_size)
+            {
+                ssize_t count = send(fd, &client->message[sent], client->message_size - sent, MSG_NOSIGNAL);
+                if (count <= 0)
+                {
+                    break;
+                }
+                sent += (size_t) count;
+            }
+            shutdown(fd, SHUT_WR);
+
+            size_t received_length = 0;
+            ssize_t count = 0;
+            while (received_length <= client->message_size &&
+                   (count = recv(fd, &received[received_length], client->message_size + 1 - received_length, 0)) > 0)
+            {
+                received_length += (size_t) count;
+            }
+            ok = sent == client->message_size && count == 0 && received_length == client->message_size &&
+                 memcmp(received, client->message, client->message_size) == 0;
+        }
+        if (fd != -1)
+        {
+            close(fd);
+        }
+
+        if (ok)
+        {
+            client->latencies[recorded] = bfrelay_now_ns() - start;
+            ++recorded;
+        }
+        else
+        {
+            ++client->failed_count;
+        }
+    }
+
+    free(received);
+
+    return NULL;
+}
+
+
+/**
+ * Orders latencies for qsort()
+ *
+ * @param left  Pointer to the first latency
+ * @param right Pointer to the second latency
+ * @return      Negative, zero or positive as the first latency is less than, equal to or greater than the second
+ */
+static int bfrelay_compare_latencies(const void *left, const void *right)
+{
+    uint64_t left_value = *(const uint64_t *) left;
+    uint64_t right_value = *(const uint64_t *) right;
+
+    return (left_value > right_value) - (left_value < right_value);
+}
+
+
+/**
+ * Returns the current time of the monotonic clock
+ *
+ * @return Time in nanoseconds
+ */
+static uint64_t bfrelay_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+
+/**
+ * Prints the usage information
+ *
+ * @param program Name of the program
+ */
+static void bfrelay_usage(const char *program)
+{
+    fprintf(stderr,
+            "Usage: %s (-e | -d) (-k keyfile | -K hexkey) [-n max_connections] [-b buffer_size] "
+            "[host:]port host:port\n"
+            "       %s -L (-k keyfile | -K hexkey) [-c connections] [-s message_size] [-P clients] "
+            "[-n max_connections] [-b buffer_size]\n"
+            "  -e          Encrypt from clients to the upstream server, decrypt the other direction\n"
+            "  -d          Decrypt from clients to the upstream server, encrypt the other direction\n"
+            "  -L          Run a load test of an encrypting and a decrypting relay on 127.0.0.1\n"
+            "  -k keyfile  Read the raw key (1 to %d bytes) from keyfile\n"
+            "  -K hexkey   Hex encoded key\n"
+            "  -n count    Maximum number of concurrent connections, default %zu\n"
+            "  -b size     Buffer size per direction of a connection, at least %zu, default %zu bytes\n"
+            "  -c count    Number of load test connections per phase, default %zu\n"
+            "  -s size     Size of the message echoed by each load test connection, default %zu bytes\n"
+            "  -P count    Number of load test client threads, default %zu\n"
+            "Each direction of an encrypted stream starts with its 64 bit initialization vector.\n",
+            program, program, BFRELAY_MAX_KEY_LENGTH, BFRELAY_DEFAULT_MAX_CONNECTIONS,
+            BFRELAY_MIN_BUFFER_SIZE, BFRELAY_DEFAULT_BUFFER_SIZE, BFRELAY_DEFAULT_LOAD_CONNECTIONS, BFRELAY_DEFAULT_MESSAGE_SIZE,
+            BFRELAY_DEFAULT_CLIENTS);
+}
@@ -0,0 +1,131 @@
+/**
+ * Command line helpers for the bfcrypt and bfrelay tools
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <bftool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+
+/**
+ * Parses a hex encoded string of bytes
+ *
+ * @param text        The hex encoded string
+ * @param buffer      Receives the bytes
+ * @param buffer_size Size of the buffer
+ * @param length      Receives the number of bytes
+ * @return            0 if the string is valid and fits into the buffer, -1 otherwise
+ */
+int bftool_parse_hex(const char *text, unsigned char *buffer, size_t buffer_size, size_t *length)
+{
+    int rc = 0;
+
+    size_t text_length = strlen(text);
+    if (text_length == 0 || text_length % 2 != 0 || text_length / 2 > buffer_size)
+    {
+        rc = -1;
+    }
+
+    for (size_t index = 0; rc == 0 && index < text_length; ++index)
+    {
+        unsigned char digit = 0;
+        char hex_char = text[index];
+        if (hex_char >= '0' && hex_char <= '9')
+        {
+            digit = (unsigned char) (hex_char - '0');
+        }
+        else
+        if (hex_char >= 'a' && hex_char <= 'f')
+        {
+            digit = (unsigned char) (hex_char - 'a' + 10);
+        }
+        else
+        if (hex_char >= 'A' && hex_char <= 'F')
+        {
+            digit = (unsigned char) (hex_char - 'A' + 10);
+        }
+        else
+        {
+            rc = -1;
+        }
+
+        if (index % 2 == 0)
+        {
+            buffer[index / 2] = (unsigned char) (digit << 4);
+        }
+        else
+        {
+            buffer[index / 2] |= digit;
+        }
+    }
+
+    (*length) = rc == 0 ? text_length / 2 : 0;
+
+    return rc;
+}
+
+
+/**
+ * Reads a raw binary key from a file
+ *
+ * @param path        Path of the key file
+ * @param buffer      Receives the key
+ * @param buffer_size Size of the buffer, which is the maximum key length
+ * @param length      Receives the key length
+ * @return            0 if a key of valid length was read, -1 otherwise
+ */
+int bftool_read_key_file(const char *path, unsigned char *buffer, size_t buffer_size, size_t *length)
+{
+    int rc = -1;
+
+    FILE *key_file = fopen(path, "rb");
+    if (key_file != NULL)
+    {
+        (*length) = fread(buffer, 1, buffer_size, key_file);
+        // The key file must not contain more data than fits into the buffer
+        if ((*length) > 0 && fgetc(key_file) == EOF && !ferror(key_file))
+        {
+            rc = 0;
+        }
+        else
+        {
+            fprintf(stderr, "%s: Key files must contain 1 to %zu bytes\n", path, buffer_size);
+        }
+        fclose(key_file);
+    }
+    else
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    }
+
+    return rc;
+}
@@ -0,0 +1,34 @@
+#ifndef BFTOOL_H
+#define	BFTOOL_H
+
+#include <stddef.h>
+
+/*
+ * Command line helpers shared by the bfcrypt and bfrelay tools
+ */
+
+/**
+ * Parses a hex encoded string of bytes
+ *
+ * @param text        The hex encoded string
+ * @param buffer      Receives the bytes
+ * @param buffer_size Size of the buffer
+ * @param length      Receives the number of bytes
+ * @return            0 if the string is valid and fits into the buffer, -1 otherwise
+ */
+int bftool_parse_hex(const char *text, unsigned char *buffer, size_t buffer_size, size_t *length);
+
+/**
+ * Reads a raw binary key from a file
+ *
+ * Reports errors on stderr.
+ *
+ * @param path        Path of the key file
+ * @param buffer      Receives the key
+ * @param buffer_size Size of the buffer, which is the maximum key length
+ * @param length      Receives the key length
+ * @return            0 if a key of valid length was read, -1 otherwise
+ */
+int bftool_read_key_file(const char *path, unsigned char *buffer, size_t buffer_size, size_t *length);
+
+#endif	/* BFTOOL_H */
@@ -31,6 +31,8 @@
  */
 
 #include <blowfish.h>
+#include <blowfish_dispatch.h>
+#include <blowfish_stats.h>
 #include <string.h>
 
 extern const bf_state BF_INIT_STATE;
@@ -45,7 +47,14 @@ const size_t BF_ROUNDS = 16;
 // Step width for the unrolled loops
 const size_t BF_UNROLLED_STEP =  2;
 
-static inline uint32_t blowfish_f(bf_state *state, uint32_t value);
+// Number of independent blocks processed in lockstep by the batch functions
+#define BF_INTERLEAVED_LANES 4
+
+static inline uint32_t blowfish_f(const bf_state *state, uint32_t value);
+static inline void blowfish_encrypt_interleaved(const bf_state *state, uint32_t *data_l, uint32_t *data_r);
+static inline void blowfish_decrypt_interleaved(const bf_state *state, uint32_t *data_l, uint32_t *data_r);
+static inline void blowfish_encrypt_multikey(bf_state **states, uint32_t *data_l, uint32_t *data_r);
+static void blowfish_expand_key(bf_state *state);
 
 
 /**
@@ -92,50 +101,39 @@ void blowfish_clear(bf_state *state)
  */
 void blowfish_set_key(bf_state *state, const unsigned char *key, size_t key_length)
 {
-    // Apply the key to the P box
-    {
-        size_t key_index = 0;
-        for (size_t p_index = 0; p_index < BF_P_BOXES; ++p_index)
-        {
-            uint32_t value = 0;
-            // Load 4 key bytes
-            for (uint32_t counter = 0; counter < 4; ++counter)
-            {
-                value = value << 8;
-                value |= key[key_index];
-                ++key_index;
-                key_index %= key_length;
-            }
-            state->p_box[p_index] ^= value;
-        }
-    }
+    blowfish_mix_key(state, key, key_length);
+    blowfish_expand_key(state);
+}
 
-    // Initialize the P box and S boxes
-    {
-        uint32_t data_l = 0;
-        uint32_t data_r = 0;
 
-        // Initialize the P box
-        for (size_t p_index = 0; p_index < BF_P_BOXES; p_index += BF_UNROLLED_STEP)
-        {
-            blowfish_encrypt(state, &data_l, &data_r);
-            state->p_box[p_index] = data_l;
-            state->p_box[p_index + 1] = data_r;
-        }
-
-        // Initialize the S boxes
-        for (size_t s_box_index = 0; s_box_index < BF_S_BOXES; ++s_box_index)
+/**
+ * Applies the key to the P box of an initialized bf_state object
+ *
+ * This is the first step of the key schedule, which is completed by
+ * one of the *_expand_keys() functions.
+ *
+ * @param state      The cipher state object
+ * @param key        The key to initialize the cipher with
+ * @param key_length The length of the key
+ */
+void blowfish_mix_key(bf_state *state, const unsigned char *key, size_t key_length)
+{
+    size_t key_index = 0;
+    for (size_t p_index = 0; p_index < BF_P_BOXES; ++p_index)
+    {
+        uint32_t value = 0;
+        // Load 4 key bytes
+        for (uint32_t counter = 0; counter < 4; ++counter)
         {
-            for (size_t s_entry_index = 0;
-                 s_entry_index < BF_S_BOX_ENTRIES;
-                 s_entry_index += BF_UNROLLED_STEP)
-            {
-                blowfish_encrypt(state, &data_l, &data_r);
-                state->s_box[s_box_index][s_entry_index] = data_l;
-                state->s_box[s_box_index][s_entry_index + 1] = data_r;
-            }
+            value = value << 8;
+            value |= key[key_index];
+            ++key_index;
+            key_index %= key_length;
         }
+        state->p_box[p_index] ^= value;
     }
+
+    BF_STATS_COUNT(BF_STATS_KEY_SCHEDULES, 1);
 }
 
 
@@ -146,7 +144,7 @@ void blowfish_set_key(bf_state *state, const unsigned char *key, size_t key_leng
  * @param data  The plain text to encrypt
  * @return      The cipher text for the supplied plain text
  */
-uint64_t blowfish_encrypt64(bf_state *state, uint64_t data)
+uint64_t blowfish_encrypt64(const bf_state *state, uint64_t data)
 {
     uint32_t data_l = (uint32_t) (data >> 32);
     uint32_t data_r = (uint32_t) data;
@@ -165,7 +163,7 @@ uint64_t blowfish_encrypt64(bf_state *state, uint64_t data)
  * @param data  The cipher text to decrypt
  * @return      The plain text for the supplied cipher text
  */
-uint64_t blowfish_decrypt64(bf_state *state, uint64_t data)
+uint64_t blowfish_decrypt64(const bf_state *state, uint64_t data)
 {
     uint32_t data_l = (uint32_t) (data >> 32);
     uint32_t data_r = (uint32_t) data;
@@ -178,6 +176,225 @@ uint64_t blowfish_decrypt64(bf_state *state, uint64_t data)
 }
 
 
+/**
+ * Encrypts two single blocks, each with its own key, in lockstep
+ *
+ * @param state_a The cipher state object for the first block
+ * @param data_a  The first block; receives its cipher text
+ * @param state_b The cipher state object for the second block
+ * @param data_b  The second block; receives its cipher text
+ */
+void blowfish_encrypt64_pair(const bf_state *state_a, uint64_t *data_a,
+                             const bf_state *state_b, uint64_t *data_b)
+{
+    uint32_t data_l0 = (uint32_t) ((*data_a) >> 32);
+    uint32_t data_r0 = (uint32_t) (*data_a);
+    uint32_t data_l1 = (uint32_t) ((*data_b) >> 32);
+    uint32_t data_r1 = (uint32_t) (*data_b);
+
+    for (size_t p_box_index = 0; p_box_index < BF_ROUNDS; p_box_index += BF_UNROLLED_STEP)
+    {
+        data_l0 ^= state_a->p_box[p_box_index];
+        data_l1 ^= state_b->p_box[p_box_index];
+        data_r0 ^= blowfish_f(state_a, data_l0) ^ state_a->p_box[p_box_index + 1];
+        data_r1 ^= blowfish_f(state_b, data_l1) ^ state_b->p_box[p_box_index + 1];
+        data_l0 ^= blowfish_f(state_a, data_r0);
+        data_l1 ^= blowfish_f(state_b, data_r1);
+    }
+
+    (*data_a) = (((uint64_t) (data_r0 ^ state_a->p_box[17])) << 32) + ((uint64_t) (data_l0 ^ state_a->p_box[16]));
+    (*data_b) = (((uint64_t) (data_r1 ^ state_b->p_box[17])) << 32) + ((uint64_t) (data_l1 ^ state_b->p_box[16]));
+}
+
+
+/**
+ * Encrypts an array of 64 bit blocks, one block at a time
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+void blowfish_scalar_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count)
+{
+    for (size_t block_index = 0; block_index < block_count; ++block_index)
+    {
+        output[block_index] = blowfish_encrypt64(state, input[block_index]);
+    }
+}
+
+
+/**
+ * Decrypts an array of 64 bit blocks, one block at a time
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+void blowfish_scalar_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count)
+{
+    for (size_t block_index = 0; block_index < block_count; ++block_index)
+    {
+        output[block_index] = blowfish_decrypt64(state, input[block_index]);
+    }
+}
+
+
+/**
+ * Completes the key schedules of multiple cipher state objects one by one
+ *
+ * @param states      The cipher state objects, prepared by blowfish_mix_key()
+ * @param state_count The number of cipher state objects
+ */
+void blowfish_scalar_expand_keys(bf_state *states[], size_t state_count)
+{
+    for (size_t state_index = 0; state_index < state_count; ++state_index)
+    {
+        blowfish_expand_key(states[state_index]);
+    }
+}
+
+
+/**
+ * Completes the key schedules of multiple cipher state objects, several at a time
+ *
+ * The key schedule of a single key is one long chain of dependent encryptions.
+ * Running BF_INTERLEAVED_LANES independent key schedules in lockstep lets
+ * the S box lookups of different keys overlap.
+ *
+ * @param states      The cipher state objects, prepared by blowfish_mix_key()
+ * @param state_count The number of cipher state objects
+ */
+void blowfish_interleaved_expand_keys(bf_state *states[], size_t state_count)
+{
+    size_t state_index = 0;
+    for (; state_index + BF_INTERLEAVED_LANES <= state_count; state_index += BF_INTERLEAVED_LANES)
+    {
+        bf_state **lane_states = &states[state_index];
+        uint32_t data_l[BF_INTERLEAVED_LANES] = { 0 };
+        uint32_t data_r[BF_INTERLEAVED_LANES] = { 0 };
+
+        // Initialize the P boxes
+        for (size_t p_index = 0; p_index < BF_P_BOXES; p_index += BF_UNROLLED_STEP)
+        {
+            blowfish_encrypt_multikey(lane_states, data_l, data_r);
+            for (size_t lane = 0; lane < BF_INTERLEAVED_LANES; ++lane)
+            {
+                lane_states[lane]->p_box[p_index] = data_l[lane];
+                lane_states[lane]->p_box[p_index + 1] = data_r[lane];
+            }
+        }
+
+        // Initialize the S boxes
+        for (size_t s_box_index = 0; s_box_index < BF_S_BOXES; ++s_box_index)
+        {
+            for (size_t s_entry_index = 0;
+                 s_entry_index < BF_S_BOX_ENTRIES;
+                 s_entry_index += BF_UNROLLED_STEP)
+            {
+                blowfish_encrypt_multikey(lane_states, data_l, data_r);
+                for (size_t lane = 0; lane < BF_INTERLEAVED_LANES; ++lane)
+                {
+                    lane_states[lane]->s_box[s_box_index][s_entry_index] = data_l[lane];
+                    lane_states[lane]->s_box[s_box_index][s_entry_index + 1] = data_r[lane];
+                }
+            }
+        }
+    }
+
+    // Complete the remaining key schedules one by one
+    for (; state_index < state_count; ++state_index)
+    {
+        blowfish_expand_key(states[state_index]);
+    }
+}
+
+
+/**
+ * Encrypts an array of 64 bit blocks, several blocks at a time
+ *
+ * Keeps BF_INTERLEAVED_LANES independent blocks in flight per round,
+ * so that the S box lookups of different blocks can overlap.
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+void blowfish_interleaved_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                           size_t block_count)
+{
+    size_t block_index = 0;
+    for (; block_index + BF_INTERLEAVED_LANES <= block_count; block_index += BF_INTERLEAVED_LANES)
+    {
+        uint32_t data_l[BF_INTERLEAVED_LANES];
+        uint32_t data_r[BF_INTERLEAVED_LANES];
+        for (size_t lane = 0; lane < BF_INTERLEAVED_LANES; ++lane)
+        {
+            data_l[lane] = (uint32_t) (input[block_index + lane] >> 32);
+            data_r[lane] = (uint32_t) input[block_index + lane];
+        }
+
+        blowfish_encrypt_interleaved(state, data_l, data_r);
+
+        for (size_t lane = 0; lane < BF_INTERLEAVED_LANES; ++lane)
+        {
+            output[block_index + lane] = (((uint64_t) data_l[lane]) << 32) + ((uint64_t) data_r[lane]);
+        }
+    }
+
+    // Encrypt the remaining blocks one by one
+    for (; block_index < block_count; ++block_index)
+    {
+        output[block_index] = blowfish_encrypt64(state, input[block_index]);
+    }
+}
+
+
+/**
+ * Decrypts an array of 64 bit blocks, several blocks at a time
+ *
+ * Keeps BF_INTERLEAVED_LANES independent blocks in flight per round,
+ * so that the S box lookups of different blocks can overlap.
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+void blowfish_interleaved_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                           size_t block_count)
+{
+    size_t block_index = 0;
+    for (; block_index + BF_INTERLEAVED_LANES <= block_count; block_index += BF_INTERLEAVED_LANES)
+    {
+        uint32_t data_l[BF_INTERLEAVED_LANES];
+        uint32_t data_r[BF_INTERLEAVED_LANES];
+        for (size_t lane = 0; lane < BF_INTERLEAVED_LANES; ++lane)
+        {
+            data_l[lane] = (uint32_t) (input[block_index + lane] >> 32);
+            data_r[lane] = (uint32_t) input[block_index + lane];
+        }
+
+        blowfish_decrypt_interleaved(state, data_l, data_r);
+
+        for (size_t lane = 0; lane < BF_INTERLEAVED_LANES; ++lane)
+        {
+            output[block_index + lane] = (((uint64_t) data_l[lane]) << 32) + ((uint64_t) data_r[lane]);
+        }
+    }
+
+    // Decrypt the remaining blocks one by one
+    for (; block_index < block_count; ++block_index)
+    {
+        output[block_index] = blowfish_decrypt64(state, input[block_index]);
+    }
+}
+
+
 /**
  * Encrypts the two 32 bit parts of a single 64 bit block of data
  *
@@ -185,7 +402,7 @@ uint64_t blowfish_decrypt64(bf_state *state, uint64_t data)
  * @param data_l_ref The left (first, big-endian high-order) 32 bits of data
  * @param data_r_ref The right (second, big-endian low-order) 32 bits of data
  */
-void blowfish_encrypt(bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_ref)
+void blowfish_encrypt(const bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_ref)
 {
     uint32_t data_l = (*data_l_ref);
     uint32_t data_r = (*data_r_ref);
@@ -212,7 +429,7 @@ void blowfish_encrypt(bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_re
  * @param data_l_ref The left (first, big-endian high-order) 32 bits of data
  * @param data_r_ref The right (second, big-endian low-order) 32 bits of data
  */
-void blowfish_decrypt(bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_ref)
+void blowfish_decrypt(const bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_ref)
 {
     uint32_t data_l = (*data_l_ref);
     uint32_t data_r = (*data_r_ref);
@@ -241,7 +458,7 @@ void blowfish_decrypt(bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_re
  * @param value The input value to operate on
  * @return      The result of the Blowfish algorithm's "F" function
  */
-static inline uint32_t blowfish_f(bf_state *state, uint32_t value)
+static inline uint32_t blowfish_f(const bf_state *state, uint32_t value)
 {
     uint32_t result = state->s_box[0][value >> 24];
     result += state->s_box[1][(value >> 16) & 0xFF];
@@ -250,3 +467,189 @@ static inline uint32_t blowfish_f(bf_state *state, uint32_t value)
 
     return result;
 }
+
+
+/**
+ * Encrypts BF_INTERLEAVED_LANES independent blocks in lockstep
+ *
+ * The lanes are kept in separate local variables rather than iterated over,
+ * so that all of them stay in registers and their S box lookups are issued
+ * back to back.
+ *
+ * @param state  The cipher state object
+ * @param data_l The left 32 bits of each block
+ * @param data_r The right 32 bits of each block
+ */
+static inline void blowfish_encrypt_interleaved(const bf_state *state, uint32_t *data_l, uint32_t *data_r)
+{
+    uint32_t data_l0 = data_l[0];
+    uint32_t data_l1 = data_l[1];
+    uint32_t data_l2 = data_l[2];
+    uint32_t data_l3 = data_l[3];
+    uint32_t data_r0 = data_r[0];
+    uint32_t data_r1 = data_r[1];
+    uint32_t data_r2 = data_r[2];
+    uint32_t data_r3 = data_r[3];
+
+    for (size_t p_box_index = 0; p_box_index < BF_ROUNDS; p_box_index += BF_UNROLLED_STEP)
+    {
+        uint32_t p_even = state->p_box[p_box_index];
+        uint32_t p_odd  = state->p_box[p_box_index + 1];
+
+        data_l0 ^= p_even;
+        data_l1 ^= p_even;
+        data_l2 ^= p_even;
+        data_l3 ^= p_even;
+        data_r0 ^= blowfish_f(state, data_l0) ^ p_odd;
+        data_r1 ^= blowfish_f(state, data_l1) ^ p_odd;
+        data_r2 ^= blowfish_f(state, data_l2) ^ p_odd;
+        data_r3 ^= blowfish_f(state, data_l3) ^ p_odd;
+        data_l0 ^= blowfish_f(state, data_r0);
+        data_l1 ^= blowfish_f(state, data_r1);
+        data_l2 ^= blowfish_f(state, data_r2);
+        data_l3 ^= blowfish_f(state, data_r3);
+    }
+
+    data_l[0] = data_r0 ^ state->p_box[17];
+    data_l[1] = data_r1 ^ state->p_box[17];
+    data_l[2] = data_r2 ^ state->p_box[17];
+    data_l[3] = data_r3 ^ state->p_box[17];
+    data_r[0] = data_l0 ^ state->p_box[16];
+    data_r[1] = data_l1 ^ state->p_box[16];
+    data_r[2] = data_l2 ^ state->p_box[16];
+    data_r[3] = data_l3 ^ state->p_box[16];
+}
+
+
+/**
+ * Decrypts BF_INTERLEAVED_LANES independent blocks in lockstep
+ *
+ * @param state  The cipher state object
+ * @param data_l The left 32 bits of each block
+ * @param data_r The right 32 bits of each block
+ */
+static inline void blowfish_decrypt_interleaved(const bf_state *state, uint32_t *data_l, uint32_t *data_r)
+{
+    uint32_t data_l0 = data_l[0];
+    uint32_t data_l1 = data_l[1];
+    uint32_t data_l2 = data_l[2];
+    uint32_t data_l3 = data_l[3];
+    uint32_t data_r0 = data_r[0];
+    uint32_t data_r1 = data_r[1];
+    uint32_t data_r2 = data_r[2];
+    uint32_t data_r3 = data_r[3];
+
+    for (size_t p_box_index = BF_ROUNDS;
+         p_box_index >= BF_UNROLLED_STEP;
+         p_box_index -= BF_UNROLLED_STEP)
+    {
+        uint32_t p_odd  = state->p_box[p_box_index + 1];
+        uint32_t p_even = state->p_box[p_box_index];
+
+        data_l0 ^= p_odd;
+        data_l1 ^= p_odd;
+        data_l2 ^= p_odd;
+        data_l3 ^= p_odd;
+        data_r0 ^= blowfish_f(state, data_l0) ^ p_even;
+        data_r1 ^= blowfish_f(state, data_l1) ^ p_even;
+        data_r2 ^= blowfish_f(state, data_l2) ^ p_even;
+        data_r3 ^= blowfish_f(state, data_l3) ^ p_even;
+        data_l0 ^= blowfish_f(state, data_r0);
+        data_l1 ^= blowfish_f(state, data_r1);
+        data_l2 ^= blowfish_f(state, data_r2);
+        data_l3 ^= blowfish_f(state, data_r3);
+    }
+
+    data_l[0] = data_r0 ^ state->p_box[0];
+    data_l[1] = data_r1 ^ state->p_box[0];
+    data_l[2] = data_r2 ^ state->p_box[0];
+    data_l[3] = data_r3 ^ state->p_box[0];
+    data_r[0] = data_l0 ^ state->p_box[1];
+    data_r[1] = data_l1 ^ state->p_box[1];
+    data_r[2] = data_l2 ^ state->p_box[1];
+    data_r[3] = data_l3 ^ state->p_box[1];
+}
+
+
+/**
+ * Encrypts BF_INTERLEAVED_LANES independent blocks in lockstep, each with its own key
+ *
+ * @param states The cipher state objects, one per lane
+ * @param data_l The left 32 bits of each block
+ * @param data_r The right 32 bits of each block
+ */
+static inline void blowfish_encrypt_multikey(bf_state **states, uint32_t *data_l, uint32_t *data_r)
+{
+    bf_state *state0 = states[0];
+    bf_state *state1 = states[1];
+    bf_state *state2 = states[2];
+    bf_state *state3 = states[3];
+
+    uint32_t data_l0 = data_l[0];
+    uint32_t data_l1 = data_l[1];
+    uint32_t data_l2 = data_l[2];
+    uint32_t data_l3 = data_l[3];
+    uint32_t data_r0 = data_r[0];
+    uint32_t data_r1 = data_r[1];
+    uint32_t data_r2 = data_r[2];
+    uint32_t data_r3 = data_r[3];
+
+    for (size_t p_box_index = 0; p_box_index < BF_ROUNDS; p_box_index += BF_UNROLLED_STEP)
+    {
+        data_l0 ^= state0->p_box[p_box_index];
+        data_l1 ^= state1->p_box[p_box_index];
+        data_l2 ^= state2->p_box[p_box_index];
+        data_l3 ^= state3->p_box[p_box_index];
+        data_r0 ^= blowfish_f(state0, data_l0) ^ state0->p_box[p_box_index + 1];
+        data_r1 ^= blowfish_f(state1, data_l1) ^ state1->p_box[p_box_index + 1];
+        data_r2 ^= blowfish_f(state2, data_l2) ^ state2->p_box[p_box_index + 1];
+        data_r3 ^= blowfish_f(state3, data_l3) ^ state3->p_box[p_box_index + 1];
+        data_l0 ^= blowfish_f(state0, data_r0);
+        data_l1 ^= blowfish_f(state1, data_r1);
+        data_l2 ^= blowfish_f(state2, data_r2);
+        data_l3 ^= blowfish_f(state3, data_r3);
+    }
+
+    data_l[0] = data_r0 ^ state0->p_box[17];
+    data_l[1] = data_r1 ^ state1->p_box[17];
+    data_l[2] = data_r2 ^ state2->p_box[17];
+    data_l[3] = data_r3 ^ state3->p_box[17];
+    data_r[0] = data_l0 ^ state0->p_box[16];
+    data_r[1] = data_l1 ^ state1->p_box[16];
+    data_r[2] = data_l2 ^ state2->p_box[16];
+    data_r[3] = data_l3 ^ state3->p_box[16];
+}
+
+
+/**
+ * Completes the key schedule by replacing the P box and S boxes with the
+ * output of successive encryptions of an all-zero block
+ *
+ * @param state The cipher state object, prepared by blowfish_mix_key()
+ */
+static void blowfish_expand_key(bf_state *state)
+{
+    uint32_t data_l = 0;
+    uint32_t data_r = 0;
+
+    // Initialize the P box
+    for (size_t p_index = 0; p_index < BF_P_BOXES; p_index += BF_UNROLLED_STEP)
+    {
+        blowfish_encrypt(state, &data_l, &data_r);
+        state->p_box[p_index] = data_l;
+        state->p_box[p_index + 1] = data_r;
+    }
+
+    // Initialize the S boxes
+    for (size_t s_box_index = 0; s_box_index < BF_S_BOXES; ++s_box_index)
+    {
+        for (size_t s_entry_index = 0;
+             s_entry_index < BF_S_BOX_ENTRIES;
+             s_entry_index += BF_UNROLLED_STEP)
+        {
+            blowfish_encrypt(state, &data_l, &data_r);
+            state->s_box[s_box_index][s_entry_index] = data_l;
+            state->s_box[s_box_index][s_entry_index + 1] = data_r;
+        }
+    }
+}
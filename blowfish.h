@@ -26,6 +26,21 @@ void blowfish_clear(bf_state *state);
  */
 void blowfish_set_key(bf_state *state, const unsigned char *key, size_t key_length);
 
+/**
+ * Initializes multiple cipher state objects and sets their encryption keys
+ *
+ * Produces the same results as calling blowfish_init() and blowfish_set_key()
+ * for each state object, but runs the key schedules of several keys in lockstep
+ * using the kernel selected by blowfish_kernel()
+ *
+ * @param states      The cipher state objects
+ * @param keys        The keys to initialize the cipher state objects with
+ * @param key_lengths The lengths of the keys
+ * @param state_count The number of cipher state objects
+ */
+void blowfish_set_keys(bf_state *states[], const unsigned char *keys[], const size_t key_lengths[],
+                       size_t state_count);
+
 /**
  * Returns the cipher text for a single block of plain text input
  *
@@ -33,7 +48,7 @@ void blowfish_set_key(bf_state *state, const unsigned char *key, size_t key_leng
  * @param data  The plain text to encrypt
  * @return      The cipher text for the supplied plain text
  */
-uint64_t blowfish_encrypt64(bf_state *state, uint64_t data);
+uint64_t blowfish_encrypt64(const bf_state *state, uint64_t data);
 
 /**
  * Returns the plain text for a single block of cipher text input
@@ -42,7 +57,49 @@ uint64_t blowfish_encrypt64(bf_state *state, uint64_t data);
  * @param data  The cipher text to decrypt
  * @return      The plain text for the supplied cipher text
  */
-uint64_t blowfish_decrypt64(bf_state *state, uint64_t data);
+uint64_t blowfish_decrypt64(const bf_state *state, uint64_t data);
+
+/**
+ * Encrypts two single blocks, each with its own key, in lockstep
+ *
+ * For a serial chain of encryptions such as CFB mode, pairing each step with an
+ * independent block lets the S box lookups of both blocks overlap.
+ *
+ * @param state_a The cipher state object for the first block
+ * @param data_a  The first block; receives its cipher text
+ * @param state_b The cipher state object for the second block
+ * @param data_b  The second block; receives its cipher text
+ */
+void blowfish_encrypt64_pair(const bf_state *state_a, uint64_t *data_a,
+                             const bf_state *state_b, uint64_t *data_b);
+
+/**
+ * Encrypts an array of 64 bit blocks
+ *
+ * Produces the same results as calling blowfish_encrypt64() for each block,
+ * using the kernel selected by blowfish_kernel()
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+void blowfish_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                               size_t block_count);
+
+/**
+ * Decrypts an array of 64 bit blocks
+ *
+ * Produces the same results as calling blowfish_decrypt64() for each block,
+ * using the kernel selected by blowfish_kernel()
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+void blowfish_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                               size_t block_count);
 
 /**
  * Encrypts the two 32 bit parts of a single 64 bit block of data
@@ -51,7 +108,7 @@ uint64_t blowfish_decrypt64(bf_state *state, uint64_t data);
  * @param data_l_ref The left (first, big-endian high-order) 32 bits of data
  * @param data_r_ref The right (second, big-endian low-order) 32 bits of data
  */
-void blowfish_encrypt(bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_ref);
+void blowfish_encrypt(const bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_ref);
 
 /**
  * Decrypts the two 32 bit parts of a single 64 bit block of data
@@ -60,6 +117,6 @@ void blowfish_encrypt(bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_re
  * @param data_l_ref The left (first, big-endian high-order) 32 bits of data
  * @param data_r_ref The right (second, big-endian low-order) 32 bits of data
  */
-void blowfish_decrypt(bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_ref);
+void blowfish_decrypt(const bf_state *state, uint32_t *data_l_ref, uint32_t *data_r_ref);
 
 #endif	/* BLOWFISH_H */
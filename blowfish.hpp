@@ -0,0 +1,413 @@
+#ifndef BLOWFISH_HPP
+#define	BLOWFISH_HPP
+
+/*
+ * Header-only C++17 implementation of the Blowfish block cipher
+ *
+ * Operates on the same bf_state objects as the C library, so a state that
+ * was set up by blowfish_set_key() can be used with the functions in this
+ * header and vice versa.
+ *
+ * The table sizes are compile-time constants and the rounds are expanded
+ * by templates, so each round indexes the P box with a constant and the
+ * compiler can fold the table offsets into the load instructions.
+ */
+
+#include <blowfish_types.h>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace blowfish
+{
+    // Number of Feistel rounds
+    constexpr std::size_t rounds = 16;
+
+    // Number of P box entries
+    constexpr std::size_t p_boxes = rounds + 2;
+
+    // Number of S boxes and entries per S box
+    constexpr std::size_t s_boxes = 4;
+    constexpr std::size_t s_box_entries = 256;
+
+    // Default number of blocks encrypted in lockstep by the *_blocks() functions
+    constexpr std::size_t default_lanes = 8;
+
+    static_assert(sizeof (bf_state) == (p_boxes + s_boxes * s_box_entries) * sizeof (std::uint32_t),
+                  "bf_state layout does not match the table sizes");
+
+    // The initial P box and S box values
+    inline constexpr bf_state init_state =
+    {
+#include <blowfish_init_state.inc>
+    };
+
+    /**
+     * Copy of the P box in a local object
+     *
+     * Since every access uses a constant index, the compiler can keep the
+     * values in registers (as far as the register file allows) instead of
+     * reloading them from the bf_state object for each block.
+     */
+    struct p_box_values
+    {
+        std::uint32_t value[p_boxes];
+
+        constexpr std::uint32_t operator[](std::size_t index) const noexcept
+        {
+            return value[index];
+        }
+    };
+
+    /**
+     * Copies the P box of a cipher state object into a local object
+     *
+     * @param state The cipher state object
+     * @return      The P box values
+     */
+    inline p_box_values load_p_box(const bf_state &state) noexcept
+    {
+        p_box_values p_box {};
+        for (std::size_t p_index = 0; p_index < p_boxes; ++p_index)
+        {
+            p_box.value[p_index] = state.p_box[p_index];
+        }
+
+        return p_box;
+    }
+
+    namespace detail
+    {
+        /**
+         * The Blowfish algorithm's "F" function
+         *
+         * @param state The cipher state object
+         * @param value The input value to operate on
+         * @return      The result of the Blowfish algorithm's "F" function
+         */
+        inline std::uint32_t f(const bf_state &state, std::uint32_t value) noexcept
+        {
+            std::uint32_t result = state.s_box[0][value >> 24];
+            result += state.s_box[1][(value >> 16) & 0xFF];
+            result ^= state.s_box[2][(value >>  8) & 0xFF];
+            result += state.s_box[3][value & 0xFF];
+
+            return result;
+        }
+
+        /**
+         * Runs two encryption rounds on each lane
+         *
+         * Two rounds at a time leave the halves in their original positions,
+         * so no swap is needed between rounds.
+         *
+         * @param state  The cipher state object
+         * @param p_box  The P box, either state.p_box or a p_box_values copy
+         * @param data_l The left 32 bits of each lane
+         * @param data_r The right 32 bits of each lane
+         */
+        template <std::size_t Pair, typename PBox, std::size_t... Lanes>
+        inline void encrypt_pair(const bf_state &state, const PBox &p_box,
+                                 std::uint32_t *data_l, std::uint32_t *data_r,
+                                 std::index_sequence<Lanes...>) noexcept
+        {
+            constexpr std::size_t p_index = Pair * 2;
+            ((data_l[Lanes] ^= p_box[p_index]), ...);
+            ((data_r[Lanes] ^= f(state, data_l[Lanes])), ...);
+            ((data_r[Lanes] ^= p_box[p_index + 1]), ...);
+            ((data_l[Lanes] ^= f(state, data_r[Lanes])), ...);
+        }
+
+        /**
+         * Runs two decryption rounds on each lane
+         *
+         * @param state  The cipher state object
+         * @param p_box  The P box, either state.p_box or a p_box_values copy
+         * @param data_l The left 32 bits of each lane
+         * @param data_r The right 32 bits of each lane
+         */
+        template <std::size_t Pair, typename PBox, std::size_t... Lanes>
+        inline void decrypt_pair(const bf_state &state, const PBox &p_box,
+                                 std::uint32_t *data_l, std::uint32_t *data_r,
+                                 std::index_sequence<Lanes...>) noexcept
+        {
+            constexpr std::size_t p_index = rounds - Pair * 2;
+            ((data_l[Lanes] ^= p_box[p_index + 1]), ...);
+            ((data_r[Lanes] ^= f(state, data_l[Lanes])), ...);
+            ((data_r[Lanes] ^= p_box[p_index]), ...);
+            ((data_l[Lanes] ^= f(state, data_r[Lanes])), ...);
+        }
+
+        /**
+         * Encrypts one block per lane with all rounds expanded
+         *
+         * @param state  The cipher state object
+         * @param p_box  The P box, either state.p_box or a p_box_values copy
+         * @param data_l The left 32 bits of each lane, receives the left 32 bits of the cipher text
+         * @param data_r The right 32 bits of each lane, receives the right 32 bits of the cipher text
+         */
+        template <typename PBox, std::size_t... Pairs, std::size_t... Lanes>
+        inline void encrypt_lanes(const bf_state &state, const PBox &p_box,
+                                  std::uint32_t *data_l, std::uint32_t *data_r,
+                                  std::index_sequence<Pairs...>, std::index_sequence<Lanes...> lanes) noexcept
+        {
+            (encrypt_pair<Pairs>(state, p_box, data_l, data_r, lanes), ...);
+            ((data_l[Lanes] ^= p_box[rounds]), ...);
+            ((data_r[Lanes] ^= p_box[rounds + 1]), ...);
+            (std::swap(data_l[Lanes], data_r[Lanes]), ...);
+        }
+
+        /**
+         * Decrypts one block per lane with all rounds expanded
+         *
+         * @param state  The cipher state object
+         * @param p_box  The P box, either state.p_box or a p_box_values copy
+         * @param data_l The left 32 bits of each lane, receives the left 32 bits of the plain text
+         * @param data_r The right 32 bits of each lane, receives the right 32 bits of the plain text
+         */
+        template <typename PBox, std::size_t... Pairs, std::size_t... Lanes>
+        inline void decrypt_lanes(const bf_state &state, const PBox &p_box,
+                                  std::uint32_t *data_l, std::uint32_t *data_r,
+                                  std::index_sequence<Pairs...>, std::index_sequence<Lanes...> lanes) noexcept
+        {
+            (decrypt_pair<Pairs>(state, p_box, data_l, data_r, lanes), ...);
+            ((data_l[Lanes] ^= p_box[1]), ...);
+            ((data_r[Lanes] ^= p_box[0]), ...);
+            (std::swap(data_l[Lanes], data_r[Lanes]), ...);
+        }
+
+        /**
+         * Encrypts or decrypts an array of 64 bit blocks, Lanes blocks at a time
+         *
+         * @param state       The cipher state object
+         * @param input       The input blocks
+         * @param output      Receives the output blocks; may be the same array as input
+         * @param block_count The number of blocks
+         */
+        template <std::size_t Lanes, bool Decrypt>
+        inline void process_blocks(const bf_state &state, const std::uint64_t *input, std::uint64_t *output,
+                                   std::size_t block_count) noexcept
+        {
+            static_assert(Lanes > 0, "at least one lane is required");
+
+            const p_box_values p_box = load_p_box(state);
+            constexpr auto pairs = std::make_index_sequence<rounds / 2>();
+
+            const std::size_t lockstep_count = block_count - block_count % Lanes;
+            std::size_t block_index = 0;
+            for (; block_index < lockstep_count; block_index += Lanes)
+            {
+                std::uint32_t data_l[Lanes];
+                std::uint32_t data_r[Lanes];
+                for (std::size_t lane = 0; lane < Lanes; ++lane)
+                {
+                    data_l[lane] = static_cast<std::uint32_t>(input[block_index + lane] >> 32);
+                    data_r[lane] = static_cast<std::uint32_t>(input[block_index + lane]);
+                }
+                if constexpr (Decrypt)
+                {
+                    decrypt_lanes(state, p_box, data_l, data_r, pairs, std::make_index_sequence<Lanes>());
+                }
+                else
+                {
+                    encrypt_lanes(state, p_box, data_l, data_r, pairs, std::make_index_sequence<Lanes>());
+                }
+                for (std::size_t lane = 0; lane < Lanes; ++lane)
+                {
+                    output[block_index + lane] = (static_cast<std::uint64_t>(data_l[lane]) << 32) | data_r[lane];
+                }
+            }
+
+            // Remaining blocks, one at a time
+            for (; block_index < block_count; ++block_index)
+            {
+                std::uint32_t data_l = static_cast<std::uint32_t>(input[block_index] >> 32);
+                std::uint32_t data_r = static_cast<std::uint32_t>(input[block_index]);
+                if constexpr (Decrypt)
+                {
+                    decrypt_lanes(state, p_box, &data_l, &data_r, pairs, std::make_index_sequence<1>());
+                }
+                else
+                {
+                    encrypt_lanes(state, p_box, &data_l, &data_r, pairs, std::make_index_sequence<1>());
+                }
+                output[block_index] = (static_cast<std::uint64_t>(data_l) << 32) | data_r;
+            }
+        }
+    }
+
+    /**
+     * Initializes a bf_state object
+     *
+     * @param state The bf_state object to initialize
+     */
+    inline void init(bf_state &state) noexcept
+    {
+        state = init_state;
+    }
+
+    /**
+     * Clears the cipher's state
+     *
+     * @param state The bf_state object to clear
+     */
+    inline void clear(bf_state &state) noexcept
+    {
+        // Volatile stores, so the clearing is not removed as a dead store
+        volatile std::uint32_t *p_box = state.p_box;
+        for (std::size_t p_index = 0; p_index < p_boxes; ++p_index)
+        {
+            p_box[p_index] = 0;
+        }
+        for (std::size_t s_box_index = 0; s_box_index < s_boxes; ++s_box_index)
+        {
+            volatile std::uint32_t *s_box = state.s_box[s_box_index];
+            for (std::size_t s_entry_index = 0; s_entry_index < s_box_entries; ++s_entry_index)
+            {
+                s_box[s_entry_index] = 0;
+            }
+        }
+    }
+
+    /**
+     * Encrypts the two 32 bit parts of a single 64 bit block of data
+     *
+     * @param state  The cipher state object
+     * @param p_box  The P box, either state.p_box or a copy returned by load_p_box()
+     * @param data_l The left (first, big-endian high-order) 32 bits of data
+     * @param data_r The right (second, big-endian low-order) 32 bits of data
+     */
+    template <typename PBox>
+    inline void encrypt(const bf_state &state, const PBox &p_box, std::uint32_t &data_l, std::uint32_t &data_r) noexcept
+    {
+        detail::encrypt_lanes(state, p_box, &data_l, &data_r,
+                              std::make_index_sequence<rounds / 2>(), std::make_index_sequence<1>());
+    }
+
+    /**
+     * Decrypts the two 32 bit parts of a single 64 bit block of data
+     *
+     * @param state  The cipher state object
+     * @param p_box  The P box, either state.p_box or a copy returned by load_p_box()
+     * @param data_l The left (first, big-endian high-order) 32 bits of data
+     * @param data_r The right (second, big-endian low-order) 32 bits of data
+     */
+    template <typename PBox>
+    inline void decrypt(const bf_state &state, const PBox &p_box, std::uint32_t &data_l, std::uint32_t &data_r) noexcept
+    {
+        detail::decrypt_lanes(state, p_box, &data_l, &data_r,
+                              std::make_index_sequence<rounds / 2>(), std::make_index_sequence<1>());
+    }
+
+    /**
+     * Returns the cipher text for a single block of plain text input
+     *
+     * @param state The cipher state object
+     * @param data  The plain text to encrypt
+     * @return      The cipher text for the supplied plain text
+     */
+    inline std::uint64_t encrypt64(const bf_state &state, std::uint64_t data) noexcept
+    {
+        std::uint32_t data_l = static_cast<std::uint32_t>(data >> 32);
+        std::uint32_t data_r = static_cast<std::uint32_t>(data);
+        encrypt(state, state.p_box, data_l, data_r);
+
+        return (static_cast<std::uint64_t>(data_l) << 32) | data_r;
+    }
+
+    /**
+     * Returns the plain text for a single block of cipher text input
+     *
+     * @param state The cipher state object
+     * @param data  The cipher text to decrypt
+     * @return      The plain text for the supplied cipher text
+     */
+    inline std::uint64_t decrypt64(const bf_state &state, std::uint64_t data) noexcept
+    {
+        std::uint32_t data_l = static_cast<std::uint32_t>(data >> 32);
+        std::uint32_t data_r = static_cast<std::uint32_t>(data);
+        decrypt(state, state.p_box, data_l, data_r);
+
+        return (static_cast<std::uint64_t>(data_l) << 32) | data_r;
+    }
+
+    /**
+     * Encrypts an array of 64 bit blocks
+     *
+     * The P box is copied into local variables once per call, and Lanes
+     * independent blocks are encrypted in lockstep so that their S box
+     * lookups overlap.
+     *
+     * @param state       The cipher state object
+     * @param input       The plain text blocks to encrypt
+     * @param output      Receives the cipher text blocks; may be the same array as input
+     * @param block_count The number of blocks to encrypt
+     */
+    template <std::size_t Lanes = default_lanes>
+    inline void encrypt64_blocks(const bf_state &state, const std::uint64_t *input, std::uint64_t *output,
+                                 std::size_t block_count) noexcept
+    {
+        detail::process_blocks<Lanes, false>(state, input, output, block_count);
+    }
+
+    /**
+     * Decrypts an array of 64 bit blocks
+     *
+     * @param state       The cipher state object
+     * @param input       The cipher text blocks to decrypt
+     * @param output      Receives the plain text blocks; may be the same array as input
+     * @param block_count The number of blocks to decrypt
+     */
+    template <std::size_t Lanes = default_lanes>
+    inline void decrypt64_blocks(const bf_state &state, const std::uint64_t *input, std::uint64_t *output,
+                                 std::size_t block_count) noexcept
+    {
+        detail::process_blocks<Lanes, true>(state, input, output, block_count);
+    }
+
+    /**
+     * Sets the encryption key of an initialized bf_state object
+     *
+     * Produces the same key schedule as blowfish_set_key().
+     *
+     * @param state      The cipher state object, initialized by init()
+     * @param key        The key to initialize the cipher with
+     * @param key_length The length of the key, 1 to 56 bytes
+     */
+    inline void set_key(bf_state &state, const unsigned char *key, std::size_t key_length) noexcept
+    {
+        std::size_t key_index = 0;
+        for (std::size_t p_index = 0; p_index < p_boxes; ++p_index)
+        {
+            std::uint32_t value = 0;
+            // Load 4 key bytes
+            for (std::size_t counter = 0; counter < 4; ++counter)
+            {
+                value = (value << 8) | key[key_index];
+                key_index = (key_index + 1) % key_length;
+            }
+            state.p_box[p_index] ^= value;
+        }
+
+        // The P box changes with each step, so it is read from the state object
+        std::uint32_t data_l = 0;
+        std::uint32_t data_r = 0;
+        for (std::size_t p_index = 0; p_index < p_boxes; p_index += 2)
+        {
+            encrypt(state, state.p_box, data_l, data_r);
+            state.p_box[p_index]     = data_l;
+            state.p_box[p_index + 1] = data_r;
+        }
+        for (std::size_t s_box_index = 0; s_box_index < s_boxes; ++s_box_index)
+        {
+            for (std::size_t s_entry_index = 0; s_entry_index < s_box_entries; s_entry_index += 2)
+            {
+                encrypt(state, state.p_box, data_l, data_r);
+                state.s_box[s_box_index][s_entry_index]     = data_l;
+                state.s_box[s_box_index][s_entry_index + 1] = data_r;
+            }
+        }
+    }
+}
+
+#endif	/* BLOWFISH_HPP */
@@ -0,0 +1,212 @@
+/**
+ * Single-pass authenticated encryption in CFB mode
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <blowfish_auth.h>
+#include <blowfish_endian.h>
+#include <blowfish_stats.h>
+
+// Size of a cipher block
+const size_t BF_AUTH_BLOCK_SIZE = 8;
+
+// Size of the segments that are authenticated and then decrypted while still in the L1 cache
+const size_t BF_AUTH_SEGMENT_SIZE = 4096;
+
+
+/**
+ * Starts an authenticated stream
+ *
+ * @param auth_state The object to initialize
+ * @param cfb_state  CFB mode state object at the start of a stream
+ * @param mac_key    The MAC key
+ */
+void blowfish_cfb64_auth_init(bf_cfb64_auth_state *auth_state, bf_cfb64_state *cfb_state,
+                              const bf_mac_key *mac_key)
+{
+    auth_state->cfb_state = cfb_state;
+    blowfish_pmac_init(&auth_state->pmac_state, mac_key);
+
+    // The feedback of a new stream is its initialization vector
+    unsigned char init_vector[8];
+    blowfish_store_be64(init_vector, cfb_state->feedback);
+    blowfish_pmac_update(&auth_state->pmac_state, init_vector, sizeof (init_vector));
+}
+
+
+/**
+ * Encrypts the supplied data in-place and adds the cipher text to the tag
+ *
+ * @param auth_state  The authenticated stream
+ * @param data        Plain text input data to encrypt
+ * @param data_length Length of the input data
+ */
+void blowfish_cfb64_auth_encrypt(bf_cfb64_auth_state *auth_state, unsigned char *data, size_t data_length)
+{
+    bf_cfb64_state *cfb_state = auth_state->cfb_state;
+    bf_pmac_state *pmac_state = &auth_state->pmac_state;
+    size_t data_index = 0;
+
+    // Finish the block started by a previous call
+    if (cfb_state->position > 0)
+    {
+        data_index = BF_AUTH_BLOCK_SIZE - cfb_state->position;
+        if (data_index > data_length)
+        {
+            data_index = data_length;
+        }
+        blowfish_cfb64_encrypt(cfb_state, data, data_index);
+        blowfish_pmac_update(pmac_state, data, data_index);
+    }
+
+    // At a block boundary, the block held back by the PMAC is the last cipher text
+    // block, which is also the CFB feedback. Each step encrypts the feedback for
+    // the next cipher text block together with that block's PMAC input.
+    size_t full_blocks = (data_length - data_index) / BF_AUTH_BLOCK_SIZE;
+    if (full_blocks > 0)
+    {
+        BF_STATS_START(stats_start);
+        const bf_mac_key *mac_key = pmac_state->key;
+        uint64_t cipher_text = cfb_state->feedback;
+        uint64_t offset = pmac_state->offset;
+        uint64_t checksum = pmac_state->checksum;
+        uint64_t block_number = pmac_state->block_count;
+        for (size_t block_index = 0; block_index < full_blocks; ++block_index)
+        {
+            ++block_number;
+            offset ^= mac_key->offsets[__builtin_ctzll(block_number)];
+            uint64_t mac_block = cipher_text ^ offset;
+            blowfish_encrypt64_pair(cfb_state->cipher_state, &cipher_text, mac_key->cipher_state, &mac_block);
+            checksum ^= mac_block;
+
+            cipher_text ^= blowfish_load_be64(&data[data_index]);
+            blowfish_store_be64(&data[data_index], cipher_text);
+            data_index += BF_AUTH_BLOCK_SIZE;
+        }
+        cfb_state->feedback = cipher_text;
+        pmac_state->offset = offset;
+        pmac_state->checksum = checksum;
+        pmac_state->block_count = block_number;
+        blowfish_store_be64(pmac_state->buffer, cipher_text);
+        BF_STATS_RECORD(BF_STATS_CFB64_ENCRYPT, stats_start, full_blocks * BF_AUTH_BLOCK_SIZE, full_blocks);
+    }
+
+    if (data_index < data_length)
+    {
+        blowfish_cfb64_encrypt(cfb_state, &data[data_index], data_length - data_index);
+        blowfish_pmac_update(pmac_state, &data[data_index], data_length - data_index);
+    }
+}
+
+
+/**
+ * Adds the supplied cipher text to the tag and decrypts it in-place
+ *
+ * @param auth_state  The authenticated stream
+ * @param data        Cipher text input data to decrypt
+ * @param data_length Length of the input data
+ */
+void blowfish_cfb64_auth_decrypt(bf_cfb64_auth_state *auth_state, unsigned char *data, size_t data_length)
+{
+    for (size_t offset = 0; offset < data_length; offset += BF_AUTH_SEGMENT_SIZE)
+    {
+        size_t segment_length = data_length - offset;
+        if (segment_length > BF_AUTH_SEGMENT_SIZE)
+        {
+            segment_length = BF_AUTH_SEGMENT_SIZE;
+        }
+        blowfish_pmac_update(&auth_state->pmac_state, &data[offset], segment_length);
+        blowfish_cfb64_decrypt(auth_state->cfb_state, &data[offset], segment_length);
+    }
+}
+
+
+/**
+ * Completes an authenticated stream
+ *
+ * @param auth_state The authenticated stream
+ * @return           The tag over the initialization vector and all cipher text
+ */
+uint64_t blowfish_cfb64_auth_final(bf_cfb64_auth_state *auth_state)
+{
+    return blowfish_pmac_final(&auth_state->pmac_state);
+}
+
+
+/**
+ * Encrypts a message in-place and computes its tag in a single pass
+ *
+ * @param cfb_state   CFB mode state object at the start of a stream
+ * @param mac_key     The MAC key
+ * @param data        Plain text input data to encrypt
+ * @param data_length Length of the input data
+ * @return            The tag
+ */
+uint64_t blowfish_cfb64_encrypt_auth(bf_cfb64_state *cfb_state, const bf_mac_key *mac_key,
+                                     unsigned char *data, size_t data_length)
+{
+    bf_cfb64_auth_state auth_state;
+    blowfish_cfb64_auth_init(&auth_state, cfb_state, mac_key);
+    blowfish_cfb64_auth_encrypt(&auth_state, data, data_length);
+
+    return blowfish_cfb64_auth_final(&auth_state);
+}
+
+
+/**
+ * Verifies and decrypts a message in-place in a single pass
+ *
+ * @param cfb_state   CFB mode state object at the start of a stream
+ * @param mac_key     The MAC key
+ * @param data        Cipher text input data to decrypt
+ * @param data_length Length of the input data
+ * @param tag         The received tag
+ * @return            0 if the tag matches, -1 otherwise
+ */
+int blowfish_cfb64_decrypt_verify(bf_cfb64_state *cfb_state, const bf_mac_key *mac_key,
+                                  unsigned char *data, size_t data_length, uint64_t tag)
+{
+    bf_cfb64_auth_state auth_state;
+    blowfish_cfb64_auth_init(&auth_state, cfb_state, mac_key);
+    blowfish_cfb64_auth_decrypt(&auth_state, data, data_length);
+
+    if (!blowfish_mac_equal(blowfish_cfb64_auth_final(&auth_state), tag))
+    {
+        // Through a volatile pointer, so that the clearing is not optimized away
+        volatile unsigned char *plain_text = data;
+        for (size_t index = 0; index < data_length; ++index)
+        {
+            plain_text[index] = 0;
+        }
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+#ifndef BLOWFISH_AUTH_H
+#define	BLOWFISH_AUTH_H
+
+#include <blowfish_cfb64.h>
+#include <blowfish_mac.h>
+
+/*
+ * Authenticated encryption in CFB mode (encrypt-then-MAC)
+ *
+ * The tag is the PMAC of the initialization vector followed by the cipher
+ * text, so it also detects a modified initialization vector. Both are
+ * computed in a single pass over the data: on encryption, each step of the
+ * serial CFB chain encrypts the PMAC input of the preceding cipher text block
+ * in lockstep, which hides most of the cost of the MAC in the latency of the
+ * chain. On decryption, the data is authenticated and then decrypted in
+ * segments that are still in the L1 cache.
+ *
+ * The MAC key must be derived from a different key than the cipher state
+ * of the CFB mode state object.
+ */
+
+typedef struct bf_cfb64_auth_state_s bf_cfb64_auth_state;
+struct bf_cfb64_auth_state_s
+{
+    bf_cfb64_state *cfb_state;
+    bf_pmac_state  pmac_state;
+};
+
+/**
+ * Starts an authenticated stream
+ *
+ * @param auth_state The object to initialize
+ * @param cfb_state  CFB mode state object at the start of a stream, directly after
+ *                   blowfish_cfb64_init() or blowfish_cfb64_set_init_vector()
+ * @param mac_key    The MAC key
+ */
+void blowfish_cfb64_auth_init(bf_cfb64_auth_state *auth_state, bf_cfb64_state *cfb_state,
+                              const bf_mac_key *mac_key);
+
+/**
+ * Encrypts the supplied data in-place and adds the cipher text to the tag
+ *
+ * @param auth_state  The authenticated stream
+ * @param data        Plain text input data to encrypt
+ * @param data_length Length of the input data
+ */
+void blowfish_cfb64_auth_encrypt(bf_cfb64_auth_state *auth_state, unsigned char *data, size_t data_length);
+
+/**
+ * Adds the supplied cipher text to the tag and decrypts it in-place
+ *
+ * The plain text is not verified until the tag is checked at the end of the
+ * stream; use blowfish_cfb64_decrypt_verify() to receive only verified plain text.
+ *
+ * @param auth_state  The authenticated stream
+ * @param data        Cipher text input data to decrypt
+ * @param data_length Length of the input data
+ */
+void blowfish_cfb64_auth_decrypt(bf_cfb64_auth_state *auth_state, unsigned char *data, size_t data_length);
+
+/**
+ * Completes an authenticated stream
+ *
+ * @param auth_state The authenticated stream
+ * @return           The tag over the initialization vector and all cipher text
+ */
+uint64_t blowfish_cfb64_auth_final(bf_cfb64_auth_state *auth_state);
+
+/**
+ * Encrypts a message in-place and computes its tag in a single pass
+ *
+ * @param cfb_state   CFB mode state object at the start of a stream
+ * @param mac_key     The MAC key
+ * @param data        Plain text input data to encrypt
+ * @param data_length Length of the input data
+ * @return            The tag
+ */
+uint64_t blowfish_cfb64_encrypt_auth(bf_cfb64_state *cfb_state, const bf_mac_key *mac_key,
+                                     unsigned char *data, size_t data_length);
+
+/**
+ * Verifies and decrypts a message in-place in a single pass
+ *
+ * If the tag does not match, the decrypted data is cleared before returning,
+ * so unverified plain text is never released.
+ *
+ * @param cfb_state   CFB mode state object at the start of a stream
+ * @param mac_key     The MAC key
+ * @param data        Cipher text input data to decrypt
+ * @param data_length Length of the input data
+ * @param tag         The received tag
+ * @return            0 if the tag matches, -1 otherwise
+ */
+int blowfish_cfb64_decrypt_verify(bf_cfb64_state *cfb_state, const bf_mac_key *mac_key,
+                                  unsigned char *data, size_t data_length, uint64_t tag);
+
+#endif	/* BLOWFISH_AUTH_H */
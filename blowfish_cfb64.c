@@ -31,6 +31,10 @@
  */
 
 #include <blowfish_cfb64.h>
+#include <blowfish_endian.h>
+#include <blowfish_stats.h>
+#include <stddef.h>
+#include <sys/uio.h>
 
 // Block size in bytes (8 == 64 bits)
 const size_t BF_CFB64_BLOCK_SIZE = 8;
@@ -44,6 +48,25 @@ const uint64_t BF_CFB64_BYTE_MASK = 0xFF;
 // Byte shift value (8 bits == 1 byte)
 const size_t BF_CFB64_BYTE_SHIFT = 8;
 
+// Number of blocks decrypted per call of the block-parallel kernel
+#define BF_CFB64_BATCH_BLOCKS 64
+
+typedef void (*bf_cfb64_copy_func)(bf_cfb64_state *cfb_state, const unsigned char *input,
+                                   unsigned char *output, size_t data_length);
+
+static inline size_t blowfish_cfb64_encrypt_bytes(bf_cfb64_state *cfb_state, uint64_t *feedback,
+                                                  const unsigned char *input, unsigned char *output,
+                                                  size_t data_length);
+static inline size_t blowfish_cfb64_decrypt_bytes(bf_cfb64_state *cfb_state, uint64_t *feedback,
+                                                  const unsigned char *input, unsigned char *output,
+                                                  size_t data_length);
+static void blowfish_cfb64_process_records(const bf_state *state, bf_cfb64_record *records,
+                                           size_t record_count, int decrypt);
+static size_t blowfish_cfb64_total_iov(const struct iovec *iov, size_t count);
+static size_t blowfish_cfb64_process_iov(bf_cfb64_state *cfb_state, bf_cfb64_copy_func process,
+                                         const struct iovec *input_iov, size_t input_count,
+                                         const struct iovec *output_iov, size_t output_count);
+
 
 /**
  * Encrypts the supplied data in-place
@@ -55,134 +78,197 @@ const size_t BF_CFB64_BYTE_SHIFT = 8;
 void blowfish_cfb64_encrypt(bf_cfb64_state *cfb_state,
                             unsigned char *data, size_t data_length)
 {
-    uint64_t cipher_text = cfb_state->feedback;
-    size_t full_blocks = data_length / BF_CFB64_BLOCK_SIZE;
-    for (size_t block_index = 0; block_index < full_blocks; ++block_index)
-    {
-        cipher_text = blowfish_encrypt64(cfb_state->cipher_state, cipher_text);
+    blowfish_cfb64_encrypt_copy(cfb_state, data, data, data_length);
+}
 
-        uint64_t plain_text = 0;
-        // Get the plain text from the data string
-        for (size_t offset = 0; offset < BF_CFB64_BLOCK_SIZE; ++offset)
-        {
-            size_t data_index = block_index * BF_CFB64_BLOCK_SIZE + offset;
-            plain_text = plain_text << BF_CFB64_BYTE_SHIFT;
-            plain_text |= data[data_index];
-        }
 
-        // XOR cipher text and plain text
-        cipher_text ^= plain_text;
+/**
+ * Decrypts the supplied data in-place
+ *
+ * @param cfb_state   CFB mode state object
+ * @param data        Cipher text input data to decrypt
+ * @param data_length Length of the input data
+ */
+void blowfish_cfb64_decrypt(bf_cfb64_state *cfb_state,
+                            unsigned char *data, size_t data_length)
+{
+    blowfish_cfb64_decrypt_copy(cfb_state, data, data, data_length);
+}
+
 
-        // Write the cipher text back to the data string
-        for (size_t offset = 0; offset < BF_CFB64_BLOCK_SIZE; ++offset)
-        {
-            size_t data_index = block_index * BF_CFB64_BLOCK_SIZE + offset;
-            data[data_index] = (unsigned char) (cipher_text >> ((BF_CFB64_REMAINDER_BASE -
-                               offset) * BF_CFB64_BYTE_SHIFT) & BF_CFB64_BYTE_MASK);
-        }
+/**
+ * Encrypts the supplied data into a separate output buffer
+ *
+ * @param cfb_state   CFB mode state object
+ * @param input       Plain text input data to encrypt
+ * @param output      Receives the cipher text; may be the same buffer as input
+ * @param data_length Length of the input data
+ */
+void blowfish_cfb64_encrypt_copy(bf_cfb64_state *cfb_state, const unsigned char *input,
+                                 unsigned char *output, size_t data_length)
+{
+    BF_STATS_START(stats_start);
+    uint64_t cipher_text = cfb_state->feedback;
+    size_t data_index = 0;
+
+    // Finish the block started by a previous call
+    if (cfb_state->position > 0)
+    {
+        data_index = blowfish_cfb64_encrypt_bytes(cfb_state, &cipher_text, input, output, data_length);
     }
 
-    size_t remainder = data_length % BF_CFB64_BLOCK_SIZE;
-    if (remainder > 0)
+    size_t full_blocks = (data_length - data_index) / BF_CFB64_BLOCK_SIZE;
+    for (size_t block_index = 0; block_index < full_blocks; ++block_index)
     {
         cipher_text = blowfish_encrypt64(cfb_state->cipher_state, cipher_text);
+        cipher_text ^= blowfish_load_be64(&input[data_index]);
+        blowfish_store_be64(&output[data_index], cipher_text);
+        data_index += BF_CFB64_BLOCK_SIZE;
+    }
 
-        uint64_t plain_text = 0;
-        // Get the remainder of the plain text from the data string
-        for (size_t offset = 0; offset < remainder; ++offset)
-        {
-            size_t data_index = data_length - remainder + offset;
-            plain_text = plain_text << BF_CFB64_BYTE_SHIFT;
-            plain_text |= data[data_index];
-        }
-        // Finish the shift to the left
-        plain_text = plain_text << ((BF_CFB64_BLOCK_SIZE - remainder) * BF_CFB64_BYTE_SHIFT);
-
-        cipher_text ^= plain_text;
-
-        // Write the remainder of the cipher text back to the data string
-        for (size_t offset = 0; offset < remainder; ++offset)
-        {
-            size_t data_index = data_length - remainder + offset;
-            data[data_index] = (unsigned char) (cipher_text >> ((BF_CFB64_REMAINDER_BASE -
-                               offset) * BF_CFB64_BYTE_SHIFT) & BF_CFB64_BYTE_MASK);
-        }
+    // Start a new block with the remaining data
+    if (data_index < data_length)
+    {
+        cipher_text = blowfish_encrypt64(cfb_state->cipher_state, cipher_text);
+        blowfish_cfb64_encrypt_bytes(cfb_state, &cipher_text, &input[data_index], &output[data_index],
+                                     data_length - data_index);
     }
 
     cfb_state->feedback = cipher_text;
+    BF_STATS_RECORD(BF_STATS_CFB64_ENCRYPT, stats_start, data_length, full_blocks + (data_index < data_length));
 }
 
 
 /**
- * Decrypts the supplied data in-place
+ * Decrypts the supplied data into a separate output buffer
  *
  * @param cfb_state   CFB mode state object
- * @param data        Cipher text input data to decrypt
+ * @param input       Cipher text input data to decrypt
+ * @param output      Receives the plain text; may be the same buffer as input
  * @param data_length Length of the input data
  */
-void blowfish_cfb64_decrypt(bf_cfb64_state *cfb_state,
-                            unsigned char *data, size_t data_length)
+void blowfish_cfb64_decrypt_copy(bf_cfb64_state *cfb_state, const unsigned char *input,
+                                 unsigned char *output, size_t data_length)
 {
+    BF_STATS_START(stats_start);
     uint64_t cipher_base = cfb_state->feedback;
+    size_t data_index = 0;
 
-    size_t full_blocks = data_length / BF_CFB64_BLOCK_SIZE;
-    for (size_t block_index = 0; block_index < full_blocks; ++block_index)
+    // Finish the block started by a previous call
+    if (cfb_state->position > 0)
     {
-        // Encrypt the current block
-        cipher_base = blowfish_encrypt64(cfb_state->cipher_state, cipher_base);
+        data_index = blowfish_cfb64_decrypt_bytes(cfb_state, &cipher_base, input, output, data_length);
+    }
+
+    // Each key stream block only depends on the preceding cipher text block,
+    // so all key stream blocks of a batch can be generated in parallel
+    size_t full_blocks = (data_length - data_index) / BF_CFB64_BLOCK_SIZE;
+    for (size_t block_index = 0; block_index < full_blocks; block_index += BF_CFB64_BATCH_BLOCKS)
+    {
+        size_t batch_blocks = full_blocks - block_index;
+        if (batch_blocks > BF_CFB64_BATCH_BLOCKS)
+        {
+            batch_blocks = BF_CFB64_BATCH_BLOCKS;
+        }
+        const unsigned char *batch_input = &input[data_index];
+        unsigned char *batch_output = &output[data_index];
 
-        // Get the cipher text from the data string
-        uint64_t cipher_text = 0;
-        for (size_t offset = 0; offset < BF_CFB64_BLOCK_SIZE; ++offset)
+        // Get the cipher text from the input data
+        uint64_t cipher_text[BF_CFB64_BATCH_BLOCKS];
+        uint64_t key_stream[BF_CFB64_BATCH_BLOCKS];
+        for (size_t batch_index = 0; batch_index < batch_blocks; ++batch_index)
         {
-            size_t data_index = block_index * BF_CFB64_BLOCK_SIZE + offset;
-            cipher_text = cipher_text << BF_CFB64_BYTE_SHIFT;
-            cipher_text |= data[data_index];
+            key_stream[batch_index] = cipher_base;
+            cipher_text[batch_index] = blowfish_load_be64(&batch_input[batch_index * BF_CFB64_BLOCK_SIZE]);
+            cipher_base = cipher_text[batch_index];
         }
 
-        // Decrypt the block
-        uint64_t plain_text = cipher_text ^ cipher_base;
+        blowfish_encrypt64_blocks(cfb_state->cipher_state, key_stream, key_stream, batch_blocks);
 
-        // Write the plain text back to the data string
-        for (size_t offset = 0; offset < BF_CFB64_BLOCK_SIZE; ++offset)
+        // Decrypt the blocks and write the plain text to the output data
+        for (size_t batch_index = 0; batch_index < batch_blocks; ++batch_index)
         {
-            size_t data_index = block_index * BF_CFB64_BLOCK_SIZE + offset;
-            data[data_index] = (unsigned char) (plain_text >> ((BF_CFB64_REMAINDER_BASE -
-                               offset) * BF_CFB64_BYTE_SHIFT) & BF_CFB64_BYTE_MASK);
+            blowfish_store_be64(&batch_output[batch_index * BF_CFB64_BLOCK_SIZE],
+                                cipher_text[batch_index] ^ key_stream[batch_index]);
         }
 
-        // Set the cipher input for the next block
-        cipher_base = cipher_text;
+        data_index += batch_blocks * BF_CFB64_BLOCK_SIZE;
     }
 
-    size_t remainder = data_length % BF_CFB64_BLOCK_SIZE;
-    if (remainder > 0)
+    // Start a new block with the remaining data
+    if (data_index < data_length)
     {
         cipher_base = blowfish_encrypt64(cfb_state->cipher_state, cipher_base);
+        blowfish_cfb64_decrypt_bytes(cfb_state, &cipher_base, &input[data_index], &output[data_index],
+                                     data_length - data_index);
+    }
 
-        uint64_t cipher_text = 0;
-        for (size_t offset = 0; offset < remainder; ++offset)
-        {
-            size_t data_index = data_length - remainder + offset;
-            cipher_text = cipher_text << BF_CFB64_BYTE_SHIFT;
-            cipher_text |= data[data_index];
-        }
-        // Finish the shift to the left
-        cipher_text = cipher_text << ((BF_CFB64_BLOCK_SIZE - remainder) * BF_CFB64_BYTE_SHIFT);
+    cfb_state->feedback = cipher_base;
+    BF_STATS_RECORD(BF_STATS_CFB64_DECRYPT, stats_start, data_length, full_blocks + (data_index < data_length));
+}
 
-        // Decrypt the block
-        uint64_t plain_text = cipher_text ^ cipher_base;
 
-        // Write the remainder of the plain text back to the data string
-        for (size_t offset = 0; offset < remainder; ++offset)
-        {
-            size_t data_index = data_length - remainder + offset;
-            data[data_index] = (unsigned char) (plain_text >> ((BF_CFB64_REMAINDER_BASE -
-                               offset) * BF_CFB64_BYTE_SHIFT) & BF_CFB64_BYTE_MASK);
-        }
-    }
+/**
+ * Encrypts data from a list of input buffers into a list of output buffers
+ *
+ * @param cfb_state    CFB mode state object
+ * @param input_iov    Plain text input buffers
+ * @param input_count  Number of input buffers
+ * @param output_iov   Output buffers receiving the cipher text
+ * @param output_count Number of output buffers
+ * @return             Number of bytes processed; the smaller of the total input and output sizes
+ */
+size_t blowfish_cfb64_encrypt_iov(bf_cfb64_state *cfb_state,
+                                  const struct iovec *input_iov, size_t input_count,
+                                  const struct iovec *output_iov, size_t output_count)
+{
+    return blowfish_cfb64_process_iov(cfb_state, blowfish_cfb64_encrypt_copy,
+                                      input_iov, input_count, output_iov, output_count);
+}
 
-    cfb_state->feedback = cipher_base;
+
+/**
+ * Decrypts data from a list of input buffers into a list of output buffers
+ *
+ * @param cfb_state    CFB mode state object
+ * @param input_iov    Cipher text input buffers
+ * @param input_count  Number of input buffers
+ * @param output_iov   Output buffers receiving the plain text
+ * @param output_count Number of output buffers
+ * @return             Number of bytes processed; the smaller of the total input and output sizes
+ */
+size_t blowfish_cfb64_decrypt_iov(bf_cfb64_state *cfb_state,
+                                  const struct iovec *input_iov, size_t input_count,
+                                  const struct iovec *output_iov, size_t output_count)
+{
+    return blowfish_cfb64_process_iov(cfb_state, blowfish_cfb64_decrypt_copy,
+                                      input_iov, input_count, output_iov, output_count);
+}
+
+
+/**
+ * Encrypts many independent messages in-place
+ *
+ * @param state        The cipher state object
+ * @param records      The messages to encrypt
+ * @param record_count Number of messages
+ */
+void blowfish_cfb64_encrypt_records(const bf_state *state, bf_cfb64_record *records, size_t record_count)
+{
+    blowfish_cfb64_process_records(state, records, record_count, 0);
+}
+
+
+/**
+ * Decrypts many independent messages in-place
+ *
+ * @param state        The cipher state object
+ * @param records      The messages to decrypt
+ * @param record_count Number of messages
+ */
+void blowfish_cfb64_decrypt_records(const bf_state *state, bf_cfb64_record *records, size_t record_count)
+{
+    blowfish_cfb64_process_records(state, records, record_count, 1);
 }
 
 
@@ -193,11 +279,12 @@ void blowfish_cfb64_decrypt(bf_cfb64_state *cfb_state,
  * @param state       Cipher state object
  * @param init_vector The initialization vector for the cipher
  */
-void blowfish_cfb64_init(bf_cfb64_state *cfb_state, bf_state *state,
+void blowfish_cfb64_init(bf_cfb64_state *cfb_state, const bf_state *state,
                          uint64_t init_vector)
 {
     cfb_state->cipher_state = state;
     cfb_state->feedback     = init_vector;
+    cfb_state->position     = 0;
 }
 
 
@@ -210,6 +297,7 @@ void blowfish_cfb64_init(bf_cfb64_state *cfb_state, bf_state *state,
 void blowfish_cfb64_set_init_vector(bf_cfb64_state *cfb_state, uint64_t init_vector)
 {
     cfb_state->feedback = init_vector;
+    cfb_state->position = 0;
 }
 
 
@@ -220,20 +308,16 @@ bf_cfb64_state *blowfish_cfb64_alloc(void)
 {
     bf_cfb64_state *cfb_state = NULL;
 
-    bf_state *cipher_state = malloc(sizeof (bf_state));
-    if (cipher_state != NULL)
+    // A single allocation holds both the mode state and the cipher state
+    bf_cfb64_context *context = malloc(sizeof (bf_cfb64_context));
+    if (context != NULL)
     {
-        cfb_state = malloc(sizeof (bf_cfb64_state));
-        if (cfb_state != NULL)
-        {
-            cfb_state->cipher_state = cipher_state;
-            cfb_state->feedback     = 0;
-            blowfish_init(cipher_state);
-        }
-        else
-        {
-            free(cipher_state);
-        }
+        cfb_state = &context->cfb_state;
+        cfb_state->cipher_state = &context->cipher_state;
+        cfb_state->feedback     = 0;
+        cfb_state->position     = 0;
+        blowfish_init(&context->cipher_state);
+        BF_STATS_COUNT(BF_STATS_ALLOCATIONS, 1);
     }
 
     return cfb_state;
@@ -245,8 +329,7 @@ bf_cfb64_state *blowfish_cfb64_alloc(void)
  */
 void blowfish_cfb64_dealloc(bf_cfb64_state *cfb_state)
 {
-    free(cfb_state->cipher_state);
-    free(cfb_state);
+    free(blowfish_cfb64_context_of(cfb_state));
 }
 
 
@@ -259,8 +342,9 @@ bf_cfb64_state *blowfish_cfb64_create(const unsigned char *key, size_t key_lengt
     bf_cfb64_state *cfb_state = blowfish_cfb64_alloc();
     if (cfb_state != NULL)
     {
-        blowfish_set_key(cfb_state->cipher_state, key, key_length);
+        blowfish_set_key(&blowfish_cfb64_context_of(cfb_state)->cipher_state, key, key_length);
         cfb_state->feedback = init_vector;
+        cfb_state->position = 0;
     }
 
     return cfb_state;
@@ -273,6 +357,314 @@ bf_cfb64_state *blowfish_cfb64_create(const unsigned char *key, size_t key_lengt
 void blowfish_cfb64_destroy(bf_cfb64_state *cfb_state)
 {
     cfb_state->feedback = 0;
-    blowfish_clear(cfb_state->cipher_state);
+    cfb_state->position = 0;
+    blowfish_clear(&blowfish_cfb64_context_of(cfb_state)->cipher_state);
     blowfish_cfb64_dealloc(cfb_state);
 }
+
+
+/**
+ * Initializes a bf_cfb64_context object in caller-provided storage
+ *
+ * @param context     The storage for the context
+ * @param key         The key to initialize the cipher with
+ * @param key_length  The length of the key
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CFB mode state object within the context
+ */
+bf_cfb64_state *blowfish_cfb64_create_in(bf_cfb64_context *context,
+                                         const unsigned char *key, size_t key_length,
+                                         uint64_t init_vector)
+{
+    blowfish_init(&context->cipher_state);
+    blowfish_set_key(&context->cipher_state, key, key_length);
+    blowfish_cfb64_init(&context->cfb_state, &context->cipher_state, init_vector);
+
+    return &context->cfb_state;
+}
+
+
+/**
+ * Clears a bf_cfb64_context object initialized by blowfish_cfb64_create_in()
+ *
+ * @param context The context to clear
+ */
+void blowfish_cfb64_destroy_in(bf_cfb64_context *context)
+{
+    context->cfb_state.feedback = 0;
+    context->cfb_state.position = 0;
+    blowfish_clear(&context->cipher_state);
+}
+
+
+/**
+ * Returns the context that contains a CFB mode state object
+ *
+ * @param cfb_state CFB mode state object returned by blowfish_cfb64_alloc(),
+ *                  blowfish_cfb64_create() or blowfish_cfb64_create_in()
+ * @return          The context containing the state object
+ */
+bf_cfb64_context *blowfish_cfb64_context_of(bf_cfb64_state *cfb_state)
+{
+    return (bf_cfb64_context *) ((unsigned char *) cfb_state - offsetof(bf_cfb64_context, cfb_state));
+}
+
+
+/**
+ * Advances up to BF_CFB64_BATCH_BLOCKS records in lockstep
+ *
+ * Each lane holds one record. In each step the feedback values of all lanes
+ * are encrypted by a single call of the block-parallel kernel, then every lane
+ * processes one block of its record. A lane whose record is complete takes the
+ * next record, so the lanes stay filled while records of different lengths
+ * are mixed.
+ *
+ * @param state        The cipher state object
+ * @param records      The messages
+ * @param record_count Number of messages
+ * @param decrypt      Non-zero to decrypt, zero to encrypt
+ */
+static void blowfish_cfb64_process_records(const bf_state *state, bf_cfb64_record *records,
+                                           size_t record_count, int decrypt)
+{
+    BF_STATS_START(stats_start);
+    bf_cfb64_record *lane_records[BF_CFB64_BATCH_BLOCKS];
+    size_t lane_offsets[BF_CFB64_BATCH_BLOCKS];
+    uint64_t feedback[BF_CFB64_BATCH_BLOCKS];
+    uint64_t key_stream[BF_CFB64_BATCH_BLOCKS];
+    uint64_t total_bytes = 0;
+    uint64_t total_blocks = 0;
+
+    size_t next_record = 0;
+    size_t lane_count = 0;
+    while (lane_count < BF_CFB64_BATCH_BLOCKS && next_record < record_count)
+    {
+        if (records[next_record].length > 0)
+        {
+            lane_records[lane_count] = &records[next_record];
+            lane_offsets[lane_count] = 0;
+            feedback[lane_count] = records[next_record].init_vector;
+            ++lane_count;
+        }
+        ++next_record;
+    }
+
+    while (lane_count > 0)
+    {
+        blowfish_encrypt64_blocks(state, feedback, key_stream, lane_count);
+        total_blocks += lane_count;
+
+        size_t lane = 0;
+        while (lane < lane_count)
+        {
+            bf_cfb64_record *record = lane_records[lane];
+            unsigned char *data = &record->data[lane_offsets[lane]];
+            size_t remaining = record->length - lane_offsets[lane];
+            if (remaining >= BF_CFB64_BLOCK_SIZE)
+            {
+                uint64_t input = blowfish_load_be64(data);
+                uint64_t output = input ^ key_stream[lane];
+                blowfish_store_be64(data, output);
+                feedback[lane] = decrypt ? input : output;
+                lane_offsets[lane] += BF_CFB64_BLOCK_SIZE;
+                remaining -= BF_CFB64_BLOCK_SIZE;
+            }
+            else
+            {
+                // The final partial block only needs the leading key stream bytes
+                for (size_t data_index = 0; data_index < remaining; ++data_index)
+                {
+                    size_t shift = (BF_CFB64_REMAINDER_BASE - data_index) * BF_CFB64_BYTE_SHIFT;
+                    data[data_index] ^= (unsigned char) (key_stream[lane] >> shift);
+                }
+                remaining = 0;
+            }
+
+            if (remaining > 0)
+            {
+                ++lane;
+            }
+            else
+            {
+                // The record is complete, the lane takes the next non-empty record
+                total_bytes += record->length;
+                while (next_record < record_count && records[next_record].length == 0)
+                {
+                    ++next_record;
+                }
+                if (next_record < record_count)
+                {
+                    // Starts with the next step, since its key stream has not been generated yet
+                    lane_records[lane] = &records[next_record];
+                    lane_offsets[lane] = 0;
+                    feedback[lane] = records[next_record].init_vector;
+                    ++next_record;
+                    ++lane;
+                }
+                else
+                {
+                    // No records left, the last lane moves here and is processed next
+                    --lane_count;
+                    lane_records[lane] = lane_records[lane_count];
+                    lane_offsets[lane] = lane_offsets[lane_count];
+                    feedback[lane] = feedback[lane_count];
+                    key_stream[lane] = key_stream[lane_count];
+                }
+            }
+        }
+    }
+
+    BF_STATS_RECORD(decrypt ? BF_STATS_CFB64_DECRYPT : BF_STATS_CFB64_ENCRYPT,
+                    stats_start, total_bytes, total_blocks);
+}
+
+
+/**
+ * Calculates the total size of a list of buffers
+ *
+ * @param iov   The buffers
+ * @param count Number of buffers
+ * @return      The sum of the buffers' sizes
+ */
+static size_t blowfish_cfb64_total_iov(const struct iovec *iov, size_t count)
+{
+    size_t total = 0;
+    for (size_t index = 0; index < count; ++index)
+    {
+        total += iov[index].iov_len;
+    }
+
+    return total;
+}
+
+
+/**
+ * Runs an out-of-place encryption or decryption function over lists of buffers
+ *
+ * Since the state keeps track of incomplete blocks, each run that is contiguous
+ * in both the input and the output buffers is simply processed in turn.
+ *
+ * @param cfb_state    CFB mode state object
+ * @param process      The encryption or decryption function
+ * @param input_iov    Input buffers
+ * @param input_count  Number of input buffers
+ * @param output_iov   Output buffers
+ * @param output_count Number of output buffers
+ * @return             Number of bytes processed
+ */
+static size_t blowfish_cfb64_process_iov(bf_cfb64_state *cfb_state, bf_cfb64_copy_func process,
+                                         const struct iovec *input_iov, size_t input_count,
+                                         const struct iovec *output_iov, size_t output_count)
+{
+    size_t total_length = blowfish_cfb64_total_iov(input_iov, input_count);
+    size_t output_length = blowfish_cfb64_total_iov(output_iov, output_count);
+    if (output_length < total_length)
+    {
+        total_length = output_length;
+    }
+
+    size_t input_index = 0;
+    size_t input_offset = 0;
+    size_t output_index = 0;
+    size_t output_offset = 0;
+    size_t remaining = total_length;
+    while (remaining > 0)
+    {
+        // Skip exhausted and empty buffers
+        while (input_offset == input_iov[input_index].iov_len)
+        {
+            ++input_index;
+            input_offset = 0;
+        }
+        while (output_offset == output_iov[output_index].iov_len)
+        {
+            ++output_index;
+            output_offset = 0;
+        }
+
+        size_t run_length = input_iov[input_index].iov_len - input_offset;
+        if (output_iov[output_index].iov_len - output_offset < run_length)
+        {
+            run_length = output_iov[output_index].iov_len - output_offset;
+        }
+        if (remaining < run_length)
+        {
+            run_length = remaining;
+        }
+
+        process(cfb_state,
+                &((const unsigned char *) input_iov[input_index].iov_base)[input_offset],
+                &((unsigned char *) output_iov[output_index].iov_base)[output_offset],
+                run_length);
+
+        input_offset += run_length;
+        output_offset += run_length;
+        remaining -= run_length;
+    }
+
+    return total_length;
+}
+
+
+/**
+ * Encrypts data bytewise, up to the end of the current block
+ *
+ * The feedback value contains the key stream for the bytes of the current block
+ * that have not been processed yet, and the cipher text for those that have.
+ * Each processed byte replaces the key stream byte with the cipher text byte.
+ *
+ * @param cfb_state   CFB mode state object, its position is updated
+ * @param feedback    The feedback value of the current block
+ * @param input       Plain text input data to encrypt
+ * @param output      Receives the cipher text
+ * @param data_length Length of the input data
+ * @return            Number of bytes processed
+ */
+static inline size_t blowfish_cfb64_encrypt_bytes(bf_cfb64_state *cfb_state, uint64_t *feedback,
+                                                  const unsigned char *input, unsigned char *output,
+                                                  size_t data_length)
+{
+    size_t position = cfb_state->position;
+    size_t data_index = 0;
+    for (; position < BF_CFB64_BLOCK_SIZE && data_index < data_length; ++position)
+    {
+        size_t shift = (BF_CFB64_REMAINDER_BASE - position) * BF_CFB64_BYTE_SHIFT;
+        uint64_t cipher_byte = (((*feedback) >> shift) ^ input[data_index]) & BF_CFB64_BYTE_MASK;
+        output[data_index] = (unsigned char) cipher_byte;
+        (*feedback) = ((*feedback) & ~(BF_CFB64_BYTE_MASK << shift)) | (cipher_byte << shift);
+        ++data_index;
+    }
+    cfb_state->position = position % BF_CFB64_BLOCK_SIZE;
+
+    return data_index;
+}
+
+
+/**
+ * Decrypts data bytewise, up to the end of the current block
+ *
+ * @param cfb_state   CFB mode state object, its position is updated
+ * @param feedback    The feedback value of the current block
+ * @param input       Cipher text input data to decrypt
+ * @param output      Receives the plain text
+ * @param data_length Length of the input data
+ * @return            Number of bytes processed
+ */
+static inline size_t blowfish_cfb64_decrypt_bytes(bf_cfb64_state *cfb_state, uint64_t *feedback,
+                                                  const unsigned char *input, unsigned char *output,
+                                                  size_t data_length)
+{
+    size_t position = cfb_state->position;
+    size_t data_index = 0;
+    for (; position < BF_CFB64_BLOCK_SIZE && data_index < data_length; ++position)
+    {
+        size_t shift = (BF_CFB64_REMAINDER_BASE - position) * BF_CFB64_BYTE_SHIFT;
+        uint64_t cipher_byte = input[data_index];
+        output[data_index] = (unsigned char) ((((*feedback) >> shift) ^ cipher_byte) & BF_CFB64_BYTE_MASK);
+        (*feedback) = ((*feedback) & ~(BF_CFB64_BYTE_MASK << shift)) | (cipher_byte << shift);
+        ++data_index;
+    }
+    cfb_state->position = position % BF_CFB64_BLOCK_SIZE;
+
+    return data_index;
+}
@@ -3,16 +3,40 @@
 #ifndef BLOWFISH_CFB64_H
 #define	BLOWFISH_CFB64_H
 
+struct iovec;
+
 typedef struct bf_cfb64_state_s bf_cfb64_state;
 struct bf_cfb64_state_s
 {
-    bf_state *cipher_state;
+    const bf_state *cipher_state;
     uint64_t feedback;
+    // Number of bytes of the current block that have already been processed
+    size_t   position;
+};
+
+// An independent message with its own initialization vector
+typedef struct bf_cfb64_record_s bf_cfb64_record;
+struct bf_cfb64_record_s
+{
+    unsigned char *data;
+    size_t        length;
+    uint64_t      init_vector;
+};
+
+typedef struct bf_cfb64_context_s bf_cfb64_context;
+struct bf_cfb64_context_s
+{
+    // First member, so that the context shares the alignment of its storage
+    bf_state       cipher_state;
+    bf_cfb64_state cfb_state;
 };
 
 /**
  * Encrypts the supplied data in-place
  *
+ * Successive calls continue the same stream, so that encrypting data in pieces
+ * of any size yields the same result as encrypting all of it in a single call.
+ *
  * @param cfb_state   CFB mode state object
  * @param data        Plain text input data to encrypt
  * @param data_length Length of the input data
@@ -23,6 +47,9 @@ void blowfish_cfb64_encrypt(bf_cfb64_state *cfb_state,
 /**
  * Decrypts the supplied data in-place
  *
+ * Successive calls continue the same stream, so that decrypting data in pieces
+ * of any size yields the same result as decrypting all of it in a single call.
+ *
  * @param cfb_state   CFB mode state object
  * @param data        Cipher text input data to decrypt
  * @param data_length Length of the input data
@@ -30,6 +57,115 @@ void blowfish_cfb64_encrypt(bf_cfb64_state *cfb_state,
 void blowfish_cfb64_decrypt(bf_cfb64_state *cfb_state,
                             unsigned char *data, size_t data_length);
 
+/**
+ * Encrypts the supplied data into a separate output buffer
+ *
+ * @param cfb_state   CFB mode state object
+ * @param input       Plain text input data to encrypt
+ * @param output      Receives the cipher text; may be the same buffer as input
+ * @param data_length Length of the input data
+ */
+void blowfish_cfb64_encrypt_copy(bf_cfb64_state *cfb_state, const unsigned char *input,
+                                 unsigned char *output, size_t data_length);
+
+/**
+ * Decrypts the supplied data into a separate output buffer
+ *
+ * @param cfb_state   CFB mode state object
+ * @param input       Cipher text input data to decrypt
+ * @param output      Receives the plain text; may be the same buffer as input
+ * @param data_length Length of the input data
+ */
+void blowfish_cfb64_decrypt_copy(bf_cfb64_state *cfb_state, const unsigned char *input,
+                                 unsigned char *output, size_t data_length);
+
+/**
+ * Encrypts data from a list of input buffers into a list of output buffers
+ *
+ * The data is processed as one contiguous stream, so the input and output
+ * buffers may be split differently.
+ *
+ * @param cfb_state    CFB mode state object
+ * @param input_iov    Plain text input buffers
+ * @param input_count  Number of input buffers
+ * @param output_iov   Output buffers receiving the cipher text
+ * @param output_count Number of output buffers
+ * @return             Number of bytes processed; the smaller of the total input and output sizes
+ */
+size_t blowfish_cfb64_encrypt_iov(bf_cfb64_state *cfb_state,
+                                  const struct iovec *input_iov, size_t input_count,
+                                  const struct iovec *output_iov, size_t output_count);
+
+/**
+ * Decrypts data from a list of input buffers into a list of output buffers
+ *
+ * The data is processed as one contiguous stream, so the input and output
+ * buffers may be split differently.
+ *
+ * @param cfb_state    CFB mode state object
+ * @param input_iov    Cipher text input buffers
+ * @param input_count  Number of input buffers
+ * @param output_iov   Output buffers receiving the plain text
+ * @param output_count Number of output buffers
+ * @return             Number of bytes processed; the smaller of the total input and output sizes
+ */
+size_t blowfish_cfb64_decrypt_iov(bf_cfb64_state *cfb_state,
+                                  const struct iovec *input_iov, size_t input_count,
+                                  const struct iovec *output_iov, size_t output_count);
+
+/**
+ * Encrypts many independent messages in-place
+ *
+ * Each record is encrypted as a separate stream, with the same result as
+ * calling blowfish_cfb64_init() with the record's initialization vector
+ * followed by blowfish_cfb64_encrypt(). The streams are advanced in lockstep,
+ * so the block encryptions of different records are issued together and run
+ * on the kernel selected by blowfish_kernel().
+ *
+ * @param state        The cipher state object
+ * @param records      The messages to encrypt
+ * @param record_count Number of messages
+ */
+void blowfish_cfb64_encrypt_records(const bf_state *state, bf_cfb64_record *records, size_t record_count);
+
+/**
+ * Decrypts many independent messages in-place
+ *
+ * @param state        The cipher state object
+ * @param records      The messages to decrypt
+ * @param record_count Number of messages
+ */
+void blowfish_cfb64_decrypt_records(const bf_state *state, bf_cfb64_record *records, size_t record_count);
+
+/**
+ * Decrypts the supplied data in-place, using multiple threads
+ *
+ * The data is split into chunks on block boundaries that are decrypted in
+ * parallel. The result, including the state left in cfb_state, is the same
+ * as that of blowfish_cfb64_decrypt().
+ *
+ * @param cfb_state    CFB mode state object
+ * @param data         Cipher text input data to decrypt
+ * @param data_length  Length of the input data
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_cfb64_decrypt_parallel(bf_cfb64_state *cfb_state,
+                                     unsigned char *data, size_t data_length,
+                                     size_t thread_count);
+
+/**
+ * Decrypts the supplied data into a separate output buffer, using multiple threads
+ *
+ * @param cfb_state    CFB mode state object
+ * @param input        Cipher text input data to decrypt
+ * @param output       Receives the plain text; may be the same buffer as input
+ * @param data_length  Length of the input data
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_cfb64_decrypt_copy_parallel(bf_cfb64_state *cfb_state, const unsigned char *input,
+                                          unsigned char *output, size_t data_length,
+                                          size_t thread_count);
+
 /**
  * Initializes a bf_cfb64_state object
  *
@@ -37,7 +173,7 @@ void blowfish_cfb64_decrypt(bf_cfb64_state *cfb_state,
  * @param state       Cipher state object
  * @param init_vector The initialization vector for the cipher
  */
-void blowfish_cfb64_init(bf_cfb64_state *cfb_state, bf_state *state,
+void blowfish_cfb64_init(bf_cfb64_state *cfb_state, const bf_state *state,
                          uint64_t init_vector);
 
 /**
@@ -69,5 +205,37 @@ bf_cfb64_state *blowfish_cfb64_create(const unsigned char *key, size_t key_lengt
  */
 void blowfish_cfb64_destroy(bf_cfb64_state *cfb_state);
 
+/**
+ * Initializes a bf_cfb64_context object in caller-provided storage
+ *
+ * Does not allocate memory, so that contexts can be embedded in other
+ * objects or taken from a pool.
+ *
+ * @param context     The storage for the context
+ * @param key         The key to initialize the cipher with
+ * @param key_length  The length of the key
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CFB mode state object within the context
+ */
+bf_cfb64_state *blowfish_cfb64_create_in(bf_cfb64_context *context,
+                                         const unsigned char *key, size_t key_length,
+                                         uint64_t init_vector);
+
+/**
+ * Clears a bf_cfb64_context object initialized by blowfish_cfb64_create_in()
+ *
+ * @param context The context to clear
+ */
+void blowfish_cfb64_destroy_in(bf_cfb64_context *context);
+
+/**
+ * Returns the context that contains a CFB mode state object
+ *
+ * @param cfb_state CFB mode state object returned by blowfish_cfb64_alloc(),
+ *                  blowfish_cfb64_create() or blowfish_cfb64_create_in()
+ * @return          The context containing the state object
+ */
+bf_cfb64_context *blowfish_cfb64_context_of(bf_cfb64_state *cfb_state);
+
 
 #endif	/* BLOWFISH_CFB64_H */
@@ -0,0 +1,828 @@
+/**
+ * Seekable chunked container format for encrypted data
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish_container.h>
+#include <blowfish_endian.h>
+#include <blowfish_thread.h>
+#include <string.h>
+#include <unistd.h>
+
+// Size of the container header
+const size_t BF_CONTAINER_HEADER_SIZE = 32;
+
+// Size of an index entry
+const size_t BF_CONTAINER_ENTRY_SIZE = 8;
+
+// Size of the footer following the index
+const size_t BF_CONTAINER_FOOTER_SIZE = 16;
+
+// Highest generation of a chunk, limited by the bits of the IV derivation left after the chunk number
+const uint32_t BF_CONTAINER_MAX_GENERATION = 0xFFFFFF;
+
+// Number of bits of the chunk number in the IV derivation
+const unsigned int BF_CONTAINER_CHUNK_BITS = 40;
+
+// Largest chunk size, so that a chunk's length fits into an index entry
+const size_t BF_CONTAINER_MAX_CHUNK_SIZE = 0x80000000UL;
+
+static const unsigned char BF_CONTAINER_MAGIC[8] = { 'B', 'F', 'C', 'N', 'T', 'R', '0', '1' };
+
+static const unsigned char BF_CONTAINER_INDEX_MAGIC[8] = { 'B', 'F', 'C', 'I', 'D', 'X', '0', '1' };
+
+struct bf_container_s
+{
+    int            fd;
+    const bf_state *cipher_state;
+    uint64_t       base_iv;
+    // The encrypted base initialization vector, which is combined with each chunk's number
+    uint64_t       iv_mask;
+    size_t         chunk_size;
+    size_t         thread_count;
+    uint64_t       data_length;
+    uint64_t       chunk_count;
+    // Generation of each chunk
+    uint32_t       *generations;
+    uint64_t       generation_capacity;
+    // Plain text collected for the next batch of chunks while writing
+    unsigned char  *batch;
+    size_t         batch_length;
+    int            finished;
+};
+
+// Chunks of a batch that are encrypted and written by blowfish_container_write_task()
+typedef struct bf_container_write_s bf_container_write;
+struct bf_container_write_s
+{
+    bf_container  *container;
+    unsigned char *data;
+    size_t        data_length;
+    uint64_t      first_chunk;
+    size_t        chunk_count;
+    size_t        task_count;
+    int           failed;
+};
+
+// A range that is read and decrypted by blowfish_container_read_task()
+typedef struct bf_container_read_s bf_container_read;
+struct bf_container_read_s
+{
+    bf_container  *container;
+    unsigned char *buffer;
+    size_t        length;
+    uint64_t      offset;
+    uint64_t      first_chunk;
+    uint64_t      chunk_count;
+    size_t        task_count;
+    int           failed;
+};
+
+static int blowfish_container_flush(bf_container *container);
+static void blowfish_container_write_task(void *context, size_t task_index);
+static void blowfish_container_read_task(void *context, size_t task_index);
+static int blowfish_container_read_segment(bf_container *container, uint64_t chunk_index,
+                                           unsigned char *buffer, size_t start, size_t end);
+static int blowfish_container_write_header(bf_container *container);
+static int blowfish_container_grow(bf_container *container, uint64_t chunk_count);
+static uint64_t blowfish_container_chunk_iv(const bf_container *container, uint64_t chunk_index,
+                                            uint64_t generation);
+static size_t blowfish_container_chunk_length(const bf_container *container, uint64_t chunk_index);
+static off_t blowfish_container_chunk_offset(const bf_container *container, uint64_t chunk_index);
+static int blowfish_container_read_full(int fd, unsigned char *buffer, size_t length, off_t offset);
+static int blowfish_container_write_full(int fd, const unsigned char *buffer, size_t length, off_t offset);
+static bf_container *blowfish_container_alloc(int fd, const bf_state *state, size_t thread_count);
+
+
+/**
+ * Starts writing a new container
+ *
+ * @param fd           File descriptor open for reading and writing
+ * @param state        Cipher state object
+ * @param base_iv      Base initialization vector
+ * @param chunk_size   Size of each chunk; 0 selects BF_CONTAINER_DEFAULT_CHUNK_SIZE
+ * @param thread_count Maximum number of threads used to encrypt and decrypt chunks
+ * @return             The container, or NULL on failure
+ */
+bf_container *blowfish_container_create(int fd, const bf_state *state, uint64_t base_iv,
+                                        size_t chunk_size, size_t thread_count)
+{
+    if (chunk_size == 0)
+    {
+        chunk_size = BF_CONTAINER_DEFAULT_CHUNK_SIZE;
+    }
+    if (chunk_size % 8 != 0 || chunk_size > BF_CONTAINER_MAX_CHUNK_SIZE)
+    {
+        return NULL;
+    }
+
+    bf_container *container = blowfish_container_alloc(fd, state, thread_count);
+    if (container == NULL)
+    {
+        return NULL;
+    }
+    container->base_iv    = base_iv;
+    container->iv_mask    = blowfish_encrypt64(state, base_iv);
+    container->chunk_size = chunk_size;
+
+    container->batch = malloc(chunk_size * container->thread_count);
+    if (container->batch == NULL || blowfish_container_write_header(container) != 0)
+    {
+        blowfish_container_close(container);
+        return NULL;
+    }
+
+    return container;
+}
+
+
+/**
+ * Opens an existing container for reading and rewriting chunks
+ *
+ * @param fd           File descriptor of the container
+ * @param state        Cipher state object
+ * @param thread_count Maximum number of threads used to decrypt chunks
+ * @return             The container, or NULL on failure
+ */
+bf_container *blowfish_container_open(int fd, const bf_state *state, size_t thread_count)
+{
+    bf_container *container = blowfish_container_alloc(fd, state, thread_count);
+    if (container == NULL)
+    {
+        return NULL;
+    }
+    container->finished = 1;
+
+    int rc = -1;
+    unsigned char header[32];
+    if (blowfish_container_read_full(fd, header, BF_CONTAINER_HEADER_SIZE, 0) == 0 &&
+        memcmp(header, BF_CONTAINER_MAGIC, sizeof (BF_CONTAINER_MAGIC)) == 0)
+    {
+        container->chunk_size  = (size_t) (blowfish_load_be64(&header[8]) >> 32);
+        container->base_iv     = blowfish_load_be64(&header[16]);
+        container->iv_mask     = blowfish_encrypt64(state, container->base_iv);
+        container->data_length = blowfish_load_be64(&header[24]);
+        if (container->chunk_size > 0 && container->chunk_size % 8 == 0 &&
+            container->chunk_size <= BF_CONTAINER_MAX_CHUNK_SIZE)
+        {
+            container->chunk_count = container->data_length / container->chunk_size +
+                                     (container->data_length % container->chunk_size != 0);
+            rc = 0;
+        }
+    }
+
+    // The index follows the last chunk
+    unsigned char footer[16];
+    off_t index_offset = blowfish_container_chunk_offset(container, 0) + (off_t) container->data_length;
+    if (rc == 0)
+    {
+        off_t footer_offset = index_offset + (off_t) (container->chunk_count * BF_CONTAINER_ENTRY_SIZE);
+        rc = blowfish_container_read_full(fd, footer, BF_CONTAINER_FOOTER_SIZE, footer_offset);
+    }
+    if (rc == 0 &&
+        (blowfish_load_be64(footer) != container->chunk_count ||
+         memcmp(&footer[8], BF_CONTAINER_INDEX_MAGIC, sizeof (BF_CONTAINER_INDEX_MAGIC)) != 0))
+    {
+        rc = -1;
+    }
+
+    unsigned char *index = NULL;
+    if (rc == 0)
+    {
+        rc = blowfish_container_grow(container, container->chunk_count);
+    }
+    if (rc == 0 && container->chunk_count > 0)
+    {
+        size_t index_size = (size_t) container->chunk_count * BF_CONTAINER_ENTRY_SIZE;
+        index = malloc(index_size);
+        rc = -1;
+        if (index != NULL && blowfish_container_read_full(fd, index, index_size, index_offset) == 0)
+        {
+            rc = 0;
+        }
+    }
+    for (uint64_t chunk_index = 0; rc == 0 && chunk_index < container->chunk_count; ++chunk_index)
+    {
+        uint64_t entry = blowfish_load_be64(&index[chunk_index * BF_CONTAINER_ENTRY_SIZE]);
+        container->generations[chunk_index] = (uint32_t) (entry >> 32);
+        if ((entry & 0xFFFFFFFFUL) != blowfish_container_chunk_length(container, chunk_index) ||
+            container->generations[chunk_index] > BF_CONTAINER_MAX_GENERATION)
+        {
+            rc = -1;
+        }
+    }
+    free(index);
+
+    if (rc != 0)
+    {
+        blowfish_container_close(container);
+        container = NULL;
+    }
+
+    return container;
+}
+
+
+/**
+ * Frees a container object, without closing its file descriptor
+ *
+ * @param container The container
+ */
+void blowfish_container_close(bf_container *container)
+{
+    if (container != NULL)
+    {
+        if (container->batch != NULL)
+        {
+            // Do not leave plain text behind in freed memory
+            volatile unsigned char *batch = container->batch;
+            for (size_t index = 0; index < container->chunk_size * container->thread_count; ++index)
+            {
+                batch[index] = 0;
+            }
+        }
+        free(container->batch);
+        free(container->generations);
+        free(container);
+    }
+}
+
+
+/**
+ * Appends data to a container that is being written
+ *
+ * @param container   The container
+ * @param data        Plain text data to append
+ * @param data_length Length of the data
+ * @return            0 on success, -1 on failure
+ */
+int blowfish_container_append(bf_container *container, const unsigned char *data, size_t data_length)
+{
+    if (container->finished)
+    {
+        return -1;
+    }
+
+    size_t batch_size = container->chunk_size * container->thread_count;
+    size_t data_offset = 0;
+    while (data_offset < data_length)
+    {
+        size_t copy_length = batch_size - container->batch_length;
+        if (copy_length > data_length - data_offset)
+        {
+            copy_length = data_length - data_offset;
+        }
+        memcpy(&container->batch[container->batch_length], &data[data_offset], copy_length);
+        container->batch_length += copy_length;
+        data_offset += copy_length;
+
+        if (container->batch_length == batch_size && blowfish_container_flush(container) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * Writes the remaining data, the index and the final header, completing a container
+ *
+ * @param container The container
+ * @return          0 on success, -1 on failure
+ */
+int blowfish_container_finish(bf_container *container)
+{
+    if (container->finished || blowfish_container_flush(container) != 0)
+    {
+        return -1;
+    }
+
+    size_t index_size = (size_t) container->chunk_count * BF_CONTAINER_ENTRY_SIZE + BF_CONTAINER_FOOTER_SIZE;
+    unsigned char *index = malloc(index_size);
+    if (index == NULL)
+    {
+        return -1;
+    }
+    for (uint64_t chunk_index = 0; chunk_index < container->chunk_count; ++chunk_index)
+    {
+        uint64_t entry = ((uint64_t) container->generations[chunk_index] << 32) |
+                         blowfish_container_chunk_length(container, chunk_index);
+        blowfish_store_be64(&index[chunk_index * BF_CONTAINER_ENTRY_SIZE], entry);
+    }
+    unsigned char *footer = &index[index_size - BF_CONTAINER_FOOTER_SIZE];
+    blowfish_store_be64(footer, container->chunk_count);
+    memcpy(&footer[8], BF_CONTAINER_INDEX_MAGIC, sizeof (BF_CONTAINER_INDEX_MAGIC));
+
+    off_t index_offset = blowfish_container_chunk_offset(container, 0) + (off_t) container->data_length;
+    int rc = blowfish_container_write_full(container->fd, index, index_size, index_offset);
+    free(index);
+
+    // The header is written last, so that an interrupted container is never read as complete
+    if (rc == 0)
+    {
+        container->finished = 1;
+        rc = blowfish_container_write_header(container);
+    }
+    // Removes whatever followed in a reused file
+    if (rc == 0 && ftruncate(container->fd, index_offset + (off_t) index_size) != 0)
+    {
+        rc = -1;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Reads and decrypts a range of a completed container
+ *
+ * @param container The container
+ * @param buffer    Receives the plain text
+ * @param length    Number of bytes to read
+ * @param offset    Offset of the first byte within the data
+ * @return          Number of bytes read, or -1 on failure
+ */
+ssize_t blowfish_container_pread(bf_container *container, unsigned char *buffer, size_t length,
+                                 uint64_t offset)
+{
+    if (!container->finished)
+    {
+        return -1;
+    }
+    if (offset >= container->data_length)
+    {
+        return 0;
+    }
+    if (length > container->data_length - offset)
+    {
+        length = (size_t) (container->data_length - offset);
+    }
+    if (length == 0)
+    {
+        return 0;
+    }
+
+    bf_container_read read_range;
+    read_range.container   = container;
+    read_range.buffer      = buffer;
+    read_range.length      = length;
+    read_range.offset      = offset;
+    read_range.first_chunk = offset / container->chunk_size;
+    read_range.chunk_count = (offset + length - 1) / container->chunk_size - read_range.first_chunk + 1;
+    read_range.task_count  = container->thread_count;
+    if (read_range.task_count > read_range.chunk_count)
+    {
+        read_range.task_count = (size_t) read_range.chunk_count;
+    }
+    read_range.failed = 0;
+
+    blowfish_thread_run(blowfish_container_read_task, &read_range, read_range.task_count);
+
+    return read_range.failed ? -1 : (ssize_t) length;
+}
+
+
+/**
+ * Replaces the content of one chunk of a completed container
+ *
+ * @param container   The container
+ * @param chunk_index Number of the chunk
+ * @param data        The new plain text of the chunk
+ * @param data_length Length of the new plain text
+ * @return            0 on success, -1 on failure
+ */
+int blowfish_container_rewrite_chunk(bf_container *container, uint64_t chunk_index,
+                                     const unsigned char *data, size_t data_length)
+{
+    if (!container->finished || chunk_index >= container->chunk_count ||
+        data_length != blowfish_container_chunk_length(container, chunk_index) ||
+        container->generations[chunk_index] >= BF_CONTAINER_MAX_GENERATION)
+    {
+        return -1;
+    }
+
+    unsigned char *cipher_text = malloc(data_length);
+    if (cipher_text == NULL)
+    {
+        return -1;
+    }
+
+    // The new generation takes effect only once both the chunk and its index entry are written
+    uint32_t generation = container->generations[chunk_index] + 1;
+    bf_cfb64_state cfb_state;
+    blowfish_cfb64_init(&cfb_state, container->cipher_state,
+                        blowfish_container_chunk_iv(container, chunk_index, generation));
+    memcpy(cipher_text, data, data_length);
+    blowfish_cfb64_encrypt(&cfb_state, cipher_text, data_length);
+
+    int rc = blowfish_container_write_full(container->fd, cipher_text, data_length,
+                                           blowfish_container_chunk_offset(container, chunk_index));
+    free(cipher_text);
+
+    if (rc == 0)
+    {
+        unsigned char entry[8];
+        blowfish_store_be64(entry, ((uint64_t) generation << 32) | data_length);
+        off_t entry_offset = blowfish_container_chunk_offset(container, 0) + (off_t) container->data_length +
+                             (off_t) (chunk_index * BF_CONTAINER_ENTRY_SIZE);
+        rc = blowfish_container_write_full(container->fd, entry, BF_CONTAINER_ENTRY_SIZE, entry_offset);
+    }
+    if (rc == 0)
+    {
+        container->generations[chunk_index] = generation;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Returns the length of the data in a container
+ *
+ * @param container The container
+ * @return          Number of plain text bytes appended so far
+ */
+uint64_t blowfish_container_length(const bf_container *container)
+{
+    return container->data_length + container->batch_length;
+}
+
+
+/**
+ * Returns the chunk size of a container
+ *
+ * @param container The container
+ * @return          The chunk size in bytes
+ */
+size_t blowfish_container_chunk_size(const bf_container *container)
+{
+    return container->chunk_size;
+}
+
+
+/**
+ * Encrypts and writes the collected batch of chunks
+ *
+ * @param container The container
+ * @return          0 on success, -1 on failure
+ */
+static int blowfish_container_flush(bf_container *container)
+{
+    if (container->batch_length == 0)
+    {
+        return 0;
+    }
+
+    bf_container_write batch;
+    batch.container   = container;
+    batch.data        = container->batch;
+    batch.data_length = container->batch_length;
+    batch.first_chunk = container->chunk_count;
+    batch.chunk_count = (container->batch_length + container->chunk_size - 1) / container->chunk_size;
+    batch.task_count  = batch.chunk_count;
+    batch.failed      = 0;
+
+    if (container->chunk_count + batch.chunk_count > (UINT64_C(1) << BF_CONTAINER_CHUNK_BITS) ||
+        blowfish_container_grow(container, container->chunk_count + batch.chunk_count) != 0)
+    {
+        return -1;
+    }
+    for (size_t chunk_index = 0; chunk_index < batch.chunk_count; ++chunk_index)
+    {
+        container->generations[batch.first_chunk + chunk_index] = 0;
+    }
+
+    // The chunk lengths depend on the data length, which includes the new chunks from here on
+    container->chunk_count += batch.chunk_count;
+    container->data_length += batch.data_length;
+    container->batch_length = 0;
+
+    blowfish_thread_run(blowfish_container_write_task, &batch, batch.task_count);
+
+    return batch.failed ? -1 : 0;
+}
+
+
+/**
+ * Encrypts and writes the chunks of a batch assigned to a task
+ *
+ * @param context     The bf_container_write object
+ * @param task_index  Index of the task; every task_count-th chunk starting here is processed
+ */
+static void blowfish_container_write_task(void *context, size_t task_index)
+{
+    bf_container_write *batch = context;
+    bf_container *container = batch->container;
+
+    for (size_t chunk_index = task_index; chunk_index < batch->chunk_count; chunk_index += batch->task_count)
+    {
+        uint64_t chunk_number = batch->first_chunk + chunk_index;
+        unsigned char *chunk_data = &batch->data[chunk_index * container->chunk_size];
+        size_t chunk_length = blowfish_container_chunk_length(container, chunk_number);
+
+        bf_cfb64_state cfb_state;
+        blowfish_cfb64_init(&cfb_state, container->cipher_state,
+                            blowfish_container_chunk_iv(container, chunk_number,
+                                                        container->generations[chunk_number]));
+        blowfish_cfb64_encrypt(&cfb_state, chunk_data, chunk_length);
+        if (blowfish_container_write_full(container->fd, chunk_data, chunk_length,
+                                          blowfish_container_chunk_offset(container, chunk_number)) != 0)
+        {
+            __atomic_store_n(&batch->failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+
+/**
+ * Reads and decrypts the parts of a range that lie in the chunks assigned to a task
+ *
+ * @param context    The bf_container_read object
+ * @param task_index Index of the task; every task_count-th chunk starting here is processed
+ */
+static void blowfish_container_read_task(void *context, size_t task_index)
+{
+    bf_container_read *read_range = context;
+    bf_container *container = read_range->container;
+    uint64_t range_end = read_range->offset + read_range->length;
+
+    for (uint64_t index = task_index; index < read_range->chunk_count; index += read_range->task_count)
+    {
+        uint64_t chunk_index = read_range->first_chunk + index;
+        uint64_t chunk_start = chunk_index * container->chunk_size;
+        uint64_t chunk_end = chunk_start + container->chunk_size;
+        uint64_t start = read_range->offset > chunk_start ? read_range->offset : chunk_start;
+        uint64_t end = range_end < chunk_end ? range_end : chunk_end;
+
+        if (blowfish_container_read_segment(container, chunk_index,
+                                            &read_range->buffer[start - read_range->offset],
+                                            (size_t) (start - chunk_start), (size_t) (end - chunk_start)) != 0)
+        {
+            __atomic_store_n(&read_range->failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+
+/**
+ * Reads and decrypts a part of a chunk
+ *
+ * Decryption in CFB mode starts at the block containing the first byte, with
+ * the preceding cipher text block as the feedback, or with the chunk's
+ * initialization vector for the first block.
+ *
+ * @param container   The container
+ * @param chunk_index Number of the chunk
+ * @param buffer      Receives the plain text
+ * @param start       Offset of the first byte within the chunk
+ * @param end         Offset following the last byte within the chunk
+ * @return            0 on success, -1 on a read error
+ */
+static int blowfish_container_read_segment(bf_container *container, uint64_t chunk_index,
+                                           unsigned char *buffer, size_t start, size_t end)
+{
+    off_t chunk_offset = blowfish_container_chunk_offset(container, chunk_index);
+    size_t block_start = start - start % 8;
+
+    // Preceding cipher text block, if any, followed by the bytes of the first block before start
+    unsigned char lead[16];
+    size_t lead_offset = block_start > 0 ? block_start - 8 : block_start;
+    size_t lead_length = start - lead_offset;
+    if (lead_length > 0 &&
+        blowfish_container_read_full(container->fd, lead, lead_length, chunk_offset + (off_t) lead_offset) != 0)
+    {
+        return -1;
+    }
+    if (blowfish_container_read_full(container->fd, buffer, end - start, chunk_offset + (off_t) start) != 0)
+    {
+        return -1;
+    }
+
+    bf_cfb64_state cfb_state;
+    unsigned char *partial = lead;
+    if (block_start > 0)
+    {
+        blowfish_cfb64_init(&cfb_state, container->cipher_state, blowfish_load_be64(lead));
+        partial = &lead[8];
+    }
+    else
+    {
+        blowfish_cfb64_init(&cfb_state, container->cipher_state,
+                            blowfish_container_chunk_iv(container, chunk_index,
+                                                        container->generations[chunk_index]));
+    }
+    // Advances the state through the bytes of the first block before start
+    blowfish_cfb64_decrypt(&cfb_state, partial, start - block_start);
+    blowfish_cfb64_decrypt(&cfb_state, buffer, end - start);
+
+    return 0;
+}
+
+
+/**
+ * Writes the container header
+ *
+ * The data length is written as 0 until the container is finished.
+ *
+ * @param container The container
+ * @return          0 on success, -1 on a write error
+ */
+static int blowfish_container_write_header(bf_container *container)
+{
+    unsigned char header[32];
+    memcpy(header, BF_CONTAINER_MAGIC, sizeof (BF_CONTAINER_MAGIC));
+    blowfish_store_be64(&header[8], (uint64_t) container->chunk_size << 32);
+    blowfish_store_be64(&header[16], container->base_iv);
+    blowfish_store_be64(&header[24], container->finished ? container->data_length : 0);
+
+    return blowfish_container_write_full(container->fd, header, BF_CONTAINER_HEADER_SIZE, 0);
+}
+
+
+/**
+ * Makes room for the generations of a number of chunks
+ *
+ * @param container   The container
+ * @param chunk_count Number of chunks
+ * @return            0 on success, -1 if out of memory
+ */
+static int blowfish_container_grow(bf_container *container, uint64_t chunk_count)
+{
+    if (chunk_count > container->generation_capacity)
+    {
+        uint64_t capacity = container->generation_capacity > 0 ? container->generation_capacity : 16;
+        while (capacity < chunk_count)
+        {
+            capacity *= 2;
+        }
+        if (capacity > SIZE_MAX / sizeof (uint32_t))
+        {
+            return -1;
+        }
+        uint32_t *generations = realloc(container->generations, (size_t) capacity * sizeof (uint32_t));
+        if (generations == NULL)
+        {
+            return -1;
+        }
+        container->generations = generations;
+        container->generation_capacity = capacity;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Derives the initialization vector of a chunk from the base initialization vector
+ *
+ * Blowfish is a permutation, so distinct pairs of chunk number and generation
+ * yield distinct initialization vectors within a container. The chunk number
+ * and generation are combined with the encrypted base initialization vector
+ * rather than the base initialization vector itself, so that containers with
+ * nearby base initialization vectors, e.g. sequential ones, do not share the
+ * initialization vectors of their chunks.
+ *
+ * @param container   The container
+ * @param chunk_index Number of the chunk
+ * @param generation  Generation of the chunk
+ * @return            The chunk's initialization vector for the generation
+ */
+static uint64_t blowfish_container_chunk_iv(const bf_container *container, uint64_t chunk_index,
+                                            uint64_t generation)
+{
+    return blowfish_encrypt64(container->cipher_state,
+                              container->iv_mask ^ ((generation << BF_CONTAINER_CHUNK_BITS) | chunk_index));
+}
+
+
+/**
+ * Returns the length of a chunk
+ *
+ * @param container   The container
+ * @param chunk_index Number of the chunk
+ * @return            The chunk size, or less for the last chunk
+ */
+static size_t blowfish_container_chunk_length(const bf_container *container, uint64_t chunk_index)
+{
+    uint64_t remaining = container->data_length - chunk_index * container->chunk_size;
+    return remaining < container->chunk_size ? (size_t) remaining : container->chunk_size;
+}
+
+
+/**
+ * Returns the file offset of a chunk
+ *
+ * @param container   The container
+ * @param chunk_index Number of the chunk
+ * @return            The offset of the chunk's first byte
+ */
+static off_t blowfish_container_chunk_offset(const bf_container *container, uint64_t chunk_index)
+{
+    return (off_t) (BF_CONTAINER_HEADER_SIZE + chunk_index * container->chunk_size);
+}
+
+
+/**
+ * Reads an exact number of bytes at an offset
+ *
+ * @param fd     The file descriptor
+ * @param buffer Receives the data
+ * @param length Number of bytes to read
+ * @param offset Offset of the first byte
+ * @return       0 on success, -1 on a read error or at the end of the file
+ */
+static int blowfish_container_read_full(int fd, unsigned char *buffer, size_t length, off_t offset)
+{
+    size_t total = 0;
+    while (total < length)
+    {
+        ssize_t count = pread(fd, &buffer[total], length - total, offset + (off_t) total);
+        if (count <= 0)
+        {
+            return -1;
+        }
+        total += (size_t) count;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Writes an exact number of bytes at an offset
+ *
+ * @param fd     The file descriptor
+ * @param buffer The data
+ * @param length Number of bytes to write
+ * @param offset Offset of the first byte
+ * @return       0 on success, -1 on a write error
+ */
+static int blowfish_container_write_full(int fd, const unsigned char *buffer, size_t length, off_t offset)
+{
+    size_t total = 0;
+    while (total < length)
+    {
+        ssize_t count = pwrite(fd, &buffer[total], length - total, offset + (off_t) total);
+        if (count <= 0)
+        {
+            return -1;
+        }
+        total += (size_t) count;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Allocates and initializes the common part of a container object
+ *
+ * @param fd           The file descriptor
+ * @param state        Cipher state object
+ * @param thread_count Maximum number of threads; 0 is treated as 1
+ * @return             The container, or NULL if out of memory
+ */
+static bf_container *blowfish_container_alloc(int fd, const bf_state *state, size_t thread_count)
+{
+    bf_container *container = malloc(sizeof (bf_container));
+    if (container != NULL)
+    {
+        memset(container, 0, sizeof (bf_container));
+        container->fd           = fd;
+        container->cipher_state = state;
+        container->thread_count = thread_count > 0 ? thread_count : 1;
+    }
+
+    return container;
+}
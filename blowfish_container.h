@@ -0,0 +1,153 @@
+#ifndef BLOWFISH_CONTAINER_H
+#define	BLOWFISH_CONTAINER_H
+
+#include <blowfish_cfb64.h>
+#include <sys/types.h>
+
+/*
+ * Container file layout; all integers are big-endian
+ *
+ *   Header, 32 bytes:
+ *     magic "BFCNTR01", chunk size (32 bit), reserved (32 bit, zero),
+ *     base initialization vector (64 bit), data length (64 bit)
+ *   Chunks:
+ *     chunk n holds the bytes n * chunk size to (n + 1) * chunk size - 1 of the
+ *     data, encrypted in CFB mode as a separate stream; the last chunk may be shorter
+ *   Index, 8 bytes per chunk:
+ *     generation of the chunk (32 bit), length of the chunk (32 bit)
+ *   Footer, 16 bytes:
+ *     number of chunks (64 bit), magic "BFCIDX01"
+ *
+ * The initialization vector of a chunk is the encrypted base initialization
+ * vector combined with the chunk number and generation, encrypted again:
+ *
+ *   encrypt64(encrypt64(base IV) ^ ((generation << 40) | chunk number))
+ *
+ * Encrypting the base initialization vector first makes the chunk
+ * initialization vectors of different containers unrelated, so sequential
+ * base initialization vectors may be used.
+ *
+ * Each rewrite of a chunk increments its generation, so that no two versions
+ * of a chunk are encrypted with the same initialization vector. The container
+ * provides confidentiality only, not integrity.
+ */
+
+// Default chunk size for blowfish_container_create()
+#define BF_CONTAINER_DEFAULT_CHUNK_SIZE 65536
+
+typedef struct bf_container_s bf_container;
+
+/**
+ * Starts writing a new container
+ *
+ * The data is added by blowfish_container_append(), and the container is
+ * completed by blowfish_container_finish(). Until then, it cannot be read.
+ *
+ * @param fd           File descriptor open for reading and writing; the container
+ *                     starts at offset 0, and the descriptor is not closed by the container
+ * @param state        Cipher state object; must remain valid until the container is closed
+ * @param base_iv      Base initialization vector; must be unique for each container with
+ *                     the same key, e.g. a counter or a random value
+ * @param chunk_size   Size of each chunk, a multiple of 8 bytes up to 2^31;
+ *                     0 selects BF_CONTAINER_DEFAULT_CHUNK_SIZE
+ * @param thread_count Maximum number of threads used to encrypt and decrypt chunks,
+ *                     including the calling thread
+ * @return             The container, or NULL if the chunk size is invalid, out of
+ *                     memory, or the header cannot be written
+ */
+bf_container *blowfish_container_create(int fd, const bf_state *state, uint64_t base_iv,
+                                        size_t chunk_size, size_t thread_count);
+
+/**
+ * Opens an existing container for reading and rewriting chunks
+ *
+ * @param fd           File descriptor of the container, open for reading, and also for
+ *                     writing if chunks are rewritten
+ * @param state        Cipher state object; must remain valid until the container is closed
+ * @param thread_count Maximum number of threads used to decrypt chunks, including the calling thread
+ * @return             The container, or NULL if the file is not a complete container or out of memory
+ */
+bf_container *blowfish_container_open(int fd, const bf_state *state, size_t thread_count);
+
+/**
+ * Frees a container object, without closing its file descriptor
+ *
+ * A container that is being written and has not been finished remains incomplete.
+ *
+ * @param container The container
+ */
+void blowfish_container_close(bf_container *container);
+
+/**
+ * Appends data to a container that is being written
+ *
+ * Data is collected until a batch of one chunk per thread is complete; the
+ * chunks of a batch are encrypted and written in parallel.
+ *
+ * @param container   The container
+ * @param data        Plain text data to append
+ * @param data_length Length of the data
+ * @return            0 on success, -1 if the container is finished or on a write error
+ */
+int blowfish_container_append(bf_container *container, const unsigned char *data, size_t data_length);
+
+/**
+ * Writes the remaining data, the index and the final header, completing a container
+ *
+ * @param container The container
+ * @return          0 on success, -1 if the container is already finished or on a write error
+ */
+int blowfish_container_finish(bf_container *container);
+
+/**
+ * Reads and decrypts a range of a completed container
+ *
+ * Only the chunks that overlap the range are read, and within the first
+ * chunk, reading starts at most 8 bytes before the range. Multiple chunks
+ * are decrypted in parallel. May be called concurrently from multiple threads,
+ * but not concurrently with blowfish_container_rewrite_chunk().
+ *
+ * @param container The container
+ * @param buffer    Receives the plain text
+ * @param length    Number of bytes to read
+ * @param offset    Offset of the first byte within the data
+ * @return          Number of bytes read, less than length only at the end of the data,
+ *                  or -1 if the container is not finished or on a read error
+ */
+ssize_t blowfish_container_pread(bf_container *container, unsigned char *buffer, size_t length,
+                                 uint64_t offset);
+
+/**
+ * Replaces the content of one chunk of a completed container
+ *
+ * Only the chunk and its index entry are written. The chunk gets a new
+ * generation and therefore a new initialization vector. The two writes are not
+ * atomic: if they are interrupted, the chunk cannot be decrypted.
+ *
+ * @param container   The container
+ * @param chunk_index Number of the chunk
+ * @param data        The new plain text of the chunk
+ * @param data_length Length of the new plain text; must equal the length of the chunk
+ * @return            0 on success, -1 if the chunk does not exist, the length differs,
+ *                    the chunk's generations are exhausted, or on a write error
+ */
+int blowfish_container_rewrite_chunk(bf_container *container, uint64_t chunk_index,
+                                     const unsigned char *data, size_t data_length);
+
+/**
+ * Returns the length of the data in a container
+ *
+ * @param container The container
+ * @return          Number of plain text bytes appended so far
+ */
+uint64_t blowfish_container_length(const bf_container *container);
+
+/**
+ * Returns the chunk size of a container
+ *
+ * @param container The container
+ * @return          The chunk size in bytes
+ */
+size_t blowfish_container_chunk_size(const bf_container *container);
+
+#endif	/* BLOWFISH_CONTAINER_H */
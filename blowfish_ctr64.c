@@ -0,0 +1,303 @@
+/**
+ * Blowfish CTR mode functions
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <blowfish_ctr64.h>
+#include <blowfish_endian.h>
+#include <blowfish_stats.h>
+#include <stddef.h>
+
+// Block size in bytes (8 == 64 bits)
+const size_t BF_CTR64_BLOCK_SIZE = 8;
+
+// Maximum shift width for a byte within a block in bits (56 == 7 bytes)
+const size_t BF_CTR64_BYTE_SHIFT_BASE = 56;
+
+// Byte shift value (8 bits == 1 byte)
+const size_t BF_CTR64_BYTE_SHIFT = 8;
+
+// Number of key stream blocks generated per call of the block-parallel kernel
+#define BF_CTR64_BATCH_BLOCKS 64
+
+
+/**
+ * Encrypts the supplied data in-place
+ *
+ * @param ctr_state   CTR mode state object
+ * @param data        Plain text input data to encrypt
+ * @param data_length Length of the input data
+ * @param offset      Position of the first byte of data within the stream
+ */
+void blowfish_ctr64_encrypt(bf_ctr64_state *ctr_state,
+                            unsigned char *data, size_t data_length, uint64_t offset)
+{
+    blowfish_ctr64_encrypt_copy(ctr_state, data, data, data_length, offset);
+}
+
+
+/**
+ * Decrypts the supplied data in-place
+ *
+ * @param ctr_state   CTR mode state object
+ * @param data        Cipher text input data to decrypt
+ * @param data_length Length of the input data
+ * @param offset      Position of the first byte of data within the stream
+ */
+void blowfish_ctr64_decrypt(bf_ctr64_state *ctr_state,
+                            unsigned char *data, size_t data_length, uint64_t offset)
+{
+    // Encryption and decryption are the same operation in CTR mode
+    blowfish_ctr64_encrypt_copy(ctr_state, data, data, data_length, offset);
+}
+
+
+/**
+ * Encrypts the supplied data into a separate output buffer
+ *
+ * @param ctr_state   CTR mode state object
+ * @param input       Plain text input data to encrypt
+ * @param output      Receives the cipher text; may be the same buffer as input
+ * @param data_length Length of the input data
+ * @param offset      Position of the first byte of data within the stream
+ */
+void blowfish_ctr64_encrypt_copy(bf_ctr64_state *ctr_state, const unsigned char *input,
+                                 unsigned char *output, size_t data_length, uint64_t offset)
+{
+    BF_STATS_START(stats_start);
+    uint64_t block_index = offset / BF_CTR64_BLOCK_SIZE;
+    size_t data_index = 0;
+
+    // Leading partial block, if the offset is not on a block boundary
+    size_t block_offset = (size_t) (offset % BF_CTR64_BLOCK_SIZE);
+    if (block_offset > 0 && data_length > 0)
+    {
+        uint64_t key_stream = blowfish_encrypt64(ctr_state->cipher_state,
+                                                 ctr_state->init_vector + block_index);
+        for (; block_offset < BF_CTR64_BLOCK_SIZE && data_index < data_length; ++block_offset)
+        {
+            size_t shift = BF_CTR64_BYTE_SHIFT_BASE - block_offset * BF_CTR64_BYTE_SHIFT;
+            output[data_index] = input[data_index] ^ (unsigned char) (key_stream >> shift);
+            ++data_index;
+        }
+        ++block_index;
+    }
+
+    // Full blocks, generating the key stream for a batch of blocks at a time
+    size_t full_blocks = (data_length - data_index) / BF_CTR64_BLOCK_SIZE;
+    while (full_blocks > 0)
+    {
+        size_t batch_blocks = full_blocks < BF_CTR64_BATCH_BLOCKS ? full_blocks : BF_CTR64_BATCH_BLOCKS;
+
+        uint64_t key_stream[BF_CTR64_BATCH_BLOCKS];
+        for (size_t batch_index = 0; batch_index < batch_blocks; ++batch_index)
+        {
+            key_stream[batch_index] = ctr_state->init_vector + block_index + batch_index;
+        }
+        blowfish_encrypt64_blocks(ctr_state->cipher_state, key_stream, key_stream, batch_blocks);
+
+        for (size_t batch_index = 0; batch_index < batch_blocks; ++batch_index)
+        {
+            blowfish_store_be64(&output[data_index],
+                                blowfish_load_be64(&input[data_index]) ^ key_stream[batch_index]);
+            data_index += BF_CTR64_BLOCK_SIZE;
+        }
+
+        block_index += batch_blocks;
+        full_blocks -= batch_blocks;
+    }
+
+    // Trailing partial block
+    if (data_index < data_length)
+    {
+        uint64_t key_stream = blowfish_encrypt64(ctr_state->cipher_state,
+                                                 ctr_state->init_vector + block_index);
+        for (block_offset = 0; data_index < data_length; ++block_offset)
+        {
+            size_t shift = BF_CTR64_BYTE_SHIFT_BASE - block_offset * BF_CTR64_BYTE_SHIFT;
+            output[data_index] = input[data_index] ^ (unsigned char) (key_stream >> shift);
+            ++data_index;
+        }
+    }
+
+    // Every block that the data overlaps was encrypted to generate the key stream
+    BF_STATS_RECORD(BF_STATS_CTR64_CRYPT, stats_start, data_length,
+                    data_length > 0 ? (offset + data_length - 1) / BF_CTR64_BLOCK_SIZE -
+                                      offset / BF_CTR64_BLOCK_SIZE + 1 : 0);
+}
+
+
+/**
+ * Decrypts the supplied data into a separate output buffer
+ *
+ * @param ctr_state   CTR mode state object
+ * @param input       Cipher text input data to decrypt
+ * @param output      Receives the plain text; may be the same buffer as input
+ * @param data_length Length of the input data
+ * @param offset      Position of the first byte of data within the stream
+ */
+void blowfish_ctr64_decrypt_copy(bf_ctr64_state *ctr_state, const unsigned char *input,
+                                 unsigned char *output, size_t data_length, uint64_t offset)
+{
+    // Encryption and decryption are the same operation in CTR mode
+    blowfish_ctr64_encrypt_copy(ctr_state, input, output, data_length, offset);
+}
+
+
+/**
+ * Initializes a bf_ctr64_state object
+ *
+ * @param ctr_state   The object to initialize
+ * @param state       Cipher state object
+ * @param init_vector The initialization vector for the cipher
+ */
+void blowfish_ctr64_init(bf_ctr64_state *ctr_state, const bf_state *state,
+                         uint64_t init_vector)
+{
+    ctr_state->cipher_state = state;
+    ctr_state->init_vector  = init_vector;
+}
+
+
+/**
+ * Sets the initialization vector
+ *
+ * @param ctr_state   The object to initialize
+ * @param init_vector The initialization vector for the cipher
+ */
+void blowfish_ctr64_set_init_vector(bf_ctr64_state *ctr_state, uint64_t init_vector)
+{
+    ctr_state->init_vector = init_vector;
+}
+
+
+/**
+ * Creates a new bf_ctr64_state object including the contained bf_state object
+ */
+bf_ctr64_state *blowfish_ctr64_alloc(void)
+{
+    bf_ctr64_state *ctr_state = NULL;
+
+    // A single allocation holds both the mode state and the cipher state
+    bf_ctr64_context *context = malloc(sizeof (bf_ctr64_context));
+    if (context != NULL)
+    {
+        ctr_state = &context->ctr_state;
+        ctr_state->cipher_state = &context->cipher_state;
+        ctr_state->init_vector  = 0;
+        blowfish_init(&context->cipher_state);
+        BF_STATS_COUNT(BF_STATS_ALLOCATIONS, 1);
+    }
+
+    return ctr_state;
+}
+
+
+/**
+ * Releases a bf_ctr64_state object including the contained bf_state object
+ */
+void blowfish_ctr64_dealloc(bf_ctr64_state *ctr_state)
+{
+    free(blowfish_ctr64_context_of(ctr_state));
+}
+
+
+/**
+ * Allocates and initializes a new bf_ctr64_state object
+ */
+bf_ctr64_state *blowfish_ctr64_create(const unsigned char *key, size_t key_length,
+                                      uint64_t init_vector)
+{
+    bf_ctr64_state *ctr_state = blowfish_ctr64_alloc();
+    if (ctr_state != NULL)
+    {
+        blowfish_set_key(&blowfish_ctr64_context_of(ctr_state)->cipher_state, key, key_length);
+        ctr_state->init_vector = init_vector;
+    }
+
+    return ctr_state;
+}
+
+
+/**
+ * Clears and deallocates a bf_ctr64_state object
+ */
+void blowfish_ctr64_destroy(bf_ctr64_state *ctr_state)
+{
+    ctr_state->init_vector = 0;
+    blowfish_clear(&blowfish_ctr64_context_of(ctr_state)->cipher_state);
+    blowfish_ctr64_dealloc(ctr_state);
+}
+
+
+/**
+ * Initializes a bf_ctr64_context object in caller-provided storage
+ *
+ * @param context     The storage for the context
+ * @param key         The key to initialize the cipher with
+ * @param key_length  The length of the key
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CTR mode state object within the context
+ */
+bf_ctr64_state *blowfish_ctr64_create_in(bf_ctr64_context *context,
+                                         const unsigned char *key, size_t key_length,
+                                         uint64_t init_vector)
+{
+    blowfish_init(&context->cipher_state);
+    blowfish_set_key(&context->cipher_state, key, key_length);
+    blowfish_ctr64_init(&context->ctr_state, &context->cipher_state, init_vector);
+
+    return &context->ctr_state;
+}
+
+
+/**
+ * Clears a bf_ctr64_context object initialized by blowfish_ctr64_create_in()
+ *
+ * @param context The context to clear
+ */
+void blowfish_ctr64_destroy_in(bf_ctr64_context *context)
+{
+    context->ctr_state.init_vector = 0;
+    blowfish_clear(&context->cipher_state);
+}
+
+
+/**
+ * Returns the context that contains a CTR mode state object
+ *
+ * @param ctr_state CTR mode state object returned by blowfish_ctr64_alloc(),
+ *                  blowfish_ctr64_create() or blowfish_ctr64_create_in()
+ * @return          The context containing the state object
+ */
+bf_ctr64_context *blowfish_ctr64_context_of(bf_ctr64_state *ctr_state)
+{
+    return (bf_ctr64_context *) ((unsigned char *) ctr_state - offsetof(bf_ctr64_context, ctr_state));
+}
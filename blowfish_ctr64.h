@@ -0,0 +1,197 @@
+#include <blowfish.h>
+
+#ifndef BLOWFISH_CTR64_H
+#define	BLOWFISH_CTR64_H
+
+typedef struct bf_ctr64_state_s bf_ctr64_state;
+struct bf_ctr64_state_s
+{
+    const bf_state *cipher_state;
+    uint64_t init_vector;
+};
+
+typedef struct bf_ctr64_context_s bf_ctr64_context;
+struct bf_ctr64_context_s
+{
+    // First member, so that the context shares the alignment of its storage
+    bf_state       cipher_state;
+    bf_ctr64_state ctr_state;
+};
+
+/**
+ * Encrypts the supplied data in-place
+ *
+ * The key stream block for the n-th block of the stream is the encrypted
+ * value of (init_vector + n), so any part of the stream can be processed
+ * independently of the data preceding it.
+ *
+ * @param ctr_state   CTR mode state object
+ * @param data        Plain text input data to encrypt
+ * @param data_length Length of the input data
+ * @param offset      Position of the first byte of data within the stream
+ */
+void blowfish_ctr64_encrypt(bf_ctr64_state *ctr_state,
+                            unsigned char *data, size_t data_length, uint64_t offset);
+
+/**
+ * Decrypts the supplied data in-place
+ *
+ * @param ctr_state   CTR mode state object
+ * @param data        Cipher text input data to decrypt
+ * @param data_length Length of the input data
+ * @param offset      Position of the first byte of data within the stream
+ */
+void blowfish_ctr64_decrypt(bf_ctr64_state *ctr_state,
+                            unsigned char *data, size_t data_length, uint64_t offset);
+
+/**
+ * Encrypts the supplied data into a separate output buffer
+ *
+ * @param ctr_state   CTR mode state object
+ * @param input       Plain text input data to encrypt
+ * @param output      Receives the cipher text; may be the same buffer as input
+ * @param data_length Length of the input data
+ * @param offset      Position of the first byte of data within the stream
+ */
+void blowfish_ctr64_encrypt_copy(bf_ctr64_state *ctr_state, const unsigned char *input,
+                                 unsigned char *output, size_t data_length, uint64_t offset);
+
+/**
+ * Decrypts the supplied data into a separate output buffer
+ *
+ * @param ctr_state   CTR mode state object
+ * @param input       Cipher text input data to decrypt
+ * @param output      Receives the plain text; may be the same buffer as input
+ * @param data_length Length of the input data
+ * @param offset      Position of the first byte of data within the stream
+ */
+void blowfish_ctr64_decrypt_copy(bf_ctr64_state *ctr_state, const unsigned char *input,
+                                 unsigned char *output, size_t data_length, uint64_t offset);
+
+/**
+ * Encrypts the supplied data in-place, using multiple threads
+ *
+ * @param ctr_state    CTR mode state object
+ * @param data         Plain text input data to encrypt
+ * @param data_length  Length of the input data
+ * @param offset       Position of the first byte of data within the stream
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_ctr64_encrypt_parallel(bf_ctr64_state *ctr_state,
+                                     unsigned char *data, size_t data_length, uint64_t offset,
+                                     size_t thread_count);
+
+/**
+ * Decrypts the supplied data in-place, using multiple threads
+ *
+ * @param ctr_state    CTR mode state object
+ * @param data         Cipher text input data to decrypt
+ * @param data_length  Length of the input data
+ * @param offset       Position of the first byte of data within the stream
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_ctr64_decrypt_parallel(bf_ctr64_state *ctr_state,
+                                     unsigned char *data, size_t data_length, uint64_t offset,
+                                     size_t thread_count);
+
+/**
+ * Encrypts the supplied data into a separate output buffer, using multiple threads
+ *
+ * @param ctr_state    CTR mode state object
+ * @param input        Plain text input data to encrypt
+ * @param output       Receives the cipher text; may be the same buffer as input
+ * @param data_length  Length of the input data
+ * @param offset       Position of the first byte of data within the stream
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_ctr64_encrypt_copy_parallel(bf_ctr64_state *ctr_state, const unsigned char *input,
+                                          unsigned char *output, size_t data_length, uint64_t offset,
+                                          size_t thread_count);
+
+/**
+ * Decrypts the supplied data into a separate output buffer, using multiple threads
+ *
+ * @param ctr_state    CTR mode state object
+ * @param input        Cipher text input data to decrypt
+ * @param output       Receives the plain text; may be the same buffer as input
+ * @param data_length  Length of the input data
+ * @param offset       Position of the first byte of data within the stream
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_ctr64_decrypt_copy_parallel(bf_ctr64_state *ctr_state, const unsigned char *input,
+                                          unsigned char *output, size_t data_length, uint64_t offset,
+                                          size_t thread_count);
+
+/**
+ * Initializes a bf_ctr64_state object
+ *
+ * @param ctr_state   The object to initialize
+ * @param state       Cipher state object
+ * @param init_vector The initialization vector for the cipher
+ */
+void blowfish_ctr64_init(bf_ctr64_state *ctr_state, const bf_state *state,
+                         uint64_t init_vector);
+
+/**
+ * Sets the initialization vector
+ *
+ * @param ctr_state   The object to initialize
+ * @param init_vector The initialization vector for the cipher
+ */
+void blowfish_ctr64_set_init_vector(bf_ctr64_state *ctr_state, uint64_t init_vector);
+
+/**
+ * Creates a new bf_ctr64_state object including the contained bf_state object
+ */
+bf_ctr64_state *blowfish_ctr64_alloc(void);
+
+/**
+ * Releases a bf_ctr64_state object including the contained bf_state object
+ */
+void blowfish_ctr64_dealloc(bf_ctr64_state *ctr_state);
+
+/**
+ * Allocates and initializes a new bf_ctr64_state object
+ */
+bf_ctr64_state *blowfish_ctr64_create(const unsigned char *key, size_t key_length,
+                                      uint64_t init_vector);
+
+/**
+ * Clears and deallocates a bf_ctr64_state object
+ */
+void blowfish_ctr64_destroy(bf_ctr64_state *ctr_state);
+
+/**
+ * Initializes a bf_ctr64_context object in caller-provided storage
+ *
+ * Does not allocate memory, so that contexts can be embedded in other
+ * objects or taken from a pool.
+ *
+ * @param context     The storage for the context
+ * @param key         The key to initialize the cipher with
+ * @param key_length  The length of the key
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CTR mode state object within the context
+ */
+bf_ctr64_state *blowfish_ctr64_create_in(bf_ctr64_context *context,
+                                         const unsigned char *key, size_t key_length,
+                                         uint64_t init_vector);
+
+/**
+ * Clears a bf_ctr64_context object initialized by blowfish_ctr64_create_in()
+ *
+ * @param context The context to clear
+ */
+void blowfish_ctr64_destroy_in(bf_ctr64_context *context);
+
+/**
+ * Returns the context that contains a CTR mode state object
+ *
+ * @param ctr_state CTR mode state object returned by blowfish_ctr64_alloc(),
+ *                  blowfish_ctr64_create() or blowfish_ctr64_create_in()
+ * @return          The context containing the state object
+ */
+bf_ctr64_context *blowfish_ctr64_context_of(bf_ctr64_state *ctr_state);
+
+
+#endif	/* BLOWFISH_CTR64_H */
@@ -0,0 +1,266 @@
+/**
+ * Runtime selection of the block-parallel cipher kernels
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <blowfish_dispatch.h>
+#include <blowfish_simd.h>
+#include <string.h>
+
+// Name of the environment variable that overrides the kernel selection
+const char *BF_IMPL_ENV_NAME = "BLOWFISH_IMPL";
+
+// Available kernels, indexed by bf_impl
+//
+// The SIMD kernels use the interleaved key schedule: each key schedule
+// reads and writes its own S boxes, so gathering for 8 or 16 keys at a time
+// spreads the lookups over more memory than the L1 cache holds
+static const bf_kernel BF_KERNELS[] =
+{
+    {
+        BF_IMPL_SCALAR, "scalar",
+        blowfish_scalar_encrypt64_blocks, blowfish_scalar_decrypt64_blocks,
+        blowfish_scalar_expand_keys
+    },
+    {
+        BF_IMPL_INTERLEAVED, "interleaved",
+        blowfish_interleaved_encrypt64_blocks, blowfish_interleaved_decrypt64_blocks,
+        blowfish_interleaved_expand_keys
+    },
+    {
+        BF_IMPL_AVX2, "avx2",
+        blowfish_avx2_encrypt64_blocks, blowfish_avx2_decrypt64_blocks,
+        blowfish_interleaved_expand_keys
+    },
+    {
+        BF_IMPL_AVX512, "avx512",
+        blowfish_avx512_encrypt64_blocks, blowfish_avx512_decrypt64_blocks,
+        blowfish_interleaved_expand_keys
+    }
+};
+
+// Number of entries in BF_KERNELS
+static const size_t BF_KERNEL_COUNT = sizeof (BF_KERNELS) / sizeof (BF_KERNELS[0]);
+
+// The selected kernel, or NULL if no kernel has been selected yet
+static const bf_kernel *bf_active_kernel = NULL;
+
+static const bf_kernel *blowfish_resolve_kernel(void);
+
+
+/**
+ * Returns the kernel used by the block-parallel functions
+ *
+ * @return The selected kernel
+ */
+const bf_kernel *blowfish_kernel(void)
+{
+    const bf_kernel *kernel = __atomic_load_n(&bf_active_kernel, __ATOMIC_ACQUIRE);
+    if (kernel == NULL)
+    {
+        // Concurrent first calls may each resolve the kernel; they all select the same one
+        kernel = blowfish_resolve_kernel();
+        __atomic_store_n(&bf_active_kernel, kernel, __ATOMIC_RELEASE);
+    }
+
+    return kernel;
+}
+
+
+/**
+ * Returns the implementation used by the block-parallel functions
+ *
+ * @return The implementation of the kernel returned by blowfish_kernel()
+ */
+bf_impl blowfish_active_impl(void)
+{
+    return blowfish_kernel()->impl;
+}
+
+
+/**
+ * Returns the name of an implementation
+ *
+ * @param impl The implementation
+ * @return     The implementation's name, e.g. "avx2", or "unknown" if impl is not an implementation
+ */
+const char *blowfish_impl_name(bf_impl impl)
+{
+    // Also rejects values below 0, which wrap around to large values
+    if ((size_t) impl >= BF_KERNEL_COUNT)
+    {
+        return "unknown";
+    }
+
+    return BF_KERNELS[impl].name;
+}
+
+
+/**
+ * Indicates whether an implementation can run on this CPU
+ *
+ * @param impl The implementation
+ * @return     Non-zero if the implementation is supported, zero otherwise
+ */
+int blowfish_impl_supported(bf_impl impl)
+{
+    int supported = 0;
+    switch (impl)
+    {
+        case BF_IMPL_SCALAR:
+            // fall-through
+        case BF_IMPL_INTERLEAVED:
+            supported = 1;
+            break;
+        case BF_IMPL_AVX2:
+            supported = blowfish_simd_avx2_supported();
+            break;
+        case BF_IMPL_AVX512:
+            supported = blowfish_simd_avx512_supported();
+            break;
+        default:
+            break;
+    }
+
+    return supported;
+}
+
+
+/**
+ * Selects the implementation used by the block-parallel functions
+ *
+ * @param impl The implementation to select
+ * @return     0 if the implementation was selected, -1 if it is not supported by the CPU
+ */
+int blowfish_select_impl(bf_impl impl)
+{
+    int rc = -1;
+    if (blowfish_impl_supported(impl))
+    {
+        __atomic_store_n(&bf_active_kernel, &BF_KERNELS[impl], __ATOMIC_RELEASE);
+        rc = 0;
+    }
+
+    return rc;
+}
+
+
+/**
+ * Selects the kernel requested by the environment or the fastest supported kernel
+ *
+ * @return The selected kernel
+ */
+static const bf_kernel *blowfish_resolve_kernel(void)
+{
+    const bf_kernel *kernel = NULL;
+
+    const char *requested = getenv(BF_IMPL_ENV_NAME);
+    if (requested != NULL)
+    {
+        for (size_t index = 0; index < BF_KERNEL_COUNT && kernel == NULL; ++index)
+        {
+            if (strcmp(requested, BF_KERNELS[index].name) == 0 &&
+                blowfish_impl_supported(BF_KERNELS[index].impl))
+            {
+                kernel = &BF_KERNELS[index];
+            }
+        }
+    }
+
+    if (kernel == NULL)
+    {
+        if (blowfish_impl_supported(BF_IMPL_AVX512))
+        {
+            kernel = &BF_KERNELS[BF_IMPL_AVX512];
+        }
+        else
+        if (blowfish_impl_supported(BF_IMPL_AVX2))
+        {
+            kernel = &BF_KERNELS[BF_IMPL_AVX2];
+        }
+        else
+        {
+            kernel = &BF_KERNELS[BF_IMPL_INTERLEAVED];
+        }
+    }
+
+    return kernel;
+}
+
+
+/**
+ * Encrypts an array of 64 bit blocks using the selected kernel
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+void blowfish_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                               size_t block_count)
+{
+    blowfish_kernel()->encrypt64_blocks(state, input, output, block_count);
+}
+
+
+/**
+ * Decrypts an array of 64 bit blocks using the selected kernel
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+void blowfish_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                               size_t block_count)
+{
+    blowfish_kernel()->decrypt64_blocks(state, input, output, block_count);
+}
+
+
+/**
+ * Initializes multiple cipher state objects and sets their encryption keys
+ *
+ * @param states      The cipher state objects
+ * @param keys        The keys to initialize the cipher state objects with
+ * @param key_lengths The lengths of the keys
+ * @param state_count The number of cipher state objects
+ */
+void blowfish_set_keys(bf_state *states[], const unsigned char *keys[], const size_t key_lengths[],
+                       size_t state_count)
+{
+    for (size_t state_index = 0; state_index < state_count; ++state_index)
+    {
+        blowfish_init(states[state_index]);
+        blowfish_mix_key(states[state_index], keys[state_index], key_lengths[state_index]);
+    }
+
+    blowfish_kernel()->expand_keys(states, state_count);
+}
@@ -0,0 +1,145 @@
+#ifndef BLOWFISH_DISPATCH_H
+#define	BLOWFISH_DISPATCH_H
+
+#include <blowfish.h>
+
+enum bf_impl_e
+{
+    BF_IMPL_SCALAR,
+    BF_IMPL_INTERLEAVED,
+    BF_IMPL_AVX2,
+    BF_IMPL_AVX512
+};
+typedef enum bf_impl_e bf_impl;
+
+typedef void (*bf_blocks_func)(const bf_state *state, const uint64_t *input, uint64_t *output,
+                               size_t block_count);
+
+typedef void (*bf_expand_func)(bf_state *states[], size_t state_count);
+
+typedef struct bf_kernel_s bf_kernel;
+struct bf_kernel_s
+{
+    bf_impl        impl;
+    const char     *name;
+    bf_blocks_func encrypt64_blocks;
+    bf_blocks_func decrypt64_blocks;
+    bf_expand_func expand_keys;
+};
+
+/**
+ * Returns the kernel used by the block-parallel functions
+ *
+ * The kernel is selected on first use. If the environment variable
+ * BLOWFISH_IMPL names a kernel that is supported by the CPU
+ * ("scalar", "interleaved", "avx2" or "avx512"), that kernel is selected,
+ * otherwise the fastest supported kernel is selected.
+ *
+ * @return The selected kernel
+ */
+const bf_kernel *blowfish_kernel(void);
+
+/**
+ * Returns the implementation used by the block-parallel functions
+ *
+ * @return The implementation of the kernel returned by blowfish_kernel()
+ */
+bf_impl blowfish_active_impl(void);
+
+/**
+ * Returns the name of an implementation
+ *
+ * @param impl The implementation
+ * @return     The implementation's name, e.g. "avx2", or "unknown" if impl is not an implementation
+ */
+const char *blowfish_impl_name(bf_impl impl);
+
+/**
+ * Indicates whether an implementation can run on this CPU
+ *
+ * @param impl The implementation
+ * @return     Non-zero if the implementation is supported, zero otherwise
+ */
+int blowfish_impl_supported(bf_impl impl);
+
+/**
+ * Selects the implementation used by the block-parallel functions
+ *
+ * Intended for testing and benchmarking. Must not be called while other
+ * threads are running cipher operations.
+ *
+ * @param impl The implementation to select
+ * @return     0 if the implementation was selected, -1 if it is not supported by the CPU
+ */
+int blowfish_select_impl(bf_impl impl);
+
+/**
+ * Encrypts an array of 64 bit blocks, one block at a time
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+void blowfish_scalar_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count);
+
+/**
+ * Decrypts an array of 64 bit blocks, one block at a time
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+void blowfish_scalar_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count);
+
+/**
+ * Encrypts an array of 64 bit blocks, several blocks at a time
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+void blowfish_interleaved_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                           size_t block_count);
+
+/**
+ * Decrypts an array of 64 bit blocks, several blocks at a time
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+void blowfish_interleaved_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                           size_t block_count);
+
+/**
+ * Applies the key to the P box of an initialized bf_state object
+ *
+ * @param state      The cipher state object
+ * @param key        The key to initialize the cipher with
+ * @param key_length The length of the key
+ */
+void blowfish_mix_key(bf_state *state, const unsigned char *key, size_t key_length);
+
+/**
+ * Completes the key schedules of multiple cipher state objects one by one
+ *
+ * @param states      The cipher state objects, prepared by blowfish_mix_key()
+ * @param state_count The number of cipher state objects
+ */
+void blowfish_scalar_expand_keys(bf_state *states[], size_t state_count);
+
+/**
+ * Completes the key schedules of multiple cipher state objects, several at a time
+ *
+ * @param states      The cipher state objects, prepared by blowfish_mix_key()
+ * @param state_count The number of cipher state objects
+ */
+void blowfish_interleaved_expand_keys(bf_state *states[], size_t state_count);
+
+#endif	/* BLOWFISH_DISPATCH_H */
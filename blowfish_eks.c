@@ -0,0 +1,529 @@
+/**
+ * Expensive key schedule (EksBlowfish) password hashing, compatible with bcrypt
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <blowfish_eks.h>
+#include <blowfish_dispatch.h>
+#include <stdio.h>
+#include <string.h>
+
+extern const size_t BF_P_BOXES;
+extern const size_t BF_S_BOXES;
+extern const size_t BF_S_BOX_ENTRIES;
+extern const size_t BF_UNROLLED_STEP;
+
+// Number of hashes of a batch whose key schedules run in lockstep;
+// keeps the cipher state objects of a group within the L2 cache
+#define BF_EKS_GROUP_SIZE 16
+
+// Number of 32 bit words of the encrypted magic value
+#define BF_EKS_MAGIC_WORDS 6
+
+// Number of times the magic value is encrypted
+const size_t BF_EKS_MAGIC_ROUNDS = 64;
+
+// Number of 32 bit words of the salt
+const size_t BF_EKS_SALT_WORDS = 4;
+
+// Encoded lengths of the salt and the digest in the modular crypt format
+#define BF_EKS_SALT_CHARS   22
+#define BF_EKS_DIGEST_CHARS 31
+
+// Length of the "$2b$NN$" prefix of the modular crypt format
+const size_t BF_EKS_PREFIX_LENGTH = 7;
+
+// The plain text "OrpheanBeholderScryDoubt" that is encrypted to produce the digest
+static const uint32_t BF_EKS_MAGIC[BF_EKS_MAGIC_WORDS] =
+{
+    0x4F727068, 0x65616E42, 0x65686F6C, 0x64657253, 0x63727944, 0x6F756274
+};
+
+// The base64 alphabet of bcrypt, which differs from the standard alphabet
+static const char BF_EKS_BASE64[] =
+    "./ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+
+typedef struct bf_eks_job_s bf_eks_job;
+struct bf_eks_job_s
+{
+    bf_state      state;
+    unsigned char key[BF_EKS_MAX_KEY_LENGTH];
+    size_t        key_length;
+    uint64_t      rounds;
+};
+
+static size_t blowfish_eks_prepare_key(const unsigned char *password, size_t password_length,
+                                       unsigned char *key);
+static void blowfish_eks_digest(bf_state *state, unsigned char *digest);
+static int blowfish_eks_equal(const unsigned char *digest, const unsigned char *other_digest);
+static void blowfish_eks_verify_group(bf_eks_job *jobs, const bf_eks_hash *hashes,
+                                      const unsigned char *passwords[], const size_t password_lengths[],
+                                      int results[], size_t count);
+static void blowfish_eks_encode64(char *output, const unsigned char *data, size_t data_length);
+static int blowfish_eks_decode64(unsigned char *output, size_t output_length, const char *input);
+
+
+/**
+ * Runs the expensive key schedule (EksBlowfishSetup)
+ *
+ * @param state      The cipher state object to initialize
+ * @param cost       The cost parameter, BF_EKS_MIN_COST to BF_EKS_MAX_COST
+ * @param salt       The salt, BF_EKS_SALT_LENGTH bytes
+ * @param key        The key
+ * @param key_length The length of the key, 1 to BF_EKS_MAX_KEY_LENGTH bytes
+ */
+void blowfish_eks_setup(bf_state *state, unsigned int cost, const unsigned char *salt,
+                        const unsigned char *key, size_t key_length)
+{
+    blowfish_init(state);
+    blowfish_eks_expand_salted(state, salt, key, key_length);
+
+    const uint64_t rounds = UINT64_C(1) << cost;
+    for (uint64_t round = 0; round < rounds; ++round)
+    {
+        blowfish_set_key(state, key, key_length);
+        blowfish_set_key(state, salt, BF_EKS_SALT_LENGTH);
+    }
+}
+
+
+/**
+ * Expands the key into an initialized state, mixing the salt into each encrypted block
+ *
+ * @param state      The cipher state object
+ * @param salt       The salt, BF_EKS_SALT_LENGTH bytes
+ * @param key        The key
+ * @param key_length The length of the key
+ */
+void blowfish_eks_expand_salted(bf_state *state, const unsigned char *salt,
+                                const unsigned char *key, size_t key_length)
+{
+    blowfish_mix_key(state, key, key_length);
+
+    uint32_t salt_words[BF_EKS_SALT_LENGTH / sizeof (uint32_t)];
+    for (size_t word_index = 0; word_index < BF_EKS_SALT_WORDS; ++word_index)
+    {
+        const unsigned char *bytes = &salt[word_index * 4];
+        salt_words[word_index] = ((uint32_t) bytes[0] << 24) | ((uint32_t) bytes[1] << 16) |
+                                 ((uint32_t) bytes[2] << 8) | (uint32_t) bytes[3];
+    }
+
+    // Each encrypted block is XORed with the next two words of the salt,
+    // alternating between the first and the second half of the salt
+    uint32_t data_l = 0;
+    uint32_t data_r = 0;
+    size_t salt_index = 0;
+    for (size_t p_index = 0; p_index < BF_P_BOXES; p_index += BF_UNROLLED_STEP)
+    {
+        data_l ^= salt_words[salt_index];
+        data_r ^= salt_words[salt_index + 1];
+        salt_index ^= 2;
+        blowfish_encrypt(state, &data_l, &data_r);
+        state->p_box[p_index] = data_l;
+        state->p_box[p_index + 1] = data_r;
+    }
+
+    for (size_t s_box_index = 0; s_box_index < BF_S_BOXES; ++s_box_index)
+    {
+        for (size_t s_entry_index = 0;
+             s_entry_index < BF_S_BOX_ENTRIES;
+             s_entry_index += BF_UNROLLED_STEP)
+        {
+            data_l ^= salt_words[salt_index];
+            data_r ^= salt_words[salt_index + 1];
+            salt_index ^= 2;
+            blowfish_encrypt(state, &data_l, &data_r);
+            state->s_box[s_box_index][s_entry_index] = data_l;
+            state->s_box[s_box_index][s_entry_index + 1] = data_r;
+        }
+    }
+}
+
+
+/**
+ * Computes the digest of a password
+ *
+ * @param hash            Supplies the cost and the salt, receives the digest
+ * @param password        The password
+ * @param password_length The length of the password
+ * @return                0 on success, -1 if the cost is out of range or out of memory
+ */
+int blowfish_eks_compute(bf_eks_hash *hash, const unsigned char *password, size_t password_length)
+{
+    if (hash->cost < BF_EKS_MIN_COST || hash->cost > BF_EKS_MAX_COST)
+    {
+        return -1;
+    }
+
+    bf_eks_job *job = malloc(sizeof (bf_eks_job));
+    if (job == NULL)
+    {
+        return -1;
+    }
+
+    job->key_length = blowfish_eks_prepare_key(password, password_length, job->key);
+    blowfish_eks_setup(&job->state, hash->cost, hash->salt, job->key, job->key_length);
+    blowfish_eks_digest(&job->state, hash->digest);
+
+    memset(job, 0, sizeof (bf_eks_job));
+    free(job);
+    return 0;
+}
+
+
+/**
+ * Checks a password against a hash
+ *
+ * @param hash            The hash to check against
+ * @param password        The password
+ * @param password_length The length of the password
+ * @return                1 if the password matches, 0 if it does not match or the hash is invalid
+ */
+int blowfish_eks_verify(const bf_eks_hash *hash, const unsigned char *password, size_t password_length)
+{
+    bf_eks_hash computed = *hash;
+    int matches = 0;
+    if (blowfish_eks_compute(&computed, password, password_length) == 0)
+    {
+        matches = blowfish_eks_equal(computed.digest, hash->digest);
+    }
+    memset(&computed, 0, sizeof (computed));
+    return matches;
+}
+
+
+/**
+ * Checks multiple passwords against their hashes
+ *
+ * @param hashes           The hashes to check against
+ * @param passwords        The passwords
+ * @param password_lengths The lengths of the passwords
+ * @param results          Receives 1 for each matching password and 0 otherwise
+ * @param count            The number of passwords
+ * @return                 0 on success, -1 if out of memory
+ */
+int blowfish_eks_verify_batch(const bf_eks_hash *hashes, const unsigned char *passwords[],
+                              const size_t password_lengths[], int results[], size_t count)
+{
+    bf_eks_job *jobs = malloc(sizeof (bf_eks_job) * BF_EKS_GROUP_SIZE);
+    if (jobs == NULL)
+    {
+        return -1;
+    }
+
+    for (size_t index = 0; index < count; index += BF_EKS_GROUP_SIZE)
+    {
+        size_t group_count = count - index < BF_EKS_GROUP_SIZE ? count - index : BF_EKS_GROUP_SIZE;
+        blowfish_eks_verify_group(jobs, &hashes[index], &passwords[index], &password_lengths[index],
+                                  &results[index], group_count);
+    }
+
+    memset(jobs, 0, sizeof (bf_eks_job) * BF_EKS_GROUP_SIZE);
+    free(jobs);
+    return 0;
+}
+
+
+/**
+ * Formats a hash as a bcrypt string in the modular crypt format
+ *
+ * @param hash   The hash to format
+ * @param output Receives the zero-terminated string, BF_EKS_STRING_LENGTH bytes
+ * @return       0 on success, -1 if the cost is out of range
+ */
+int blowfish_eks_format(const bf_eks_hash *hash, char *output)
+{
+    if (hash->cost < BF_EKS_MIN_COST || hash->cost > BF_EKS_MAX_COST)
+    {
+        return -1;
+    }
+
+    snprintf(output, BF_EKS_PREFIX_LENGTH + 1, "$2b$%02u$", hash->cost);
+    blowfish_eks_encode64(&output[BF_EKS_PREFIX_LENGTH], hash->salt, BF_EKS_SALT_LENGTH);
+    blowfish_eks_encode64(&output[BF_EKS_PREFIX_LENGTH + BF_EKS_SALT_CHARS],
+                          hash->digest, BF_EKS_DIGEST_LENGTH);
+    output[BF_EKS_STRING_LENGTH - 1] = '\0';
+    return 0;
+}
+
+
+/**
+ * Parses a bcrypt string in the modular crypt format
+ *
+ * @param hash  Receives the cost, the salt and the digest
+ * @param input The zero-terminated string
+ * @return      0 on success, -1 if the string is not a valid bcrypt hash
+ */
+int blowfish_eks_parse(bf_eks_hash *hash, const char *input)
+{
+    if (strlen(input) != BF_EKS_STRING_LENGTH - 1 ||
+        input[0] != '$' || input[1] != '2' || strchr("aby", input[2]) == NULL || input[3] != '$' ||
+        input[4] < '0' || input[4] > '9' || input[5] < '0' || input[5] > '9' || input[6] != '$')
+    {
+        return -1;
+    }
+
+    hash->cost = (unsigned int) ((input[4] - '0') * 10 + (input[5] - '0'));
+    if (hash->cost < BF_EKS_MIN_COST || hash->cost > BF_EKS_MAX_COST ||
+        blowfish_eks_decode64(hash->salt, BF_EKS_SALT_LENGTH, &input[BF_EKS_PREFIX_LENGTH]) != 0 ||
+        blowfish_eks_decode64(hash->digest, BF_EKS_DIGEST_LENGTH,
+                              &input[BF_EKS_PREFIX_LENGTH + BF_EKS_SALT_CHARS]) != 0)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * Converts a password to the key used by the key schedule
+ *
+ * @param password        The password
+ * @param password_length The length of the password
+ * @param key             Receives the key, BF_EKS_MAX_KEY_LENGTH bytes
+ * @return                The length of the key
+ */
+static size_t blowfish_eks_prepare_key(const unsigned char *password, size_t password_length,
+                                       unsigned char *key)
+{
+    size_t key_length = password_length;
+    if (key_length >= BF_EKS_MAX_KEY_LENGTH)
+    {
+        key_length = BF_EKS_MAX_KEY_LENGTH;
+        memcpy(key, password, key_length);
+    }
+    else
+    {
+        memcpy(key, password, key_length);
+        key[key_length] = 0;
+        ++key_length;
+    }
+    return key_length;
+}
+
+
+/**
+ * Encrypts the magic value with the expanded state to produce the digest
+ *
+ * @param state  The cipher state object set up by blowfish_eks_setup()
+ * @param digest Receives the digest, BF_EKS_DIGEST_LENGTH bytes
+ */
+static void blowfish_eks_digest(bf_state *state, unsigned char *digest)
+{
+    uint32_t words[BF_EKS_MAGIC_WORDS];
+    memcpy(words, BF_EKS_MAGIC, sizeof (words));
+
+    for (size_t round = 0; round < BF_EKS_MAGIC_ROUNDS; ++round)
+    {
+        for (size_t word_index = 0; word_index < BF_EKS_MAGIC_WORDS; word_index += 2)
+        {
+            blowfish_encrypt(state, &words[word_index], &words[word_index + 1]);
+        }
+    }
+
+    unsigned char cipher_text[BF_EKS_MAGIC_WORDS * 4];
+    for (size_t word_index = 0; word_index < BF_EKS_MAGIC_WORDS; ++word_index)
+    {
+        cipher_text[word_index * 4]     = (unsigned char) (words[word_index] >> 24);
+        cipher_text[word_index * 4 + 1] = (unsigned char) (words[word_index] >> 16);
+        cipher_text[word_index * 4 + 2] = (unsigned char) (words[word_index] >> 8);
+        cipher_text[word_index * 4 + 3] = (unsigned char) words[word_index];
+    }
+    memcpy(digest, cipher_text, BF_EKS_DIGEST_LENGTH);
+}
+
+
+/**
+ * Compares two digests in constant time
+ *
+ * @param digest       The first digest
+ * @param other_digest The second digest
+ * @return             1 if the digests are equal, 0 otherwise
+ */
+static int blowfish_eks_equal(const unsigned char *digest, const unsigned char *other_digest)
+{
+    unsigned char difference = 0;
+    for (size_t index = 0; index < BF_EKS_DIGEST_LENGTH; ++index)
+    {
+        difference |= digest[index] ^ other_digest[index];
+    }
+    return difference == 0;
+}
+
+
+/**
+ * Checks a group of passwords against their hashes with the key schedules in lockstep
+ *
+ * Hashes with a lower cost drop out of the lockstep once their key schedule is complete.
+ *
+ * @param jobs             Work area for BF_EKS_GROUP_SIZE hashes
+ * @param hashes           The hashes to check against
+ * @param passwords        The passwords
+ * @param password_lengths The lengths of the passwords
+ * @param results          Receives 1 for each matching password and 0 otherwise
+ * @param count            The number of passwords, at most BF_EKS_GROUP_SIZE
+ */
+static void blowfish_eks_verify_group(bf_eks_job *jobs, const bf_eks_hash *hashes,
+                                      const unsigned char *passwords[], const size_t password_lengths[],
+                                      int results[], size_t count)
+{
+    const bf_kernel *kernel = blowfish_kernel();
+
+    uint64_t max_rounds = 0;
+    for (size_t index = 0; index < count; ++index)
+    {
+        bf_eks_job *job = &jobs[index];
+        const bf_eks_hash *hash = &hashes[index];
+        job->rounds = 0;
+        if (hash->cost >= BF_EKS_MIN_COST && hash->cost <= BF_EKS_MAX_COST)
+        {
+            job->rounds = UINT64_C(1) << hash->cost;
+            job->key_length = blowfish_eks_prepare_key(passwords[index], password_lengths[index], job->key);
+            blowfish_init(&job->state);
+            blowfish_eks_expand_salted(&job->state, hash->salt, job->key, job->key_length);
+        }
+        if (job->rounds > max_rounds)
+        {
+            max_rounds = job->rounds;
+        }
+    }
+
+    bf_state *active_states[BF_EKS_GROUP_SIZE];
+    for (uint64_t round = 0; round < max_rounds; ++round)
+    {
+        size_t active_count = 0;
+        for (size_t index = 0; index < count; ++index)
+        {
+            if (round < jobs[index].rounds)
+            {
+                blowfish_mix_key(&jobs[index].state, jobs[index].key, jobs[index].key_length);
+                active_states[active_count] = &jobs[index].state;
+                ++active_count;
+            }
+        }
+        kernel->expand_keys(active_states, active_count);
+
+        for (size_t index = 0; index < count; ++index)
+        {
+            if (round < jobs[index].rounds)
+            {
+                blowfish_mix_key(&jobs[index].state, hashes[index].salt, BF_EKS_SALT_LENGTH);
+            }
+        }
+        kernel->expand_keys(active_states, active_count);
+    }
+
+    for (size_t index = 0; index < count; ++index)
+    {
+        results[index] = 0;
+        if (jobs[index].rounds > 0)
+        {
+            unsigned char digest[BF_EKS_DIGEST_LENGTH];
+            blowfish_eks_digest(&jobs[index].state, digest);
+            results[index] = blowfish_eks_equal(digest, hashes[index].digest);
+        }
+    }
+}
+
+
+/**
+ * Encodes data using the base64 alphabet of bcrypt, without padding
+ *
+ * @param output      Receives the encoded characters, not zero-terminated
+ * @param data        The data to encode
+ * @param data_length The length of the data
+ */
+static void blowfish_eks_encode64(char *output, const unsigned char *data, size_t data_length)
+{
+    size_t out_index = 0;
+    for (size_t index = 0; index < data_length; index += 3)
+    {
+        size_t remaining = data_length - index;
+        uint32_t group = (uint32_t) data[index] << 16;
+        if (remaining > 1)
+        {
+            group |= (uint32_t) data[index + 1] << 8;
+        }
+        if (remaining > 2)
+        {
+            group |= (uint32_t) data[index + 2];
+        }
+
+        // 1, 2 or 3 bytes are encoded as 2, 3 or 4 characters
+        size_t char_count = remaining > 2 ? 4 : remaining + 1;
+        for (size_t char_index = 0; char_index < char_count; ++char_index)
+        {
+            output[out_index] = BF_EKS_BASE64[(group >> (18 - 6 * char_index)) & 0x3F];
+            ++out_index;
+        }
+    }
+}
+
+
+/**
+ * Decodes data encoded using the base64 alphabet of bcrypt
+ *
+ * @param output        Receives the decoded data
+ * @param output_length The number of bytes to decode
+ * @param input         The encoded characters
+ * @return              0 on success, -1 if the input contains an invalid character
+ */
+static int blowfish_eks_decode64(unsigned char *output, size_t output_length, const char *input)
+{
+    size_t in_index = 0;
+    for (size_t index = 0; index < output_length; index += 3)
+    {
+        size_t remaining = output_length - index;
+        size_t char_count = remaining > 2 ? 4 : remaining + 1;
+        uint32_t group = 0;
+        for (size_t char_index = 0; char_index < char_count; ++char_index)
+        {
+            const char *position = input[in_index] != '\0' ? strchr(BF_EKS_BASE64, input[in_index]) : NULL;
+            if (position == NULL)
+            {
+                return -1;
+            }
+            group |= (uint32_t) (position - BF_EKS_BASE64) << (18 - 6 * char_index);
+            ++in_index;
+        }
+
+        output[index] = (unsigned char) (group >> 16);
+        if (remaining > 1)
+        {
+            output[index + 1] = (unsigned char) (group >> 8);
+        }
+        if (remaining > 2)
+        {
+            output[index + 2] = (unsigned char) group;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+#ifndef BLOWFISH_EKS_H
+#define	BLOWFISH_EKS_H
+
+#include <blowfish.h>
+
+// Length of the salt in bytes (128 bits)
+#define BF_EKS_SALT_LENGTH 16
+
+// Length of the digest in bytes; bcrypt discards the last byte of the 192 bit cipher text
+#define BF_EKS_DIGEST_LENGTH 23
+
+// Maximum number of key bytes used, including the appended zero byte
+#define BF_EKS_MAX_KEY_LENGTH 72
+
+// Length of a hash string in the modular crypt format, including the terminating zero byte
+#define BF_EKS_STRING_LENGTH 61
+
+// Range of the cost parameter, the key schedule runs 2^cost times
+#define BF_EKS_MIN_COST 4
+#define BF_EKS_MAX_COST 31
+
+typedef struct bf_eks_hash_s bf_eks_hash;
+struct bf_eks_hash_s
+{
+    unsigned int  cost;
+    unsigned char salt[BF_EKS_SALT_LENGTH];
+    unsigned char digest[BF_EKS_DIGEST_LENGTH];
+};
+
+/**
+ * Runs the expensive key schedule (EksBlowfishSetup)
+ *
+ * Initializes the state, expands the key using the salt, then alternately
+ * expands the key and the salt without salting 2^cost times.
+ *
+ * @param state      The cipher state object to initialize
+ * @param cost       The cost parameter, BF_EKS_MIN_COST to BF_EKS_MAX_COST
+ * @param salt       The salt, BF_EKS_SALT_LENGTH bytes
+ * @param key        The key
+ * @param key_length The length of the key, 1 to BF_EKS_MAX_KEY_LENGTH bytes
+ */
+void blowfish_eks_setup(bf_state *state, unsigned int cost, const unsigned char *salt,
+                        const unsigned char *key, size_t key_length);
+
+/**
+ * Expands the key into an initialized state, mixing the salt into each encrypted block
+ *
+ * @param state      The cipher state object
+ * @param salt       The salt, BF_EKS_SALT_LENGTH bytes
+ * @param key        The key
+ * @param key_length The length of the key
+ */
+void blowfish_eks_expand_salted(bf_state *state, const unsigned char *salt,
+                                const unsigned char *key, size_t key_length);
+
+/**
+ * Computes the digest of a password
+ *
+ * Compatible with bcrypt ($2b$): a zero byte is appended to the password
+ * and the result is truncated to BF_EKS_MAX_KEY_LENGTH bytes.
+ *
+ * @param hash            Supplies the cost and the salt, receives the digest
+ * @param password        The password
+ * @param password_length The length of the password
+ * @return                0 on success, -1 if the cost is out of range or out of memory
+ */
+int blowfish_eks_compute(bf_eks_hash *hash, const unsigned char *password, size_t password_length);
+
+/**
+ * Checks a password against a hash
+ *
+ * @param hash            The hash to check against
+ * @param password        The password
+ * @param password_length The length of the password
+ * @return                1 if the password matches, 0 if it does not match or the hash is invalid
+ */
+int blowfish_eks_verify(const bf_eks_hash *hash, const unsigned char *password, size_t password_length);
+
+/**
+ * Checks multiple passwords against their hashes
+ *
+ * The key schedules of all hashes run in lockstep, several at a time, using
+ * the kernel selected by blowfish_kernel(), so that the S box lookups of
+ * independent hashes can overlap. The hashes may have different costs.
+ *
+ * @param hashes           The hashes to check against
+ * @param passwords        The passwords
+ * @param password_lengths The lengths of the passwords
+ * @param results          Receives 1 for each matching password and 0 otherwise
+ * @param count            The number of passwords
+ * @return                 0 on success, -1 if out of memory
+ */
+int blowfish_eks_verify_batch(const bf_eks_hash *hashes, const unsigned char *passwords[],
+                              const size_t password_lengths[], int results[], size_t count);
+
+/**
+ * Formats a hash as a bcrypt string in the modular crypt format
+ *
+ * @param hash   The hash to format
+ * @param output Receives the zero-terminated string, BF_EKS_STRING_LENGTH bytes
+ * @return       0 on success, -1 if the cost is out of range
+ */
+int blowfish_eks_format(const bf_eks_hash *hash, char *output);
+
+/**
+ * Parses a bcrypt string in the modular crypt format
+ *
+ * Accepts the $2a$, $2b$ and $2y$ prefixes.
+ *
+ * @param hash  Receives the cost, the salt and the digest
+ * @param input The zero-terminated string
+ * @return      0 on success, -1 if the string is not a valid bcrypt hash
+ */
+int blowfish_eks_parse(bf_eks_hash *hash, const char *input);
+
+#endif	/* BLOWFISH_EKS_H */
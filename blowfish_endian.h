@@ -0,0 +1,38 @@
+#ifndef BLOWFISH_ENDIAN_H
+#define	BLOWFISH_ENDIAN_H
+
+#include <stdint.h>
+
+/**
+ * Loads a 64 bit block from 8 bytes of big-endian data
+ *
+ * @param data Pointer to the first byte of the block
+ * @return     The 64 bit block
+ */
+static inline uint64_t blowfish_load_be64(const unsigned char *data)
+{
+    return (((uint64_t) data[0]) << 56) | (((uint64_t) data[1]) << 48) |
+           (((uint64_t) data[2]) << 40) | (((uint64_t) data[3]) << 32) |
+           (((uint64_t) data[4]) << 24) | (((uint64_t) data[5]) << 16) |
+           (((uint64_t) data[6]) <<  8) |  ((uint64_t) data[7]);
+}
+
+/**
+ * Stores a 64 bit block as 8 bytes of big-endian data
+ *
+ * @param data  Pointer to the first byte of the destination
+ * @param value The 64 bit block
+ */
+static inline void blowfish_store_be64(unsigned char *data, uint64_t value)
+{
+    data[0] = (unsigned char) (value >> 56);
+    data[1] = (unsigned char) (value >> 48);
+    data[2] = (unsigned char) (value >> 40);
+    data[3] = (unsigned char) (value >> 32);
+    data[4] = (unsigned char) (value >> 24);
+    data[5] = (unsigned char) (value >> 16);
+    data[6] = (unsigned char) (value >>  8);
+    data[7] = (unsigned char) value;
+}
+
+#endif	/* BLOWFISH_ENDIAN_H */
@@ -0,0 +1,937 @@
+/**
+ * Asynchronous job engine with a lock-free submission queue and work stealing
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish_engine.h>
+#include <blowfish_endian.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+extern const size_t BF_CFB64_BLOCK_SIZE;
+
+// Number of blocks per chunk of a decryption job (64 kiB)
+const size_t BF_ENGINE_CHUNK_BLOCKS = 8192;
+
+// Number of buckets of the table of streams with jobs in the engine, a power of 2
+const size_t BF_ENGINE_STREAM_BUCKETS = 1024;
+
+// Time after which idle workers retry dispatching a deferred job if no stream object was returned (10 ms)
+const long BF_ENGINE_RETRY_NS = 10000000L;
+
+// Intrusive lock-free multi-producer, single-consumer queue of jobs
+// (D. Vyukov's algorithm); the stub keeps the queue non-empty
+typedef struct bf_engine_queue_s bf_engine_queue;
+struct bf_engine_queue_s
+{
+    // Most recently pushed job; written by the producers
+    bf_engine_job *head;
+    // Next job to pop; owned by the consumer
+    bf_engine_job *tail;
+    bf_engine_job stub;
+};
+
+// A bf_cfb64_state object with jobs in the engine
+struct bf_engine_stream_s
+{
+    bf_cfb64_state   *cfb_state;
+    // Jobs submitted while an earlier job of the stream is running
+    bf_engine_job    *waiting_head;
+    bf_engine_job    *waiting_tail;
+    bf_engine_stream *next;
+};
+
+typedef struct bf_engine_worker_s bf_engine_worker;
+struct bf_engine_worker_s
+{
+    bf_engine       *engine;
+    size_t          index;
+    pthread_t       thread;
+    int             started;
+    // Runnable tasks; the owner takes the newest, thieves take the oldest
+    pthread_mutex_t lock;
+    bf_engine_task  *oldest;
+    bf_engine_task  *newest;
+};
+
+struct bf_engine_s
+{
+    bf_engine_queue  submissions;
+    bf_engine_queue  completions;
+    bf_engine_worker *workers;
+    size_t           worker_count;
+
+    // Protects the stream table and the stream free list
+    pthread_mutex_t  streams_lock;
+    bf_engine_stream **stream_buckets;
+    bf_engine_stream *free_streams;
+
+    // Idle workers wait for new jobs or tasks
+    pthread_mutex_t  idle_lock;
+    pthread_cond_t   idle_cond;
+    size_t           sleepers;
+
+    // Jobs submitted but not yet dispatched
+    size_t           queued_jobs;
+    // Tasks in the workers' queues
+    size_t           queued_tasks;
+    // Jobs submitted but not yet completed
+    size_t           active_jobs;
+    // Set while a worker is moving jobs from the submission queue to the streams
+    int              dispatching;
+    // Job taken from the submission queue for which no stream object could be
+    // allocated; dispatched before any other job; owned by the dispatching worker
+    bf_engine_job    *deferred_job;
+    // Set while the deferred job waits for a stream object; workers do not
+    // dispatch, and do not count the submitted jobs as work, until it is cleared
+    int              dispatch_stalled;
+    int              stop;
+    int              event_fd;
+};
+
+static void *blowfish_engine_worker_main(void *arg);
+static void blowfish_engine_dispatch(bf_engine_worker *worker);
+static void blowfish_engine_schedule(bf_engine_worker *worker, bf_engine_job *job);
+static void blowfish_engine_run_task(bf_engine_worker *worker, bf_engine_task *task);
+static void blowfish_engine_complete(bf_engine_worker *worker, bf_engine_job *job);
+static bf_engine_task *blowfish_engine_take_task(bf_engine_worker *worker);
+static bf_engine_task *blowfish_engine_steal_task(bf_engine_worker *worker);
+static void blowfish_engine_wake(bf_engine *engine, size_t count);
+static int blowfish_engine_has_work(bf_engine *engine);
+static size_t blowfish_engine_stream_bucket(const bf_cfb64_state *cfb_state);
+static void blowfish_engine_queue_init(bf_engine_queue *queue);
+static void blowfish_engine_queue_push(bf_engine_queue *queue, bf_engine_job *job);
+static bf_engine_job *blowfish_engine_queue_pop(bf_engine_queue *queue);
+
+
+/**
+ * Creates an engine that runs jobs on a pool of worker threads
+ *
+ * @param worker_count Number of worker threads; 0 selects the number of online CPUs
+ * @param flags        0 or BF_ENGINE_EVENTFD
+ * @return             The new engine, or NULL if out of resources
+ */
+bf_engine *blowfish_engine_create(size_t worker_count, unsigned int flags)
+{
+    if (worker_count == 0)
+    {
+        long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cpu_count > 0 ? (size_t) cpu_count : 1;
+    }
+
+    bf_engine *engine = malloc(sizeof (bf_engine));
+    if (engine == NULL)
+    {
+        return NULL;
+    }
+    memset(engine, 0, sizeof (bf_engine));
+    blowfish_engine_queue_init(&engine->submissions);
+    blowfish_engine_queue_init(&engine->completions);
+    engine->event_fd = -1;
+
+    int rc = 0;
+    engine->workers = malloc(sizeof (bf_engine_worker) * worker_count);
+    engine->stream_buckets = calloc(BF_ENGINE_STREAM_BUCKETS, sizeof (bf_engine_stream *));
+    if (engine->workers == NULL || engine->stream_buckets == NULL)
+    {
+        rc = -1;
+    }
+
+    if (rc == 0 && (flags & BF_ENGINE_EVENTFD) != 0)
+    {
+#ifdef __linux__
+        engine->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+        if (engine->event_fd == -1)
+        {
+            rc = -1;
+        }
+    }
+
+    if (rc != 0)
+    {
+        free(engine->stream_buckets);
+        free(engine->workers);
+        free(engine);
+        return NULL;
+    }
+
+    pthread_mutex_init(&engine->streams_lock, NULL);
+    pthread_mutex_init(&engine->idle_lock, NULL);
+    pthread_cond_init(&engine->idle_cond, NULL);
+
+    for (size_t index = 0; index < worker_count; ++index)
+    {
+        bf_engine_worker *worker = &engine->workers[index];
+        worker->engine = engine;
+        worker->index  = index;
+        worker->oldest = NULL;
+        worker->newest = NULL;
+        pthread_mutex_init(&worker->lock, NULL);
+    }
+    engine->worker_count = worker_count;
+
+    // Started after all workers are initialized, since each may steal from the others
+    size_t started_count = 0;
+    for (size_t index = 0; index < worker_count; ++index)
+    {
+        bf_engine_worker *worker = &engine->workers[index];
+        worker->started = pthread_create(&worker->thread, NULL, blowfish_engine_worker_main, worker) == 0;
+        if (worker->started)
+        {
+            ++started_count;
+        }
+    }
+
+    if (started_count == 0)
+    {
+        blowfish_engine_destroy(engine);
+        engine = NULL;
+    }
+
+    return engine;
+}
+
+
+/**
+ * Completes all submitted jobs, stops the worker threads and destroys an engine
+ *
+ * @param engine The engine to destroy
+ */
+void blowfish_engine_destroy(bf_engine *engine)
+{
+    if (engine != NULL)
+    {
+        pthread_mutex_lock(&engine->idle_lock);
+        __atomic_store_n(&engine->stop, 1, __ATOMIC_SEQ_CST);
+        pthread_cond_broadcast(&engine->idle_cond);
+        pthread_mutex_unlock(&engine->idle_lock);
+
+        for (size_t index = 0; index < engine->worker_count; ++index)
+        {
+            if (engine->workers[index].started)
+            {
+                pthread_join(engine->workers[index].thread, NULL);
+            }
+        }
+        // Destroyed only after all workers have exited, since idle workers try to steal
+        for (size_t index = 0; index < engine->worker_count; ++index)
+        {
+            pthread_mutex_destroy(&engine->workers[index].lock);
+        }
+
+        // All jobs are completed, so all streams are on the free list
+        while (engine->free_streams != NULL)
+        {
+            bf_engine_stream *next = engine->free_streams->next;
+            free(engine->free_streams);
+            engine->free_streams = next;
+        }
+
+        if (engine->event_fd != -1)
+        {
+            close(engine->event_fd);
+        }
+        pthread_cond_destroy(&engine->idle_cond);
+        pthread_mutex_destroy(&engine->idle_lock);
+        pthread_mutex_destroy(&engine->streams_lock);
+        free(engine->stream_buckets);
+        free(engine->workers);
+        free(engine);
+    }
+}
+
+
+/**
+ * Submits a job
+ *
+ * @param engine The engine
+ * @param job    The job; its public members must be set
+ */
+void blowfish_engine_submit(bf_engine *engine, bf_engine_job *job)
+{
+    __atomic_add_fetch(&engine->active_jobs, 1, __ATOMIC_RELAXED);
+    // Counted before the job is visible, so that the counter never drops below zero
+    __atomic_add_fetch(&engine->queued_jobs, 1, __ATOMIC_SEQ_CST);
+    blowfish_engine_queue_push(&engine->submissions, job);
+    blowfish_engine_wake(engine, 1);
+}
+
+
+/**
+ * Takes completed jobs that have no callback
+ *
+ * @param engine    The engine
+ * @param jobs      Receives the completed jobs, in order of completion
+ * @param max_count Maximum number of jobs to take
+ * @return          Number of jobs taken
+ */
+size_t blowfish_engine_reap(bf_engine *engine, bf_engine_job *jobs[], size_t max_count)
+{
+    size_t count = 0;
+    while (count < max_count)
+    {
+        bf_engine_job *job = blowfish_engine_queue_pop(&engine->completions);
+        if (job == NULL)
+        {
+            break;
+        }
+        jobs[count] = job;
+        ++count;
+    }
+
+    return count;
+}
+
+
+/**
+ * Returns the engine's eventfd
+ *
+ * @param engine The engine
+ * @return       The eventfd, or -1 if the engine was created without BF_ENGINE_EVENTFD
+ */
+int blowfish_engine_eventfd(const bf_engine *engine)
+{
+    return engine->event_fd;
+}
+
+
+/**
+ * Runs tasks until the engine is stopped and all jobs are completed
+ *
+ * A worker runs its own newest task first. Without own tasks, it moves
+ * submitted jobs to their streams if no other worker is doing so, then
+ * steals the oldest task of another worker, and finally sleeps.
+ *
+ * @param arg The worker
+ * @return    NULL
+ */
+static void *blowfish_engine_worker_main(void *arg)
+{
+    bf_engine_worker *worker = arg;
+    bf_engine *engine = worker->engine;
+
+    while (1)
+    {
+        bf_engine_task *task = blowfish_engine_take_task(worker);
+        if (task == NULL && __atomic_load_n(&engine->queued_jobs, __ATOMIC_SEQ_CST) > 0 &&
+            !__atomic_load_n(&engine->dispatch_stalled, __ATOMIC_SEQ_CST) &&
+            !__atomic_exchange_n(&engine->dispatching, 1, __ATOMIC_ACQUIRE))
+        {
+            blowfish_engine_dispatch(worker);
+            __atomic_store_n(&engine->dispatching, 0, __ATOMIC_RELEASE);
+            continue;
+        }
+        if (task == NULL)
+        {
+            task = blowfish_engine_steal_task(worker);
+        }
+        if (task != NULL)
+        {
+            blowfish_engine_run_task(worker, task);
+            continue;
+        }
+
+        int done = 0;
+        pthread_mutex_lock(&engine->idle_lock);
+        __atomic_add_fetch(&engine->sleepers, 1, __ATOMIC_SEQ_CST);
+        while (!done && !blowfish_engine_has_work(engine))
+        {
+            if (__atomic_load_n(&engine->stop, __ATOMIC_SEQ_CST) &&
+                __atomic_load_n(&engine->active_jobs, __ATOMIC_SEQ_CST) == 0)
+            {
+                done = 1;
+            }
+            else
+            if (__atomic_load_n(&engine->dispatch_stalled, __ATOMIC_SEQ_CST))
+            {
+                // No stream object may ever be returned if no other job is in the
+                // engine, so the allocation is retried after a while
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += BF_ENGINE_RETRY_NS;
+                if (deadline.tv_nsec >= 1000000000L)
+                {
+                    deadline.tv_nsec -= 1000000000L;
+                    ++deadline.tv_sec;
+                }
+                if (pthread_cond_timedwait(&engine->idle_cond, &engine->idle_lock, &deadline) != 0)
+                {
+                    __atomic_store_n(&engine->dispatch_stalled, 0, __ATOMIC_SEQ_CST);
+                }
+            }
+            else
+            {
+                pthread_cond_wait(&engine->idle_cond, &engine->idle_lock);
+            }
+        }
+        __atomic_sub_fetch(&engine->sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&engine->idle_lock);
+
+        if (done)
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Moves submitted jobs to their streams and schedules those that can run
+ *
+ * A job can run if no earlier job of the same stream is in the engine,
+ * otherwise it waits for the earlier jobs to complete. If no stream object
+ * can be allocated for a job, the job and all jobs submitted after it stay
+ * queued and are dispatched again when a completed job returns its stream
+ * object, or after BF_ENGINE_RETRY_NS if none is returned. Meanwhile, idle
+ * workers sleep.
+ *
+ * @param worker The worker acting as the single consumer of the submission queue
+ */
+static void blowfish_engine_dispatch(bf_engine_worker *worker)
+{
+    bf_engine *engine = worker->engine;
+
+    bf_engine_job *job = engine->deferred_job;
+    engine->deferred_job = NULL;
+    if (job == NULL)
+    {
+        job = blowfish_engine_queue_pop(&engine->submissions);
+    }
+    for (; job != NULL; job = blowfish_engine_queue_pop(&engine->submissions))
+    {
+        int runnable = 0;
+        pthread_mutex_lock(&engine->streams_lock);
+        size_t bucket = blowfish_engine_stream_bucket(job->cfb_state);
+        bf_engine_stream *stream = engine->stream_buckets[bucket];
+        while (stream != NULL && stream->cfb_state != job->cfb_state)
+        {
+            stream = stream->next;
+        }
+        if (stream == NULL)
+        {
+            stream = engine->free_streams;
+            if (stream != NULL)
+            {
+                engine->free_streams = stream->next;
+            }
+            else
+            {
+                stream = malloc(sizeof (bf_engine_stream));
+                if (stream == NULL)
+                {
+                    // Running the job without a stream object would break the ordering of its stream;
+                    // set under the lock, so that a stream object returned later clears it
+                    __atomic_store_n(&engine->dispatch_stalled, 1, __ATOMIC_SEQ_CST);
+                    pthread_mutex_unlock(&engine->streams_lock);
+                    engine->deferred_job = job;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            job->stream_next = NULL;
+            if (stream->waiting_tail != NULL)
+            {
+                stream->waiting_tail->stream_next = job;
+            }
+            else
+            {
+                stream->waiting_head = job;
+            }
+            stream->waiting_tail = job;
+            job->stream = stream;
+            stream = NULL;
+            // Queued behind the running job of the stream
+            runnable = -1;
+        }
+
+        if (runnable == 0)
+        {
+            stream->cfb_state = job->cfb_state;
+            stream->waiting_head = NULL;
+            stream->waiting_tail = NULL;
+            stream->next = engine->stream_buckets[bucket];
+            engine->stream_buckets[bucket] = stream;
+            job->stream = stream;
+            runnable = 1;
+        }
+        pthread_mutex_unlock(&engine->streams_lock);
+
+        __atomic_sub_fetch(&engine->queued_jobs, 1, __ATOMIC_SEQ_CST);
+        if (runnable == 1)
+        {
+            blowfish_engine_schedule(worker, job);
+        }
+    }
+}
+
+
+/**
+ * Splits a job into tasks and adds them to a worker's queue
+ *
+ * Decryption jobs larger than one chunk are split on block boundaries. Each
+ * chunk's feedback is the cipher text block preceding it, which is read
+ * before any chunk is decrypted in-place.
+ *
+ * @param worker The worker
+ * @param job    A job that can run
+ */
+static void blowfish_engine_schedule(bf_engine_worker *worker, bf_engine_job *job)
+{
+    bf_engine *engine = worker->engine;
+    bf_cfb64_state *cfb_state = job->cfb_state;
+
+    size_t lead_length = 0;
+    size_t chunk_count = 1;
+    size_t full_blocks = 0;
+    if (job->operation == BF_ENGINE_CFB64_DECRYPT)
+    {
+        if (cfb_state->position > 0)
+        {
+            lead_length = BF_CFB64_BLOCK_SIZE - cfb_state->position;
+            if (lead_length > job->data_length)
+            {
+                lead_length = job->data_length;
+            }
+        }
+        full_blocks = (job->data_length - lead_length) / BF_CFB64_BLOCK_SIZE;
+        chunk_count = (full_blocks + BF_ENGINE_CHUNK_BLOCKS - 1) / BF_ENGINE_CHUNK_BLOCKS;
+    }
+
+    job->tasks = NULL;
+    if (chunk_count > 1)
+    {
+        job->tasks = malloc(sizeof (bf_engine_task) * chunk_count);
+    }
+    if (job->tasks == NULL)
+    {
+        // A single task, or out of memory
+        chunk_count = 1;
+        job->tasks = &job->task;
+    }
+    job->task_count = chunk_count;
+    job->tasks_remaining = chunk_count;
+
+    size_t data_offset = 0;
+    for (size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+    {
+        bf_engine_task *task = &job->tasks[chunk_index];
+        task->job = job;
+        task->data = &job->data[data_offset];
+        if (chunk_index == 0)
+        {
+            task->cfb_state = *cfb_state;
+        }
+        else
+        {
+            task->cfb_state.cipher_state = cfb_state->cipher_state;
+            task->cfb_state.feedback = blowfish_load_be64(&job->data[data_offset - BF_CFB64_BLOCK_SIZE]);
+            task->cfb_state.position = 0;
+        }
+
+        if (chunk_index + 1 < chunk_count)
+        {
+            task->data_length = BF_ENGINE_CHUNK_BLOCKS * BF_CFB64_BLOCK_SIZE;
+            if (chunk_index == 0)
+            {
+                task->data_length += lead_length;
+            }
+        }
+        else
+        {
+            // The last chunk also takes any incomplete block
+            task->data_length = job->data_length - data_offset;
+        }
+        data_offset += task->data_length;
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    for (size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+    {
+        bf_engine_task *task = &job->tasks[chunk_index];
+        task->next = NULL;
+        task->prev = worker->newest;
+        if (worker->newest != NULL)
+        {
+            worker->newest->next = task;
+        }
+        else
+        {
+            worker->oldest = task;
+        }
+        worker->newest = task;
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    __atomic_add_fetch(&engine->queued_tasks, chunk_count, __ATOMIC_SEQ_CST);
+    // The worker itself runs one of the tasks
+    blowfish_engine_wake(engine, chunk_count - 1);
+}
+
+
+/**
+ * Runs a task and completes its job if it was the job's last task
+ *
+ * @param worker The worker
+ * @param task   The task
+ */
+static void blowfish_engine_run_task(bf_engine_worker *worker, bf_engine_task *task)
+{
+    bf_engine_job *job = task->job;
+    switch (job->operation)
+    {
+        case BF_ENGINE_CFB64_ENCRYPT:
+            blowfish_cfb64_encrypt(&task->cfb_state, task->data, task->data_length);
+            break;
+        case BF_ENGINE_CFB64_DECRYPT:
+            blowfish_cfb64_decrypt(&task->cfb_state, task->data, task->data_length);
+            break;
+        default:
+            break;
+    }
+
+    if (__atomic_sub_fetch(&job->tasks_remaining, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        blowfish_engine_complete(worker, job);
+    }
+}
+
+
+/**
+ * Completes a job and schedules the next job of its stream
+ *
+ * The next job is scheduled after the completion has been delivered, so that
+ * completions of a stream are delivered in the order of submission.
+ *
+ * @param worker The worker
+ * @param job    The job whose tasks have all run
+ */
+static void blowfish_engine_complete(bf_engine_worker *worker, bf_engine_job *job)
+{
+    bf_engine *engine = worker->engine;
+
+    // The state after the last chunk is the state after the whole job
+    bf_engine_task *last_task = &job->tasks[job->task_count - 1];
+    job->cfb_state->feedback = last_task->cfb_state.feedback;
+    job->cfb_state->position = last_task->cfb_state.position;
+    if (job->tasks != &job->task)
+    {
+        free(job->tasks);
+    }
+    job->tasks = NULL;
+
+    // The job may be released by its owner as soon as it is delivered
+    bf_engine_stream *stream = job->stream;
+    if (job->callback != NULL)
+    {
+        job->callback(job, job->context);
+    }
+    else
+    {
+        blowfish_engine_queue_push(&engine->completions, job);
+        if (engine->event_fd != -1)
+        {
+            uint64_t increment = 1;
+            ssize_t rc = write(engine->event_fd, &increment, sizeof (increment));
+            (void) rc;
+        }
+    }
+
+    pthread_mutex_lock(&engine->streams_lock);
+    bf_engine_job *next_job = stream->waiting_head;
+    if (next_job != NULL)
+    {
+        stream->waiting_head = next_job->stream_next;
+        if (stream->waiting_head == NULL)
+        {
+            stream->waiting_tail = NULL;
+        }
+    }
+    else
+    {
+        // No more jobs for this stream, remove it from the table
+        size_t bucket = blowfish_engine_stream_bucket(stream->cfb_state);
+        bf_engine_stream **link = &engine->stream_buckets[bucket];
+        while (*link != stream)
+        {
+            link = &(*link)->next;
+        }
+        *link = stream->next;
+        stream->next = engine->free_streams;
+        engine->free_streams = stream;
+    }
+    // A returned stream object lets a deferred job be dispatched
+    int resume_dispatch = next_job == NULL &&
+                          __atomic_exchange_n(&engine->dispatch_stalled, 0, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&engine->streams_lock);
+    if (resume_dispatch)
+    {
+        blowfish_engine_wake(engine, 1);
+    }
+
+    if (next_job != NULL)
+    {
+        blowfish_engine_schedule(worker, next_job);
+    }
+
+    if (__atomic_sub_fetch(&engine->active_jobs, 1, __ATOMIC_SEQ_CST) == 0 &&
+        __atomic_load_n(&engine->stop, __ATOMIC_SEQ_CST))
+    {
+        // Lets the idle workers exit
+        pthread_mutex_lock(&engine->idle_lock);
+        pthread_cond_broadcast(&engine->idle_cond);
+        pthread_mutex_unlock(&engine->idle_lock);
+    }
+}
+
+
+/**
+ * Takes the newest task from a worker's own queue
+ *
+ * @param worker The worker
+ * @return       The task, or NULL if the queue is empty
+ */
+static bf_engine_task *blowfish_engine_take_task(bf_engine_worker *worker)
+{
+    pthread_mutex_lock(&worker->lock);
+    bf_engine_task *task = worker->newest;
+    if (task != NULL)
+    {
+        worker->newest = task->prev;
+        if (worker->newest != NULL)
+        {
+            worker->newest->next = NULL;
+        }
+        else
+        {
+            worker->oldest = NULL;
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    if (task != NULL)
+    {
+        __atomic_sub_fetch(&worker->engine->queued_tasks, 1, __ATOMIC_SEQ_CST);
+    }
+
+    return task;
+}
+
+
+/**
+ * Takes the oldest task from the queue of another worker
+ *
+ * @param worker The worker looking for work
+ * @return       The task, or NULL if all other queues are empty
+ */
+static bf_engine_task *blowfish_engine_steal_task(bf_engine_worker *worker)
+{
+    bf_engine *engine = worker->engine;
+    bf_engine_task *task = NULL;
+
+    for (size_t count = 1; task == NULL && count < engine->worker_count; ++count)
+    {
+        bf_engine_worker *victim = &engine->workers[(worker->index + count) % engine->worker_count];
+        pthread_mutex_lock(&victim->lock);
+        task = victim->oldest;
+        if (task != NULL)
+        {
+            victim->oldest = task->next;
+            if (victim->oldest != NULL)
+            {
+                victim->oldest->prev = NULL;
+            }
+            else
+            {
+                victim->newest = NULL;
+            }
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    if (task != NULL)
+    {
+        __atomic_sub_fetch(&engine->queued_tasks, 1, __ATOMIC_SEQ_CST);
+    }
+
+    return task;
+}
+
+
+/**
+ * Wakes idle workers
+ *
+ * The counters of queued work are updated before this is called, and an idle
+ * worker registers as a sleeper before it checks the counters, so either the
+ * worker sees the new work or this function sees the sleeper.
+ *
+ * @param engine The engine
+ * @param count  Number of workers to wake
+ */
+static void blowfish_engine_wake(bf_engine *engine, size_t count)
+{
+    if (count > 0 && __atomic_load_n(&engine->sleepers, __ATOMIC_SEQ_CST) > 0)
+    {
+        pthread_mutex_lock(&engine->idle_lock);
+        if (count > 1)
+        {
+            pthread_cond_broadcast(&engine->idle_cond);
+        }
+        else
+        {
+            pthread_cond_signal(&engine->idle_cond);
+        }
+        pthread_mutex_unlock(&engine->idle_lock);
+    }
+}
+
+
+/**
+ * Indicates whether there are submitted jobs that can be dispatched or queued tasks
+ *
+ * @param engine The engine
+ * @return       Non-zero if there is work, zero otherwise
+ */
+static int blowfish_engine_has_work(bf_engine *engine)
+{
+    return (__atomic_load_n(&engine->queued_jobs, __ATOMIC_SEQ_CST) > 0 &&
+            !__atomic_load_n(&engine->dispatch_stalled, __ATOMIC_SEQ_CST)) ||
+           __atomic_load_n(&engine->queued_tasks, __ATOMIC_SEQ_CST) > 0;
+}
+
+
+/**
+ * Selects the bucket of the stream table for a state object
+ *
+ * @param cfb_state The state object
+ * @return          The bucket index
+ */
+static size_t blowfish_engine_stream_bucket(const bf_cfb64_state *cfb_state)
+{
+    // The low bits of the address are the same for all objects of the same alignment
+    uint64_t hash = (uint64_t) (uintptr_t) cfb_state * 0x9E3779B97F4A7C15ULL;
+
+    return (size_t) (hash >> 32) & (BF_ENGINE_STREAM_BUCKETS - 1);
+}
+
+
+/**
+ * Initializes an empty queue
+ *
+ * @param queue The queue
+ */
+static void blowfish_engine_queue_init(bf_engine_queue *queue)
+{
+    queue->stub.queue_next = NULL;
+    queue->head = &queue->stub;
+    queue->tail = &queue->stub;
+}
+
+
+/**
+ * Appends a job to a queue; safe to call from multiple threads
+ *
+ * @param queue The queue
+ * @param job   The job
+ */
+static void blowfish_engine_queue_push(bf_engine_queue *queue, bf_engine_job *job)
+{
+    __atomic_store_n(&job->queue_next, NULL, __ATOMIC_RELAXED);
+    bf_engine_job *prev = __atomic_exchange_n(&queue->head, job, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->queue_next, job, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Removes the oldest job from a queue; may only be called by the consumer
+ *
+ * Between a producer's exchange of the head and the link of the previous
+ * job, the queue is briefly disconnected; the consumer then waits for the
+ * link rather than reporting the queue as empty.
+ *
+ * @param queue The queue
+ * @return      The job, or NULL if the queue is empty
+ */
+static bf_engine_job *blowfish_engine_queue_pop(bf_engine_queue *queue)
+{
+    while (1)
+    {
+        bf_engine_job *tail = queue->tail;
+        bf_engine_job *next = __atomic_load_n(&tail->queue_next, __ATOMIC_ACQUIRE);
+        if (tail == &queue->stub)
+        {
+            if (next == NULL)
+            {
+                if (__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == tail)
+                {
+                    return NULL;
+                }
+                sched_yield();
+                continue;
+            }
+            queue->tail = next;
+            tail = next;
+            next = __atomic_load_n(&tail->queue_next, __ATOMIC_ACQUIRE);
+        }
+
+        if (next != NULL)
+        {
+            queue->tail = next;
+            return tail;
+        }
+
+        if (__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == tail)
+        {
+            // The last job is taken by re-inserting the stub behind it
+            blowfish_engine_queue_push(queue, &queue->stub);
+            next = __atomic_load_n(&tail->queue_next, __ATOMIC_ACQUIRE);
+            if (next != NULL)
+            {
+                queue->tail = next;
+                return tail;
+            }
+        }
+        sched_yield();
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef BLOWFISH_ENGINE_H
+#define	BLOWFISH_ENGINE_H
+
+#include <blowfish_cfb64.h>
+
+// Create an eventfd that is signaled for each job completed without a callback
+#define BF_ENGINE_EVENTFD 0x1
+
+typedef struct bf_engine_s bf_engine;
+
+typedef struct bf_engine_job_s bf_engine_job;
+
+typedef struct bf_engine_task_s bf_engine_task;
+
+typedef struct bf_engine_stream_s bf_engine_stream;
+
+typedef void (*bf_engine_callback)(bf_engine_job *job, void *context);
+
+enum bf_engine_operation_e
+{
+    BF_ENGINE_CFB64_ENCRYPT,
+    BF_ENGINE_CFB64_DECRYPT
+};
+typedef enum bf_engine_operation_e bf_engine_operation;
+
+// A part of a job that is run by one worker; private to the engine
+struct bf_engine_task_s
+{
+    bf_engine_job  *job;
+    bf_cfb64_state cfb_state;
+    unsigned char  *data;
+    size_t         data_length;
+    bf_engine_task *prev;
+    bf_engine_task *next;
+};
+
+/*
+ * An encryption or decryption request
+ *
+ * The caller sets the public members and keeps the job object and the data
+ * valid until the job is completed. Jobs for the same bf_cfb64_state object
+ * are run, and completed, in the order of their submission. The state object
+ * must not be used outside of the engine while it has jobs in the engine.
+ */
+struct bf_engine_job_s
+{
+    bf_engine_operation operation;
+    bf_cfb64_state      *cfb_state;
+    unsigned char       *data;
+    size_t              data_length;
+    // Called by a worker thread when the job is completed; if NULL, the job
+    // is queued for blowfish_engine_reap() instead
+    bf_engine_callback  callback;
+    void                *context;
+
+    // Private to the engine
+    bf_engine_job       *queue_next;
+    bf_engine_job       *stream_next;
+    bf_engine_stream    *stream;
+    bf_engine_task      *tasks;
+    size_t              task_count;
+    size_t              tasks_remaining;
+    bf_engine_task      task;
+};
+
+/**
+ * Creates an engine that runs jobs on a pool of worker threads
+ *
+ * Jobs are submitted through a lock-free queue. Large decryption jobs are
+ * split into chunks; idle workers steal chunks and jobs from busy workers.
+ *
+ * @param worker_count Number of worker threads; 0 selects the number of online CPUs
+ * @param flags        0 or BF_ENGINE_EVENTFD
+ * @return             The new engine, or NULL if out of resources
+ */
+bf_engine *blowfish_engine_create(size_t worker_count, unsigned int flags);
+
+/**
+ * Completes all submitted jobs, stops the worker threads and destroys an engine
+ *
+ * Completed jobs that have not been reaped are discarded.
+ *
+ * @param engine The engine to destroy
+ */
+void blowfish_engine_destroy(bf_engine *engine);
+
+/**
+ * Submits a job
+ *
+ * Lock-free and safe to call from any number of threads concurrently.
+ *
+ * @param engine The engine
+ * @param job    The job; its public members must be set
+ */
+void blowfish_engine_submit(bf_engine *engine, bf_engine_job *job);
+
+/**
+ * Takes completed jobs that have no callback
+ *
+ * Only one thread at a time may reap the jobs of an engine.
+ *
+ * @param engine    The engine
+ * @param jobs      Receives the completed jobs, in order of completion
+ * @param max_count Maximum number of jobs to take
+ * @return          Number of jobs taken
+ */
+size_t blowfish_engine_reap(bf_engine *engine, bf_engine_job *jobs[], size_t max_count);
+
+/**
+ * Returns the engine's eventfd
+ *
+ * The eventfd becomes readable when a job without a callback is completed,
+ * so it can be added to an epoll set. After reading it, the owner should call
+ * blowfish_engine_reap() until it returns fewer jobs than requested.
+ *
+ * @param engine The engine
+ * @return       The eventfd, or -1 if the engine was created without BF_ENGINE_EVENTFD
+ */
+int blowfish_engine_eventfd(const bf_engine *engine);
+
+#endif	/* BLOWFISH_ENGINE_H */
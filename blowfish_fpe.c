@@ -0,0 +1,294 @@
+/**
+ * Format-preserving encryption of integers in arbitrary ranges
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <blowfish_fpe.h>
+
+// Number of Feistel rounds, each keyed with a P box entry
+#define BF_FPE_ROUNDS 16
+
+// Number of values permuted in lockstep by the batch functions
+#define BF_FPE_LANES 16
+
+static inline uint32_t blowfish_fpe_f(const bf_state *state, uint32_t value);
+static inline uint64_t blowfish_fpe_permute(const bf_fpe *fpe, uint64_t value, int decrypt);
+static void blowfish_fpe_process_values(const bf_fpe *fpe, const uint64_t *input, uint64_t *output,
+                                        size_t value_count, int decrypt);
+
+
+/**
+ * Initializes a format-preserving permutation of the integers 0 to domain_size - 1
+ *
+ * @param fpe          The object to initialize
+ * @param state        Cipher state object
+ * @param domain_size  Number of values in the domain, at least 1
+ * @return             0 on success, -1 if domain_size is 0
+ */
+int blowfish_fpe_init(bf_fpe *fpe, const bf_state *state, uint64_t domain_size)
+{
+    if (domain_size == 0)
+    {
+        return -1;
+    }
+
+    // Width of the largest value; at least 2 bits, so that both parts are non-empty
+    unsigned int bits = 2;
+    while (bits < 64 && (domain_size - 1) >> bits != 0)
+    {
+        ++bits;
+    }
+
+    fpe->cipher_state = state;
+    fpe->domain_size  = domain_size;
+    fpe->left_bits    = bits / 2;
+    fpe->right_bits   = bits - fpe->left_bits;
+    fpe->left_mask    = (UINT64_C(1) << fpe->left_bits) - 1;
+    fpe->right_mask   = (UINT64_C(1) << fpe->right_bits) - 1;
+
+    return 0;
+}
+
+
+/**
+ * Encrypts a value within the domain
+ *
+ * @param fpe   The permutation
+ * @param value The value to encrypt, less than the domain size
+ * @return      The encrypted value, less than the domain size
+ */
+uint64_t blowfish_fpe_encrypt(const bf_fpe *fpe, uint64_t value)
+{
+    // The walk only terminates for values within the domain
+    if (value < fpe->domain_size)
+    {
+        do
+        {
+            value = blowfish_fpe_permute(fpe, value, 0);
+        }
+        while (value >= fpe->domain_size);
+    }
+
+    return value;
+}
+
+
+/**
+ * Decrypts a value within the domain
+ *
+ * @param fpe   The permutation
+ * @param value The value to decrypt, less than the domain size
+ * @return      The decrypted value
+ */
+uint64_t blowfish_fpe_decrypt(const bf_fpe *fpe, uint64_t value)
+{
+    if (value < fpe->domain_size)
+    {
+        do
+        {
+            value = blowfish_fpe_permute(fpe, value, 1);
+        }
+        while (value >= fpe->domain_size);
+    }
+
+    return value;
+}
+
+
+/**
+ * Encrypts an array of values within the domain
+ *
+ * @param fpe         The permutation
+ * @param input       The values to encrypt
+ * @param output      Receives the encrypted values
+ * @param value_count Number of values
+ */
+void blowfish_fpe_encrypt_values(const bf_fpe *fpe, const uint64_t *input, uint64_t *output,
+                                 size_t value_count)
+{
+    blowfish_fpe_process_values(fpe, input, output, value_count, 0);
+}
+
+
+/**
+ * Decrypts an array of values within the domain
+ *
+ * @param fpe         The permutation
+ * @param input       The values to decrypt
+ * @param output      Receives the decrypted values
+ * @param value_count Number of values
+ */
+void blowfish_fpe_decrypt_values(const bf_fpe *fpe, const uint64_t *input, uint64_t *output,
+                                 size_t value_count)
+{
+    blowfish_fpe_process_values(fpe, input, output, value_count, 1);
+}
+
+
+/**
+ * The Blowfish algorithm's "F" function
+ *
+ * @param state The cipher state object
+ * @param value The input value to operate on
+ * @return      The result of the "F" function
+ */
+static inline uint32_t blowfish_fpe_f(const bf_state *state, uint32_t value)
+{
+    uint32_t result = state->s_box[0][value >> 24];
+    result += state->s_box[1][(value >> 16) & 0xFF];
+    result ^= state->s_box[2][(value >>  8) & 0xFF];
+    result += state->s_box[3][value & 0xFF];
+
+    return result;
+}
+
+
+/**
+ * Applies the Feistel network once
+ *
+ * Even rounds modify the low part based on the high part, odd rounds the
+ * high part based on the low part. Each round is its own inverse, so
+ * decryption runs the same rounds in reverse order. The parts are at most
+ * 32 bits wide.
+ *
+ * @param fpe     The permutation
+ * @param value   The value to permute, less than 2 to the power of the total width
+ * @param decrypt Non-zero to apply the inverse permutation
+ * @return        The permuted value, which may lie outside of the domain
+ */
+static inline uint64_t blowfish_fpe_permute(const bf_fpe *fpe, uint64_t value, int decrypt)
+{
+    const bf_state *state = fpe->cipher_state;
+    uint32_t left  = (uint32_t) (value >> fpe->right_bits);
+    uint32_t right = (uint32_t) (value & fpe->right_mask);
+
+    for (size_t counter = 0; counter < BF_FPE_ROUNDS; ++counter)
+    {
+        size_t round = decrypt ? BF_FPE_ROUNDS - 1 - counter : counter;
+        if (round % 2 == 0)
+        {
+            right ^= blowfish_fpe_f(state, left ^ state->p_box[round]) & (uint32_t) fpe->right_mask;
+        }
+        else
+        {
+            left ^= blowfish_fpe_f(state, right ^ state->p_box[round]) & (uint32_t) fpe->left_mask;
+        }
+    }
+
+    return ((uint64_t) left << fpe->right_bits) | right;
+}
+
+
+/**
+ * Encrypts or decrypts an array of values, walking many values in lockstep
+ *
+ * Each lane holds a value that is permuted round by round together with the
+ * other lanes, so that the S box lookups of different values overlap. After
+ * each permutation, lanes whose value fell into the domain store it and take
+ * the next input value; the other lanes walk on.
+ *
+ * @param fpe         The permutation
+ * @param input       The input values
+ * @param output      Receives the output values
+ * @param value_count Number of values
+ * @param decrypt     Non-zero to decrypt, zero to encrypt
+ */
+static void blowfish_fpe_process_values(const bf_fpe *fpe, const uint64_t *input, uint64_t *output,
+                                        size_t value_count, int decrypt)
+{
+    const bf_state *state = fpe->cipher_state;
+    uint32_t left[BF_FPE_LANES];
+    uint32_t right[BF_FPE_LANES];
+    size_t lane_indexes[BF_FPE_LANES];
+    uint32_t left_mask  = (uint32_t) fpe->left_mask;
+    uint32_t right_mask = (uint32_t) fpe->right_mask;
+
+    size_t next_index = 0;
+    size_t lane_count = 0;
+    while (lane_count > 0 || next_index < value_count)
+    {
+        // Refill the free lanes; values outside of the domain are copied unchanged
+        while (lane_count < BF_FPE_LANES && next_index < value_count)
+        {
+            uint64_t value = input[next_index];
+            if (value < fpe->domain_size)
+            {
+                left[lane_count]  = (uint32_t) (value >> fpe->right_bits);
+                right[lane_count] = (uint32_t) (value & fpe->right_mask);
+                lane_indexes[lane_count] = next_index;
+                ++lane_count;
+            }
+            else
+            {
+                output[next_index] = value;
+            }
+            ++next_index;
+        }
+
+        for (size_t counter = 0; counter < BF_FPE_ROUNDS; ++counter)
+        {
+            size_t round = decrypt ? BF_FPE_ROUNDS - 1 - counter : counter;
+            uint32_t round_key = state->p_box[round];
+            if (round % 2 == 0)
+            {
+                for (size_t lane = 0; lane < lane_count; ++lane)
+                {
+                    right[lane] ^= blowfish_fpe_f(state, left[lane] ^ round_key) & right_mask;
+                }
+            }
+            else
+            {
+                for (size_t lane = 0; lane < lane_count; ++lane)
+                {
+                    left[lane] ^= blowfish_fpe_f(state, right[lane] ^ round_key) & left_mask;
+                }
+            }
+        }
+
+        // Retire the lanes that are done, moving the last lane into each freed slot
+        size_t lane = 0;
+        while (lane < lane_count)
+        {
+            uint64_t value = ((uint64_t) left[lane] << fpe->right_bits) | right[lane];
+            if (value < fpe->domain_size)
+            {
+                output[lane_indexes[lane]] = value;
+                --lane_count;
+                left[lane]  = left[lane_count];
+                right[lane] = right[lane_count];
+                lane_indexes[lane] = lane_indexes[lane_count];
+            }
+            else
+            {
+                ++lane;
+            }
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef BLOWFISH_FPE_H
+#define	BLOWFISH_FPE_H
+
+#include <blowfish.h>
+
+typedef struct bf_fpe_s bf_fpe;
+struct bf_fpe_s
+{
+    const bf_state *cipher_state;
+    uint64_t       domain_size;
+    // The permuted value is split into a high part of left_bits and a low part of right_bits
+    unsigned int   left_bits;
+    unsigned int   right_bits;
+    uint64_t       left_mask;
+    uint64_t       right_mask;
+};
+
+/**
+ * Initializes a format-preserving permutation of the integers 0 to domain_size - 1
+ *
+ * Values are permuted by an alternating Feistel network over the smallest
+ * number of bits that holds domain_size - 1, using the Blowfish "F" function
+ * with the S boxes of the cipher state and a P box entry as the round key.
+ * Results outside of the domain are permuted again until they fall into it
+ * (cycle walking). Since the bit width is at most twice the domain size,
+ * a value takes less than 2 permutations on average.
+ *
+ * @param fpe          The object to initialize
+ * @param state        Cipher state object; must remain valid while fpe is in use
+ * @param domain_size  Number of values in the domain, at least 1
+ * @return             0 on success, -1 if domain_size is 0
+ */
+int blowfish_fpe_init(bf_fpe *fpe, const bf_state *state, uint64_t domain_size);
+
+/**
+ * Encrypts a value within the domain
+ *
+ * @param fpe   The permutation
+ * @param value The value to encrypt, less than the domain size
+ * @return      The encrypted value, less than the domain size; values outside of
+ *              the domain are returned unchanged
+ */
+uint64_t blowfish_fpe_encrypt(const bf_fpe *fpe, uint64_t value);
+
+/**
+ * Decrypts a value within the domain
+ *
+ * @param fpe   The permutation
+ * @param value The value to decrypt, less than the domain size
+ * @return      The decrypted value; values outside of the domain are returned unchanged
+ */
+uint64_t blowfish_fpe_decrypt(const bf_fpe *fpe, uint64_t value);
+
+/**
+ * Encrypts an array of values within the domain
+ *
+ * The result is the same as that of blowfish_fpe_encrypt() for each value.
+ * Many values are permuted in lockstep, and a value that needs another
+ * walk step keeps its lane while finished lanes are refilled, so that values
+ * with long walks do not hold up the others.
+ *
+ * @param fpe         The permutation
+ * @param input       The values to encrypt
+ * @param output      Receives the encrypted values; may be the same array as input
+ * @param value_count Number of values
+ */
+void blowfish_fpe_encrypt_values(const bf_fpe *fpe, const uint64_t *input, uint64_t *output,
+                                 size_t value_count);
+
+/**
+ * Decrypts an array of values within the domain
+ *
+ * @param fpe         The permutation
+ * @param input       The values to decrypt
+ * @param output      Receives the decrypted values; may be the same array as input
+ * @param value_count Number of values
+ */
+void blowfish_fpe_decrypt_values(const bf_fpe *fpe, const uint64_t *input, uint64_t *output,
+                                 size_t value_count);
+
+#endif	/* BLOWFISH_FPE_H */
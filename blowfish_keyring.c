@@ -0,0 +1,662 @@
+/**
+ * Keyring with a bounded cache of expanded key schedules
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish_keyring.h>
+#include <pthread.h>
+#include <string.h>
+
+// Maximum key length in bytes (56 == 448 bits)
+#define BF_KEYRING_MAX_KEY_LENGTH 56
+
+// Slot index value of a key that has no cached key schedule
+const uint32_t BF_KEYRING_NO_SLOT = UINT32_MAX;
+
+// Number of shards selected if the caller does not specify a shard count
+const size_t BF_KEYRING_DEFAULT_SHARDS = 16;
+
+// Initial capacity of each shard's key table, must be a power of two
+const size_t BF_KEYRING_INITIAL_CAPACITY = 16;
+
+// Cache line size used for the alignment of shards and cache slots
+const size_t BF_KEYRING_ALIGNMENT = 64;
+
+typedef struct bf_keyring_entry_s bf_keyring_entry;
+struct bf_keyring_entry_s
+{
+    uint64_t      key_id;
+    uint32_t      slot_index;
+    uint8_t       key_length;
+    uint8_t       used;
+    unsigned char key[BF_KEYRING_MAX_KEY_LENGTH];
+};
+
+typedef struct bf_keyring_shard_s bf_keyring_shard;
+
+typedef struct bf_keyring_slot_s bf_keyring_slot;
+struct bf_keyring_slot_s
+{
+    // Must be the first member, see blowfish_keyring_release()
+    bf_state         state;
+    bf_keyring_shard *shard;
+    uint64_t         key_id;
+    uint32_t         pin_count;
+    // Set on each use, cleared by the clock hand
+    uint8_t          referenced;
+    // Set while the slot holds the key schedule of a key in the key table
+    uint8_t          valid;
+    // Set while the key schedule is being expanded
+    uint8_t          loading;
+    // Set for key schedules allocated outside of the cache
+    uint8_t          transient;
+};
+
+struct bf_keyring_shard_s
+{
+    pthread_mutex_t  lock;
+    pthread_cond_t   loaded;
+    bf_keyring_entry *entries;
+    size_t           capacity;
+    size_t           key_count;
+    bf_keyring_slot  *slots;
+    size_t           slot_count;
+    size_t           clock_hand;
+    uint64_t         hits;
+    uint64_t         misses;
+    uint64_t         evictions;
+};
+
+struct bf_keyring_s
+{
+    bf_keyring_shard *shards;
+    size_t           shard_count;
+};
+
+static uint64_t blowfish_keyring_hash(uint64_t key_id);
+static bf_keyring_shard *blowfish_keyring_shard(bf_keyring *keyring, uint64_t key_id);
+static bf_keyring_entry *blowfish_keyring_find(bf_keyring_shard *shard, uint64_t key_id);
+static bf_keyring_entry *blowfish_keyring_insert_slot(
+    bf_keyring_entry *entries,
+    size_t           capacity,
+    uint64_t         key_id
+);
+static int blowfish_keyring_grow(bf_keyring_shard *shard);
+static void blowfish_keyring_erase(bf_keyring_shard *shard, bf_keyring_entry *entry);
+static bf_keyring_slot *blowfish_keyring_evict(bf_keyring_shard *shard);
+static bf_keyring_slot *blowfish_keyring_transient(bf_keyring_shard *shard);
+static int blowfish_keyring_shard_init(bf_keyring_shard *shard, size_t slot_count);
+static void blowfish_keyring_shard_destroy(bf_keyring_shard *shard);
+
+
+/**
+ * Creates a new keyring
+ *
+ * @param cache_size  Maximum number of key schedules held in the cache
+ * @param shard_count Number of shards; 0 selects a default
+ * @return            The new keyring, or NULL if out of memory
+ */
+bf_keyring *blowfish_keyring_create(size_t cache_size, size_t shard_count)
+{
+    if (shard_count == 0)
+    {
+        shard_count = BF_KEYRING_DEFAULT_SHARDS;
+    }
+    if (cache_size < shard_count)
+    {
+        // Each shard needs at least one cache slot
+        shard_count = cache_size > 0 ? cache_size : 1;
+    }
+
+    bf_keyring *keyring = malloc(sizeof (bf_keyring));
+    if (keyring == NULL)
+    {
+        return NULL;
+    }
+
+    void *shards = NULL;
+    if (posix_memalign(&shards, BF_KEYRING_ALIGNMENT, sizeof (bf_keyring_shard) * shard_count) != 0)
+    {
+        free(keyring);
+        return NULL;
+    }
+    keyring->shards      = shards;
+    keyring->shard_count = 0;
+
+    // Distribute the cache slots evenly, the first shards receive the remainder
+    size_t slots_per_shard = cache_size / shard_count;
+    size_t slots_remainder = cache_size % shard_count;
+    for (size_t index = 0; index < shard_count; ++index)
+    {
+        size_t slot_count = slots_per_shard + (index < slots_remainder ? 1 : 0);
+        if (slot_count == 0)
+        {
+            slot_count = 1;
+        }
+        if (blowfish_keyring_shard_init(&keyring->shards[index], slot_count) != 0)
+        {
+            blowfish_keyring_destroy(keyring);
+            return NULL;
+        }
+        ++keyring->shard_count;
+    }
+
+    return keyring;
+}
+
+
+/**
+ * Destroys a keyring, clearing all keys and key schedules
+ *
+ * @param keyring The keyring to destroy
+ */
+void blowfish_keyring_destroy(bf_keyring *keyring)
+{
+    if (keyring != NULL)
+    {
+        for (size_t index = 0; index < keyring->shard_count; ++index)
+        {
+            blowfish_keyring_shard_destroy(&keyring->shards[index]);
+        }
+        free(keyring->shards);
+        free(keyring);
+    }
+}
+
+
+/**
+ * Adds a key to the keyring
+ *
+ * @param keyring    The keyring
+ * @param key_id     Identifier of the key
+ * @param key        The key
+ * @param key_length The length of the key, 1 to 56 bytes
+ * @return           0 on success, -1 if the key length is invalid, the key_id
+ *                   is already in use, or out of memory
+ */
+int blowfish_keyring_add(bf_keyring *keyring, uint64_t key_id,
+                         const unsigned char *key, size_t key_length)
+{
+    if (key_length < 1 || key_length > BF_KEYRING_MAX_KEY_LENGTH)
+    {
+        return -1;
+    }
+
+    int rc = -1;
+    bf_keyring_shard *shard = blowfish_keyring_shard(keyring, key_id);
+    pthread_mutex_lock(&shard->lock);
+    if (blowfish_keyring_find(shard, key_id) == NULL)
+    {
+        // Keep the load factor of the key table at or below 3/4
+        if ((shard->key_count + 1) * 4 <= shard->capacity * 3 || blowfish_keyring_grow(shard) == 0)
+        {
+            bf_keyring_entry *entry = blowfish_keyring_insert_slot(shard->entries, shard->capacity, key_id);
+            entry->key_id     = key_id;
+            entry->slot_index = BF_KEYRING_NO_SLOT;
+            entry->key_length = (uint8_t) key_length;
+            entry->used       = 1;
+            memcpy(entry->key, key, key_length);
+            ++shard->key_count;
+            rc = 0;
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return rc;
+}
+
+
+/**
+ * Removes a key from the keyring
+ *
+ * @param keyring The keyring
+ * @param key_id  Identifier of the key
+ * @return        0 on success, -1 if the key_id is not in use
+ */
+int blowfish_keyring_remove(bf_keyring *keyring, uint64_t key_id)
+{
+    int rc = -1;
+    bf_keyring_shard *shard = blowfish_keyring_shard(keyring, key_id);
+    pthread_mutex_lock(&shard->lock);
+    bf_keyring_entry *entry = blowfish_keyring_find(shard, key_id);
+    if (entry != NULL)
+    {
+        if (entry->slot_index != BF_KEYRING_NO_SLOT)
+        {
+            // Pinned key schedules remain usable, the slot is reused once released
+            bf_keyring_slot *slot = &shard->slots[entry->slot_index];
+            slot->valid      = 0;
+            slot->referenced = 0;
+            if (slot->pin_count == 0)
+            {
+                blowfish_clear(&slot->state);
+            }
+        }
+        blowfish_keyring_erase(shard, entry);
+        rc = 0;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return rc;
+}
+
+
+/**
+ * Returns the key schedule for a key, expanding it if it is not cached
+ *
+ * @param keyring The keyring
+ * @param key_id  Identifier of the key
+ * @return        The key schedule, or NULL if the key_id is not in use or out of memory
+ */
+const bf_state *blowfish_keyring_acquire(bf_keyring *keyring, uint64_t key_id)
+{
+    bf_keyring_shard *shard = blowfish_keyring_shard(keyring, key_id);
+    pthread_mutex_lock(&shard->lock);
+    bf_keyring_entry *entry = blowfish_keyring_find(shard, key_id);
+    if (entry == NULL)
+    {
+        pthread_mutex_unlock(&shard->lock);
+        return NULL;
+    }
+
+    bf_keyring_slot *slot = NULL;
+    if (entry->slot_index != BF_KEYRING_NO_SLOT)
+    {
+        slot = &shard->slots[entry->slot_index];
+        ++slot->pin_count;
+        slot->referenced = 1;
+        ++shard->hits;
+        // Another thread may still be expanding the key schedule
+        while (slot->loading)
+        {
+            pthread_cond_wait(&shard->loaded, &shard->lock);
+        }
+        pthread_mutex_unlock(&shard->lock);
+        return &slot->state;
+    }
+
+    ++shard->misses;
+    slot = blowfish_keyring_evict(shard);
+    if (slot != NULL)
+    {
+        if (slot->valid)
+        {
+            bf_keyring_entry *evicted = blowfish_keyring_find(shard, slot->key_id);
+            evicted->slot_index = BF_KEYRING_NO_SLOT;
+            ++shard->evictions;
+        }
+        slot->key_id     = key_id;
+        slot->pin_count  = 1;
+        slot->referenced = 1;
+        slot->valid      = 1;
+        slot->loading    = 1;
+        entry->slot_index = (uint32_t) (slot - shard->slots);
+    }
+    else
+    {
+        // All cache slots are pinned
+        slot = blowfish_keyring_transient(shard);
+        if (slot == NULL)
+        {
+            pthread_mutex_unlock(&shard->lock);
+            return NULL;
+        }
+    }
+
+    // The entry may move once the lock is released, so copy the key first
+    unsigned char key[BF_KEYRING_MAX_KEY_LENGTH];
+    size_t key_length = entry->key_length;
+    memcpy(key, entry->key, key_length);
+    pthread_mutex_unlock(&shard->lock);
+
+    // Expanding the key schedule is expensive, other keys of the shard
+    // remain accessible in the meantime
+    blowfish_init(&slot->state);
+    blowfish_set_key(&slot->state, key, key_length);
+    memset(key, 0, sizeof (key));
+
+    if (!slot->transient)
+    {
+        pthread_mutex_lock(&shard->lock);
+        slot->loading = 0;
+        pthread_cond_broadcast(&shard->loaded);
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return &slot->state;
+}
+
+
+/**
+ * Releases a key schedule returned by blowfish_keyring_acquire()
+ *
+ * @param keyring The keyring
+ * @param state   The key schedule to release
+ */
+void blowfish_keyring_release(bf_keyring *keyring, const bf_state *state)
+{
+    (void) keyring;
+
+    bf_keyring_slot *slot = (bf_keyring_slot *) state;
+    if (slot->transient)
+    {
+        blowfish_clear(&slot->state);
+        free(slot);
+    }
+    else
+    {
+        bf_keyring_shard *shard = slot->shard;
+        pthread_mutex_lock(&shard->lock);
+        --slot->pin_count;
+        if (slot->pin_count == 0 && !slot->valid)
+        {
+            // The key was removed while the key schedule was in use
+            blowfish_clear(&slot->state);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+
+/**
+ * Returns the keyring's counters
+ *
+ * @param keyring The keyring
+ * @param stats   Receives the sum of the counters of all shards
+ */
+void blowfish_keyring_stats(bf_keyring *keyring, bf_keyring_stats *stats)
+{
+    memset(stats, 0, sizeof (bf_keyring_stats));
+    for (size_t index = 0; index < keyring->shard_count; ++index)
+    {
+        bf_keyring_shard *shard = &keyring->shards[index];
+        pthread_mutex_lock(&shard->lock);
+        stats->key_count += shard->key_count;
+        for (size_t slot_index = 0; slot_index < shard->slot_count; ++slot_index)
+        {
+            if (shard->slots[slot_index].valid)
+            {
+                ++stats->cached_count;
+            }
+        }
+        stats->hits      += shard->hits;
+        stats->misses    += shard->misses;
+        stats->evictions += shard->evictions;
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+
+/**
+ * Mixes the bits of a key identifier
+ *
+ * Uses the finalizer of the SplitMix64 generator, so that sequential
+ * key identifiers are spread evenly over shards and key table positions.
+ *
+ * @param key_id Identifier of the key
+ * @return       Hash value of the key identifier
+ */
+static uint64_t blowfish_keyring_hash(uint64_t key_id)
+{
+    uint64_t hash = key_id;
+    hash = (hash ^ (hash >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    hash = (hash ^ (hash >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return hash ^ (hash >> 31);
+}
+
+
+/**
+ * Returns the shard responsible for a key
+ *
+ * The shard is selected by the upper half of the hash value, the
+ * position in the shard's key table by the lower half.
+ *
+ * @param keyring The keyring
+ * @param key_id  Identifier of the key
+ * @return        The shard
+ */
+static bf_keyring_shard *blowfish_keyring_shard(bf_keyring *keyring, uint64_t key_id)
+{
+    uint64_t hash = blowfish_keyring_hash(key_id);
+    return &keyring->shards[(size_t) ((hash >> 32) % keyring->shard_count)];
+}
+
+
+/**
+ * Finds a key in a shard's key table
+ *
+ * @param shard  The shard, must be locked
+ * @param key_id Identifier of the key
+ * @return       The key table entry, or NULL if the key is not in the table
+ */
+static bf_keyring_entry *blowfish_keyring_find(bf_keyring_shard *shard, uint64_t key_id)
+{
+    size_t mask = shard->capacity - 1;
+    size_t position = (size_t) blowfish_keyring_hash(key_id) & mask;
+    while (shard->entries[position].used)
+    {
+        if (shard->entries[position].key_id == key_id)
+        {
+            return &shard->entries[position];
+        }
+        position = (position + 1) & mask;
+    }
+    return NULL;
+}
+
+
+/**
+ * Returns the free key table entry at which a key is inserted
+ *
+ * @param entries  The key table
+ * @param capacity Capacity of the key table, must be a power of two
+ * @param key_id   Identifier of the key
+ * @return         The free key table entry
+ */
+static bf_keyring_entry *blowfish_keyring_insert_slot(
+    bf_keyring_entry *entries,
+    size_t           capacity,
+    uint64_t         key_id
+)
+{
+    size_t mask = capacity - 1;
+    size_t position = (size_t) blowfish_keyring_hash(key_id) & mask;
+    while (entries[position].used)
+    {
+        position = (position + 1) & mask;
+    }
+    return &entries[position];
+}
+
+
+/**
+ * Doubles the capacity of a shard's key table
+ *
+ * @param shard The shard, must be locked
+ * @return      0 on success, -1 if out of memory
+ */
+static int blowfish_keyring_grow(bf_keyring_shard *shard)
+{
+    size_t capacity = shard->capacity * 2;
+    bf_keyring_entry *entries = calloc(capacity, sizeof (bf_keyring_entry));
+    if (entries == NULL)
+    {
+        return -1;
+    }
+
+    for (size_t index = 0; index < shard->capacity; ++index)
+    {
+        bf_keyring_entry *entry = &shard->entries[index];
+        if (entry->used)
+        {
+            *blowfish_keyring_insert_slot(entries, capacity, entry->key_id) = *entry;
+        }
+    }
+
+    memset(shard->entries, 0, sizeof (bf_keyring_entry) * shard->capacity);
+    free(shard->entries);
+    shard->entries  = entries;
+    shard->capacity = capacity;
+    return 0;
+}
+
+
+/**
+ * Removes an entry from a shard's key table
+ *
+ * Entries following the removed entry are shifted back, so that the
+ * table does not require deletion markers.
+ *
+ * @param shard The shard, must be locked
+ * @param entry The entry to remove
+ */
+static void blowfish_keyring_erase(bf_keyring_shard *shard, bf_keyring_entry *entry)
+{
+    size_t mask = shard->capacity - 1;
+    size_t hole = (size_t) (entry - shard->entries);
+    size_t position = (hole + 1) & mask;
+    while (shard->entries[position].used)
+    {
+        size_t home = (size_t) blowfish_keyring_hash(shard->entries[position].key_id) & mask;
+        // Move the entry into the hole unless its home position lies
+        // cyclically between the hole and its current position
+        if (((position - home) & mask) >= ((position - hole) & mask))
+        {
+            shard->entries[hole] = shard->entries[position];
+            hole = position;
+        }
+        position = (position + 1) & mask;
+    }
+    memset(&shard->entries[hole], 0, sizeof (bf_keyring_entry));
+    --shard->key_count;
+}
+
+
+/**
+ * Selects the cache slot for a new key schedule
+ *
+ * Implements the CLOCK approximation of LRU eviction: the clock hand passes
+ * over slots that were used since its last pass, clearing their referenced
+ * flag, and stops at the first unpinned slot that was not.
+ *
+ * @param shard The shard, must be locked
+ * @return      The cache slot, or NULL if all slots are pinned
+ */
+static bf_keyring_slot *blowfish_keyring_evict(bf_keyring_shard *shard)
+{
+    // Two passes clear all referenced flags and visit each slot once more
+    for (size_t step = 0; step < shard->slot_count * 2; ++step)
+    {
+        bf_keyring_slot *slot = &shard->slots[shard->clock_hand];
+        shard->clock_hand = (shard->clock_hand + 1) % shard->slot_count;
+        if (slot->pin_count == 0)
+        {
+            if (!slot->valid || !slot->referenced)
+            {
+                return slot;
+            }
+            slot->referenced = 0;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Allocates a key schedule outside of the cache
+ *
+ * @param shard The shard the key belongs to
+ * @return      The uncached slot, or NULL if out of memory
+ */
+static bf_keyring_slot *blowfish_keyring_transient(bf_keyring_shard *shard)
+{
+    void *memory = NULL;
+    if (posix_memalign(&memory, BF_KEYRING_ALIGNMENT, sizeof (bf_keyring_slot)) != 0)
+    {
+        return NULL;
+    }
+    bf_keyring_slot *slot = memory;
+    memset(slot, 0, sizeof (bf_keyring_slot));
+    slot->shard     = shard;
+    slot->pin_count = 1;
+    slot->transient = 1;
+    return slot;
+}
+
+
+/**
+ * Initializes a shard
+ *
+ * @param shard      The shard
+ * @param slot_count Number of cache slots of the shard
+ * @return           0 on success, -1 if out of memory
+ */
+static int blowfish_keyring_shard_init(bf_keyring_shard *shard, size_t slot_count)
+{
+    memset(shard, 0, sizeof (bf_keyring_shard));
+
+    shard->entries = calloc(BF_KEYRING_INITIAL_CAPACITY, sizeof (bf_keyring_entry));
+    void *slots = NULL;
+    if (shard->entries == NULL ||
+        posix_memalign(&slots, BF_KEYRING_ALIGNMENT, sizeof (bf_keyring_slot) * slot_count) != 0)
+    {
+        free(shard->entries);
+        return -1;
+    }
+    memset(slots, 0, sizeof (bf_keyring_slot) * slot_count);
+
+    shard->capacity   = BF_KEYRING_INITIAL_CAPACITY;
+    shard->slots      = slots;
+    shard->slot_count = slot_count;
+    for (size_t index = 0; index < slot_count; ++index)
+    {
+        shard->slots[index].shard = shard;
+    }
+
+    pthread_mutex_init(&shard->lock, NULL);
+    pthread_cond_init(&shard->loaded, NULL);
+    return 0;
+}
+
+
+/**
+ * Destroys a shard, clearing its keys and key schedules
+ *
+ * @param shard The shard
+ */
+static void blowfish_keyring_shard_destroy(bf_keyring_shard *shard)
+{
+    memset(shard->entries, 0, sizeof (bf_keyring_entry) * shard->capacity);
+    memset(shard->slots, 0, sizeof (bf_keyring_slot) * shard->slot_count);
+    free(shard->entries);
+    free(shard->slots);
+    pthread_cond_destroy(&shard->loaded);
+    pthread_mutex_destroy(&shard->lock);
+}
@@ -0,0 +1,99 @@
+#ifndef BLOWFISH_KEYRING_H
+#define	BLOWFISH_KEYRING_H
+
+#include <blowfish.h>
+
+typedef struct bf_keyring_s bf_keyring;
+
+typedef struct bf_keyring_stats_s bf_keyring_stats;
+struct bf_keyring_stats_s
+{
+    // Number of keys in the keyring
+    size_t   key_count;
+    // Number of key schedules currently held in the cache
+    size_t   cached_count;
+    // Lookups that found the key schedule in the cache
+    uint64_t hits;
+    // Lookups that had to expand the key schedule
+    uint64_t misses;
+    // Cached key schedules that were replaced by another key's schedule
+    uint64_t evictions;
+};
+
+/**
+ * Creates a new keyring
+ *
+ * The keyring stores raw keys and keeps the expanded key schedules of
+ * recently used keys in a cache of fixed size. Keys are distributed over
+ * a number of shards, each with its own lock, key table and part of the cache,
+ * so that lookups of keys in different shards do not contend.
+ *
+ * @param cache_size  Maximum number of key schedules held in the cache
+ * @param shard_count Number of shards; 0 selects a default
+ * @return            The new keyring, or NULL if out of memory
+ */
+bf_keyring *blowfish_keyring_create(size_t cache_size, size_t shard_count);
+
+/**
+ * Destroys a keyring, clearing all keys and key schedules
+ *
+ * No key schedules of the keyring may be in use.
+ *
+ * @param keyring The keyring to destroy
+ */
+void blowfish_keyring_destroy(bf_keyring *keyring);
+
+/**
+ * Adds a key to the keyring
+ *
+ * @param keyring    The keyring
+ * @param key_id     Identifier of the key
+ * @param key        The key
+ * @param key_length The length of the key, 1 to 56 bytes
+ * @return           0 on success, -1 if the key length is invalid, the key_id
+ *                   is already in use, or out of memory
+ */
+int blowfish_keyring_add(bf_keyring *keyring, uint64_t key_id,
+                         const unsigned char *key, size_t key_length);
+
+/**
+ * Removes a key from the keyring
+ *
+ * Key schedules of the key that are still in use remain valid until released.
+ *
+ * @param keyring The keyring
+ * @param key_id  Identifier of the key
+ * @return        0 on success, -1 if the key_id is not in use
+ */
+int blowfish_keyring_remove(bf_keyring *keyring, uint64_t key_id);
+
+/**
+ * Returns the key schedule for a key, expanding it if it is not cached
+ *
+ * The key schedule remains valid and is not evicted until it is released
+ * by blowfish_keyring_release(). If all cache entries of the key's shard are
+ * in use, an uncached key schedule is returned.
+ *
+ * @param keyring The keyring
+ * @param key_id  Identifier of the key
+ * @return        The key schedule, or NULL if the key_id is not in use or out of memory
+ */
+const bf_state *blowfish_keyring_acquire(bf_keyring *keyring, uint64_t key_id);
+
+/**
+ * Releases a key schedule returned by blowfish_keyring_acquire()
+ *
+ * @param keyring The keyring
+ * @param state   The key schedule to release
+ */
+void blowfish_keyring_release(bf_keyring *keyring, const bf_state *state);
+
+/**
+ * Returns the keyring's counters
+ *
+ * @param keyring The keyring
+ * @param stats   Receives the sum of the counters of all shards
+ */
+void blowfish_keyring_stats(bf_keyring *keyring, bf_keyring_stats *stats);
+
+#endif	/* BLOWFISH_KEYRING_H */
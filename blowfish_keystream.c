@@ -0,0 +1,466 @@
+/**
+ * CTR mode key stream generated ahead of time by a background thread
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish_keystream.h>
+#include <blowfish_endian.h>
+#include <blowfish_stats.h>
+#include <pthread.h>
+#include <string.h>
+
+// Block size in bytes (8 == 64 bits)
+const size_t BF_KEYSTREAM_BLOCK_SIZE = 8;
+
+// Maximum shift width for a byte within a block in bits (56 == 7 bytes)
+const size_t BF_KEYSTREAM_BYTE_SHIFT_BASE = 56;
+
+// Byte shift value (8 bits == 1 byte)
+const size_t BF_KEYSTREAM_BYTE_SHIFT = 8;
+
+// Default number of blocks in the ring (8 kiB, fits into the L1 data cache)
+const size_t BF_KEYSTREAM_DEFAULT_DEPTH = 1024;
+
+// Largest supported number of blocks in the ring
+const size_t BF_KEYSTREAM_MAX_DEPTH = (size_t) 1 << 24;
+
+// Cache line size, separates the fields written by the producer and the consumer
+#define BF_KEYSTREAM_CACHE_LINE 64
+
+// Maximum number of blocks generated or taken from the ring at once
+#define BF_KEYSTREAM_BATCH_BLOCKS 64
+
+struct bf_keystream_s
+{
+    // Index of the next block the producer generates; written by the producer
+    uint64_t        head;
+    unsigned char   head_padding[BF_KEYSTREAM_CACHE_LINE - sizeof (uint64_t)];
+
+    // Index of the next block the consumer needs; written by the consumer
+    uint64_t        tail;
+    uint64_t        ring_blocks;
+    uint64_t        inline_blocks;
+    // Position within the stream in bytes
+    uint64_t        offset;
+    // Key stream of the block that contains the byte at offset, if offset is within a block
+    uint64_t        partial_block;
+    unsigned char   tail_padding[BF_KEYSTREAM_CACHE_LINE - 5 * sizeof (uint64_t)];
+
+    bf_ctr64_state  ctr_state;
+    uint64_t        *ring;
+    size_t          depth;
+    // The producer sleeps until no more than this number of blocks is left in the ring
+    size_t          low_watermark;
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  wakeup;
+    int             sleeping;
+    int             stop;
+};
+
+static size_t blowfish_keystream_take(bf_keystream *keystream, uint64_t *key_stream, size_t block_count);
+static void blowfish_keystream_process(bf_keystream *keystream, const unsigned char *input,
+                                       unsigned char *output, size_t data_length);
+static void *blowfish_keystream_producer(void *arg);
+static size_t blowfish_keystream_fill(uint64_t head, uint64_t tail);
+
+
+/**
+ * Creates a CTR mode key stream that is generated ahead of time
+ *
+ * @param state       Cipher state object; must remain valid until the key stream is destroyed
+ * @param init_vector The initialization vector for the cipher
+ * @param depth       Number of 64 bit blocks held in the ring, rounded up to a
+ *                    power of 2; 0 selects a default
+ * @return            The new key stream, or NULL if out of resources
+ */
+bf_keystream *blowfish_keystream_create(const bf_state *state, uint64_t init_vector, size_t depth)
+{
+    if (depth == 0)
+    {
+        depth = BF_KEYSTREAM_DEFAULT_DEPTH;
+    }
+    if (depth > BF_KEYSTREAM_MAX_DEPTH)
+    {
+        return NULL;
+    }
+    // A power of 2 allows mapping block indexes to slots with a mask
+    size_t ring_depth = 1;
+    while (ring_depth < depth)
+    {
+        ring_depth <<= 1;
+    }
+
+    void *memory = NULL;
+    if (posix_memalign(&memory, BF_KEYSTREAM_CACHE_LINE, sizeof (bf_keystream)) != 0)
+    {
+        return NULL;
+    }
+    bf_keystream *keystream = memory;
+    memset(keystream, 0, sizeof (bf_keystream));
+
+    if (posix_memalign(&memory, BF_KEYSTREAM_CACHE_LINE, ring_depth * sizeof (uint64_t)) != 0)
+    {
+        free(keystream);
+        return NULL;
+    }
+    keystream->ring          = memory;
+    keystream->depth         = ring_depth;
+    keystream->low_watermark = ring_depth / 2;
+    blowfish_ctr64_init(&keystream->ctr_state, state, init_vector);
+
+    int rc = -1;
+    if (pthread_mutex_init(&keystream->lock, NULL) == 0)
+    {
+        if (pthread_cond_init(&keystream->wakeup, NULL) == 0)
+        {
+            if (pthread_create(&keystream->thread, NULL, blowfish_keystream_producer, keystream) == 0)
+            {
+                rc = 0;
+            }
+            else
+            {
+                pthread_cond_destroy(&keystream->wakeup);
+            }
+        }
+        if (rc != 0)
+        {
+            pthread_mutex_destroy(&keystream->lock);
+        }
+    }
+
+    if (rc != 0)
+    {
+        free(keystream->ring);
+        free(keystream);
+        keystream = NULL;
+    }
+
+    return keystream;
+}
+
+
+/**
+ * Stops the background thread and destroys a key stream
+ *
+ * @param keystream The key stream to destroy
+ */
+void blowfish_keystream_destroy(bf_keystream *keystream)
+{
+    if (keystream != NULL)
+    {
+        pthread_mutex_lock(&keystream->lock);
+        __atomic_store_n(&keystream->stop, 1, __ATOMIC_RELAXED);
+        pthread_cond_signal(&keystream->wakeup);
+        pthread_mutex_unlock(&keystream->lock);
+        pthread_join(keystream->thread, NULL);
+
+        pthread_cond_destroy(&keystream->wakeup);
+        pthread_mutex_destroy(&keystream->lock);
+
+        // Clear the precomputed key stream
+        memset(keystream->ring, 0, keystream->depth * sizeof (uint64_t));
+        free(keystream->ring);
+        memset(keystream, 0, sizeof (bf_keystream));
+        free(keystream);
+    }
+}
+
+
+/**
+ * Encrypts the supplied data in-place with the next part of the key stream
+ *
+ * @param keystream   The key stream
+ * @param data        Plain text input data to encrypt
+ * @param data_length Length of the input data
+ */
+void blowfish_keystream_encrypt(bf_keystream *keystream, unsigned char *data, size_t data_length)
+{
+    blowfish_keystream_process(keystream, data, data, data_length);
+}
+
+
+/**
+ * Decrypts the supplied data in-place with the next part of the key stream
+ *
+ * @param keystream   The key stream
+ * @param data        Cipher text input data to decrypt
+ * @param data_length Length of the input data
+ */
+void blowfish_keystream_decrypt(bf_keystream *keystream, unsigned char *data, size_t data_length)
+{
+    blowfish_keystream_process(keystream, data, data, data_length);
+}
+
+
+/**
+ * Encrypts the supplied data into a separate output buffer with the next part of the key stream
+ *
+ * @param keystream   The key stream
+ * @param input       Plain text input data to encrypt
+ * @param output      Receives the cipher text; may be the same buffer as input
+ * @param data_length Length of the input data
+ */
+void blowfish_keystream_encrypt_copy(bf_keystream *keystream, const unsigned char *input,
+                                     unsigned char *output, size_t data_length)
+{
+    blowfish_keystream_process(keystream, input, output, data_length);
+}
+
+
+/**
+ * Decrypts the supplied data into a separate output buffer with the next part of the key stream
+ *
+ * @param keystream   The key stream
+ * @param input       Cipher text input data to decrypt
+ * @param output      Receives the plain text; may be the same buffer as input
+ * @param data_length Length of the input data
+ */
+void blowfish_keystream_decrypt_copy(bf_keystream *keystream, const unsigned char *input,
+                                     unsigned char *output, size_t data_length)
+{
+    // Encryption and decryption are the same operation in CTR mode
+    blowfish_keystream_process(keystream, input, output, data_length);
+}
+
+
+/**
+ * Returns the position of the next byte within the stream
+ *
+ * @param keystream The key stream
+ * @return          Number of bytes processed so far
+ */
+uint64_t blowfish_keystream_offset(const bf_keystream *keystream)
+{
+    return keystream->offset;
+}
+
+
+/**
+ * Retrieves the key stream's statistics
+ *
+ * @param keystream The key stream
+ * @param stats     Receives the statistics
+ */
+void blowfish_keystream_stats(const bf_keystream *keystream, bf_keystream_stats *stats)
+{
+    stats->ring_blocks   = __atomic_load_n(&keystream->ring_blocks, __ATOMIC_RELAXED);
+    stats->inline_blocks = __atomic_load_n(&keystream->inline_blocks, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Takes the next key stream blocks, from the ring if available, otherwise
+ * by generating them
+ *
+ * @param keystream   The key stream
+ * @param key_stream  Receives the key stream blocks
+ * @param block_count Number of blocks needed, 1 to BF_KEYSTREAM_BATCH_BLOCKS
+ * @return            Number of blocks taken, at least 1
+ */
+static size_t blowfish_keystream_take(bf_keystream *keystream, uint64_t *key_stream, size_t block_count)
+{
+    uint64_t tail = keystream->tail;
+    uint64_t head = __atomic_load_n(&keystream->head, __ATOMIC_ACQUIRE);
+
+    size_t available = blowfish_keystream_fill(head, tail);
+    if (available > 0)
+    {
+        if (block_count > available)
+        {
+            block_count = available;
+        }
+        for (size_t block_index = 0; block_index < block_count; ++block_index)
+        {
+            key_stream[block_index] = keystream->ring[(tail + block_index) & (keystream->depth - 1)];
+        }
+        __atomic_store_n(&keystream->ring_blocks, keystream->ring_blocks + block_count, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        // The ring is empty; the producer skips the blocks generated here
+        for (size_t block_index = 0; block_index < block_count; ++block_index)
+        {
+            key_stream[block_index] = keystream->ctr_state.init_vector + tail + block_index;
+        }
+        blowfish_encrypt64_blocks(keystream->ctr_state.cipher_state, key_stream, key_stream, block_count);
+        __atomic_store_n(&keystream->inline_blocks, keystream->inline_blocks + block_count, __ATOMIC_RELAXED);
+    }
+
+    // Sequentially consistent, ordered against the load of the producer's sleeping flag
+    tail += block_count;
+    __atomic_store_n(&keystream->tail, tail, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&keystream->sleeping, __ATOMIC_SEQ_CST) &&
+        blowfish_keystream_fill(head, tail) <= keystream->low_watermark)
+    {
+        pthread_mutex_lock(&keystream->lock);
+        pthread_cond_signal(&keystream->wakeup);
+        pthread_mutex_unlock(&keystream->lock);
+    }
+
+    return block_count;
+}
+
+
+/**
+ * XORs data with the next part of the key stream
+ *
+ * @param keystream   The key stream
+ * @param input       Input data
+ * @param output      Receives the output data; may be the same buffer as input
+ * @param data_length Length of the input data
+ */
+static void blowfish_keystream_process(bf_keystream *keystream, const unsigned char *input,
+                                       unsigned char *output, size_t data_length)
+{
+    BF_STATS_START(stats_start);
+    uint64_t key_stream[BF_KEYSTREAM_BATCH_BLOCKS];
+    size_t data_index = 0;
+
+    // Rest of the block started by a previous call
+    size_t block_offset = (size_t) (keystream->offset % BF_KEYSTREAM_BLOCK_SIZE);
+    if (block_offset > 0)
+    {
+        for (; block_offset < BF_KEYSTREAM_BLOCK_SIZE && data_index < data_length; ++block_offset)
+        {
+            size_t shift = BF_KEYSTREAM_BYTE_SHIFT_BASE - block_offset * BF_KEYSTREAM_BYTE_SHIFT;
+            output[data_index] = input[data_index] ^ (unsigned char) (keystream->partial_block >> shift);
+            ++data_index;
+        }
+    }
+
+    size_t full_blocks = (data_length - data_index) / BF_KEYSTREAM_BLOCK_SIZE;
+    size_t block_count = full_blocks;
+    while (full_blocks > 0)
+    {
+        size_t batch_blocks = full_blocks < BF_KEYSTREAM_BATCH_BLOCKS ? full_blocks : BF_KEYSTREAM_BATCH_BLOCKS;
+        batch_blocks = blowfish_keystream_take(keystream, key_stream, batch_blocks);
+        for (size_t batch_index = 0; batch_index < batch_blocks; ++batch_index)
+        {
+            blowfish_store_be64(&output[data_index],
+                                blowfish_load_be64(&input[data_index]) ^ key_stream[batch_index]);
+            data_index += BF_KEYSTREAM_BLOCK_SIZE;
+        }
+        full_blocks -= batch_blocks;
+    }
+
+    // Start a new block with the remaining data
+    if (data_index < data_length)
+    {
+        blowfish_keystream_take(keystream, key_stream, 1);
+        keystream->partial_block = key_stream[0];
+        for (block_offset = 0; data_index < data_length; ++block_offset)
+        {
+            size_t shift = BF_KEYSTREAM_BYTE_SHIFT_BASE - block_offset * BF_KEYSTREAM_BYTE_SHIFT;
+            output[data_index] = input[data_index] ^ (unsigned char) (keystream->partial_block >> shift);
+            ++data_index;
+        }
+        ++block_count;
+    }
+
+    keystream->offset += data_length;
+    BF_STATS_RECORD(BF_STATS_CTR64_CRYPT, stats_start, data_length, block_count);
+}
+
+
+/**
+ * Background thread that keeps the ring filled
+ *
+ * @param arg The key stream
+ * @return    NULL
+ */
+static void *blowfish_keystream_producer(void *arg)
+{
+    bf_keystream *keystream = arg;
+    uint64_t head = 0;
+
+    while (!__atomic_load_n(&keystream->stop, __ATOMIC_RELAXED))
+    {
+        uint64_t tail = __atomic_load_n(&keystream->tail, __ATOMIC_ACQUIRE);
+        if (head < tail)
+        {
+            // The consumer generated these blocks itself
+            head = tail;
+            __atomic_store_n(&keystream->head, head, __ATOMIC_RELEASE);
+        }
+
+        size_t free_blocks = keystream->depth - blowfish_keystream_fill(head, tail);
+        if (free_blocks == 0)
+        {
+            // Sleep until the consumer has drained the ring to the low watermark
+            pthread_mutex_lock(&keystream->lock);
+            __atomic_store_n(&keystream->sleeping, 1, __ATOMIC_SEQ_CST);
+            while (!__atomic_load_n(&keystream->stop, __ATOMIC_RELAXED) &&
+                   blowfish_keystream_fill(head, __atomic_load_n(&keystream->tail, __ATOMIC_SEQ_CST)) >
+                   keystream->low_watermark)
+            {
+                pthread_cond_wait(&keystream->wakeup, &keystream->lock);
+            }
+            __atomic_store_n(&keystream->sleeping, 0, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&keystream->lock);
+            continue;
+        }
+
+        // Generate a batch of blocks in place, without wrapping around the end of the ring
+        size_t slot = (size_t) (head & (keystream->depth - 1));
+        size_t batch_blocks = free_blocks < BF_KEYSTREAM_BATCH_BLOCKS ? free_blocks : BF_KEYSTREAM_BATCH_BLOCKS;
+        if (batch_blocks > keystream->depth - slot)
+        {
+            batch_blocks = keystream->depth - slot;
+        }
+        uint64_t *batch = &keystream->ring[slot];
+        for (size_t batch_index = 0; batch_index < batch_blocks; ++batch_index)
+        {
+            batch[batch_index] = keystream->ctr_state.init_vector + head + batch_index;
+        }
+        blowfish_encrypt64_blocks(keystream->ctr_state.cipher_state, batch, batch, batch_blocks);
+
+        head += batch_blocks;
+        __atomic_store_n(&keystream->head, head, __ATOMIC_RELEASE);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * Calculates the number of blocks in the ring
+ *
+ * @param head Index of the next block the producer generates
+ * @param tail Index of the next block the consumer needs
+ * @return     Number of generated blocks the consumer has not yet taken; 0 if the
+ *             consumer is ahead of the producer
+ */
+static size_t blowfish_keystream_fill(uint64_t head, uint64_t tail)
+{
+    return head > tail ? (size_t) (head - tail) : 0;
+}
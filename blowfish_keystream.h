@@ -0,0 +1,105 @@
+#ifndef BLOWFISH_KEYSTREAM_H
+#define	BLOWFISH_KEYSTREAM_H
+
+#include <blowfish_ctr64.h>
+
+typedef struct bf_keystream_s bf_keystream;
+
+typedef struct bf_keystream_stats_s bf_keystream_stats;
+struct bf_keystream_stats_s
+{
+    // Key stream blocks taken from the ring
+    uint64_t ring_blocks;
+    // Key stream blocks generated by the consumer because the ring was empty
+    uint64_t inline_blocks;
+};
+
+/**
+ * Creates a CTR mode key stream that is generated ahead of time
+ *
+ * A background thread encrypts the counter blocks into a single-producer,
+ * single-consumer ring, so that encrypting a message only XORs it with
+ * precomputed key stream. If the ring runs empty, the consumer generates
+ * the key stream itself and the background thread skips ahead.
+ *
+ * The key stream is that of blowfish_ctr64_encrypt() with the same state
+ * and initialization vector, starting at offset 0, so the other side can
+ * use the regular CTR mode functions.
+ *
+ * @param state       Cipher state object; must remain valid until the key stream is destroyed
+ * @param init_vector The initialization vector for the cipher
+ * @param depth       Number of 64 bit blocks held in the ring, rounded up to a
+ *                    power of 2; 0 selects a default
+ * @return            The new key stream, or NULL if out of resources
+ */
+bf_keystream *blowfish_keystream_create(const bf_state *state, uint64_t init_vector, size_t depth);
+
+/**
+ * Stops the background thread and destroys a key stream
+ *
+ * @param keystream The key stream to destroy
+ */
+void blowfish_keystream_destroy(bf_keystream *keystream);
+
+/**
+ * Encrypts the supplied data in-place with the next part of the key stream
+ *
+ * Only one thread at a time may call the encryption and decryption functions
+ * of a key stream.
+ *
+ * @param keystream   The key stream
+ * @param data        Plain text input data to encrypt
+ * @param data_length Length of the input data
+ */
+void blowfish_keystream_encrypt(bf_keystream *keystream, unsigned char *data, size_t data_length);
+
+/**
+ * Decrypts the supplied data in-place with the next part of the key stream
+ *
+ * @param keystream   The key stream
+ * @param data        Cipher text input data to decrypt
+ * @param data_length Length of the input data
+ */
+void blowfish_keystream_decrypt(bf_keystream *keystream, unsigned char *data, size_t data_length);
+
+/**
+ * Encrypts the supplied data into a separate output buffer with the next part of the key stream
+ *
+ * @param keystream   The key stream
+ * @param input       Plain text input data to encrypt
+ * @param output      Receives the cipher text; may be the same buffer as input
+ * @param data_length Length of the input data
+ */
+void blowfish_keystream_encrypt_copy(bf_keystream *keystream, const unsigned char *input,
+                                     unsigned char *output, size_t data_length);
+
+/**
+ * Decrypts the supplied data into a separate output buffer with the next part of the key stream
+ *
+ * @param keystream   The key stream
+ * @param input       Cipher text input data to decrypt
+ * @param output      Receives the plain text; may be the same buffer as input
+ * @param data_length Length of the input data
+ */
+void blowfish_keystream_decrypt_copy(bf_keystream *keystream, const unsigned char *input,
+                                     unsigned char *output, size_t data_length);
+
+/**
+ * Returns the position of the next byte within the stream
+ *
+ * @param keystream The key stream
+ * @return          Number of bytes processed so far
+ */
+uint64_t blowfish_keystream_offset(const bf_keystream *keystream);
+
+/**
+ * Retrieves the key stream's statistics
+ *
+ * May be called from any thread.
+ *
+ * @param keystream The key stream
+ * @param stats     Receives the statistics
+ */
+void blowfish_keystream_stats(const bf_keystream *keystream, bf_keystream_stats *stats);
+
+#endif	/* BLOWFISH_KEYSTREAM_H */
@@ -0,0 +1,498 @@
+/**
+ * PMAC and CMAC message authentication codes
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <blowfish_mac.h>
+#include <blowfish_endian.h>
+#include <blowfish_thread.h>
+#include <string.h>
+
+extern const size_t BF_PARALLEL_MIN_BLOCKS;
+
+// Block size in bytes (8 == 64 bits)
+const size_t BF_MAC_BLOCK_SIZE = 8;
+
+// Reduction of x^64 in GF(2^64): x^4 + x^3 + x + 1
+const uint64_t BF_MAC_POLYNOMIAL = 0x1B;
+
+// Number of blocks encrypted per call of the block-parallel kernel
+#define BF_MAC_BATCH_BLOCKS 64
+
+// A range of blocks whose PMAC checksum is computed by one thread
+typedef struct bf_pmac_chunk_s bf_pmac_chunk;
+struct bf_pmac_chunk_s
+{
+    const bf_mac_key    *key;
+    const unsigned char *data;
+    // Number of the first block, counting from 1
+    uint64_t            first_block;
+    size_t              block_count;
+    uint64_t            checksum;
+};
+
+static uint64_t blowfish_pmac_blocks(const bf_mac_key *key, const unsigned char *data,
+                                     size_t block_count, uint64_t *offset, uint64_t *block_number);
+static uint64_t blowfish_pmac_finish(const bf_mac_key *key, uint64_t checksum,
+                                     const unsigned char *data, size_t data_length);
+static void blowfish_pmac_chunk(void *context, size_t chunk_index);
+static uint64_t blowfish_pmac_offset(const bf_mac_key *key, uint64_t block_number);
+static inline uint64_t blowfish_mac_double(uint64_t value);
+static inline uint64_t blowfish_mac_pad(const unsigned char *data, size_t data_length);
+static inline unsigned int blowfish_mac_trailing_zeros(uint64_t value);
+
+
+/**
+ * Derives the subkeys of a MAC key
+ *
+ * @param key   The object to initialize
+ * @param state Cipher state object
+ */
+void blowfish_mac_key_init(bf_mac_key *key, const bf_state *state)
+{
+    key->cipher_state = state;
+    key->offsets[0] = blowfish_encrypt64(state, 0);
+    for (size_t index = 1; index < 64; ++index)
+    {
+        key->offsets[index] = blowfish_mac_double(key->offsets[index - 1]);
+    }
+
+    // Inverse of doubling: a set low bit can only stem from the reduction
+    uint64_t value = key->offsets[0];
+    key->final_offset = (value & 1) != 0 ?
+        ((value ^ BF_MAC_POLYNOMIAL) >> 1) | (UINT64_C(1) << 63) :
+        value >> 1;
+}
+
+
+/**
+ * Starts computing a PMAC
+ *
+ * @param pmac_state The object to initialize
+ * @param key        The MAC key
+ */
+void blowfish_pmac_init(bf_pmac_state *pmac_state, const bf_mac_key *key)
+{
+    pmac_state->key           = key;
+    pmac_state->offset        = 0;
+    pmac_state->checksum      = 0;
+    pmac_state->block_count   = 0;
+    pmac_state->buffer_length = 0;
+}
+
+
+/**
+ * Adds data to a PMAC
+ *
+ * @param pmac_state  The PMAC state object
+ * @param data        The data
+ * @param data_length Length of the data
+ */
+void blowfish_pmac_update(bf_pmac_state *pmac_state, const unsigned char *data, size_t data_length)
+{
+    // Complete the held back block; it is processed only once more data follows
+    if (pmac_state->buffer_length < BF_MAC_BLOCK_SIZE)
+    {
+        size_t fill_length = BF_MAC_BLOCK_SIZE - pmac_state->buffer_length;
+        if (fill_length > data_length)
+        {
+            fill_length = data_length;
+        }
+        memcpy(&pmac_state->buffer[pmac_state->buffer_length], data, fill_length);
+        pmac_state->buffer_length += fill_length;
+        data = &data[fill_length];
+        data_length -= fill_length;
+    }
+    if (data_length == 0)
+    {
+        return;
+    }
+
+    uint64_t block_number = pmac_state->block_count;
+    pmac_state->checksum ^= blowfish_pmac_blocks(pmac_state->key, pmac_state->buffer, 1,
+                                                 &pmac_state->offset, &block_number);
+
+    // All complete blocks except the last one, which may be the final block
+    size_t block_count = (data_length - 1) / BF_MAC_BLOCK_SIZE;
+    pmac_state->checksum ^= blowfish_pmac_blocks(pmac_state->key, data, block_count,
+                                                 &pmac_state->offset, &block_number);
+    pmac_state->block_count = block_number;
+
+    size_t rest_offset = block_count * BF_MAC_BLOCK_SIZE;
+    pmac_state->buffer_length = data_length - rest_offset;
+    memcpy(pmac_state->buffer, &data[rest_offset], pmac_state->buffer_length);
+}
+
+
+/**
+ * Completes a PMAC
+ *
+ * @param pmac_state The PMAC state object
+ * @return           The tag
+ */
+uint64_t blowfish_pmac_final(bf_pmac_state *pmac_state)
+{
+    uint64_t tag = blowfish_pmac_finish(pmac_state->key, pmac_state->checksum,
+                                        pmac_state->buffer, pmac_state->buffer_length);
+    memset(pmac_state->buffer, 0, sizeof (pmac_state->buffer));
+
+    return tag;
+}
+
+
+/**
+ * Computes the PMAC of a message, using multiple threads
+ *
+ * @param key          The MAC key
+ * @param data         The message
+ * @param data_length  Length of the message
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ * @return             The tag
+ */
+uint64_t blowfish_pmac_parallel(const bf_mac_key *key, const unsigned char *data, size_t data_length,
+                                size_t thread_count)
+{
+    // The final block, complete or not, is processed separately
+    size_t block_count = data_length > 0 ? (data_length - 1) / BF_MAC_BLOCK_SIZE : 0;
+
+    size_t chunk_count = block_count / BF_PARALLEL_MIN_BLOCKS;
+    if (chunk_count > thread_count)
+    {
+        chunk_count = thread_count;
+    }
+
+    bf_pmac_chunk *chunks = NULL;
+    if (chunk_count > 1)
+    {
+        chunks = malloc(sizeof (bf_pmac_chunk) * chunk_count);
+    }
+
+    uint64_t checksum = 0;
+    if (chunks != NULL)
+    {
+        size_t block_offset = 0;
+        for (size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+        {
+            size_t next_block_offset = block_count / chunk_count * (chunk_index + 1);
+            if (chunk_index + 1 == chunk_count)
+            {
+                next_block_offset = block_count;
+            }
+            bf_pmac_chunk *chunk = &chunks[chunk_index];
+            chunk->key         = key;
+            chunk->data        = &data[block_offset * BF_MAC_BLOCK_SIZE];
+            chunk->first_block = block_offset + 1;
+            chunk->block_count = next_block_offset - block_offset;
+            block_offset = next_block_offset;
+        }
+
+        blowfish_thread_run(blowfish_pmac_chunk, chunks, chunk_count);
+
+        for (size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+        {
+            checksum ^= chunks[chunk_index].checksum;
+        }
+        free(chunks);
+    }
+    else
+    {
+        // Single chunk, or out of memory
+        uint64_t offset = 0;
+        uint64_t block_number = 0;
+        checksum = blowfish_pmac_blocks(key, data, block_count, &offset, &block_number);
+    }
+
+    size_t final_offset = block_count * BF_MAC_BLOCK_SIZE;
+    return blowfish_pmac_finish(key, checksum, &data[final_offset], data_length - final_offset);
+}
+
+
+/**
+ * Starts computing a CMAC
+ *
+ * @param cmac_state The object to initialize
+ * @param key        The MAC key
+ */
+void blowfish_cmac_init(bf_cmac_state *cmac_state, const bf_mac_key *key)
+{
+    cmac_state->key           = key;
+    cmac_state->chain         = 0;
+    cmac_state->buffer_length = 0;
+}
+
+
+/**
+ * Adds data to a CMAC
+ *
+ * @param cmac_state  The CMAC state object
+ * @param data        The data
+ * @param data_length Length of the data
+ */
+void blowfish_cmac_update(bf_cmac_state *cmac_state, const unsigned char *data, size_t data_length)
+{
+    const bf_state *state = cmac_state->key->cipher_state;
+
+    size_t data_offset = 0;
+    while (data_offset < data_length)
+    {
+        // A complete block is held back until more data follows, since it may be the final block
+        if (cmac_state->buffer_length == BF_MAC_BLOCK_SIZE)
+        {
+            cmac_state->chain = blowfish_encrypt64(state, cmac_state->chain ^ blowfish_load_be64(cmac_state->buffer));
+            cmac_state->buffer_length = 0;
+        }
+
+        if (cmac_state->buffer_length == 0)
+        {
+            while (data_length - data_offset > BF_MAC_BLOCK_SIZE)
+            {
+                cmac_state->chain = blowfish_encrypt64(state, cmac_state->chain ^ blowfish_load_be64(&data[data_offset]));
+                data_offset += BF_MAC_BLOCK_SIZE;
+            }
+        }
+
+        size_t copy_length = BF_MAC_BLOCK_SIZE - cmac_state->buffer_length;
+        if (copy_length > data_length - data_offset)
+        {
+            copy_length = data_length - data_offset;
+        }
+        memcpy(&cmac_state->buffer[cmac_state->buffer_length], &data[data_offset], copy_length);
+        cmac_state->buffer_length += copy_length;
+        data_offset += copy_length;
+    }
+}
+
+
+/**
+ * Completes a CMAC
+ *
+ * @param cmac_state The CMAC state object
+ * @return           The tag
+ */
+uint64_t blowfish_cmac_final(bf_cmac_state *cmac_state)
+{
+    const bf_mac_key *key = cmac_state->key;
+
+    // K1 = L * x for a complete final block, K2 = L * x^2 for a padded one
+    uint64_t last_block = blowfish_mac_pad(cmac_state->buffer, cmac_state->buffer_length);
+    last_block ^= cmac_state->buffer_length == BF_MAC_BLOCK_SIZE ? key->offsets[1] : key->offsets[2];
+    memset(cmac_state->buffer, 0, sizeof (cmac_state->buffer));
+
+    return blowfish_encrypt64(key->cipher_state, cmac_state->chain ^ last_block);
+}
+
+
+/**
+ * Compares two tags in constant time
+ *
+ * @param tag      The computed tag
+ * @param expected The received tag
+ * @return         1 if the tags are equal, 0 otherwise
+ */
+int blowfish_mac_equal(uint64_t tag, uint64_t expected)
+{
+    uint64_t difference = tag ^ expected;
+    difference |= difference >> 32;
+    difference |= difference >> 16;
+    difference |= difference >> 8;
+    difference |= difference >> 4;
+    difference |= difference >> 2;
+    difference |= difference >> 1;
+
+    return (int) (~difference & 1);
+}
+
+
+/**
+ * Computes the PMAC checksum of complete blocks that are not the final block
+ *
+ * Block i is encrypted after adding offset(i) = offset(i - 1) ^ L * x^ntz(i).
+ * The offsets are computed sequentially, which only takes an XOR per block,
+ * and the blocks are encrypted in batches.
+ *
+ * @param key          The MAC key
+ * @param data         The blocks
+ * @param block_count  Number of blocks
+ * @param offset       Offset of the preceding block; receives the offset of the last block
+ * @param block_number Number of the preceding block; receives the number of the last block
+ * @return             XOR of the encrypted blocks
+ */
+static uint64_t blowfish_pmac_blocks(const bf_mac_key *key, const unsigned char *data,
+                                     size_t block_count, uint64_t *offset, uint64_t *block_number)
+{
+    uint64_t checksum = 0;
+    uint64_t current_offset = *offset;
+    uint64_t current_number = *block_number;
+
+    for (size_t block_index = 0; block_index < block_count; block_index += BF_MAC_BATCH_BLOCKS)
+    {
+        size_t batch_blocks = block_count - block_index;
+        if (batch_blocks > BF_MAC_BATCH_BLOCKS)
+        {
+            batch_blocks = BF_MAC_BATCH_BLOCKS;
+        }
+
+        uint64_t blocks[BF_MAC_BATCH_BLOCKS];
+        for (size_t batch_index = 0; batch_index < batch_blocks; ++batch_index)
+        {
+            ++current_number;
+            current_offset ^= key->offsets[blowfish_mac_trailing_zeros(current_number)];
+            blocks[batch_index] = blowfish_load_be64(&data[(block_index + batch_index) * BF_MAC_BLOCK_SIZE]) ^
+                                  current_offset;
+        }
+        blowfish_encrypt64_blocks(key->cipher_state, blocks, blocks, batch_blocks);
+        for (size_t batch_index = 0; batch_index < batch_blocks; ++batch_index)
+        {
+            checksum ^= blocks[batch_index];
+        }
+    }
+
+    *offset = current_offset;
+    *block_number = current_number;
+
+    return checksum;
+}
+
+
+/**
+ * Adds the final block to a PMAC checksum and computes the tag
+ *
+ * A complete final block is added as is and the checksum is encrypted
+ * after adding L * x^-1; an incomplete final block is padded and the
+ * checksum is encrypted without an offset.
+ *
+ * @param key         The MAC key
+ * @param checksum    Checksum of all other blocks
+ * @param data        The final block
+ * @param data_length Length of the final block, 0 to 8 bytes
+ * @return            The tag
+ */
+static uint64_t blowfish_pmac_finish(const bf_mac_key *key, uint64_t checksum,
+                                     const unsigned char *data, size_t data_length)
+{
+    checksum ^= blowfish_mac_pad(data, data_length);
+    if (data_length == BF_MAC_BLOCK_SIZE)
+    {
+        checksum ^= key->final_offset;
+    }
+
+    return blowfish_encrypt64(key->cipher_state, checksum);
+}
+
+
+/**
+ * Computes the PMAC checksum of a range of blocks
+ *
+ * @param context     Array of bf_pmac_chunk objects
+ * @param chunk_index Index of the chunk to process
+ */
+static void blowfish_pmac_chunk(void *context, size_t chunk_index)
+{
+    bf_pmac_chunk *chunk = &((bf_pmac_chunk *) context)[chunk_index];
+    uint64_t block_number = chunk->first_block - 1;
+    uint64_t offset = blowfish_pmac_offset(chunk->key, block_number);
+    chunk->checksum = blowfish_pmac_blocks(chunk->key, chunk->data, chunk->block_count,
+                                           &offset, &block_number);
+}
+
+
+/**
+ * Computes the offset of a block directly
+ *
+ * Each step from block i - 1 to block i flips bit ntz(i) of the Gray code of
+ * i, so the offset of block i is the sum of L * x^j over the set bits j of
+ * the Gray code.
+ *
+ * @param key          The MAC key
+ * @param block_number Number of the block, counting from 1; 0 yields the initial offset
+ * @return             The offset
+ */
+static uint64_t blowfish_pmac_offset(const bf_mac_key *key, uint64_t block_number)
+{
+    uint64_t gray_code = block_number ^ (block_number >> 1);
+    uint64_t offset = 0;
+    for (size_t bit = 0; bit < 64; ++bit)
+    {
+        if (((gray_code >> bit) & 1) != 0)
+        {
+            offset ^= key->offsets[bit];
+        }
+    }
+
+    return offset;
+}
+
+
+/**
+ * Multiplies a value by x in GF(2^64)
+ *
+ * @param value The value
+ * @return      The product
+ */
+static inline uint64_t blowfish_mac_double(uint64_t value)
+{
+    return (value << 1) ^ ((0 - (value >> 63)) & BF_MAC_POLYNOMIAL);
+}
+
+
+/**
+ * Loads a final block, padding an incomplete one
+ *
+ * @param data        The block
+ * @param data_length Length of the block, 0 to 8 bytes
+ * @return            The block, followed by a 1 bit and 0 bits if incomplete
+ */
+static inline uint64_t blowfish_mac_pad(const unsigned char *data, size_t data_length)
+{
+    unsigned char block[8];
+    memset(block, 0, sizeof (block));
+    if (data_length > 0)
+    {
+        memcpy(block, data, data_length);
+    }
+    if (data_length < BF_MAC_BLOCK_SIZE)
+    {
+        block[data_length] = 0x80;
+    }
+
+    return blowfish_load_be64(block);
+}
+
+
+/**
+ * Counts the trailing zero bits of a non-zero value
+ *
+ * @param value The value
+ * @return      Number of trailing zero bits
+ */
+static inline unsigned int blowfish_mac_trailing_zeros(uint64_t value)
+{
+    return (unsigned int) __builtin_ctzll(value);
+}
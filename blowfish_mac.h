@@ -0,0 +1,142 @@
+#ifndef BLOWFISH_MAC_H
+#define	BLOWFISH_MAC_H
+
+#include <blowfish.h>
+
+/*
+ * Message authentication codes over the 64 bit block cipher
+ *
+ * Both modes use the field GF(2^64) with the polynomial x^64 + x^4 + x^3 + x + 1
+ * and a subkey L = encrypt64(0), and produce a 64 bit tag. Message blocks are
+ * read big-endian, as by the CFB and CTR modes. An incomplete last block is
+ * padded with a 1 bit followed by 0 bits.
+ *
+ * PMAC follows PMAC1: block i is encrypted after adding an offset derived from
+ * L and i, so all blocks except the last are independent of each other and
+ * are encrypted in batches by the kernel selected by blowfish_kernel().
+ * CMAC follows RFC 4493 and is sequential, but has a lower fixed cost for
+ * short messages.
+ *
+ * A MAC key should not also be used for encryption; derive separate keys.
+ */
+
+// Size of a tag in bytes
+#define BF_MAC_TAG_SIZE 8
+
+typedef struct bf_mac_key_s bf_mac_key;
+struct bf_mac_key_s
+{
+    const bf_state *cipher_state;
+    // L * x^i
+    uint64_t       offsets[64];
+    // L * x^-1
+    uint64_t       final_offset;
+};
+
+typedef struct bf_pmac_state_s bf_pmac_state;
+struct bf_pmac_state_s
+{
+    const bf_mac_key *key;
+    // Offset of the last processed block
+    uint64_t         offset;
+    uint64_t         checksum;
+    // Number of processed blocks
+    uint64_t         block_count;
+    // The last block is held back until it is known whether it is the final block
+    unsigned char    buffer[8];
+    size_t           buffer_length;
+};
+
+typedef struct bf_cmac_state_s bf_cmac_state;
+struct bf_cmac_state_s
+{
+    const bf_mac_key *key;
+    uint64_t         chain;
+    unsigned char    buffer[8];
+    size_t           buffer_length;
+};
+
+/**
+ * Derives the subkeys of a MAC key
+ *
+ * @param key   The object to initialize
+ * @param state Cipher state object; must remain valid while key is in use
+ */
+void blowfish_mac_key_init(bf_mac_key *key, const bf_state *state);
+
+/**
+ * Starts computing a PMAC
+ *
+ * @param pmac_state The object to initialize
+ * @param key        The MAC key
+ */
+void blowfish_pmac_init(bf_pmac_state *pmac_state, const bf_mac_key *key);
+
+/**
+ * Adds data to a PMAC
+ *
+ * @param pmac_state  The PMAC state object
+ * @param data        The data
+ * @param data_length Length of the data
+ */
+void blowfish_pmac_update(bf_pmac_state *pmac_state, const unsigned char *data, size_t data_length);
+
+/**
+ * Completes a PMAC
+ *
+ * @param pmac_state The PMAC state object; must be initialized again before reuse
+ * @return           The tag
+ */
+uint64_t blowfish_pmac_final(bf_pmac_state *pmac_state);
+
+/**
+ * Computes the PMAC of a message, using multiple threads
+ *
+ * The blocks are split into ranges whose checksums are computed in parallel
+ * and combined. The result is the same as that of blowfish_pmac_update()
+ * with the whole message.
+ *
+ * @param key          The MAC key
+ * @param data         The message
+ * @param data_length  Length of the message
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ * @return             The tag
+ */
+uint64_t blowfish_pmac_parallel(const bf_mac_key *key, const unsigned char *data, size_t data_length,
+                                size_t thread_count);
+
+/**
+ * Starts computing a CMAC
+ *
+ * @param cmac_state The object to initialize
+ * @param key        The MAC key
+ */
+void blowfish_cmac_init(bf_cmac_state *cmac_state, const bf_mac_key *key);
+
+/**
+ * Adds data to a CMAC
+ *
+ * @param cmac_state  The CMAC state object
+ * @param data        The data
+ * @param data_length Length of the data
+ */
+void blowfish_cmac_update(bf_cmac_state *cmac_state, const unsigned char *data, size_t data_length);
+
+/**
+ * Completes a CMAC
+ *
+ * @param cmac_state The CMAC state object; must be initialized again before reuse
+ * @return           The tag
+ */
+uint64_t blowfish_cmac_final(bf_cmac_state *cmac_state);
+
+/**
+ * Compares two tags in constant time
+ *
+ * @param tag      The computed tag
+ * @param expected The received tag
+ * @return         1 if the tags are equal, 0 otherwise
+ */
+int blowfish_mac_equal(uint64_t tag, uint64_t expected);
+
+#endif	/* BLOWFISH_MAC_H */
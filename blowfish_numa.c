@@ -0,0 +1,394 @@
+/**
+ * Replication of key schedules into NUMA node-local memory
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+
+#include <blowfish_numa.h>
+#include <blowfish_stats.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef BLOWFISH_LIBNUMA
+#include <numa.h>
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#ifndef BLOWFISH_LIBNUMA
+// Memory policy of mbind() that prefers the node in the node mask (MPOL_PREFERRED),
+// so that a node without memory of its own falls back to the nearest node
+const int BF_NUMA_MPOL_PREFERRED = 1;
+
+// Flag of move_pages() that moves the pages of the calling process only (MPOL_MF_MOVE)
+const int BF_NUMA_MPOL_MF_MOVE = 2;
+
+// Maximum length of a node or CPU list read from sysfs
+#define BF_NUMA_LIST_LENGTH 4096
+
+// Number of words of the node mask passed to mbind(), enough for 1024 nodes
+#define BF_NUMA_MASK_WORDS (1024 / (8 * sizeof (unsigned long)))
+#endif
+
+typedef struct bf_numa_topology_s bf_numa_topology;
+struct bf_numa_topology_s
+{
+    size_t node_count;
+    // Node of each CPU, indexed by CPU number
+    size_t *cpu_nodes;
+    size_t cpu_count;
+};
+
+struct bf_numa_state_s
+{
+    const bf_state *source;
+    // Size of each replica's allocation
+    size_t         replica_size;
+    size_t         node_count;
+    // Replica of each node, NULL if the node has none
+    bf_state       *replicas[];
+};
+
+static pthread_once_t blowfish_numa_once = PTHREAD_ONCE_INIT;
+
+static bf_numa_topology blowfish_numa_topology;
+
+static void blowfish_numa_init(void);
+static bf_state *blowfish_numa_alloc(size_t size, size_t node);
+static void blowfish_numa_free(bf_state *replica, size_t size);
+#ifndef BLOWFISH_LIBNUMA
+static size_t blowfish_numa_read_list(const char *path, size_t *marks, size_t mark_count, size_t value);
+#endif
+
+
+/**
+ * Returns the number of NUMA nodes
+ *
+ * @return Number of nodes; 1 on single-node systems and if the topology is unknown
+ */
+size_t blowfish_numa_node_count(void)
+{
+    pthread_once(&blowfish_numa_once, blowfish_numa_init);
+    return blowfish_numa_topology.node_count;
+}
+
+
+/**
+ * Replicates an expanded key schedule into the local memory of each NUMA node
+ *
+ * @param state The cipher state object to replicate
+ * @return      The replicas, or NULL if out of memory
+ */
+bf_numa_state *blowfish_numa_replicate(const bf_state *state)
+{
+    size_t node_count = blowfish_numa_node_count();
+    if (node_count == 1)
+    {
+        // Nothing to replicate, blowfish_numa_local() returns the source
+        node_count = 0;
+    }
+
+    bf_numa_state *replicas = malloc(sizeof (bf_numa_state) + node_count * sizeof (bf_state *));
+    if (replicas == NULL)
+    {
+        return NULL;
+    }
+    replicas->source     = state;
+    replicas->node_count = node_count;
+
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    replicas->replica_size = (sizeof (bf_state) + page_size - 1) / page_size * page_size;
+
+    for (size_t node = 0; node < node_count; ++node)
+    {
+        // A node that cannot hold a replica uses the source
+        replicas->replicas[node] = blowfish_numa_alloc(replicas->replica_size, node);
+        if (replicas->replicas[node] != NULL)
+        {
+            memcpy(replicas->replicas[node], state, sizeof (bf_state));
+            BF_STATS_COUNT(BF_STATS_ALLOCATIONS, 1);
+        }
+    }
+
+    return replicas;
+}
+
+
+/**
+ * Clears and frees the replicas of a key schedule
+ *
+ * @param replicas The replicas to destroy
+ */
+void blowfish_numa_destroy(bf_numa_state *replicas)
+{
+    if (replicas != NULL)
+    {
+        for (size_t node = 0; node < replicas->node_count; ++node)
+        {
+            if (replicas->replicas[node] != NULL)
+            {
+                blowfish_clear(replicas->replicas[node]);
+                blowfish_numa_free(replicas->replicas[node], replicas->replica_size);
+            }
+        }
+        free(replicas);
+    }
+}
+
+
+/**
+ * Returns the replica on the NUMA node of the calling thread's current CPU
+ *
+ * @param replicas The replicas
+ * @return         The node-local cipher state object, or the source state if
+ *                 there is no replica for the node
+ */
+const bf_state *blowfish_numa_local(const bf_numa_state *replicas)
+{
+    if (replicas->node_count == 0)
+    {
+        return replicas->source;
+    }
+
+    // Answered by the vDSO on most platforms, without entering the kernel;
+    // the topology is initialized, since there are replicas
+    int cpu = sched_getcpu();
+    size_t node = 0;
+    if (cpu >= 0 && (size_t) cpu < blowfish_numa_topology.cpu_count)
+    {
+        node = blowfish_numa_topology.cpu_nodes[cpu];
+    }
+
+    return blowfish_numa_node_state(replicas, node);
+}
+
+
+/**
+ * Returns the replica on a specific NUMA node
+ *
+ * @param replicas The replicas
+ * @param node     The node
+ * @return         The cipher state object, or the source state if there is no replica for the node
+ */
+const bf_state *blowfish_numa_node_state(const bf_numa_state *replicas, size_t node)
+{
+    const bf_state *state = replicas->source;
+    if (node < replicas->node_count && replicas->replicas[node] != NULL)
+    {
+        state = replicas->replicas[node];
+    }
+
+    return state;
+}
+
+
+/**
+ * Determines the number of nodes and the node of each CPU
+ *
+ * Falls back to a single node if the topology cannot be determined.
+ */
+static void blowfish_numa_init(void)
+{
+    bf_numa_topology *topology = &blowfish_numa_topology;
+    topology->node_count = 1;
+    topology->cpu_nodes  = NULL;
+    topology->cpu_count  = 0;
+
+    size_t node_count = 0;
+    size_t cpu_count  = 0;
+#ifdef BLOWFISH_LIBNUMA
+    if (numa_available() >= 0)
+    {
+        node_count = (size_t) numa_max_node() + 1;
+        cpu_count  = (size_t) numa_num_possible_cpus();
+    }
+#else
+    node_count = blowfish_numa_read_list("/sys/devices/system/node/online", NULL, 0, 0);
+    cpu_count  = blowfish_numa_read_list("/sys/devices/system/cpu/possible", NULL, 0, 0);
+#endif
+    if (node_count <= 1 || cpu_count == 0)
+    {
+        return;
+    }
+
+    size_t *cpu_nodes = calloc(cpu_count, sizeof (size_t));
+    if (cpu_nodes == NULL)
+    {
+        return;
+    }
+
+#ifdef BLOWFISH_LIBNUMA
+    for (size_t cpu = 0; cpu < cpu_count; ++cpu)
+    {
+        int node = numa_node_of_cpu((int) cpu);
+        cpu_nodes[cpu] = node >= 0 ? (size_t) node : 0;
+    }
+#else
+    for (size_t node = 0; node < node_count; ++node)
+    {
+        char path[64];
+        snprintf(path, sizeof (path), "/sys/devices/system/node/node%zu/cpulist", node);
+        blowfish_numa_read_list(path, cpu_nodes, cpu_count, node);
+    }
+#endif
+
+    topology->node_count = node_count;
+    topology->cpu_nodes  = cpu_nodes;
+    topology->cpu_count  = cpu_count;
+}
+
+
+/**
+ * Allocates zeroed memory on a NUMA node
+ *
+ * Placement is best effort: if the node cannot be selected, the memory is
+ * still returned, allocated wherever the kernel placed it.
+ *
+ * @param size Size of the allocation, a multiple of the page size
+ * @param node The node
+ * @return     The memory, or NULL if out of memory
+ */
+static bf_state *blowfish_numa_alloc(size_t size, size_t node)
+{
+#ifdef BLOWFISH_LIBNUMA
+    return numa_alloc_onnode(size, (int) node);
+#else
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    // The policy is set before the pages are touched, so that they are allocated on the node
+    long rc = -1;
+    unsigned long node_mask[BF_NUMA_MASK_WORDS];
+    if (node < 8 * sizeof (node_mask))
+    {
+        memset(node_mask, 0, sizeof (node_mask));
+        node_mask[node / (8 * sizeof (unsigned long))] = 1UL << (node % (8 * sizeof (unsigned long)));
+        rc = syscall(SYS_mbind, memory, size, BF_NUMA_MPOL_PREFERRED, node_mask,
+                     (unsigned long) (8 * sizeof (node_mask)), 0U);
+    }
+    if (rc != 0)
+    {
+        // Without a policy, e.g. if mbind() is refused, the pages are allocated
+        // by touching them and then moved to the node
+        size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+        for (size_t offset = 0; offset < size; offset += page_size)
+        {
+            void *page = (unsigned char *) memory + offset;
+            int target_node = (int) node;
+            int status = 0;
+            memset(page, 0, page_size);
+            syscall(SYS_move_pages, 0, 1UL, &page, &target_node, &status, BF_NUMA_MPOL_MF_MOVE);
+        }
+    }
+
+#ifdef MADV_DONTDUMP
+    // Keep key material out of core dumps
+    madvise(memory, size, MADV_DONTDUMP);
+#endif
+
+    return memory;
+#endif
+}
+
+
+/**
+ * Frees memory allocated by blowfish_numa_alloc()
+ *
+ * @param replica The memory
+ * @param size    Size of the allocation
+ */
+static void blowfish_numa_free(bf_state *replica, size_t size)
+{
+#ifdef BLOWFISH_LIBNUMA
+    numa_free(replica, size);
+#else
+    munmap(replica, size);
+#endif
+}
+
+
+#ifndef BLOWFISH_LIBNUMA
+/**
+ * Reads a sysfs list of node or CPU numbers, e.g. "0-3,8-11"
+ *
+ * @param path       Path of the list
+ * @param marks      Optional; each entry indexed by a number in the list is set to value
+ * @param mark_count Number of entries of marks
+ * @param value      The value to set
+ * @return           The highest number in the list plus 1, or 0 if the list cannot be read
+ */
+static size_t blowfish_numa_read_list(const char *path, size_t *marks, size_t mark_count, size_t value)
+{
+    FILE *list_file = fopen(path, "r");
+    if (list_file == NULL)
+    {
+        return 0;
+    }
+
+    char list[BF_NUMA_LIST_LENGTH];
+    size_t list_length = fread(list, 1, sizeof (list) - 1, list_file);
+    fclose(list_file);
+    list[list_length] = '\0';
+
+    size_t limit = 0;
+    char *position = list;
+    while (*position >= '0' && *position <= '9')
+    {
+        unsigned long first = strtoul(position, &position, 10);
+        unsigned long last = first;
+        if (*position == '-')
+        {
+            last = strtoul(position + 1, &position, 10);
+        }
+        for (unsigned long number = first; number <= last && number < mark_count; ++number)
+        {
+            marks[number] = value;
+        }
+        if (last + 1 > limit)
+        {
+            limit = last + 1;
+        }
+        if (*position == ',')
+        {
+            ++position;
+        }
+    }
+
+    return limit;
+}
+#endif
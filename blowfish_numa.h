@@ -0,0 +1,58 @@
+#ifndef BLOWFISH_NUMA_H
+#define	BLOWFISH_NUMA_H
+
+#include <blowfish.h>
+
+typedef struct bf_numa_state_s bf_numa_state;
+
+/**
+ * Returns the number of NUMA nodes
+ *
+ * @return Number of nodes; 1 on single-node systems and if the topology is unknown
+ */
+size_t blowfish_numa_node_count(void);
+
+/**
+ * Replicates an expanded key schedule into the local memory of each NUMA node
+ *
+ * Each copy is placed on its node with libnuma if the library was built with
+ * BLOWFISH_LIBNUMA, and with the mbind() or move_pages() system calls otherwise.
+ * On single-node systems, no copies are made and the source state is used.
+ *
+ * @param state The cipher state object to replicate; must remain valid until
+ *              the replicas are destroyed
+ * @return      The replicas, or NULL if out of memory
+ */
+bf_numa_state *blowfish_numa_replicate(const bf_state *state);
+
+/**
+ * Clears and frees the replicas of a key schedule
+ *
+ * The source state is not modified.
+ *
+ * @param replicas The replicas to destroy
+ */
+void blowfish_numa_destroy(bf_numa_state *replicas);
+
+/**
+ * Returns the replica on the NUMA node of the calling thread's current CPU
+ *
+ * All replicas are identical, so a thread that migrates to another node
+ * while using a replica still gets correct results, only slower.
+ *
+ * @param replicas The replicas
+ * @return         The node-local cipher state object, or the source state if
+ *                 there is no replica for the node
+ */
+const bf_state *blowfish_numa_local(const bf_numa_state *replicas);
+
+/**
+ * Returns the replica on a specific NUMA node
+ *
+ * @param replicas The replicas
+ * @param node     The node
+ * @return         The cipher state object, or the source state if there is no replica for the node
+ */
+const bf_state *blowfish_numa_node_state(const bf_numa_state *replicas, size_t node);
+
+#endif	/* BLOWFISH_NUMA_H */
@@ -0,0 +1,307 @@
+/**
+ * Multi-threaded Blowfish mode functions
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <blowfish_cfb64.h>
+#include <blowfish_ctr64.h>
+#include <blowfish_endian.h>
+#include <blowfish_thread.h>
+
+extern const size_t BF_CFB64_BLOCK_SIZE;
+extern const size_t BF_CTR64_BLOCK_SIZE;
+
+// Minimum number of blocks per thread, smaller chunks do not pay for the thread startup
+const size_t BF_PARALLEL_MIN_BLOCKS = 4096;
+
+typedef struct bf_cfb64_chunk_s bf_cfb64_chunk;
+struct bf_cfb64_chunk_s
+{
+    bf_cfb64_state      cfb_state;
+    const unsigned char *input;
+    unsigned char       *output;
+    size_t              data_length;
+};
+
+typedef struct bf_ctr64_chunk_s bf_ctr64_chunk;
+struct bf_ctr64_chunk_s
+{
+    bf_ctr64_state      *ctr_state;
+    const unsigned char *input;
+    unsigned char       *output;
+    size_t              data_length;
+    uint64_t            offset;
+};
+
+static size_t blowfish_parallel_chunk_count(size_t full_blocks, size_t thread_count);
+static void blowfish_cfb64_decrypt_chunk(void *context, size_t chunk_index);
+static void blowfish_ctr64_crypt_chunk(void *context, size_t chunk_index);
+
+
+/**
+ * Decrypts the supplied data in-place, using multiple threads
+ *
+ * @param cfb_state    CFB mode state object
+ * @param data         Cipher text input data to decrypt
+ * @param data_length  Length of the input data
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_cfb64_decrypt_parallel(bf_cfb64_state *cfb_state,
+                                     unsigned char *data, size_t data_length,
+                                     size_t thread_count)
+{
+    blowfish_cfb64_decrypt_copy_parallel(cfb_state, data, data, data_length, thread_count);
+}
+
+
+/**
+ * Decrypts the supplied data into a separate output buffer, using multiple threads
+ *
+ * @param cfb_state    CFB mode state object
+ * @param input        Cipher text input data to decrypt
+ * @param output       Receives the plain text; may be the same buffer as input
+ * @param data_length  Length of the input data
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_cfb64_decrypt_copy_parallel(bf_cfb64_state *cfb_state, const unsigned char *input,
+                                          unsigned char *output, size_t data_length,
+                                          size_t thread_count)
+{
+    // Finish the block started by a previous call, so that the chunks start on block boundaries
+    if (cfb_state->position > 0)
+    {
+        size_t lead_length = BF_CFB64_BLOCK_SIZE - cfb_state->position;
+        if (lead_length > data_length)
+        {
+            lead_length = data_length;
+        }
+        blowfish_cfb64_decrypt_copy(cfb_state, input, output, lead_length);
+        input = &input[lead_length];
+        output = &output[lead_length];
+        data_length -= lead_length;
+    }
+
+    size_t full_blocks = data_length / BF_CFB64_BLOCK_SIZE;
+    size_t chunk_count = blowfish_parallel_chunk_count(full_blocks, thread_count);
+
+    bf_cfb64_chunk *chunks = NULL;
+    if (chunk_count > 1)
+    {
+        chunks = malloc(sizeof (bf_cfb64_chunk) * chunk_count);
+    }
+
+    if (chunks != NULL)
+    {
+        // The feedback for each chunk is the last cipher text block of the
+        // preceding chunk, which must be read before any chunk is decrypted
+        size_t block_offset = 0;
+        for (size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+        {
+            size_t next_block_offset = full_blocks / chunk_count * (chunk_index + 1);
+            bf_cfb64_chunk *chunk = &chunks[chunk_index];
+            chunk->cfb_state.cipher_state = cfb_state->cipher_state;
+            chunk->cfb_state.feedback = chunk_index == 0 ?
+                cfb_state->feedback :
+                blowfish_load_be64(&input[(block_offset - 1) * BF_CFB64_BLOCK_SIZE]);
+            chunk->cfb_state.position = 0;
+            chunk->input = &input[block_offset * BF_CFB64_BLOCK_SIZE];
+            chunk->output = &output[block_offset * BF_CFB64_BLOCK_SIZE];
+            chunk->data_length = (next_block_offset - block_offset) * BF_CFB64_BLOCK_SIZE;
+            block_offset = next_block_offset;
+        }
+        // The last chunk also decrypts the remaining blocks and any incomplete block
+        bf_cfb64_chunk *last_chunk = &chunks[chunk_count - 1];
+        last_chunk->data_length = data_length - (size_t) (last_chunk->input - input);
+
+        blowfish_thread_run(blowfish_cfb64_decrypt_chunk, chunks, chunk_count);
+
+        cfb_state->feedback = last_chunk->cfb_state.feedback;
+        cfb_state->position = last_chunk->cfb_state.position;
+
+        free(chunks);
+    }
+    else
+    {
+        // Too little data to split, or out of memory
+        blowfish_cfb64_decrypt_copy(cfb_state, input, output, data_length);
+    }
+}
+
+
+/**
+ * Encrypts the supplied data in-place, using multiple threads
+ *
+ * @param ctr_state    CTR mode state object
+ * @param data         Plain text input data to encrypt
+ * @param data_length  Length of the input data
+ * @param offset       Position of the first byte of data within the stream
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_ctr64_encrypt_parallel(bf_ctr64_state *ctr_state,
+                                     unsigned char *data, size_t data_length, uint64_t offset,
+                                     size_t thread_count)
+{
+    blowfish_ctr64_encrypt_copy_parallel(ctr_state, data, data, data_length, offset, thread_count);
+}
+
+
+/**
+ * Decrypts the supplied data in-place, using multiple threads
+ *
+ * @param ctr_state    CTR mode state object
+ * @param data         Cipher text input data to decrypt
+ * @param data_length  Length of the input data
+ * @param offset       Position of the first byte of data within the stream
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_ctr64_decrypt_parallel(bf_ctr64_state *ctr_state,
+                                     unsigned char *data, size_t data_length, uint64_t offset,
+                                     size_t thread_count)
+{
+    // Encryption and decryption are the same operation in CTR mode
+    blowfish_ctr64_encrypt_copy_parallel(ctr_state, data, data, data_length, offset, thread_count);
+}
+
+
+/**
+ * Encrypts the supplied data into a separate output buffer, using multiple threads
+ *
+ * @param ctr_state    CTR mode state object
+ * @param input        Plain text input data to encrypt
+ * @param output       Receives the cipher text; may be the same buffer as input
+ * @param data_length  Length of the input data
+ * @param offset       Position of the first byte of data within the stream
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_ctr64_encrypt_copy_parallel(bf_ctr64_state *ctr_state, const unsigned char *input,
+                                          unsigned char *output, size_t data_length, uint64_t offset,
+                                          size_t thread_count)
+{
+    size_t full_blocks = data_length / BF_CTR64_BLOCK_SIZE;
+    size_t chunk_count = blowfish_parallel_chunk_count(full_blocks, thread_count);
+
+    bf_ctr64_chunk *chunks = NULL;
+    if (chunk_count > 1)
+    {
+        chunks = malloc(sizeof (bf_ctr64_chunk) * chunk_count);
+    }
+
+    if (chunks != NULL)
+    {
+        // CTR mode chunks are independent, so they only need to be
+        // a multiple of the block size to keep the split cheap
+        size_t chunk_length = full_blocks / chunk_count * BF_CTR64_BLOCK_SIZE;
+        for (size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+        {
+            bf_ctr64_chunk *chunk = &chunks[chunk_index];
+            chunk->ctr_state   = ctr_state;
+            chunk->input       = &input[chunk_index * chunk_length];
+            chunk->output      = &output[chunk_index * chunk_length];
+            chunk->data_length = chunk_length;
+            chunk->offset      = offset + chunk_index * chunk_length;
+        }
+        // The last chunk also processes the remaining data
+        chunks[chunk_count - 1].data_length = data_length - (chunk_count - 1) * chunk_length;
+
+        blowfish_thread_run(blowfish_ctr64_crypt_chunk, chunks, chunk_count);
+
+        free(chunks);
+    }
+    else
+    {
+        // Too little data to split, or out of memory
+        blowfish_ctr64_encrypt_copy(ctr_state, input, output, data_length, offset);
+    }
+}
+
+
+/**
+ * Decrypts the supplied data into a separate output buffer, using multiple threads
+ *
+ * @param ctr_state    CTR mode state object
+ * @param input        Cipher text input data to decrypt
+ * @param output       Receives the plain text; may be the same buffer as input
+ * @param data_length  Length of the input data
+ * @param offset       Position of the first byte of data within the stream
+ * @param thread_count Maximum number of threads to use, including the calling thread
+ */
+void blowfish_ctr64_decrypt_copy_parallel(bf_ctr64_state *ctr_state, const unsigned char *input,
+                                          unsigned char *output, size_t data_length, uint64_t offset,
+                                          size_t thread_count)
+{
+    // Encryption and decryption are the same operation in CTR mode
+    blowfish_ctr64_encrypt_copy_parallel(ctr_state, input, output, data_length, offset, thread_count);
+}
+
+
+/**
+ * Calculates the number of chunks to split an operation into
+ *
+ * @param full_blocks  The number of full blocks to process
+ * @param thread_count Maximum number of threads to use
+ * @return             The number of chunks; 0 or 1 if the data should not be split
+ */
+static size_t blowfish_parallel_chunk_count(size_t full_blocks, size_t thread_count)
+{
+    size_t chunk_count = full_blocks / BF_PARALLEL_MIN_BLOCKS;
+    if (chunk_count > thread_count)
+    {
+        chunk_count = thread_count;
+    }
+
+    return chunk_count;
+}
+
+
+/**
+ * Decrypts a single chunk of data in CFB mode
+ *
+ * @param context     The array of chunks
+ * @param chunk_index Index of the chunk to decrypt
+ */
+static void blowfish_cfb64_decrypt_chunk(void *context, size_t chunk_index)
+{
+    bf_cfb64_chunk *chunk = &((bf_cfb64_chunk *) context)[chunk_index];
+    blowfish_cfb64_decrypt_copy(&chunk->cfb_state, chunk->input, chunk->output, chunk->data_length);
+}
+
+
+/**
+ * Encrypts or decrypts a single chunk of data in CTR mode
+ *
+ * @param context     The array of chunks
+ * @param chunk_index Index of the chunk to process
+ */
+static void blowfish_ctr64_crypt_chunk(void *context, size_t chunk_index)
+{
+    bf_ctr64_chunk *chunk = &((bf_ctr64_chunk *) context)[chunk_index];
+    blowfish_ctr64_encrypt_copy(chunk->ctr_state, chunk->input, chunk->output,
+                                chunk->data_length, chunk->offset);
+}
@@ -0,0 +1,508 @@
+/**
+ * Pool of cache-line-aligned cipher contexts with per-thread caches
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _DEFAULT_SOURCE
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish_pool.h>
+#include <blowfish_stats.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Cache line size, the alignment of each context
+const size_t BF_POOL_ALIGNMENT = 64;
+
+// Default slab size (2 MiB == the huge page size on x86-64)
+const size_t BF_POOL_DEFAULT_SLAB_SIZE = 2 * 1024 * 1024;
+
+// Number of contexts moved between a thread's cache and the shared free list at once
+const size_t BF_POOL_TRANSFER_COUNT = 32;
+
+typedef struct bf_pool_node_s bf_pool_node;
+struct bf_pool_node_s
+{
+    bf_pool_node *next;
+};
+
+typedef struct bf_pool_slab_s bf_pool_slab;
+struct bf_pool_slab_s
+{
+    void         *memory;
+    size_t       size;
+    bf_pool_slab *next;
+};
+
+typedef struct bf_pool_cache_s bf_pool_cache;
+struct bf_pool_cache_s
+{
+    bf_pool       *pool;
+    bf_pool_node  *free_list;
+    size_t        free_count;
+    bf_pool_cache *prev;
+    bf_pool_cache *next;
+};
+
+struct bf_pool_s
+{
+    pthread_mutex_t lock;
+    pthread_key_t   cache_key;
+    // Free contexts that are not in any thread's cache
+    bf_pool_node    *free_list;
+    bf_pool_slab    *slabs;
+    bf_pool_cache   *caches;
+    size_t          slot_size;
+    size_t          slab_size;
+    unsigned int    flags;
+};
+
+static bf_pool_cache *blowfish_pool_cache(bf_pool *pool);
+static void blowfish_pool_cache_release(void *arg);
+static int blowfish_pool_add_slab(bf_pool *pool);
+static size_t blowfish_pool_round_up(size_t value, size_t alignment);
+
+
+/**
+ * Creates a pool of cipher contexts
+ *
+ * @param slab_size Size of each slab in bytes; 0 selects a default
+ * @param flags     Combination of BF_POOL_HUGE_PAGES and BF_POOL_LOCKED
+ * @return          The new pool, or NULL if out of resources
+ */
+bf_pool *blowfish_pool_create(size_t slab_size, unsigned int flags)
+{
+    bf_pool *pool = malloc(sizeof (bf_pool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+
+    if (pthread_key_create(&pool->cache_key, blowfish_pool_cache_release) != 0)
+    {
+        free(pool);
+        return NULL;
+    }
+
+    size_t context_size = sizeof (bf_cfb64_context) > sizeof (bf_ctr64_context) ?
+                          sizeof (bf_cfb64_context) : sizeof (bf_ctr64_context);
+    pool->slot_size = blowfish_pool_round_up(context_size, BF_POOL_ALIGNMENT);
+
+    // Slabs are whole pages and hold at least one context
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    if (slab_size == 0)
+    {
+        slab_size = BF_POOL_DEFAULT_SLAB_SIZE;
+    }
+    if (slab_size < pool->slot_size)
+    {
+        slab_size = pool->slot_size;
+    }
+    pool->slab_size = blowfish_pool_round_up(slab_size, page_size);
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->free_list = NULL;
+    pool->slabs     = NULL;
+    pool->caches    = NULL;
+    pool->flags     = flags;
+
+    return pool;
+}
+
+
+/**
+ * Destroys a pool and unmaps all of its slabs
+ *
+ * @param pool The pool to destroy
+ */
+void blowfish_pool_destroy(bf_pool *pool)
+{
+    if (pool != NULL)
+    {
+        // Thread caches are no longer released on thread exit once the key is deleted
+        pthread_key_delete(pool->cache_key);
+
+        bf_pool_cache *cache = pool->caches;
+        while (cache != NULL)
+        {
+            bf_pool_cache *next = cache->next;
+            free(cache);
+            cache = next;
+        }
+
+        bf_pool_slab *slab = pool->slabs;
+        while (slab != NULL)
+        {
+            bf_pool_slab *next = slab->next;
+            munmap(slab->memory, slab->size);
+            free(slab);
+            slab = next;
+        }
+
+        pthread_mutex_destroy(&pool->lock);
+        free(pool);
+    }
+}
+
+
+/**
+ * Takes a context from the pool and initializes it for CFB mode
+ *
+ * @param pool        The pool
+ * @param key         The key to initialize the cipher with
+ * @param key_length  The length of the key
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CFB mode state object, or NULL if out of memory
+ */
+bf_cfb64_state *blowfish_pool_cfb64_create(bf_pool *pool, const unsigned char *key, size_t key_length,
+                                           uint64_t init_vector)
+{
+    bf_cfb64_state *cfb_state = NULL;
+    bf_cfb64_context *context = blowfish_pool_alloc(pool);
+    if (context != NULL)
+    {
+        cfb_state = blowfish_cfb64_create_in(context, key, key_length, init_vector);
+    }
+
+    return cfb_state;
+}
+
+
+/**
+ * Clears a CFB mode context and returns it to the pool
+ *
+ * @param pool      The pool the context was taken from
+ * @param cfb_state The CFB mode state object returned by blowfish_pool_cfb64_create()
+ */
+void blowfish_pool_cfb64_destroy(bf_pool *pool, bf_cfb64_state *cfb_state)
+{
+    bf_cfb64_context *context = blowfish_cfb64_context_of(cfb_state);
+    blowfish_cfb64_destroy_in(context);
+    blowfish_pool_free(pool, context);
+}
+
+
+/**
+ * Takes a context from the pool and initializes it for CTR mode
+ *
+ * @param pool        The pool
+ * @param key         The key to initialize the cipher with
+ * @param key_length  The length of the key
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CTR mode state object, or NULL if out of memory
+ */
+bf_ctr64_state *blowfish_pool_ctr64_create(bf_pool *pool, const unsigned char *key, size_t key_length,
+                                           uint64_t init_vector)
+{
+    bf_ctr64_state *ctr_state = NULL;
+    bf_ctr64_context *context = blowfish_pool_alloc(pool);
+    if (context != NULL)
+    {
+        ctr_state = blowfish_ctr64_create_in(context, key, key_length, init_vector);
+    }
+
+    return ctr_state;
+}
+
+
+/**
+ * Clears a CTR mode context and returns it to the pool
+ *
+ * @param pool      The pool the context was taken from
+ * @param ctr_state The CTR mode state object returned by blowfish_pool_ctr64_create()
+ */
+void blowfish_pool_ctr64_destroy(bf_pool *pool, bf_ctr64_state *ctr_state)
+{
+    bf_ctr64_context *context = blowfish_ctr64_context_of(ctr_state);
+    blowfish_ctr64_destroy_in(context);
+    blowfish_pool_free(pool, context);
+}
+
+
+/**
+ * Takes uninitialized storage for a context from the pool
+ *
+ * @param pool The pool
+ * @return     The storage, or NULL if out of memory
+ */
+void *blowfish_pool_alloc(bf_pool *pool)
+{
+    bf_pool_node *node = NULL;
+    bf_pool_cache *cache = blowfish_pool_cache(pool);
+    if (cache != NULL && cache->free_list != NULL)
+    {
+        // Fast path, no lock required
+        node = cache->free_list;
+        cache->free_list = node->next;
+        --cache->free_count;
+    }
+    else
+    {
+        pthread_mutex_lock(&pool->lock);
+        if (pool->free_list != NULL || blowfish_pool_add_slab(pool) == 0)
+        {
+            node = pool->free_list;
+            pool->free_list = node->next;
+
+            // Refill the thread's cache for subsequent allocations
+            if (cache != NULL)
+            {
+                while (pool->free_list != NULL && cache->free_count < BF_POOL_TRANSFER_COUNT)
+                {
+                    bf_pool_node *transfer = pool->free_list;
+                    pool->free_list = transfer->next;
+                    transfer->next = cache->free_list;
+                    cache->free_list = transfer;
+                    ++cache->free_count;
+                }
+            }
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    if (node != NULL)
+    {
+        BF_STATS_COUNT(BF_STATS_ALLOCATIONS, 1);
+    }
+
+    return node;
+}
+
+
+/**
+ * Returns storage taken by blowfish_pool_alloc() to the pool
+ *
+ * @param pool    The pool the storage was taken from
+ * @param storage The storage
+ */
+void blowfish_pool_free(bf_pool *pool, void *storage)
+{
+    bf_pool_node *node = storage;
+    bf_pool_cache *cache = blowfish_pool_cache(pool);
+    if (cache != NULL)
+    {
+        node->next = cache->free_list;
+        cache->free_list = node;
+        ++cache->free_count;
+
+        // Return surplus contexts, so that contexts freed by one thread
+        // can be reused by others
+        if (cache->free_count >= 2 * BF_POOL_TRANSFER_COUNT)
+        {
+            pthread_mutex_lock(&pool->lock);
+            for (size_t count = 0; count < BF_POOL_TRANSFER_COUNT; ++count)
+            {
+                bf_pool_node *transfer = cache->free_list;
+                cache->free_list = transfer->next;
+                transfer->next = pool->free_list;
+                pool->free_list = transfer;
+            }
+            cache->free_count -= BF_POOL_TRANSFER_COUNT;
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+    else
+    {
+        pthread_mutex_lock(&pool->lock);
+        node->next = pool->free_list;
+        pool->free_list = node;
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+
+/**
+ * Returns the calling thread's cache, creating it on first use
+ *
+ * @param pool The pool
+ * @return     The thread's cache, or NULL if out of memory
+ */
+static bf_pool_cache *blowfish_pool_cache(bf_pool *pool)
+{
+    bf_pool_cache *cache = pthread_getspecific(pool->cache_key);
+    if (cache == NULL)
+    {
+        cache = malloc(sizeof (bf_pool_cache));
+        if (cache != NULL)
+        {
+            cache->pool       = pool;
+            cache->free_list  = NULL;
+            cache->free_count = 0;
+            cache->prev       = NULL;
+            if (pthread_setspecific(pool->cache_key, cache) == 0)
+            {
+                pthread_mutex_lock(&pool->lock);
+                cache->next = pool->caches;
+                if (pool->caches != NULL)
+                {
+                    pool->caches->prev = cache;
+                }
+                pool->caches = cache;
+                pthread_mutex_unlock(&pool->lock);
+            }
+            else
+            {
+                free(cache);
+                cache = NULL;
+            }
+        }
+    }
+
+    return cache;
+}
+
+
+/**
+ * Returns the contexts of a thread's cache to the pool and frees the cache
+ *
+ * Called on thread exit.
+ *
+ * @param arg The thread's cache
+ */
+static void blowfish_pool_cache_release(void *arg)
+{
+    bf_pool_cache *cache = arg;
+    bf_pool *pool = cache->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    while (cache->free_list != NULL)
+    {
+        bf_pool_node *transfer = cache->free_list;
+        cache->free_list = transfer->next;
+        transfer->next = pool->free_list;
+        pool->free_list = transfer;
+    }
+
+    if (cache->prev != NULL)
+    {
+        cache->prev->next = cache->next;
+    }
+    else
+    {
+        pool->caches = cache->next;
+    }
+    if (cache->next != NULL)
+    {
+        cache->next->prev = cache->prev;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    free(cache);
+}
+
+
+/**
+ * Maps a new slab and adds its contexts to the shared free list
+ *
+ * @param pool The pool, must be locked
+ * @return     0 on success, -1 if out of resources
+ */
+static int blowfish_pool_add_slab(bf_pool *pool)
+{
+    bf_pool_slab *slab = malloc(sizeof (bf_pool_slab));
+    if (slab == NULL)
+    {
+        return -1;
+    }
+
+    slab->size   = pool->slab_size;
+    slab->memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if ((pool->flags & BF_POOL_HUGE_PAGES) != 0)
+    {
+        // Huge page mappings must be a multiple of the huge page size
+        slab->size   = blowfish_pool_round_up(pool->slab_size, BF_POOL_DEFAULT_SLAB_SIZE);
+        slab->memory = mmap(NULL, slab->size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (slab->memory == MAP_FAILED)
+        {
+            slab->size = pool->slab_size;
+        }
+    }
+#endif
+    if (slab->memory == MAP_FAILED)
+    {
+        slab->memory = mmap(NULL, slab->size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (slab->memory == MAP_FAILED)
+        {
+            free(slab);
+            return -1;
+        }
+#ifdef MADV_HUGEPAGE
+        // Fall back to transparent huge pages
+        if ((pool->flags & BF_POOL_HUGE_PAGES) != 0)
+        {
+            madvise(slab->memory, slab->size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+#ifdef MADV_DONTDUMP
+    // Keep key material out of core dumps
+    madvise(slab->memory, slab->size, MADV_DONTDUMP);
+#endif
+
+    if ((pool->flags & BF_POOL_LOCKED) != 0 && mlock(slab->memory, slab->size) != 0)
+    {
+        munmap(slab->memory, slab->size);
+        free(slab);
+        return -1;
+    }
+
+    // Thread the slots in address order onto the free list
+    size_t slot_count = slab->size / pool->slot_size;
+    unsigned char *memory = slab->memory;
+    for (size_t slot_index = slot_count; slot_index > 0; --slot_index)
+    {
+        bf_pool_node *node = (bf_pool_node *) &memory[(slot_index - 1) * pool->slot_size];
+        node->next = pool->free_list;
+        pool->free_list = node;
+    }
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    return 0;
+}
+
+
+/**
+ * Rounds a value up to a multiple of an alignment
+ *
+ * @param value     The value to round up
+ * @param alignment The alignment, must be a power of two
+ * @return          The rounded value
+ */
+static size_t blowfish_pool_round_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
@@ -0,0 +1,100 @@
+#ifndef BLOWFISH_POOL_H
+#define	BLOWFISH_POOL_H
+
+#include <blowfish_cfb64.h>
+#include <blowfish_ctr64.h>
+
+// Back the slabs with huge pages if available
+#define BF_POOL_HUGE_PAGES 0x1
+
+// Lock the slabs into memory, so that key material is never swapped out
+#define BF_POOL_LOCKED     0x2
+
+typedef struct bf_pool_s bf_pool;
+
+/**
+ * Creates a pool of cipher contexts
+ *
+ * Contexts are carved from slabs of memory that are mapped on demand and
+ * aligned to the cache line size. Each thread keeps a cache of free contexts,
+ * so that taking a context from the pool and returning it usually requires
+ * neither a lock nor a memory allocation.
+ *
+ * @param slab_size Size of each slab in bytes; 0 selects a default
+ * @param flags     Combination of BF_POOL_HUGE_PAGES and BF_POOL_LOCKED
+ * @return          The new pool, or NULL if out of resources
+ */
+bf_pool *blowfish_pool_create(size_t slab_size, unsigned int flags);
+
+/**
+ * Destroys a pool and unmaps all of its slabs
+ *
+ * All contexts must have been returned to the pool, and no other thread
+ * may use the pool concurrently.
+ *
+ * @param pool The pool to destroy
+ */
+void blowfish_pool_destroy(bf_pool *pool);
+
+/**
+ * Takes a context from the pool and initializes it for CFB mode
+ *
+ * @param pool        The pool
+ * @param key         The key to initialize the cipher with
+ * @param key_length  The length of the key
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CFB mode state object, or NULL if out of memory
+ */
+bf_cfb64_state *blowfish_pool_cfb64_create(bf_pool *pool, const unsigned char *key, size_t key_length,
+                                           uint64_t init_vector);
+
+/**
+ * Clears a CFB mode context and returns it to the pool
+ *
+ * @param pool      The pool the context was taken from
+ * @param cfb_state The CFB mode state object returned by blowfish_pool_cfb64_create()
+ */
+void blowfish_pool_cfb64_destroy(bf_pool *pool, bf_cfb64_state *cfb_state);
+
+/**
+ * Takes a context from the pool and initializes it for CTR mode
+ *
+ * @param pool        The pool
+ * @param key         The key to initialize the cipher with
+ * @param key_length  The length of the key
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CTR mode state object, or NULL if out of memory
+ */
+bf_ctr64_state *blowfish_pool_ctr64_create(bf_pool *pool, const unsigned char *key, size_t key_length,
+                                           uint64_t init_vector);
+
+/**
+ * Clears a CTR mode context and returns it to the pool
+ *
+ * @param pool      The pool the context was taken from
+ * @param ctr_state The CTR mode state object returned by blowfish_pool_ctr64_create()
+ */
+void blowfish_pool_ctr64_destroy(bf_pool *pool, bf_ctr64_state *ctr_state);
+
+/**
+ * Takes uninitialized storage for a context from the pool
+ *
+ * The storage is aligned to the cache line size and large enough for a
+ * bf_cfb64_context or a bf_ctr64_context object.
+ *
+ * @param pool The pool
+ * @return     The storage, or NULL if out of memory
+ */
+void *blowfish_pool_alloc(bf_pool *pool);
+
+/**
+ * Returns storage taken by blowfish_pool_alloc() to the pool
+ *
+ * The storage is not cleared.
+ *
+ * @param pool    The pool the storage was taken from
+ * @param storage The storage
+ */
+void blowfish_pool_free(bf_pool *pool, void *storage);
+
+#endif	/* BLOWFISH_POOL_H */
@@ -0,0 +1,195 @@
+/**
+ * Immutable, reference-counted key schedules shared by multiple streams
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish_schedule.h>
+#include <blowfish_stats.h>
+#include <string.h>
+
+// Cache line size, the alignment of each key schedule
+const size_t BF_SCHEDULE_ALIGNMENT = 64;
+
+struct bf_key_schedule_s
+{
+    // First member, so that the cipher state starts on a cache line
+    // and a schedule can be found from its cipher state
+    bf_state cipher_state;
+    size_t   references;
+};
+
+static bf_key_schedule *blowfish_schedule_of(const bf_state *state);
+
+
+/**
+ * Creates an immutable, reference-counted key schedule
+ *
+ * @param key        The key
+ * @param key_length The length of the key
+ * @return           The key schedule with a reference count of 1, or NULL if out of memory
+ */
+bf_key_schedule *blowfish_schedule_create(const unsigned char *key, size_t key_length)
+{
+    void *memory = NULL;
+    if (posix_memalign(&memory, BF_SCHEDULE_ALIGNMENT, sizeof (bf_key_schedule)) != 0)
+    {
+        return NULL;
+    }
+
+    bf_key_schedule *schedule = memory;
+    blowfish_init(&schedule->cipher_state);
+    blowfish_set_key(&schedule->cipher_state, key, key_length);
+    schedule->references = 1;
+    BF_STATS_COUNT(BF_STATS_ALLOCATIONS, 1);
+
+    return schedule;
+}
+
+
+/**
+ * Adds a reference to a key schedule
+ *
+ * @param schedule The key schedule
+ * @return         The key schedule
+ */
+bf_key_schedule *blowfish_schedule_retain(bf_key_schedule *schedule)
+{
+    // The caller already holds a reference, so no ordering is required
+    __atomic_add_fetch(&schedule->references, 1, __ATOMIC_RELAXED);
+    return schedule;
+}
+
+
+/**
+ * Removes a reference from a key schedule, clearing and freeing it with the last reference
+ *
+ * @param schedule The key schedule
+ */
+void blowfish_schedule_release(bf_key_schedule *schedule)
+{
+    // Orders all uses by other threads before the cipher state is cleared
+    if (__atomic_sub_fetch(&schedule->references, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        blowfish_clear(&schedule->cipher_state);
+        free(schedule);
+    }
+}
+
+
+/**
+ * Returns the cipher state of a key schedule
+ *
+ * @param schedule The key schedule
+ * @return         The cipher state object
+ */
+const bf_state *blowfish_schedule_state(const bf_key_schedule *schedule)
+{
+    return &schedule->cipher_state;
+}
+
+
+/**
+ * Creates a CFB mode state object that uses a shared key schedule
+ *
+ * @param schedule    The key schedule
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CFB mode state object, or NULL if out of memory
+ */
+bf_cfb64_state *blowfish_schedule_cfb64_create(bf_key_schedule *schedule, uint64_t init_vector)
+{
+    bf_cfb64_state *cfb_state = malloc(sizeof (bf_cfb64_state));
+    if (cfb_state != NULL)
+    {
+        blowfish_cfb64_init(cfb_state, &blowfish_schedule_retain(schedule)->cipher_state, init_vector);
+        BF_STATS_COUNT(BF_STATS_ALLOCATIONS, 1);
+    }
+
+    return cfb_state;
+}
+
+
+/**
+ * Destroys a CFB mode state object created by blowfish_schedule_cfb64_create()
+ *
+ * @param cfb_state The CFB mode state object
+ */
+void blowfish_schedule_cfb64_destroy(bf_cfb64_state *cfb_state)
+{
+    blowfish_schedule_release(blowfish_schedule_of(cfb_state->cipher_state));
+    memset(cfb_state, 0, sizeof (bf_cfb64_state));
+    free(cfb_state);
+}
+
+
+/**
+ * Creates a CTR mode state object that uses a shared key schedule
+ *
+ * @param schedule    The key schedule
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CTR mode state object, or NULL if out of memory
+ */
+bf_ctr64_state *blowfish_schedule_ctr64_create(bf_key_schedule *schedule, uint64_t init_vector)
+{
+    bf_ctr64_state *ctr_state = malloc(sizeof (bf_ctr64_state));
+    if (ctr_state != NULL)
+    {
+        blowfish_ctr64_init(ctr_state, &blowfish_schedule_retain(schedule)->cipher_state, init_vector);
+        BF_STATS_COUNT(BF_STATS_ALLOCATIONS, 1);
+    }
+
+    return ctr_state;
+}
+
+
+/**
+ * Destroys a CTR mode state object created by blowfish_schedule_ctr64_create()
+ *
+ * @param ctr_state The CTR mode state object
+ */
+void blowfish_schedule_ctr64_destroy(bf_ctr64_state *ctr_state)
+{
+    blowfish_schedule_release(blowfish_schedule_of(ctr_state->cipher_state));
+    memset(ctr_state, 0, sizeof (bf_ctr64_state));
+    free(ctr_state);
+}
+
+
+/**
+ * Returns the key schedule that contains a cipher state object
+ *
+ * @param state Cipher state object of a key schedule
+ * @return      The key schedule
+ */
+static bf_key_schedule *blowfish_schedule_of(const bf_state *state)
+{
+    return (bf_key_schedule *) state;
+}
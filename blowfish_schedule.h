@@ -0,0 +1,85 @@
+#ifndef BLOWFISH_SCHEDULE_H
+#define	BLOWFISH_SCHEDULE_H
+
+#include <blowfish_cfb64.h>
+#include <blowfish_ctr64.h>
+
+typedef struct bf_key_schedule_s bf_key_schedule;
+
+/**
+ * Creates an immutable, reference-counted key schedule
+ *
+ * The key schedule is expanded once and is only read afterwards, so any number
+ * of threads can use it concurrently without locking. Streams using the same key
+ * share the key schedule instead of each carrying a copy of the S boxes.
+ *
+ * @param key        The key
+ * @param key_length The length of the key
+ * @return           The key schedule with a reference count of 1, or NULL if out of memory
+ */
+bf_key_schedule *blowfish_schedule_create(const unsigned char *key, size_t key_length);
+
+/**
+ * Adds a reference to a key schedule
+ *
+ * @param schedule The key schedule
+ * @return         The key schedule
+ */
+bf_key_schedule *blowfish_schedule_retain(bf_key_schedule *schedule);
+
+/**
+ * Removes a reference from a key schedule, clearing and freeing it with the last reference
+ *
+ * @param schedule The key schedule
+ */
+void blowfish_schedule_release(bf_key_schedule *schedule);
+
+/**
+ * Returns the cipher state of a key schedule
+ *
+ * The cipher state remains valid as long as the caller holds a reference.
+ *
+ * @param schedule The key schedule
+ * @return         The cipher state object
+ */
+const bf_state *blowfish_schedule_state(const bf_key_schedule *schedule);
+
+/**
+ * Creates a CFB mode state object that uses a shared key schedule
+ *
+ * Adds a reference to the key schedule, which is released by
+ * blowfish_schedule_cfb64_destroy().
+ *
+ * @param schedule    The key schedule
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CFB mode state object, or NULL if out of memory
+ */
+bf_cfb64_state *blowfish_schedule_cfb64_create(bf_key_schedule *schedule, uint64_t init_vector);
+
+/**
+ * Destroys a CFB mode state object created by blowfish_schedule_cfb64_create()
+ *
+ * @param cfb_state The CFB mode state object
+ */
+void blowfish_schedule_cfb64_destroy(bf_cfb64_state *cfb_state);
+
+/**
+ * Creates a CTR mode state object that uses a shared key schedule
+ *
+ * Adds a reference to the key schedule, which is released by
+ * blowfish_schedule_ctr64_destroy().
+ *
+ * @param schedule    The key schedule
+ * @param init_vector The initialization vector for the cipher
+ * @return            The CTR mode state object, or NULL if out of memory
+ */
+bf_ctr64_state *blowfish_schedule_ctr64_create(bf_key_schedule *schedule, uint64_t init_vector);
+
+/**
+ * Destroys a CTR mode state object created by blowfish_schedule_ctr64_create()
+ *
+ * @param ctr_state The CTR mode state object
+ */
+void blowfish_schedule_ctr64_destroy(bf_ctr64_state *ctr_state);
+
+#endif	/* BLOWFISH_SCHEDULE_H */
@@ -0,0 +1,499 @@
+/**
+ * SIMD kernels for block-parallel Blowfish operations
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <blowfish_simd.h>
+#include <blowfish_dispatch.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BF_SIMD_X86
+#include <immintrin.h>
+#endif
+
+extern const size_t BF_ROUNDS;
+extern const size_t BF_UNROLLED_STEP;
+
+#ifdef BF_SIMD_X86
+
+// Number of blocks per AVX2 vector
+#define BF_AVX2_LANES 8
+
+// Number of blocks per AVX-512 vector
+#define BF_AVX512_LANES 16
+
+// The kernels keep two vectors of blocks in flight, so that the gathers of
+// one vector can overlap with the arithmetic of the other one
+#define BF_AVX2_BLOCKS   (2 * BF_AVX2_LANES)
+#define BF_AVX512_BLOCKS (2 * BF_AVX512_LANES)
+
+#define BF_TARGET_AVX2   __attribute__((target("avx2")))
+#define BF_TARGET_AVX512 __attribute__((target("avx512f")))
+
+BF_TARGET_AVX2 static inline __m256i blowfish_avx2_f(const bf_state *state, __m256i value);
+BF_TARGET_AVX2 static inline void blowfish_avx2_load(const uint64_t *input,
+                                                     __m256i *data_l, __m256i *data_r);
+BF_TARGET_AVX2 static inline void blowfish_avx2_store(uint64_t *output,
+                                                      __m256i data_l, __m256i data_r);
+
+BF_TARGET_AVX512 static inline __m512i blowfish_avx512_f(const bf_state *state, __m512i value);
+BF_TARGET_AVX512 static inline void blowfish_avx512_load(const uint64_t *input,
+                                                         __m512i *data_l, __m512i *data_r);
+BF_TARGET_AVX512 static inline void blowfish_avx512_store(uint64_t *output,
+                                                          __m512i data_l, __m512i data_r);
+
+#endif /* BF_SIMD_X86 */
+
+
+/**
+ * Indicates whether the AVX2 kernel can run on this CPU
+ *
+ * @return Non-zero if the AVX2 kernel is supported, zero otherwise
+ */
+int blowfish_simd_avx2_supported(void)
+{
+#ifdef BF_SIMD_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return 0;
+#endif
+}
+
+
+/**
+ * Indicates whether the AVX-512 kernel can run on this CPU
+ *
+ * @return Non-zero if the AVX-512 kernel is supported, zero otherwise
+ */
+int blowfish_simd_avx512_supported(void)
+{
+#ifdef BF_SIMD_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+#else
+    return 0;
+#endif
+}
+
+
+#ifdef BF_SIMD_X86
+
+/**
+ * Encrypts an array of 64 bit blocks, 16 blocks at a time using AVX2
+ *
+ * Must only be called if blowfish_simd_avx2_supported() returns non-zero.
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+BF_TARGET_AVX2
+void blowfish_avx2_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                    size_t block_count)
+{
+    size_t block_index = 0;
+    for (; block_index + BF_AVX2_BLOCKS <= block_count; block_index += BF_AVX2_BLOCKS)
+    {
+        __m256i data_l0;
+        __m256i data_r0;
+        __m256i data_l1;
+        __m256i data_r1;
+        blowfish_avx2_load(&input[block_index], &data_l0, &data_r0);
+        blowfish_avx2_load(&input[block_index + BF_AVX2_LANES], &data_l1, &data_r1);
+
+        for (size_t p_box_index = 0; p_box_index < BF_ROUNDS; p_box_index += BF_UNROLLED_STEP)
+        {
+            __m256i p_even = _mm256_set1_epi32((int) state->p_box[p_box_index]);
+            __m256i p_odd  = _mm256_set1_epi32((int) state->p_box[p_box_index + 1]);
+
+            data_l0 = _mm256_xor_si256(data_l0, p_even);
+            data_l1 = _mm256_xor_si256(data_l1, p_even);
+            data_r0 = _mm256_xor_si256(data_r0, _mm256_xor_si256(blowfish_avx2_f(state, data_l0), p_odd));
+            data_r1 = _mm256_xor_si256(data_r1, _mm256_xor_si256(blowfish_avx2_f(state, data_l1), p_odd));
+            data_l0 = _mm256_xor_si256(data_l0, blowfish_avx2_f(state, data_r0));
+            data_l1 = _mm256_xor_si256(data_l1, blowfish_avx2_f(state, data_r1));
+        }
+
+        __m256i final_l = _mm256_set1_epi32((int) state->p_box[17]);
+        __m256i final_r = _mm256_set1_epi32((int) state->p_box[16]);
+        blowfish_avx2_store(&output[block_index],
+                            _mm256_xor_si256(data_r0, final_l),
+                            _mm256_xor_si256(data_l0, final_r));
+        blowfish_avx2_store(&output[block_index + BF_AVX2_LANES],
+                            _mm256_xor_si256(data_r1, final_l),
+                            _mm256_xor_si256(data_l1, final_r));
+    }
+
+    // Encrypt the remaining blocks using the interleaved scalar kernel
+    blowfish_interleaved_encrypt64_blocks(state, &input[block_index], &output[block_index],
+                                          block_count - block_index);
+}
+
+
+/**
+ * Decrypts an array of 64 bit blocks, 16 blocks at a time using AVX2
+ *
+ * Must only be called if blowfish_simd_avx2_supported() returns non-zero.
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+BF_TARGET_AVX2
+void blowfish_avx2_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                    size_t block_count)
+{
+    size_t block_index = 0;
+    for (; block_index + BF_AVX2_BLOCKS <= block_count; block_index += BF_AVX2_BLOCKS)
+    {
+        __m256i data_l0;
+        __m256i data_r0;
+        __m256i data_l1;
+        __m256i data_r1;
+        blowfish_avx2_load(&input[block_index], &data_l0, &data_r0);
+        blowfish_avx2_load(&input[block_index + BF_AVX2_LANES], &data_l1, &data_r1);
+
+        for (size_t p_box_index = BF_ROUNDS;
+             p_box_index >= BF_UNROLLED_STEP;
+             p_box_index -= BF_UNROLLED_STEP)
+        {
+            __m256i p_odd  = _mm256_set1_epi32((int) state->p_box[p_box_index + 1]);
+            __m256i p_even = _mm256_set1_epi32((int) state->p_box[p_box_index]);
+
+            data_l0 = _mm256_xor_si256(data_l0, p_odd);
+            data_l1 = _mm256_xor_si256(data_l1, p_odd);
+            data_r0 = _mm256_xor_si256(data_r0, _mm256_xor_si256(blowfish_avx2_f(state, data_l0), p_even));
+            data_r1 = _mm256_xor_si256(data_r1, _mm256_xor_si256(blowfish_avx2_f(state, data_l1), p_even));
+            data_l0 = _mm256_xor_si256(data_l0, blowfish_avx2_f(state, data_r0));
+            data_l1 = _mm256_xor_si256(data_l1, blowfish_avx2_f(state, data_r1));
+        }
+
+        __m256i final_l = _mm256_set1_epi32((int) state->p_box[0]);
+        __m256i final_r = _mm256_set1_epi32((int) state->p_box[1]);
+        blowfish_avx2_store(&output[block_index],
+                            _mm256_xor_si256(data_r0, final_l),
+                            _mm256_xor_si256(data_l0, final_r));
+        blowfish_avx2_store(&output[block_index + BF_AVX2_LANES],
+                            _mm256_xor_si256(data_r1, final_l),
+                            _mm256_xor_si256(data_l1, final_r));
+    }
+
+    // Decrypt the remaining blocks using the interleaved scalar kernel
+    blowfish_interleaved_decrypt64_blocks(state, &input[block_index], &output[block_index],
+                                          block_count - block_index);
+}
+
+
+/**
+ * Encrypts an array of 64 bit blocks, 32 blocks at a time using AVX-512
+ *
+ * Must only be called if blowfish_simd_avx512_supported() returns non-zero.
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+BF_TARGET_AVX512
+void blowfish_avx512_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count)
+{
+    size_t block_index = 0;
+    for (; block_index + BF_AVX512_BLOCKS <= block_count; block_index += BF_AVX512_BLOCKS)
+    {
+        __m512i data_l0;
+        __m512i data_r0;
+        __m512i data_l1;
+        __m512i data_r1;
+        blowfish_avx512_load(&input[block_index], &data_l0, &data_r0);
+        blowfish_avx512_load(&input[block_index + BF_AVX512_LANES], &data_l1, &data_r1);
+
+        for (size_t p_box_index = 0; p_box_index < BF_ROUNDS; p_box_index += BF_UNROLLED_STEP)
+        {
+            __m512i p_even = _mm512_set1_epi32((int) state->p_box[p_box_index]);
+            __m512i p_odd  = _mm512_set1_epi32((int) state->p_box[p_box_index + 1]);
+
+            data_l0 = _mm512_xor_si512(data_l0, p_even);
+            data_l1 = _mm512_xor_si512(data_l1, p_even);
+            data_r0 = _mm512_xor_si512(data_r0, _mm512_xor_si512(blowfish_avx512_f(state, data_l0), p_odd));
+            data_r1 = _mm512_xor_si512(data_r1, _mm512_xor_si512(blowfish_avx512_f(state, data_l1), p_odd));
+            data_l0 = _mm512_xor_si512(data_l0, blowfish_avx512_f(state, data_r0));
+            data_l1 = _mm512_xor_si512(data_l1, blowfish_avx512_f(state, data_r1));
+        }
+
+        __m512i final_l = _mm512_set1_epi32((int) state->p_box[17]);
+        __m512i final_r = _mm512_set1_epi32((int) state->p_box[16]);
+        blowfish_avx512_store(&output[block_index],
+                              _mm512_xor_si512(data_r0, final_l),
+                              _mm512_xor_si512(data_l0, final_r));
+        blowfish_avx512_store(&output[block_index + BF_AVX512_LANES],
+                              _mm512_xor_si512(data_r1, final_l),
+                              _mm512_xor_si512(data_l1, final_r));
+    }
+
+    // Encrypt the remaining blocks using the interleaved scalar kernel
+    blowfish_interleaved_encrypt64_blocks(state, &input[block_index], &output[block_index],
+                                          block_count - block_index);
+}
+
+
+/**
+ * Decrypts an array of 64 bit blocks, 32 blocks at a time using AVX-512
+ *
+ * Must only be called if blowfish_simd_avx512_supported() returns non-zero.
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+BF_TARGET_AVX512
+void blowfish_avx512_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count)
+{
+    size_t block_index = 0;
+    for (; block_index + BF_AVX512_BLOCKS <= block_count; block_index += BF_AVX512_BLOCKS)
+    {
+        __m512i data_l0;
+        __m512i data_r0;
+        __m512i data_l1;
+        __m512i data_r1;
+        blowfish_avx512_load(&input[block_index], &data_l0, &data_r0);
+        blowfish_avx512_load(&input[block_index + BF_AVX512_LANES], &data_l1, &data_r1);
+
+        for (size_t p_box_index = BF_ROUNDS;
+             p_box_index >= BF_UNROLLED_STEP;
+             p_box_index -= BF_UNROLLED_STEP)
+        {
+            __m512i p_odd  = _mm512_set1_epi32((int) state->p_box[p_box_index + 1]);
+            __m512i p_even = _mm512_set1_epi32((int) state->p_box[p_box_index]);
+
+            data_l0 = _mm512_xor_si512(data_l0, p_odd);
+            data_l1 = _mm512_xor_si512(data_l1, p_odd);
+            data_r0 = _mm512_xor_si512(data_r0, _mm512_xor_si512(blowfish_avx512_f(state, data_l0), p_even));
+            data_r1 = _mm512_xor_si512(data_r1, _mm512_xor_si512(blowfish_avx512_f(state, data_l1), p_even));
+            data_l0 = _mm512_xor_si512(data_l0, blowfish_avx512_f(state, data_r0));
+            data_l1 = _mm512_xor_si512(data_l1, blowfish_avx512_f(state, data_r1));
+        }
+
+        __m512i final_l = _mm512_set1_epi32((int) state->p_box[0]);
+        __m512i final_r = _mm512_set1_epi32((int) state->p_box[1]);
+        blowfish_avx512_store(&output[block_index],
+                              _mm512_xor_si512(data_r0, final_l),
+                              _mm512_xor_si512(data_l0, final_r));
+        blowfish_avx512_store(&output[block_index + BF_AVX512_LANES],
+                              _mm512_xor_si512(data_r1, final_l),
+                              _mm512_xor_si512(data_l1, final_r));
+    }
+
+    // Decrypt the remaining blocks using the interleaved scalar kernel
+    blowfish_interleaved_decrypt64_blocks(state, &input[block_index], &output[block_index],
+                                          block_count - block_index);
+}
+
+
+/**
+ * The Blowfish algorithm's "F" function for 8 lanes, using AVX2 gathers
+ *
+ * @param state The cipher state object
+ * @param value The input values to operate on
+ * @return      The results of the Blowfish algorithm's "F" function
+ */
+BF_TARGET_AVX2
+static inline __m256i blowfish_avx2_f(const bf_state *state, __m256i value)
+{
+    const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+
+    __m256i index_0 = _mm256_srli_epi32(value, 24);
+    __m256i index_1 = _mm256_and_si256(_mm256_srli_epi32(value, 16), byte_mask);
+    __m256i index_2 = _mm256_and_si256(_mm256_srli_epi32(value,  8), byte_mask);
+    __m256i index_3 = _mm256_and_si256(value, byte_mask);
+
+    __m256i result = _mm256_i32gather_epi32((const int *) state->s_box[0], index_0, 4);
+    result = _mm256_add_epi32(result, _mm256_i32gather_epi32((const int *) state->s_box[1], index_1, 4));
+    result = _mm256_xor_si256(result, _mm256_i32gather_epi32((const int *) state->s_box[2], index_2, 4));
+    result = _mm256_add_epi32(result, _mm256_i32gather_epi32((const int *) state->s_box[3], index_3, 4));
+
+    return result;
+}
+
+
+/**
+ * Loads 8 blocks and splits them into their left and right 32 bit halves
+ *
+ * @param input  The blocks to load
+ * @param data_l Receives the left 32 bits of each block
+ * @param data_r Receives the right 32 bits of each block
+ */
+BF_TARGET_AVX2
+static inline void blowfish_avx2_load(const uint64_t *input, __m256i *data_l, __m256i *data_r)
+{
+    // Sorts each 128 bit half to right halves followed by left halves
+    const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    __m256i low  = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *) input), split);
+    __m256i high = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i *) &input[4]), split);
+
+    (*data_r) = _mm256_permute2x128_si256(low, high, 0x20);
+    (*data_l) = _mm256_permute2x128_si256(low, high, 0x31);
+}
+
+
+/**
+ * Joins the left and right 32 bit halves of 8 blocks and stores the blocks
+ *
+ * @param output Receives the blocks
+ * @param data_l The left 32 bits of each block
+ * @param data_r The right 32 bits of each block
+ */
+BF_TARGET_AVX2
+static inline void blowfish_avx2_store(uint64_t *output, __m256i data_l, __m256i data_r)
+{
+    __m256i low  = _mm256_unpacklo_epi32(data_r, data_l);
+    __m256i high = _mm256_unpackhi_epi32(data_r, data_l);
+
+    _mm256_storeu_si256((__m256i *) output, _mm256_permute2x128_si256(low, high, 0x20));
+    _mm256_storeu_si256((__m256i *) &output[4], _mm256_permute2x128_si256(low, high, 0x31));
+}
+
+
+/**
+ * The Blowfish algorithm's "F" function for 16 lanes, using AVX-512 gathers
+ *
+ * @param state The cipher state object
+ * @param value The input values to operate on
+ * @return      The results of the Blowfish algorithm's "F" function
+ */
+BF_TARGET_AVX512
+static inline __m512i blowfish_avx512_f(const bf_state *state, __m512i value)
+{
+    const __m512i byte_mask = _mm512_set1_epi32(0xFF);
+
+    __m512i index_0 = _mm512_srli_epi32(value, 24);
+    __m512i index_1 = _mm512_and_si512(_mm512_srli_epi32(value, 16), byte_mask);
+    __m512i index_2 = _mm512_and_si512(_mm512_srli_epi32(value,  8), byte_mask);
+    __m512i index_3 = _mm512_and_si512(value, byte_mask);
+
+    __m512i result = _mm512_i32gather_epi32(index_0, state->s_box[0], 4);
+    result = _mm512_add_epi32(result, _mm512_i32gather_epi32(index_1, state->s_box[1], 4));
+    result = _mm512_xor_si512(result, _mm512_i32gather_epi32(index_2, state->s_box[2], 4));
+    result = _mm512_add_epi32(result, _mm512_i32gather_epi32(index_3, state->s_box[3], 4));
+
+    return result;
+}
+
+
+/**
+ * Loads 16 blocks and splits them into their left and right 32 bit halves
+ *
+ * @param input  The blocks to load
+ * @param data_l Receives the left 32 bits of each block
+ * @param data_r Receives the right 32 bits of each block
+ */
+BF_TARGET_AVX512
+static inline void blowfish_avx512_load(const uint64_t *input, __m512i *data_l, __m512i *data_r)
+{
+    const __m512i even = _mm512_setr_epi32(0,  2,  4,  6,  8, 10, 12, 14,
+                                           16, 18, 20, 22, 24, 26, 28, 30);
+    const __m512i odd  = _mm512_setr_epi32(1,  3,  5,  7,  9, 11, 13, 15,
+                                           17, 19, 21, 23, 25, 27, 29, 31);
+
+    __m512i low  = _mm512_loadu_si512(input);
+    __m512i high = _mm512_loadu_si512(&input[8]);
+
+    (*data_r) = _mm512_permutex2var_epi32(low, even, high);
+    (*data_l) = _mm512_permutex2var_epi32(low, odd, high);
+}
+
+
+/**
+ * Joins the left and right 32 bit halves of 16 blocks and stores the blocks
+ *
+ * @param output Receives the blocks
+ * @param data_l The left 32 bits of each block
+ * @param data_r The right 32 bits of each block
+ */
+BF_TARGET_AVX512
+static inline void blowfish_avx512_store(uint64_t *output, __m512i data_l, __m512i data_r)
+{
+    const __m512i interleave_low  = _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, 19,
+                                                      4, 20, 5, 21, 6, 22, 7, 23);
+    const __m512i interleave_high = _mm512_setr_epi32(8, 24,  9, 25, 10, 26, 11, 27,
+                                                      12, 28, 13, 29, 14, 30, 15, 31);
+
+    _mm512_storeu_si512(output, _mm512_permutex2var_epi32(data_r, interleave_low, data_l));
+    _mm512_storeu_si512(&output[8], _mm512_permutex2var_epi32(data_r, interleave_high, data_l));
+}
+
+#else /* BF_SIMD_X86 */
+
+/**
+ * Scalar substitute for the AVX2 encryption kernel on non-x86 platforms
+ */
+void blowfish_avx2_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                    size_t block_count)
+{
+    blowfish_interleaved_encrypt64_blocks(state, input, output, block_count);
+}
+
+
+/**
+ * Scalar substitute for the AVX2 decryption kernel on non-x86 platforms
+ */
+void blowfish_avx2_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                    size_t block_count)
+{
+    blowfish_interleaved_decrypt64_blocks(state, input, output, block_count);
+}
+
+
+/**
+ * Scalar substitute for the AVX-512 encryption kernel on non-x86 platforms
+ */
+void blowfish_avx512_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count)
+{
+    blowfish_interleaved_encrypt64_blocks(state, input, output, block_count);
+}
+
+
+/**
+ * Scalar substitute for the AVX-512 decryption kernel on non-x86 platforms
+ */
+void blowfish_avx512_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count)
+{
+    blowfish_interleaved_decrypt64_blocks(state, input, output, block_count);
+}
+
+#endif /* BF_SIMD_X86 */
@@ -0,0 +1,72 @@
+#ifndef BLOWFISH_SIMD_H
+#define	BLOWFISH_SIMD_H
+
+#include <blowfish.h>
+
+/**
+ * Indicates whether the AVX2 kernel can run on this CPU
+ *
+ * @return Non-zero if the AVX2 kernel is supported, zero otherwise
+ */
+int blowfish_simd_avx2_supported(void);
+
+/**
+ * Indicates whether the AVX-512 kernel can run on this CPU
+ *
+ * @return Non-zero if the AVX-512 kernel is supported, zero otherwise
+ */
+int blowfish_simd_avx512_supported(void);
+
+/**
+ * Encrypts an array of 64 bit blocks, 16 blocks at a time using AVX2
+ *
+ * Must only be called if blowfish_simd_avx2_supported() returns non-zero.
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+void blowfish_avx2_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                    size_t block_count);
+
+/**
+ * Decrypts an array of 64 bit blocks, 16 blocks at a time using AVX2
+ *
+ * Must only be called if blowfish_simd_avx2_supported() returns non-zero.
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+void blowfish_avx2_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                    size_t block_count);
+
+/**
+ * Encrypts an array of 64 bit blocks, 32 blocks at a time using AVX-512
+ *
+ * Must only be called if blowfish_simd_avx512_supported() returns non-zero.
+ *
+ * @param state       The cipher state object
+ * @param input       The plain text blocks to encrypt
+ * @param output      Receives the cipher text blocks; may be the same array as input
+ * @param block_count The number of blocks to encrypt
+ */
+void blowfish_avx512_encrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count);
+
+/**
+ * Decrypts an array of 64 bit blocks, 32 blocks at a time using AVX-512
+ *
+ * Must only be called if blowfish_simd_avx512_supported() returns non-zero.
+ *
+ * @param state       The cipher state object
+ * @param input       The cipher text blocks to decrypt
+ * @param output      Receives the plain text blocks; may be the same array as input
+ * @param block_count The number of blocks to decrypt
+ */
+void blowfish_avx512_decrypt64_blocks(const bf_state *state, const uint64_t *input, uint64_t *output,
+                                      size_t block_count);
+
+#endif	/* BLOWFISH_SIMD_H */
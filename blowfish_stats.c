@@ -0,0 +1,349 @@
+/**
+ * Optional per-thread counters and latency histograms
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish_stats.h>
+#include <string.h>
+
+#ifdef BLOWFISH_STATS
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Cache line size, the alignment of each thread's record
+const size_t BF_STATS_ALIGNMENT = 64;
+
+typedef struct bf_stats_record_s bf_stats_record;
+struct bf_stats_record_s
+{
+    bf_stats_snapshot values;
+    bf_stats_record   *prev;
+    bf_stats_record   *next;
+};
+
+static pthread_once_t blowfish_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t blowfish_stats_key;
+static int blowfish_stats_key_valid = 0;
+
+// Protects the list of records and the totals of exited threads;
+// only taken on a thread's first update, on thread exit and by snapshots
+static pthread_mutex_t blowfish_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static bf_stats_record *blowfish_stats_records = NULL;
+static bf_stats_snapshot blowfish_stats_retired;
+
+static void blowfish_stats_init(void);
+static bf_stats_record *blowfish_stats_thread_record(void);
+static void blowfish_stats_release(void *arg);
+static inline void blowfish_stats_add(uint64_t *value, uint64_t amount);
+static void blowfish_stats_merge(bf_stats_snapshot *snapshot, const bf_stats_snapshot *values);
+
+#endif	/* BLOWFISH_STATS */
+
+static const char *const BF_STATS_COUNTER_NAMES[BF_STATS_COUNTER_COUNT] =
+{
+    "blocks",
+    "bytes",
+    "key_schedules",
+    "allocations"
+};
+
+static const char *const BF_STATS_OPERATION_NAMES[BF_STATS_OPERATION_COUNT] =
+{
+    "cfb64_encrypt",
+    "cfb64_decrypt",
+    "ctr64_crypt"
+};
+
+
+/**
+ * Collects the statistics of all threads
+ *
+ * @param snapshot Receives the statistics
+ * @return         0 on success, -1 if the library was built without BLOWFISH_STATS
+ */
+int blowfish_stats_snapshot(bf_stats_snapshot *snapshot)
+{
+    memset(snapshot, 0, sizeof (bf_stats_snapshot));
+
+#ifdef BLOWFISH_STATS
+    pthread_mutex_lock(&blowfish_stats_lock);
+    blowfish_stats_merge(snapshot, &blowfish_stats_retired);
+    for (bf_stats_record *record = blowfish_stats_records; record != NULL; record = record->next)
+    {
+        blowfish_stats_merge(snapshot, &record->values);
+        ++snapshot->thread_count;
+    }
+    pthread_mutex_unlock(&blowfish_stats_lock);
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+
+/**
+ * Returns the name of a counter
+ *
+ * @param counter The counter
+ * @return        The counter's name, e.g. "bytes", or "unknown" if counter is not a counter
+ */
+const char *blowfish_stats_counter_name(bf_stats_counter counter)
+{
+    // Also rejects values below 0, which wrap around to large values
+    if ((size_t) counter >= BF_STATS_COUNTER_COUNT)
+    {
+        return "unknown";
+    }
+
+    return BF_STATS_COUNTER_NAMES[counter];
+}
+
+
+/**
+ * Returns the name of an operation
+ *
+ * @param operation The operation
+ * @return          The operation's name, e.g. "cfb64_encrypt", or "unknown" if operation
+ *                  is not an operation
+ */
+const char *blowfish_stats_operation_name(bf_stats_operation operation)
+{
+    // Also rejects values below 0, which wrap around to large values
+    if ((size_t) operation >= BF_STATS_OPERATION_COUNT)
+    {
+        return "unknown";
+    }
+
+    return BF_STATS_OPERATION_NAMES[operation];
+}
+
+#ifdef BLOWFISH_STATS
+
+/**
+ * Adds to a counter of the calling thread
+ *
+ * @param counter The counter
+ * @param amount  The amount to add
+ */
+void blowfish_stats_count(bf_stats_counter counter, uint64_t amount)
+{
+    bf_stats_record *record = blowfish_stats_thread_record();
+    if (record != NULL)
+    {
+        blowfish_stats_add(&record->values.counters[counter], amount);
+    }
+}
+
+
+/**
+ * Returns the start time for blowfish_stats_record()
+ *
+ * @return Time of the monotonic clock in nanoseconds
+ */
+uint64_t blowfish_stats_start(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+
+/**
+ * Records a completed operation of the calling thread
+ *
+ * @param operation The operation
+ * @param start     The time returned by blowfish_stats_start() when the operation started
+ * @param bytes     Number of bytes processed
+ * @param blocks    Number of blocks processed
+ */
+void blowfish_stats_record(bf_stats_operation operation, uint64_t start, uint64_t bytes, uint64_t blocks)
+{
+    uint64_t elapsed = blowfish_stats_start() - start;
+
+    bf_stats_record *record = blowfish_stats_thread_record();
+    if (record != NULL)
+    {
+        // Bucket n holds durations with the highest set bit n
+        size_t bucket = 0;
+        if (elapsed > 0)
+        {
+            bucket = (size_t) (63 - __builtin_clzll(elapsed));
+            if (bucket >= BF_STATS_BUCKET_COUNT)
+            {
+                bucket = BF_STATS_BUCKET_COUNT - 1;
+            }
+        }
+
+        bf_stats_histogram *histogram = &record->values.latency[operation];
+        blowfish_stats_add(&histogram->count, 1);
+        blowfish_stats_add(&histogram->total_ns, elapsed);
+        blowfish_stats_add(&histogram->buckets[bucket], 1);
+        blowfish_stats_add(&record->values.counters[BF_STATS_BYTES], bytes);
+        blowfish_stats_add(&record->values.counters[BF_STATS_BLOCKS], blocks);
+    }
+}
+
+
+/**
+ * Creates the key of the per-thread records
+ */
+static void blowfish_stats_init(void)
+{
+    blowfish_stats_key_valid = pthread_key_create(&blowfish_stats_key, blowfish_stats_release) == 0;
+}
+
+
+/**
+ * Returns the calling thread's record, creating it on first use
+ *
+ * @return The thread's record, or NULL if out of resources
+ */
+static bf_stats_record *blowfish_stats_thread_record(void)
+{
+    pthread_once(&blowfish_stats_once, blowfish_stats_init);
+    if (!blowfish_stats_key_valid)
+    {
+        return NULL;
+    }
+
+    bf_stats_record *record = pthread_getspecific(blowfish_stats_key);
+    if (record == NULL)
+    {
+        // Aligned to keep the records of different threads on separate cache lines
+        void *memory = NULL;
+        if (posix_memalign(&memory, BF_STATS_ALIGNMENT, sizeof (bf_stats_record)) == 0)
+        {
+            record = memory;
+            memset(&record->values, 0, sizeof (bf_stats_snapshot));
+            record->prev = NULL;
+            if (pthread_setspecific(blowfish_stats_key, record) == 0)
+            {
+                pthread_mutex_lock(&blowfish_stats_lock);
+                record->next = blowfish_stats_records;
+                if (blowfish_stats_records != NULL)
+                {
+                    blowfish_stats_records->prev = record;
+                }
+                blowfish_stats_records = record;
+                pthread_mutex_unlock(&blowfish_stats_lock);
+            }
+            else
+            {
+                free(record);
+                record = NULL;
+            }
+        }
+    }
+
+    return record;
+}
+
+
+/**
+ * Adds a thread's statistics to the totals of exited threads and frees its record
+ *
+ * Called on thread exit.
+ *
+ * @param arg The thread's record
+ */
+static void blowfish_stats_release(void *arg)
+{
+    bf_stats_record *record = arg;
+
+    pthread_mutex_lock(&blowfish_stats_lock);
+    blowfish_stats_merge(&blowfish_stats_retired, &record->values);
+
+    if (record->prev != NULL)
+    {
+        record->prev->next = record->next;
+    }
+    else
+    {
+        blowfish_stats_records = record->next;
+    }
+    if (record->next != NULL)
+    {
+        record->next->prev = record->prev;
+    }
+    pthread_mutex_unlock(&blowfish_stats_lock);
+
+    free(record);
+}
+
+
+/**
+ * Adds to a counter that is only written by the calling thread
+ *
+ * A relaxed load and store instead of an atomic read-modify-write keeps
+ * the update as cheap as a plain addition, while still allowing other
+ * threads to read the counter without tearing.
+ *
+ * @param value  The counter
+ * @param amount The amount to add
+ */
+static inline void blowfish_stats_add(uint64_t *value, uint64_t amount)
+{
+    __atomic_store_n(value, __atomic_load_n(value, __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Adds one set of statistics to another
+ *
+ * @param snapshot Receives the sum
+ * @param values   The statistics to add, may be updated concurrently by their thread
+ */
+static void blowfish_stats_merge(bf_stats_snapshot *snapshot, const bf_stats_snapshot *values)
+{
+    for (size_t counter = 0; counter < BF_STATS_COUNTER_COUNT; ++counter)
+    {
+        snapshot->counters[counter] += __atomic_load_n(&values->counters[counter], __ATOMIC_RELAXED);
+    }
+
+    for (size_t operation = 0; operation < BF_STATS_OPERATION_COUNT; ++operation)
+    {
+        bf_stats_histogram *target = &snapshot->latency[operation];
+        const bf_stats_histogram *source = &values->latency[operation];
+        target->count    += __atomic_load_n(&source->count, __ATOMIC_RELAXED);
+        target->total_ns += __atomic_load_n(&source->total_ns, __ATOMIC_RELAXED);
+        for (size_t bucket = 0; bucket < BF_STATS_BUCKET_COUNT; ++bucket)
+        {
+            target->buckets[bucket] += __atomic_load_n(&source->buckets[bucket], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+#endif	/* BLOWFISH_STATS */
@@ -0,0 +1,128 @@
+#ifndef BLOWFISH_STATS_H
+#define	BLOWFISH_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+enum bf_stats_counter_e
+{
+    // Blocks processed by the CFB and CTR mode functions
+    BF_STATS_BLOCKS,
+    // Bytes processed by the CFB and CTR mode functions
+    BF_STATS_BYTES,
+    // Key schedule expansions, including each expansion of an EksBlowfish setup
+    BF_STATS_KEY_SCHEDULES,
+    // Cipher contexts and key schedules allocated
+    BF_STATS_ALLOCATIONS
+};
+typedef enum bf_stats_counter_e bf_stats_counter;
+
+// Number of counters in a snapshot
+#define BF_STATS_COUNTER_COUNT 4
+
+enum bf_stats_operation_e
+{
+    BF_STATS_CFB64_ENCRYPT,
+    BF_STATS_CFB64_DECRYPT,
+    BF_STATS_CTR64_CRYPT
+};
+typedef enum bf_stats_operation_e bf_stats_operation;
+
+// Number of operations with a latency histogram
+#define BF_STATS_OPERATION_COUNT 3
+
+// Number of latency histogram buckets
+#define BF_STATS_BUCKET_COUNT 32
+
+typedef struct bf_stats_histogram_s bf_stats_histogram;
+struct bf_stats_histogram_s
+{
+    uint64_t count;
+    uint64_t total_ns;
+    // buckets[n] counts calls that took 2^n to 2^(n+1) - 1 ns; bucket 0 includes
+    // calls below 1 ns, and the last bucket includes all longer calls
+    uint64_t buckets[BF_STATS_BUCKET_COUNT];
+};
+
+typedef struct bf_stats_snapshot_s bf_stats_snapshot;
+struct bf_stats_snapshot_s
+{
+    uint64_t           counters[BF_STATS_COUNTER_COUNT];
+    bf_stats_histogram latency[BF_STATS_OPERATION_COUNT];
+    // Number of running threads that have recorded statistics
+    size_t             thread_count;
+};
+
+/**
+ * Collects the statistics of all threads
+ *
+ * The statistics include those of threads that have exited. Each thread
+ * updates only its own counters, and the counters are read without
+ * stopping the threads, so a snapshot taken while cipher operations are
+ * running is not an atomic cut across all counters.
+ *
+ * @param snapshot Receives the statistics; cleared if the library was
+ *                 built without BLOWFISH_STATS
+ * @return         0 on success, -1 if the library was built without BLOWFISH_STATS
+ */
+int blowfish_stats_snapshot(bf_stats_snapshot *snapshot);
+
+/**
+ * Returns the name of a counter
+ *
+ * @param counter The counter
+ * @return        The counter's name, e.g. "bytes", or "unknown" if counter is not a counter
+ */
+const char *blowfish_stats_counter_name(bf_stats_counter counter);
+
+/**
+ * Returns the name of an operation
+ *
+ * @param operation The operation
+ * @return          The operation's name, e.g. "cfb64_encrypt", or "unknown" if operation
+ *                  is not an operation
+ */
+const char *blowfish_stats_operation_name(bf_stats_operation operation);
+
+#ifdef BLOWFISH_STATS
+
+/**
+ * Adds to a counter of the calling thread
+ *
+ * @param counter The counter
+ * @param amount  The amount to add
+ */
+void blowfish_stats_count(bf_stats_counter counter, uint64_t amount);
+
+/**
+ * Returns the start time for blowfish_stats_record()
+ *
+ * @return Time of the monotonic clock in nanoseconds
+ */
+uint64_t blowfish_stats_start(void);
+
+/**
+ * Records a completed operation of the calling thread
+ *
+ * @param operation The operation
+ * @param start     The time returned by blowfish_stats_start() when the operation started
+ * @param bytes     Number of bytes processed
+ * @param blocks    Number of blocks processed
+ */
+void blowfish_stats_record(bf_stats_operation operation, uint64_t start, uint64_t bytes, uint64_t blocks);
+
+#define BF_STATS_COUNT(counter, amount) blowfish_stats_count((counter), (amount))
+#define BF_STATS_START(start) uint64_t start = blowfish_stats_start()
+#define BF_STATS_RECORD(operation, start, bytes, blocks) \
+    blowfish_stats_record((operation), (start), (bytes), (blocks))
+
+#else
+
+// Instrumentation is compiled out; the arguments are not evaluated
+#define BF_STATS_COUNT(counter, amount) ((void) 0)
+#define BF_STATS_START(start) ((void) 0)
+#define BF_STATS_RECORD(operation, start, bytes, blocks) ((void) 0)
+
+#endif	/* BLOWFISH_STATS */
+
+#endif	/* BLOWFISH_STATS_H */
@@ -0,0 +1,118 @@
+/**
+ * Thread helpers for the parallel cipher functions
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish_thread.h>
+#include <pthread.h>
+
+typedef struct bf_thread_task_s bf_thread_task;
+struct bf_thread_task_s
+{
+    bf_task_func task;
+    void         *context;
+    size_t       task_index;
+    pthread_t    thread;
+    int          started;
+};
+
+static void *blowfish_thread_main(void *arg);
+
+
+/**
+ * Runs a number of tasks in parallel and waits for their completion
+ *
+ * @param task       The function to run for each task
+ * @param context    The context object passed to each task
+ * @param task_count The number of tasks
+ */
+void blowfish_thread_run(bf_task_func task, void *context, size_t task_count)
+{
+    bf_thread_task *thread_tasks = NULL;
+    if (task_count > 1)
+    {
+        thread_tasks = malloc(sizeof (bf_thread_task) * task_count);
+    }
+
+    if (thread_tasks != NULL)
+    {
+        for (size_t task_index = 1; task_index < task_count; ++task_index)
+        {
+            bf_thread_task *thread_task = &thread_tasks[task_index];
+            thread_task->task       = task;
+            thread_task->context    = context;
+            thread_task->task_index = task_index;
+            thread_task->started    = pthread_create(&thread_task->thread, NULL,
+                                                     blowfish_thread_main, thread_task) == 0;
+        }
+
+        task(context, 0);
+
+        for (size_t task_index = 1; task_index < task_count; ++task_index)
+        {
+            bf_thread_task *thread_task = &thread_tasks[task_index];
+            if (thread_task->started)
+            {
+                pthread_join(thread_task->thread, NULL);
+            }
+            else
+            {
+                task(context, task_index);
+            }
+        }
+
+        free(thread_tasks);
+    }
+    else
+    {
+        // Single task, or out of memory
+        for (size_t task_index = 0; task_index < task_count; ++task_index)
+        {
+            task(context, task_index);
+        }
+    }
+}
+
+
+/**
+ * Thread entry point, runs a single task
+ *
+ * @param arg The bf_thread_task object describing the task
+ * @return    Always NULL
+ */
+static void *blowfish_thread_main(void *arg)
+{
+    bf_thread_task *thread_task = arg;
+    thread_task->task(thread_task->context, thread_task->task_index);
+
+    return NULL;
+}
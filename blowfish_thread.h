@@ -0,0 +1,21 @@
+#ifndef BLOWFISH_THREAD_H
+#define	BLOWFISH_THREAD_H
+
+#include <stdlib.h>
+
+typedef void (*bf_task_func)(void *context, size_t task_index);
+
+/**
+ * Runs a number of tasks in parallel and waits for their completion
+ *
+ * Calls task(context, task_index) for each task_index from 0 to task_count - 1,
+ * each on a separate thread. The first task runs on the calling thread.
+ * If a thread cannot be created, its task runs on the calling thread instead.
+ *
+ * @param task       The function to run for each task
+ * @param context    The context object passed to each task
+ * @param task_count The number of tasks
+ */
+void blowfish_thread_run(bf_task_func task, void *context, size_t task_count);
+
+#endif	/* BLOWFISH_THREAD_H */
@@ -0,0 +1,219 @@
+/**
+ * Tests of the bcrypt password hash with the OpenWall crypt_blowfish test vectors
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <blowfish_eks.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct test_eks_vector_s test_eks_vector;
+struct test_eks_vector_s
+{
+    const char *hash;
+    const char *password;
+};
+
+// Test vectors of OpenWall's crypt_blowfish; the last password is longer
+// than BF_EKS_MAX_KEY_LENGTH, so only its first 72 bytes are used
+const test_eks_vector TEST_EKS_VECTORS[] =
+{
+    { "$2b$05$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOeW", "U*U" },
+    { "$2b$05$CCCCCCCCCCCCCCCCCCCCC.VGOzA784oUp/Z0DY336zx7pLYAy0lwK", "U*U*" },
+    { "$2b$05$XXXXXXXXXXXXXXXXXXXXXOAcXxm9kjPGEMsLznoKqmqw7tc8WCx4a", "U*U*U" },
+    { "$2b$05$CCCCCCCCCCCCCCCCCCCCC.7uG0VCzI2bS7j6ymqJi9CdcdxiRTWNy", "" },
+    {
+        "$2b$05$abcdefghijklmnopqrstuu5s2v8.iXieOjg/.AySBTTZIIVFJeBui",
+        "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789chars after 72 are ignored"
+    }
+};
+
+// Number of test vectors
+#define TEST_EKS_VECTOR_COUNT (sizeof (TEST_EKS_VECTORS) / sizeof (TEST_EKS_VECTORS[0]))
+
+// Cost of all test vectors
+const unsigned int TEST_EKS_COST = 5;
+
+// Strings that are not valid bcrypt hashes
+const char *const TEST_EKS_INVALID[] =
+{
+    "$2x$05$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOeW",
+    "$2b$03$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOeW",
+    "$2b$05$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOe",
+    ""
+};
+
+// Number of invalid strings
+#define TEST_EKS_INVALID_COUNT (sizeof (TEST_EKS_INVALID) / sizeof (TEST_EKS_INVALID[0]))
+
+static int test_eks_vector_check(const test_eks_vector *vector);
+static int test_eks_invalid(void);
+static int test_eks_batch(void);
+static int test_eks_report(const char *name, int passed);
+
+
+int main(void)
+{
+    int rc = EXIT_SUCCESS;
+    for (size_t index = 0; index < TEST_EKS_VECTOR_COUNT; ++index)
+    {
+        if (test_eks_vector_check(&TEST_EKS_VECTORS[index]) != 0)
+        {
+            rc = EXIT_FAILURE;
+        }
+    }
+    if (test_eks_invalid() != 0)
+    {
+        rc = EXIT_FAILURE;
+    }
+    if (test_eks_batch() != 0)
+    {
+        rc = EXIT_FAILURE;
+    }
+    return rc;
+}
+
+
+/**
+ * Checks that a test vector is parsed and formatted back to the same string,
+ * that its password verifies and that a different password does not
+ *
+ * @param vector The test vector
+ * @return       0 if the test passed, -1 otherwise
+ */
+static int test_eks_vector_check(const test_eks_vector *vector)
+{
+    int passed = 0;
+    bf_eks_hash hash;
+    char output[BF_EKS_STRING_LENGTH];
+    const unsigned char *password = (const unsigned char *) vector->password;
+    size_t password_length = strlen(vector->password);
+    if (blowfish_eks_parse(&hash, vector->hash) == 0 && hash.cost == TEST_EKS_COST &&
+        blowfish_eks_format(&hash, output) == 0 && strcmp(output, vector->hash) == 0)
+    {
+        passed = blowfish_eks_verify(&hash, password, password_length) == 1;
+        if (password_length >= BF_EKS_MAX_KEY_LENGTH)
+        {
+            // Bytes after the first BF_EKS_MAX_KEY_LENGTH do not change the digest,
+            // the ones before do
+            passed &= blowfish_eks_verify(&hash, password, BF_EKS_MAX_KEY_LENGTH) == 1;
+            passed &= blowfish_eks_verify(&hash, password, BF_EKS_MAX_KEY_LENGTH - 1) == 0;
+        }
+        else
+        {
+            // The password with an appended character
+            unsigned char longer[BF_EKS_MAX_KEY_LENGTH];
+            memcpy(longer, password, password_length);
+            longer[password_length] = 'U';
+            passed &= blowfish_eks_verify(&hash, longer, password_length + 1) == 0;
+        }
+    }
+
+    char name[32];
+    snprintf(name, sizeof (name), "password \"%.16s\"", vector->password);
+    return test_eks_report(name, passed);
+}
+
+
+/**
+ * Checks that strings with an unknown prefix, a cost out of range or a
+ * wrong length are rejected
+ *
+ * @return 0 if the test passed, -1 otherwise
+ */
+static int test_eks_invalid(void)
+{
+    int passed = 1;
+    for (size_t index = 0; index < TEST_EKS_INVALID_COUNT; ++index)
+    {
+        bf_eks_hash hash;
+        passed &= blowfish_eks_parse(&hash, TEST_EKS_INVALID[index]) == -1;
+    }
+    return test_eks_report("invalid strings", passed);
+}
+
+
+/**
+ * Checks all test vectors in one batch, followed by the password of the
+ * first vector checked against the hash of the second
+ *
+ * @return 0 if the test passed, -1 otherwise
+ */
+static int test_eks_batch(void)
+{
+    int passed = 1;
+    bf_eks_hash hashes[TEST_EKS_VECTOR_COUNT + 1];
+    const unsigned char *passwords[TEST_EKS_VECTOR_COUNT + 1];
+    size_t password_lengths[TEST_EKS_VECTOR_COUNT + 1];
+    int results[TEST_EKS_VECTOR_COUNT + 1];
+    int expected[TEST_EKS_VECTOR_COUNT + 1];
+    for (size_t index = 0; index < TEST_EKS_VECTOR_COUNT; ++index)
+    {
+        passed &= blowfish_eks_parse(&hashes[index], TEST_EKS_VECTORS[index].hash) == 0;
+        passwords[index] = (const unsigned char *) TEST_EKS_VECTORS[index].password;
+        password_lengths[index] = strlen(TEST_EKS_VECTORS[index].password);
+        expected[index] = 1;
+    }
+
+    // The wrong password
+    hashes[TEST_EKS_VECTOR_COUNT] = hashes[1];
+    passwords[TEST_EKS_VECTOR_COUNT] = passwords[0];
+    password_lengths[TEST_EKS_VECTOR_COUNT] = password_lengths[0];
+    expected[TEST_EKS_VECTOR_COUNT] = 0;
+
+    if (passed && blowfish_eks_verify_batch(hashes, passwords, password_lengths, results,
+                                            TEST_EKS_VECTOR_COUNT + 1) == 0)
+    {
+        for (size_t index = 0; index <= TEST_EKS_VECTOR_COUNT; ++index)
+        {
+            passed &= results[index] == expected[index];
+        }
+    }
+    else
+    {
+        passed = 0;
+    }
+    return test_eks_report("batch with a wrong password", passed);
+}
+
+
+/**
+ * Prints the result of a test
+ *
+ * @param name   Name of the test
+ * @param passed Non-zero if the test passed
+ * @return       0 if the test passed, -1 otherwise
+ */
+static int test_eks_report(const char *name, int passed)
+{
+    printf("%s: %s\n", name, passed ? "OK" : "FAILED");
+    return passed ? 0 : -1;
+}
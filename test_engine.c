@@ -0,0 +1,457 @@
+/**
+ * Tests of the job engine's ordering and idle behavior when allocations fail
+ *
+ * @version 2026-10-16
+ * @author  Robert Altnoeder (r.altnoeder@gmx.net)
+ *
+ * Copyright (C) 2015 Robert ALTNOEDER
+ *
+ * Redistribution and use in source and binary forms,
+ * with or without modification, are permitted provided that
+ * the following conditions are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in
+ *     the documentation and/or other materials provided with the distribution.
+ *  3. The name of the author may not be used to endorse or promote products
+ *     derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE,
+ * EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <blowfish.h>
+#include <blowfish_cfb64.h>
+#include <blowfish_engine.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+// Number of streams and number of jobs submitted to each stream
+#define TEST_ENGINE_STREAMS 6
+#define TEST_ENGINE_JOBS    40
+
+// Largest length of a large and of a small job in bytes; one job in four is large
+const size_t TEST_ENGINE_MAX_LARGE = 300000;
+const size_t TEST_ENGINE_MAX_SMALL = 100;
+
+// Worker counts that the ordering test runs with
+const size_t TEST_ENGINE_WORKER_COUNTS[] = { 1, 2, 4 };
+
+// Time that a job is kept waiting for a stream object by the idle test (200 ms)
+const long TEST_ENGINE_STALL_NS = 200000000L;
+
+// Largest CPU time in seconds that the engine may use while the job waits
+const double TEST_ENGINE_MAX_STALL_CPU = 0.05;
+
+// Allocation failure modes of __wrap_malloc()
+enum test_engine_failures_e
+{
+    TEST_ENGINE_FAIL_NONE,
+    TEST_ENGINE_FAIL_HALF,
+    TEST_ENGINE_FAIL_ALL
+};
+typedef enum test_engine_failures_e test_engine_failures;
+
+typedef struct test_engine_context_s test_engine_context;
+struct test_engine_context_s
+{
+    bf_engine      *engine;
+    bf_state       cipher_state;
+    bf_cfb64_state cfb_states[TEST_ENGINE_STREAMS];
+    bf_engine_job  jobs[TEST_ENGINE_STREAMS][TEST_ENGINE_JOBS];
+    unsigned char  *data[TEST_ENGINE_STREAMS][TEST_ENGINE_JOBS];
+    unsigned char  *expected[TEST_ENGINE_STREAMS][TEST_ENGINE_JOBS];
+    size_t         lengths[TEST_ENGINE_STREAMS][TEST_ENGINE_JOBS];
+    // Index of the next job expected to complete on each stream
+    size_t         completed[TEST_ENGINE_STREAMS];
+    int            failed;
+};
+
+typedef struct test_engine_submitter_s test_engine_submitter;
+struct test_engine_submitter_s
+{
+    test_engine_context *context;
+    size_t              stream;
+    pthread_t           thread;
+};
+
+// Linked with -Wl,--wrap=malloc, so that the allocations of the engine can be made to fail
+void *__real_malloc(size_t size);
+void *__wrap_malloc(size_t size);
+
+static int test_engine_ordering(size_t worker_count);
+static int test_engine_idle(void);
+static void *test_engine_submit(void *argument);
+static void test_engine_complete(test_engine_context *context, bf_engine_job *job);
+static void test_engine_callback(bf_engine_job *job, void *callback_context);
+static int test_engine_reaps(size_t stream);
+static double test_engine_cpu_time(void);
+
+static test_engine_failures failure_mode = TEST_ENGINE_FAIL_NONE;
+static uint32_t failure_seed = 7;
+static unsigned long failure_count = 0;
+
+
+int main(void)
+{
+    int rc = EXIT_SUCCESS;
+    size_t count = sizeof (TEST_ENGINE_WORKER_COUNTS) / sizeof (TEST_ENGINE_WORKER_COUNTS[0]);
+    for (size_t index = 0; index < count; ++index)
+    {
+        if (test_engine_ordering(TEST_ENGINE_WORKER_COUNTS[index]) != 0)
+        {
+            rc = EXIT_FAILURE;
+        }
+    }
+    if (test_engine_idle() != 0)
+    {
+        rc = EXIT_FAILURE;
+    }
+    return rc;
+}
+
+
+/**
+ * Fails allocations according to the current failure mode; all other
+ * allocations are passed to the C library's malloc()
+ *
+ * @param size Size of the allocation in bytes
+ * @return     The allocated memory, or NULL if the allocation failed
+ */
+void *__wrap_malloc(size_t size)
+{
+    void *memory = NULL;
+    test_engine_failures mode = __atomic_load_n(&failure_mode, __ATOMIC_SEQ_CST);
+    int fail = mode == TEST_ENGINE_FAIL_ALL;
+    if (mode == TEST_ENGINE_FAIL_HALF)
+    {
+        uint32_t seed = __atomic_add_fetch(&failure_seed, 2654435761U, __ATOMIC_RELAXED);
+        fail = ((seed >> 16) & 1) == 0;
+    }
+    if (fail)
+    {
+        __atomic_add_fetch(&failure_count, 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        memory = __real_malloc(size);
+    }
+    return memory;
+}
+
+
+/**
+ * Submits jobs of several streams from concurrent threads while half of the
+ * engine's allocations fail, and checks that the jobs of each stream complete
+ * in submission order with the same results as a serial run
+ *
+ * Jobs of some streams complete through a callback, the others are reaped
+ * after the engine's eventfd signals them
+ *
+ * @param worker_count Number of worker threads of the engine
+ * @return             0 if the test passed, -1 otherwise
+ */
+static int test_engine_ordering(size_t worker_count)
+{
+    int rc = -1;
+    test_engine_context *context = calloc(1, sizeof (test_engine_context));
+    if (context == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return rc;
+    }
+
+    const unsigned char key[] = "0123456789abcdef";
+    blowfish_init(&context->cipher_state);
+    blowfish_set_key(&context->cipher_state, key, sizeof (key) - 1);
+
+    // Prepare the data and compute the expected results serially
+    srand(1);
+    int prepared = 1;
+    for (size_t stream = 0; stream < TEST_ENGINE_STREAMS; ++stream)
+    {
+        bf_cfb64_state reference;
+        blowfish_cfb64_init(&reference, &context->cipher_state, stream * 77);
+        blowfish_cfb64_init(&context->cfb_states[stream], &context->cipher_state, stream * 77);
+        for (size_t index = 0; index < TEST_ENGINE_JOBS; ++index)
+        {
+            size_t length = rand() % 4 == 0 ?
+                (size_t) rand() % TEST_ENGINE_MAX_LARGE : (size_t) rand() % TEST_ENGINE_MAX_SMALL;
+            unsigned char *data = malloc(length + 1);
+            unsigned char *expected = malloc(length + 1);
+            context->data[stream][index] = data;
+            context->expected[stream][index] = expected;
+            context->lengths[stream][index] = length;
+            if (data == NULL || expected == NULL)
+            {
+                prepared = 0;
+                continue;
+            }
+            for (size_t offset = 0; offset < length; ++offset)
+            {
+                data[offset] = (unsigned char) rand();
+            }
+            memcpy(expected, data, length);
+            if ((stream & 1) == 0)
+            {
+                blowfish_cfb64_encrypt(&reference, expected, length);
+            }
+            else
+            {
+                blowfish_cfb64_decrypt(&reference, expected, length);
+            }
+        }
+    }
+
+    if (prepared)
+    {
+        context->engine = blowfish_engine_create(worker_count, BF_ENGINE_EVENTFD);
+    }
+    if (context->engine != NULL)
+    {
+        failure_count = 0;
+        __atomic_store_n(&failure_mode, TEST_ENGINE_FAIL_HALF, __ATOMIC_SEQ_CST);
+
+        test_engine_submitter submitters[TEST_ENGINE_STREAMS];
+        for (size_t stream = 0; stream < TEST_ENGINE_STREAMS; ++stream)
+        {
+            submitters[stream].context = context;
+            submitters[stream].stream = stream;
+            pthread_create(&submitters[stream].thread, NULL, test_engine_submit, &submitters[stream]);
+        }
+        for (size_t stream = 0; stream < TEST_ENGINE_STREAMS; ++stream)
+        {
+            pthread_join(submitters[stream].thread, NULL);
+        }
+
+        size_t reap_count = 0;
+        for (size_t stream = 0; stream < TEST_ENGINE_STREAMS; ++stream)
+        {
+            if (test_engine_reaps(stream))
+            {
+                reap_count += TEST_ENGINE_JOBS;
+            }
+        }
+        while (reap_count > 0)
+        {
+            uint64_t signals = 0;
+            if (read(blowfish_engine_eventfd(context->engine), &signals, sizeof (signals)) > 0)
+            {
+                bf_engine_job *jobs[16];
+                size_t count = 0;
+                while ((count = blowfish_engine_reap(context->engine, jobs, 16)) > 0)
+                {
+                    for (size_t index = 0; index < count; ++index)
+                    {
+                        test_engine_complete(context, jobs[index]);
+                    }
+                    reap_count -= count;
+                }
+            }
+        }
+        blowfish_engine_destroy(context->engine);
+
+        __atomic_store_n(&failure_mode, TEST_ENGINE_FAIL_NONE, __ATOMIC_SEQ_CST);
+
+        for (size_t stream = 0; stream < TEST_ENGINE_STREAMS; ++stream)
+        {
+            if (context->completed[stream] != TEST_ENGINE_JOBS)
+            {
+                context->failed = 1;
+            }
+            for (size_t index = 0; index < TEST_ENGINE_JOBS; ++index)
+            {
+                if (memcmp(context->data[stream][index], context->expected[stream][index],
+                           context->lengths[stream][index]) != 0)
+                {
+                    context->failed = 1;
+                }
+            }
+        }
+        if (context->failed == 0)
+        {
+            rc = 0;
+        }
+        printf("ordering, %zu workers, %lu failed allocations: %s\n",
+               worker_count, failure_count, rc == 0 ? "OK" : "FAILED");
+    }
+    else
+    {
+        fprintf(stderr, "Cannot create the engine\n");
+    }
+
+    for (size_t stream = 0; stream < TEST_ENGINE_STREAMS; ++stream)
+    {
+        for (size_t index = 0; index < TEST_ENGINE_JOBS; ++index)
+        {
+            free(context->data[stream][index]);
+            free(context->expected[stream][index]);
+        }
+    }
+    free(context);
+    return rc;
+}
+
+
+/**
+ * Keeps a job waiting for a stream object while all allocations fail, and
+ * checks that the idle workers sleep instead of spinning and that the job
+ * completes once allocations succeed again
+ *
+ * @return 0 if the test passed, -1 otherwise
+ */
+static int test_engine_idle(void)
+{
+    int rc = -1;
+    bf_engine *engine = blowfish_engine_create(TEST_ENGINE_WORKER_COUNTS[0], 0);
+    if (engine == NULL)
+    {
+        fprintf(stderr, "Cannot create the engine\n");
+        return rc;
+    }
+
+    const unsigned char key[] = "idle";
+    bf_state cipher_state;
+    blowfish_init(&cipher_state);
+    blowfish_set_key(&cipher_state, key, sizeof (key) - 1);
+    bf_cfb64_state cfb_state;
+    blowfish_cfb64_init(&cfb_state, &cipher_state, 0);
+
+    unsigned char data[64];
+    memset(data, 0, sizeof (data));
+    bf_engine_job job;
+    memset(&job, 0, sizeof (job));
+    job.operation = BF_ENGINE_CFB64_ENCRYPT;
+    job.cfb_state = &cfb_state;
+    job.data = data;
+    job.data_length = sizeof (data);
+
+    __atomic_store_n(&failure_mode, TEST_ENGINE_FAIL_ALL, __ATOMIC_SEQ_CST);
+    double start = test_engine_cpu_time();
+    blowfish_engine_submit(engine, &job);
+    struct timespec stall = { 0, TEST_ENGINE_STALL_NS };
+    nanosleep(&stall, NULL);
+    double stall_cpu = test_engine_cpu_time() - start;
+    __atomic_store_n(&failure_mode, TEST_ENGINE_FAIL_NONE, __ATOMIC_SEQ_CST);
+
+    // The deferred job is retried after a while even if no stream object is returned
+    bf_engine_job *completed = NULL;
+    struct timespec poll = { 0, TEST_ENGINE_STALL_NS / 100 };
+    for (unsigned int count = 0; count < 100 && completed == NULL; ++count)
+    {
+        if (blowfish_engine_reap(engine, &completed, 1) == 0)
+        {
+            nanosleep(&poll, NULL);
+        }
+    }
+    blowfish_engine_destroy(engine);
+
+    if (completed == &job && stall_cpu <= TEST_ENGINE_MAX_STALL_CPU)
+    {
+        rc = 0;
+    }
+    printf("idle, %.1f ms CPU time while waiting for a stream object, job %s: %s\n",
+           stall_cpu * 1000, completed == &job ? "completed" : "not completed", rc == 0 ? "OK" : "FAILED");
+    return rc;
+}
+
+
+/**
+ * Submits all jobs of one stream
+ *
+ * @param argument The test_engine_submitter object of the stream
+ * @return         NULL
+ */
+static void *test_engine_submit(void *argument)
+{
+    test_engine_submitter *submitter = argument;
+    test_engine_context *context = submitter->context;
+    size_t stream = submitter->stream;
+    for (size_t index = 0; index < TEST_ENGINE_JOBS; ++index)
+    {
+        bf_engine_job *job = &context->jobs[stream][index];
+        job->operation = (stream & 1) == 0 ? BF_ENGINE_CFB64_ENCRYPT : BF_ENGINE_CFB64_DECRYPT;
+        job->cfb_state = &context->cfb_states[stream];
+        job->data = context->data[stream][index];
+        job->data_length = context->lengths[stream][index];
+        job->callback = test_engine_reaps(stream) ? NULL : test_engine_callback;
+        job->context = context;
+        blowfish_engine_submit(context->engine, job);
+    }
+    return NULL;
+}
+
+
+/**
+ * Checks that a completed job is the next job of its stream
+ *
+ * @param context The test context
+ * @param job     The completed job
+ */
+static void test_engine_complete(test_engine_context *context, bf_engine_job *job)
+{
+    size_t stream = (size_t) (job->cfb_state - context->cfb_states);
+    size_t index = __atomic_fetch_add(&context->completed[stream], 1, __ATOMIC_SEQ_CST);
+    if (index >= TEST_ENGINE_JOBS || job != &context->jobs[stream][index])
+    {
+        __atomic_store_n(&context->failed, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+
+/**
+ * Completion callback of the jobs that are not reaped
+ *
+ * @param job              The completed job
+ * @param callback_context The test context
+ */
+static void test_engine_callback(bf_engine_job *job, void *callback_context)
+{
+    test_engine_complete(callback_context, job);
+}
+
+
+/**
+ * Indicates whether the jobs of a stream are reaped instead of completing
+ * through a callback
+ *
+ * @param stream Index of the stream
+ * @return       Non-zero if the jobs are reaped
+ */
+static int test_engine_reaps(size_t stream)
+{
+    return stream % 3 == 2;
+}
+
+
+/**
+ * Returns the CPU time used by the process
+ *
+ * @return CPU time in seconds
+ */
+static double test_engine_cpu_time(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (double) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+        (double) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}